@@ -0,0 +1,1113 @@
+/*
+    Description: Entry point of filemanager-bench, the reproducible benchmark
+                 of directory listing and the file operations. Builds
+                 synthetic trees, times each operation warm and cold and
+                 writes the results as JSON so runs can be compared.
+                 --syscalls instead counts the stats and syscalls of each
+                 user action against a budget, and --checks runs
+                 correctness checks of the file operations.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CopyEngine.h"
+#include "DeleteEngine.h"
+#include "DirCache.h"
+#include "DirLoader.h"
+#include "DirScanner.h"
+#include "FileActions.h"
+#include "FileOp.h"
+#include "FileStat.h"
+#include "Json.h"
+#include "Reclaimer.h"
+#include "ThreadPool.h"
+
+namespace {
+const char kUsage[] =
+    "usage: filemanager-bench [options]\n"
+    "\n"
+    "Builds synthetic trees under --dir and times listing (scan, load), copy,\n"
+    "rename (whole tree and single files), move and delete on each, with warm\n"
+    "and cold caches. Reports median and p99 latency, files/s and MB/s.\n"
+    "Run it on the filesystem you care about: tmpfs measures memory.\n"
+    "\n"
+    "options:\n"
+    "  --dir DIR          scratch directory (default: bench-data)\n"
+    "  --out FILE         JSON results (default: bench-results.json)\n"
+    "  --reps N           timed runs per operation (default: 5)\n"
+    "  --shapes LIST      comma separated: tiny,huge,deep,wide (default: all)\n"
+    "  --scale F          multiply every file count and size by F (default: 1)\n"
+    "  --threads N        copy and delete threads (default: one per CPU)\n"
+    "  --no-warm          skip the warm cache runs\n"
+    "  --no-cold          skip the cold cache runs\n"
+    "  --move-to DIR      move across to DIR (another filesystem) instead of renaming\n"
+    "  --keep             leave the generated trees in place\n"
+    "  --syscalls         count stats and syscalls per user action instead of\n"
+    "                     timing; exits 1 if an action goes over its budget\n"
+    "  --checks           run correctness checks of the file operations instead\n"
+    "                     of timing; exits 1 if one fails\n"
+    "  --tiny-files N --tiny-size BYTES      many small files (20000 x 1 KB)\n"
+    "  --huge-files N --huge-size BYTES      few large files (2 x 256 MB)\n"
+    "  --deep-depth N --deep-files N         nesting (64 levels x 8 files)\n"
+    "  --wide-files N                        one wide directory (100000 empty files)\n";
+
+constexpr std::size_t kFilesPerDir = 1000;      // tiny: files per generated directory
+constexpr std::size_t kWriteChunk = 1024 * 1024;
+constexpr std::size_t kRenameSamples = 1000;    // Single-file renames timed per run
+
+// What to build and run
+struct BenchConfig {
+    std::filesystem::path dir = "bench-data";
+    std::filesystem::path out = "bench-results.json";
+    std::filesystem::path moveTo;
+    unsigned reps = 5;
+    unsigned threads = 0;
+    double scale = 1.0;
+    bool warm = true;
+    bool cold = true;
+    bool keep = false;
+    bool syscalls = false;
+    bool checks = false;
+    std::vector<std::string> shapes = {"tiny", "huge", "deep", "wide"};
+    std::uint64_t tinyFiles = 20000;
+    std::uint64_t tinySize = 1024;
+    std::uint64_t hugeFiles = 2;
+    std::uint64_t hugeSize = 256ull * 1024 * 1024;
+    std::uint64_t deepDepth = 64;
+    std::uint64_t deepFiles = 8;
+    std::uint64_t wideFiles = 100000;
+};
+
+// A generated tree
+struct Tree {
+    std::string shape;
+    std::filesystem::path root;
+    std::uint64_t files = 0;
+    std::uint64_t dirs = 0;
+    std::uint64_t bytes = 0;
+    std::vector<std::filesystem::path> sample; // Relative paths of files for single-file renames
+};
+
+// Timings of one operation on one tree with one cache state
+struct Result {
+    std::string shape;
+    std::string op;
+    std::string cache;
+    std::vector<double> seconds;  // One per run (per call for rename-file)
+    std::uint64_t files = 0;      // Per run
+    std::uint64_t bytes = 0;      // Per run
+};
+
+// How cold runs empty the caches
+enum class ColdMethod { DropCaches, Fadvise, None };
+
+const char* ColdMethodName(ColdMethod method) {
+    switch (method) {
+    case ColdMethod::DropCaches: return "drop_caches";
+    case ColdMethod::Fadvise: return "fadvise";
+    default: return "none";
+    }
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Parse argv
+* @return false on a usage error
+*/
+bool ParseArgs(int argc, char** argv, BenchConfig& config, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                error = arg + " needs a value";
+                return nullptr;
+            }
+            return argv[++i];
+        };
+        auto number = [&](std::uint64_t& out) {
+            const char* v = value();
+            if (!v) return false;
+            char* end = nullptr;
+            out = std::strtoull(v, &end, 10);
+            if (*v == '\0' || *end != '\0') {
+                error = "bad number for " + arg + ": " + v;
+                return false;
+            }
+            return true;
+        };
+        const char* v = nullptr;
+        std::uint64_t n = 0;
+        if (arg == "-h" || arg == "--help") {
+            error.clear();
+            return false;
+        } else if (arg == "--dir") {
+            if (!(v = value())) return false;
+            config.dir = v;
+        } else if (arg == "--out") {
+            if (!(v = value())) return false;
+            config.out = v;
+        } else if (arg == "--move-to") {
+            if (!(v = value())) return false;
+            config.moveTo = v;
+        } else if (arg == "--reps") {
+            if (!number(n) || n == 0) return false;
+            config.reps = static_cast<unsigned>(n);
+        } else if (arg == "--threads") {
+            if (!number(n)) return false;
+            config.threads = static_cast<unsigned>(n);
+        } else if (arg == "--scale") {
+            if (!(v = value())) return false;
+            config.scale = std::atof(v);
+            if (config.scale <= 0) {
+                error = std::string("bad scale: ") + v;
+                return false;
+            }
+        } else if (arg == "--shapes") {
+            if (!(v = value())) return false;
+            config.shapes.clear();
+            std::string list = v;
+            for (std::size_t start = 0; start <= list.size();) {
+                const std::size_t comma = std::min(list.find(',', start), list.size());
+                const std::string shape = list.substr(start, comma - start);
+                if (shape != "tiny" && shape != "huge" && shape != "deep" && shape != "wide") {
+                    error = "unknown shape: " + shape;
+                    return false;
+                }
+                config.shapes.push_back(shape);
+                start = comma + 1;
+            }
+        } else if (arg == "--no-warm") {
+            config.warm = false;
+        } else if (arg == "--no-cold") {
+            config.cold = false;
+        } else if (arg == "--keep") {
+            config.keep = true;
+        } else if (arg == "--syscalls") {
+            config.syscalls = true;
+        } else if (arg == "--checks") {
+            config.checks = true;
+        } else if (arg == "--tiny-files") {
+            if (!number(config.tinyFiles)) return false;
+        } else if (arg == "--tiny-size") {
+            if (!number(config.tinySize)) return false;
+        } else if (arg == "--huge-files") {
+            if (!number(config.hugeFiles)) return false;
+        } else if (arg == "--huge-size") {
+            if (!number(config.hugeSize)) return false;
+        } else if (arg == "--deep-depth") {
+            if (!number(config.deepDepth)) return false;
+        } else if (arg == "--deep-files") {
+            if (!number(config.deepFiles)) return false;
+        } else if (arg == "--wide-files") {
+            if (!number(config.wideFiles)) return false;
+        } else {
+            error = "unknown option: " + arg;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::uint64_t Scaled(std::uint64_t n, double scale) {
+    return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::llround(n * scale)));
+}
+
+/* Write size bytes of incompressible data, different for every seed
+* @return false with ec on error
+*/
+bool WriteFile(const std::filesystem::path& path, std::uint64_t size, std::uint64_t seed, std::error_code& ec) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    thread_local std::vector<std::uint64_t> chunk(kWriteChunk / sizeof(std::uint64_t));
+    std::uint64_t x = seed * 0x9E3779B97F4A7C15ull + 1;
+    for (std::uint64_t off = 0; off < size && !ec;) {
+        for (auto& word : chunk) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            word = x;
+        }
+        const std::size_t len = static_cast<std::size_t>(std::min<std::uint64_t>(kWriteChunk, size - off));
+        const char* data = reinterpret_cast<const char*>(chunk.data());
+        for (std::size_t done = 0; done < len;) {
+            const ssize_t w = ::write(fd, data + done, len - done);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                ec = std::error_code(errno, std::generic_category());
+                break;
+            }
+            done += static_cast<std::size_t>(w);
+        }
+        off += len;
+    }
+    ::close(fd);
+    return !ec;
+}
+
+/* Create the tree of one shape; files are written in parallel
+* @param config
+* @param shape
+* @param tree
+* @param ec
+* @return false on error
+*/
+bool BuildTree(const BenchConfig& config, const std::string& shape, Tree& tree, std::error_code& ec) {
+    tree.shape = shape;
+    tree.root = config.dir / ("src-" + shape);
+    std::filesystem::remove_all(tree.root, ec);
+    if (ec) return false;
+    // (relative path, size) of every file; directories are made up front
+    std::vector<std::pair<std::filesystem::path, std::uint64_t>> files;
+    std::vector<std::filesystem::path> dirs = {"."};
+    if (shape == "tiny") {
+        const std::uint64_t count = Scaled(config.tinyFiles, config.scale);
+        for (std::uint64_t i = 0; i < count; ++i) {
+            const std::filesystem::path dir = "d" + std::to_string(i / kFilesPerDir);
+            if (i % kFilesPerDir == 0) dirs.push_back(dir);
+            files.emplace_back(dir / ("f" + std::to_string(i)), config.tinySize);
+        }
+    } else if (shape == "huge") {
+        const std::uint64_t count = Scaled(config.hugeFiles, config.scale);
+        for (std::uint64_t i = 0; i < count; ++i) {
+            files.emplace_back("f" + std::to_string(i), Scaled(config.hugeSize, config.scale));
+        }
+    } else if (shape == "deep") {
+        std::filesystem::path dir = ".";
+        const std::uint64_t depth = Scaled(config.deepDepth, config.scale);
+        for (std::uint64_t level = 0; level < depth; ++level) {
+            dir /= "l" + std::to_string(level);
+            dirs.push_back(dir);
+            for (std::uint64_t i = 0; i < config.deepFiles; ++i) {
+                files.emplace_back(dir / ("f" + std::to_string(i)), 4096);
+            }
+        }
+    } else {
+        const std::uint64_t count = Scaled(config.wideFiles, config.scale);
+        for (std::uint64_t i = 0; i < count; ++i) files.emplace_back("f" + std::to_string(i), 0);
+    }
+    for (const auto& dir : dirs) {
+        std::filesystem::create_directories(tree.root / dir, ec);
+        if (ec) return false;
+    }
+    std::mutex mutex;
+    {
+        ThreadPool pool(config.threads);
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            pool.Submit([&, i]() {
+                std::error_code fileEc;
+                if (WriteFile(tree.root / files[i].first, files[i].second, i, fileEc)) return;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ec) ec = fileEc;
+            });
+        }
+        pool.Wait();
+    }
+    if (ec) return false;
+    tree.files = files.size();
+    tree.dirs = dirs.size();
+    for (const auto& file : files) tree.bytes += file.second;
+    const std::size_t step = std::max<std::size_t>(1, files.size() / kRenameSamples);
+    for (std::size_t i = 0; i < files.size() && tree.sample.size() < kRenameSamples; i += step) {
+        tree.sample.push_back(files[i].first);
+    }
+    return true;
+}
+
+/* Every regular file under root, for evicting them one by one
+*/
+void CollectFiles(const std::filesystem::path& root, std::vector<std::filesystem::path>& files) {
+    std::vector<std::filesystem::path> stack = {root};
+    while (!stack.empty()) {
+        const std::filesystem::path dir = std::move(stack.back());
+        stack.pop_back();
+        std::error_code ec;
+        DirScanner::Scan(dir, DirScanner::kNoFollow, [&](const DirEntryInfo& info) {
+            if (info.symlink) return true;
+            if (info.type == EntryType::Dir) stack.push_back(dir / std::string(info.name));
+            else files.push_back(dir / std::string(info.name));
+            return true;
+        }, ec);
+    }
+}
+
+/* Empty the caches before a cold run. Root can drop the page, dentry and
+* inode caches; otherwise the data pages of the tree are evicted, which
+* leaves metadata cached.
+* @param root: tree the next operation reads
+* @return what was done
+*/
+ColdMethod DropCaches(const std::filesystem::path& root) {
+    ::sync();
+#if defined(__linux__)
+    {
+        std::ofstream drop("/proc/sys/vm/drop_caches");
+        if (drop && (drop << "3").flush()) return ColdMethod::DropCaches;
+    }
+#endif
+#if defined(POSIX_FADV_DONTNEED)
+    std::vector<std::filesystem::path> files;
+    CollectFiles(root, files);
+    for (const auto& file : files) {
+        const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0) continue;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+    return ColdMethod::Fadvise;
+#else
+    return ColdMethod::None;
+#endif
+}
+
+/* Recursive listing with size and time, directories fanned out over a
+* pool the way the directory size walk does it
+* @return entries seen
+*/
+std::uint64_t ScanTree(const std::filesystem::path& root, unsigned threads, std::error_code& ec) {
+    std::atomic<std::uint64_t> entries{0};
+    std::mutex mutex;
+    ThreadPool pool(threads);
+    std::function<void(std::filesystem::path)> scan = [&](std::filesystem::path dir) {
+        std::error_code scanEc;
+        DirScanner::Scan(dir, DirScanner::kWantStat | DirScanner::kNoFollow, [&](const DirEntryInfo& info) {
+            entries.fetch_add(1, std::memory_order_relaxed);
+            if (info.type == EntryType::Dir && !info.symlink) {
+                pool.Submit([&scan, child = dir / std::string(info.name)]() { scan(child); });
+            }
+            return true;
+        }, scanEc);
+        if (scanEc) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ec) ec = scanEc;
+        }
+    };
+    pool.Submit([&scan, root]() { scan(root); });
+    pool.Wait();
+    return entries.load();
+}
+
+/* Load one directory with DirLoader, as opening it in the file list does,
+* and wait for the last batch
+* @return entries loaded
+*/
+std::uint64_t LoadDir(const std::filesystem::path& dir, std::error_code& ec) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    std::uint64_t entries = 0;
+    DirLoader loader;
+    loader.Start(dir, [&](std::uint64_t, std::shared_ptr<EntryStore> batch, bool last, std::error_code loadEc) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (batch) entries += batch->Size();
+        if (last) {
+            ec = loadEc;
+            done = true;
+            cv.notify_all();
+        }
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return done; });
+    lock.unlock();
+    loader.Shutdown();
+    return entries;
+}
+
+/* Time every operation on one tree for one cache state
+* @param config
+* @param tree
+* @param cold
+* @param results: receives one Result per operation
+* @param ec: first failure; the run stops at it
+* @return false on failure
+*/
+bool RunTree(const BenchConfig& config, const Tree& tree, bool cold, std::vector<Result>& results,
+             std::error_code& ec) {
+    const char* cache = cold ? "cold" : "warm";
+    auto result = [&](const char* op, std::uint64_t files, std::uint64_t bytes) -> Result& {
+        for (Result& r : results) {
+            if (r.shape == tree.shape && r.op == op && r.cache == cache) return r;
+        }
+        results.push_back(Result{tree.shape, op, cache, {}, files, bytes});
+        return results.back();
+    };
+    const std::filesystem::path copy = config.dir / ("copy-" + tree.shape);
+    const std::filesystem::path renamed = config.dir / ("renamed-" + tree.shape);
+    const std::filesystem::path moved = (config.moveTo.empty() ? config.dir : config.moveTo) / ("moved-" + tree.shape);
+    CopyOptions copyOptions;
+    copyOptions.threads = config.threads;
+    DeleteOptions deleteOptions;
+    deleteOptions.threads = config.threads;
+
+    // The first warm run only fills the caches
+    for (unsigned run = cold ? 0 : 1; run <= config.reps; ++run) {
+        const bool timed = run > 0;
+        for (const auto& p : {copy, renamed, moved}) {
+            std::filesystem::remove_all(p, ec);
+            if (ec) return false;
+        }
+        auto time = [&](const char* op, std::uint64_t files, std::uint64_t bytes, const std::filesystem::path& reads,
+                        const std::function<bool()>& body) {
+            if (cold) DropCaches(reads);
+            const auto start = std::chrono::steady_clock::now();
+            if (!body()) return false;
+            const double seconds = SecondsSince(start);
+            if (timed) result(op, files, bytes).seconds.push_back(seconds);
+            return true;
+        };
+        const std::uint64_t entries = tree.files + tree.dirs - 1;
+        std::uint64_t top = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(tree.root, ec)) {
+            (void)entry;
+            ++top;
+        }
+        if (ec) return false;
+        if (!time("scan", entries, 0, tree.root, [&] { ScanTree(tree.root, config.threads, ec); return !ec; }) ||
+            !time("load", top, 0, tree.root, [&] { LoadDir(tree.root, ec); return !ec; })) {
+            return false;
+        }
+        if (!time("copy", tree.files, tree.bytes, tree.root, [&] {
+                CopyStats stats;
+                return FileOp::CopyPath(tree.root, copy, false, copyOptions, stats, ec);
+            }) ||
+            !time("rename", 1, 0, copy, [&] { return FileOp::RenamePath(copy, renamed, false, ec); })) {
+            return false;
+        }
+        // Single-file renames: one sample per call
+        if (cold) DropCaches(renamed);
+        for (const auto& rel : tree.sample) {
+            std::filesystem::path from = renamed / rel;
+            std::filesystem::path to = from;
+            to += ".r";
+            const auto start = std::chrono::steady_clock::now();
+            if (!FileOp::RenamePath(from, to, false, ec)) return false;
+            const double seconds = SecondsSince(start);
+            if (timed) result("rename-file", 1, 0).seconds.push_back(seconds);
+        }
+        if (!time("move", tree.files, config.moveTo.empty() ? 0 : tree.bytes, renamed, [&] {
+                CopyStats stats;
+                return FileOp::MovePath(renamed, moved, false, copyOptions, stats, ec);
+            }) ||
+            !time("delete", entries + 1, 0, moved, [&] {
+                DeleteStats stats;
+                return FileOp::DeletePath(moved, deleteOptions, stats, ec);
+            })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Nearest-rank percentile of sorted samples
+*/
+double Percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    const std::size_t rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+/* JSON object of one result: latencies in milliseconds, throughput at
+* the median
+*/
+std::string ResultJson(const Result& r) {
+    std::vector<double> sorted = r.seconds;
+    std::sort(sorted.begin(), sorted.end());
+    const double median = Percentile(sorted, 0.5);
+    double sum = 0.0;
+    for (double s : sorted) sum += s;
+    return JsonLine().Add("shape", r.shape)
+                     .Add("op", r.op)
+                     .Add("cache", r.cache)
+                     .Add("runs", static_cast<std::uint64_t>(sorted.size()))
+                     .Add("median_ms", median * 1e3)
+                     .Add("p99_ms", Percentile(sorted, 0.99) * 1e3)
+                     .Add("min_ms", sorted.empty() ? 0.0 : sorted.front() * 1e3)
+                     .Add("max_ms", sorted.empty() ? 0.0 : sorted.back() * 1e3)
+                     .Add("mean_ms", sorted.empty() ? 0.0 : sum / sorted.size() * 1e3)
+                     .Add("files", r.files)
+                     .Add("bytes", r.bytes)
+                     .Add("files_per_sec", median > 0 ? r.files / median : 0.0)
+                     .Add("mb_per_sec", median > 0 ? r.bytes / median / (1024.0 * 1024.0) : 0.0)
+                     .Str();
+}
+
+/* Machine and run description, so results are only compared like for like
+*/
+std::string HostJson(const BenchConfig& config, ColdMethod coldMethod) {
+    struct utsname name;
+    const bool haveName = ::uname(&name) == 0;
+    char stamp[32];
+    const std::time_t now = std::time(nullptr);
+    std::tm utc{};
+    gmtime_r(&now, &utc);
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return JsonLine().Add("timestamp", stamp)
+                     .Add("host", haveName ? name.nodename : "")
+                     .Add("system", haveName ? std::string(name.sysname) + " " + name.release : std::string())
+                     .Add("cpus", static_cast<std::uint64_t>(ThreadPool::DefaultThreads()))
+                     .Add("compiler", __VERSION__)
+                     .Add("dir", std::filesystem::absolute(config.dir))
+                     .Add("reps", static_cast<std::uint64_t>(config.reps))
+                     .Add("threads", static_cast<std::uint64_t>(config.threads))
+                     .Add("scale", config.scale)
+                     .Add("cold_method", ColdMethodName(coldMethod))
+                     .Str();
+}
+
+/* Stats and syscalls one user action may make, as the kernel sees them:
+   the action runs in a traced child and every filesystem syscall of every
+   thread is counted (memory, futex and thread calls are not). The GUI
+   handlers call the same FileStat, FileActions and FileOp functions as
+   the runs below; reading the listing and the row updates afterwards are
+   not included, the background delete of a replaced file is. Lower a
+   budget when an action gets cheaper.
+*/
+struct ActionBudget {
+    const char* action;
+    std::uint64_t stats;
+    std::uint64_t syscalls;
+};
+
+const ActionBudget kActionBudgets[] = {
+    {"path-enter", 1, 1},        // OnPathEnter: stat, then the cached listing
+    {"open-dir", 1, 1},          // OnFileActivated / OnOpen on a directory
+    {"paste-new", 4, 17},        // OnPaste of one file into a dir without it
+    {"paste-overwrite", 5, 20},  // Same over an existing file, confirmed
+    {"rename", 1, 2},            // OnRename to a free name
+    {"rename-overwrite", 3, 6},  // OnRename over an existing file, confirmed
+};
+
+// Syscall counts of one traced action
+struct SyscallCount {
+    std::uint64_t stats = 0;     // stat, lstat, fstat, newfstatat, statx
+    std::uint64_t syscalls = 0;  // Every filesystem call, stats included
+};
+
+/* Whether a syscall number is a filesystem call, and a stat
+* @param nr
+* @param isStat: set for the stat family
+* @return true if it is counted
+*/
+bool IsFileSyscall(long nr, bool& isStat) {
+    static const long kStats[] = {
+#ifdef SYS_stat
+        SYS_stat,
+#endif
+#ifdef SYS_lstat
+        SYS_lstat,
+#endif
+#ifdef SYS_newfstatat
+        SYS_newfstatat,
+#endif
+        SYS_fstat, SYS_statx,
+    };
+    static const long kOthers[] = {
+#ifdef SYS_open
+        SYS_open,
+#endif
+#ifdef SYS_mkdir
+        SYS_mkdir,
+#endif
+#ifdef SYS_rmdir
+        SYS_rmdir,
+#endif
+#ifdef SYS_unlink
+        SYS_unlink,
+#endif
+#ifdef SYS_rename
+        SYS_rename,
+#endif
+#ifdef SYS_link
+        SYS_link,
+#endif
+#ifdef SYS_symlink
+        SYS_symlink,
+#endif
+#ifdef SYS_readlink
+        SYS_readlink,
+#endif
+#ifdef SYS_access
+        SYS_access,
+#endif
+#ifdef SYS_chmod
+        SYS_chmod,
+#endif
+#ifdef SYS_getdents
+        SYS_getdents,
+#endif
+#ifdef SYS_openat2
+        SYS_openat2,
+#endif
+#ifdef SYS_faccessat2
+        SYS_faccessat2,
+#endif
+        SYS_openat, SYS_close, SYS_read, SYS_pread64, SYS_readv, SYS_preadv,
+        SYS_write, SYS_pwrite64, SYS_writev, SYS_pwritev, SYS_lseek, SYS_getdents64,
+        SYS_mkdirat, SYS_unlinkat, SYS_renameat, SYS_renameat2, SYS_linkat, SYS_symlinkat,
+        SYS_readlinkat, SYS_faccessat, SYS_copy_file_range, SYS_sendfile, SYS_ioctl,
+        SYS_fsync, SYS_fdatasync, SYS_fchmod, SYS_fchmodat, SYS_fchown, SYS_fchownat,
+        SYS_utimensat, SYS_ftruncate, SYS_fallocate, SYS_fadvise64, SYS_statfs, SYS_fstatfs,
+        SYS_getxattr, SYS_lgetxattr, SYS_fgetxattr, SYS_setxattr, SYS_lsetxattr, SYS_fsetxattr,
+        SYS_listxattr, SYS_llistxattr, SYS_flistxattr,
+    };
+    isStat = std::find(std::begin(kStats), std::end(kStats), nr) != std::end(kStats);
+    return isStat || std::find(std::begin(kOthers), std::end(kOthers), nr) != std::end(kOthers);
+}
+
+/* Run one user action in a forked child under ptrace and count the
+* filesystem syscalls of all its threads. The child first starts the
+* Reclaimer (a GUI has it running already), then signals SIGUSR1, runs
+* the action, waits for the background delete of whatever it replaced so
+* the numbers do not depend on when that thread gets to it, and signals
+* SIGUSR2; only calls between the two are counted.
+* @param setup: puts the files in place; runs here, not counted
+* @param action: the handler's calls
+* @param count: syscalls of action alone
+* @param ec
+* @return false if setup, tracing or the action failed
+*/
+bool CountAction(const std::function<bool(std::error_code&)>& setup,
+                 const std::function<bool(std::error_code&)>& action,
+                 SyscallCount& count, std::error_code& ec) {
+    if (!setup(ec)) return false;
+    int result[2];
+    if (::pipe(result) != 0) {
+        ec.assign(errno, std::generic_category());
+        return false;
+    }
+    const pid_t child = ::fork();
+    if (child < 0) {
+        ec.assign(errno, std::generic_category());
+        ::close(result[0]);
+        ::close(result[1]);
+        return false;
+    }
+    if (child == 0) {
+        ::close(result[0]);
+        if (::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0) ::_exit(2);
+        ::raise(SIGSTOP); // Wait for the tracer
+        Reclaimer::Instance().WaitIdle();
+        ::raise(SIGUSR1);
+        std::error_code actionEc;
+        bool ok = action(actionEc);
+        Reclaimer::Instance().WaitIdle();
+        ::raise(SIGUSR2);
+        int value = ok ? 0 : (actionEc ? actionEc.value() : -1);
+        if (::write(result[1], &value, sizeof(value)) != sizeof(value)) ok = false;
+        ::_exit(ok ? 0 : 1);
+    }
+    ::close(result[1]);
+    int status = 0;
+    bool traced = ::waitpid(child, &status, 0) == child && WIFSTOPPED(status) &&
+                  ::ptrace(PTRACE_SETOPTIONS, child, nullptr,
+                           PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL) == 0 &&
+                  ::ptrace(PTRACE_SYSCALL, child, nullptr, nullptr) == 0;
+    if (!traced) {
+        ec.assign(errno ? errno : EPERM, std::generic_category());
+        ::kill(child, SIGKILL);
+    }
+    bool counting = false;
+    int childStatus = -1;
+    count = SyscallCount();
+    // Every thread of the child reports here until the last one is gone
+    for (pid_t pid; (pid = ::waitpid(-1, &status, __WALL)) > 0;) {
+        if (!WIFSTOPPED(status)) {
+            if (pid == child) childStatus = status;
+            continue;
+        }
+        int deliver = 0;
+        const int sig = WSTOPSIG(status);
+        if (sig == (SIGTRAP | 0x80)) {
+            __ptrace_syscall_info info{};
+            if (counting &&
+                ::ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) > 0 &&
+                info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+                bool isStat = false;
+                if (IsFileSyscall(static_cast<long>(info.entry.nr), isStat)) {
+                    ++count.syscalls;
+                    if (isStat) ++count.stats;
+                }
+            }
+        } else if (status >> 16 != 0) {
+            // A clone event; the new thread is traced too
+        } else if (sig == SIGUSR1 && pid == child) {
+            counting = true;
+        } else if (sig == SIGUSR2 && pid == child) {
+            counting = false;
+        } else if (sig != SIGSTOP) {
+            deliver = sig; // New threads start with SIGSTOP; anything else is real
+        }
+        ::ptrace(PTRACE_SYSCALL, pid, nullptr, reinterpret_cast<void*>(static_cast<long>(deliver)));
+    }
+    int value = -1;
+    const bool reported = ::read(result[0], &value, sizeof(value)) == sizeof(value);
+    ::close(result[0]);
+    if (!traced) return false;
+    if (!reported || !WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0) {
+        if (reported && value > 0) ec.assign(value, std::generic_category());
+        return false;
+    }
+    return true;
+}
+
+/* Run every action of kActionBudgets in a scratch dir and compare
+* @param config
+* @return exit code: 0 within budget, 1 over budget or failed
+*/
+int RunSyscallChecks(const BenchConfig& config) {
+    const std::filesystem::path root = config.dir / "syscalls";
+    const std::filesystem::path dir = root / "dir";
+    const std::filesystem::path file = root / "file";
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+    std::filesystem::create_directories(dir, ec);
+    if (!ec) WriteFile(file, 64 * 1024, 1, ec);
+    if (ec) {
+        std::fprintf(stderr, "filemanager-bench: %s\n", ec.message().c_str());
+        return 1;
+    }
+    // Filled here by setup; each traced child gets a copy
+    DirCache dirCache;
+    CopyOptions copyOptions;
+    copyOptions.threads = 1;
+    auto reset = [&](std::error_code& setupEc) {
+        std::filesystem::remove_all(dir, setupEc);
+        std::filesystem::create_directories(dir, setupEc);
+        return !setupEc;
+    };
+    // OnPathEnter / OnFileActivated into a listing that is in dirCache
+    auto navigate = [&](std::error_code& actionEc) {
+        const FileStat st = FileStat::Of(dir);
+        if (!st.IsDir()) {
+            actionEc = std::make_error_code(std::errc::not_a_directory);
+            return false;
+        }
+        DirStamp now;
+        DirStamp stamp;
+        return FileActions::CachedListing(dir, st, true, dirCache, now, stamp) != nullptr;
+    };
+    auto cacheListing = [&](std::error_code& setupEc) {
+        DirStamp stamp;
+        if (!DirCache::Stamp(dir, stamp)) {
+            setupEc = std::make_error_code(std::errc::no_such_file_or_directory);
+            return false;
+        }
+        dirCache.Store(dir, stamp, std::make_shared<const EntryStore>());
+        return true;
+    };
+    // OnPaste: existence and sync checks, confirm, then the job
+    auto paste = [&](std::error_code& actionEc) {
+        StatCache statCache;
+        const std::vector<std::filesystem::path> clipboard = {file};
+        const PastePlan plan = FileActions::PlanPaste(clipboard, dir, true, statCache);
+        if (plan.syncable) return false; // Would offer a sync
+        const bool overwrite = !plan.existing.empty();
+        CopyOptions options = copyOptions;
+        options.statCache = &statCache;
+        CopyStats stats;
+        std::vector<PathError> failures;
+        return FileActions::Paste(FileActions::PasteSources(clipboard, plan, overwrite), dir, overwrite, true,
+                                  options, stats, failures, actionEc);
+    };
+    const std::filesystem::path renameFrom = dir / "a";
+    const std::filesystem::path renameTo = dir / "b";
+    // OnRename: existence check, confirm, then the job
+    auto rename = [&](std::error_code& actionEc) {
+        StatCache statCache;
+        const bool overwrite = statCache.Get(renameTo).exists;
+        return FileOp::RenamePath(renameFrom, renameTo, overwrite, statCache, actionEc);
+    };
+    auto makeFiles = [&](std::vector<std::filesystem::path> paths) {
+        return [&, paths](std::error_code& setupEc) {
+            if (!reset(setupEc)) return false;
+            for (const auto& p : paths) {
+                if (!WriteFile(p, 4096, 2, setupEc)) return false;
+            }
+            return true;
+        };
+    };
+    const std::filesystem::path pasted = dir / file.filename();
+    const std::pair<std::function<bool(std::error_code&)>, std::function<bool(std::error_code&)>> runs[] = {
+        {[&](std::error_code& e) { return reset(e) && cacheListing(e); }, navigate},
+        {cacheListing, navigate},
+        {makeFiles({}), paste},
+        {makeFiles({pasted}), paste},
+        {makeFiles({renameFrom}), rename},
+        {makeFiles({renameFrom, renameTo}), rename},
+    };
+
+    int status = 0;
+    std::string json = "{\"syscalls\":[\n";
+    std::fprintf(stderr, "%-17s %6s %6s %9s %9s\n", "action", "stats", "budget", "syscalls", "budget");
+    for (std::size_t i = 0; i < sizeof(kActionBudgets) / sizeof(kActionBudgets[0]); ++i) {
+        const ActionBudget& budget = kActionBudgets[i];
+        SyscallCount count;
+        if (!CountAction(runs[i].first, runs[i].second, count, ec)) {
+            std::fprintf(stderr, "filemanager-bench: %s failed: %s\n", budget.action,
+                         ec ? ec.message().c_str() : "unexpected state");
+            return 1;
+        }
+        const bool over = count.stats > budget.stats || count.syscalls > budget.syscalls;
+        if (over) status = 1;
+        std::fprintf(stderr, "%-17s %6llu %6llu %9llu %9llu%s\n", budget.action,
+                     static_cast<unsigned long long>(count.stats), static_cast<unsigned long long>(budget.stats),
+                     static_cast<unsigned long long>(count.syscalls),
+                     static_cast<unsigned long long>(budget.syscalls), over ? "  OVER BUDGET" : "");
+        json += JsonLine().Add("action", budget.action)
+                          .Add("stats", count.stats)
+                          .Add("stats_budget", budget.stats)
+                          .Add("syscalls", count.syscalls)
+                          .Add("syscalls_budget", budget.syscalls)
+                          .Str() + (i + 1 < sizeof(kActionBudgets) / sizeof(kActionBudgets[0]) ? ",\n" : "\n");
+    }
+    json += "]}\n";
+    if (!config.keep) std::filesystem::remove_all(root, ec);
+    std::ofstream out(config.out, std::ios::binary | std::ios::trunc);
+    if (!(out << json).flush()) {
+        std::fprintf(stderr, "filemanager-bench: cannot write %s\n", config.out.c_str());
+        return 1;
+    }
+    if (status != 0) std::fprintf(stderr, "\nsyscall budget exceeded; see above\n");
+    return status;
+}
+
+// One correctness check of the file operations
+struct Check {
+    const char* name;
+    std::function<bool(const std::filesystem::path& dir, std::string& why)> run;
+};
+
+// Size of p, or -1 if nothing is there (a symlink counts as itself)
+long long SizeAt(const std::filesystem::path& p) {
+    struct stat st;
+    if (::lstat(p.c_str(), &st) != 0) return -1;
+    return static_cast<long long>(st.st_size);
+}
+
+/* Overwrite by rename or move, then reuse the source name at once, as a
+* user renaming files in a row does. The old dest must be off the source
+* name when the call returns, and the Reclaimer must not touch the new file.
+* @param dir: empty scratch dir
+* @param move: MovePath instead of RenamePath
+* @param why: what went wrong
+* @return true if it held every round
+*/
+bool CheckOverwriteByRename(const std::filesystem::path& dir, bool move, std::string& why) {
+    const std::filesystem::path a = dir / "a";
+    const std::filesystem::path b = dir / "b";
+    const std::filesystem::path c = dir / "c";
+    for (int round = 0; round < 50; ++round) {
+        std::error_code ec;
+        if (!WriteFile(a, 1000, 1, ec) || !WriteFile(b, 2000, 2, ec) || !WriteFile(c, 3000, 3, ec)) {
+            why = ec.message();
+            return false;
+        }
+        StatCache cache;
+        CopyOptions options;
+        CopyStats stats;
+        const bool ok = move ? FileOp::MovePath(a, b, true, options, stats, ec)
+                             : FileOp::RenamePath(a, b, true, cache, ec);
+        if (!ok) {
+            why = "overwrite failed: " + ec.message();
+            return false;
+        }
+        if (SizeAt(a) != -1) {
+            why = "the replaced file is still at the source name";
+            return false;
+        }
+        std::filesystem::rename(c, a, ec);
+        Reclaimer::Instance().WaitIdle();
+        if (SizeAt(b) != 1000 || SizeAt(a) != 3000) {
+            why = "round " + std::to_string(round) + ": the file renamed to the source name was lost";
+            return false;
+        }
+        std::filesystem::remove(a, ec);
+        std::filesystem::remove(b, ec);
+    }
+    return true;
+}
+
+/* Delete a tree far deeper than the fds a process may hold, with the
+* limit lowered to what many systems give by default
+* @param dir: empty scratch dir
+* @param why: what went wrong
+* @return true if the whole tree is gone
+*/
+bool CheckDeleteDeep(const std::filesystem::path& dir, std::string& why) {
+    constexpr int kDepth = 1500;
+    constexpr rlim_t kFdLimit = 256;
+    const std::filesystem::path top = dir / "deep";
+    std::filesystem::path p = top;
+    std::error_code ec;
+    for (int level = 0; level < kDepth && !ec; ++level) {
+        p /= "d";
+        if (std::filesystem::create_directories(p, ec) || !ec) WriteFile(p / "f", 0, 0, ec);
+    }
+    if (ec) {
+        why = "cannot build the tree: " + ec.message();
+        return false;
+    }
+    struct rlimit saved;
+    ::getrlimit(RLIMIT_NOFILE, &saved);
+    struct rlimit lowered = saved;
+    if (lowered.rlim_cur == RLIM_INFINITY || lowered.rlim_cur > kFdLimit) lowered.rlim_cur = kFdLimit;
+    ::setrlimit(RLIMIT_NOFILE, &lowered);
+    DeleteOptions options;
+    DeleteStats stats;
+    const bool ok = DeleteEngine::DeleteTree(top, options, stats, ec);
+    ::setrlimit(RLIMIT_NOFILE, &saved);
+    if (!ok) {
+        why = ec.message() + " after " + std::to_string(stats.entries) + " entries";
+        return false;
+    }
+    if (SizeAt(top) != -1) {
+        why = "the tree is still there";
+        return false;
+    }
+    return true;
+}
+
+/* Run every check in its own scratch dir
+* @param config
+* @return exit code: 0 if all passed, 1 otherwise
+*/
+int RunChecks(const BenchConfig& config) {
+    const Check checks[] = {
+        {"rename-overwrite", [](const std::filesystem::path& dir, std::string& why) {
+            return CheckOverwriteByRename(dir, false, why);
+        }},
+        {"move-overwrite", [](const std::filesystem::path& dir, std::string& why) {
+            return CheckOverwriteByRename(dir, true, why);
+        }},
+        {"delete-deep", CheckDeleteDeep},
+    };
+    const std::filesystem::path root = config.dir / "checks";
+    int status = 0;
+    std::string json = "{\"checks\":[\n";
+    for (std::size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i) {
+        const std::filesystem::path dir = root / checks[i].name;
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+        std::filesystem::create_directories(dir, ec);
+        std::string why;
+        const bool ok = !ec && checks[i].run(dir, why);
+        if (ec) why = ec.message();
+        if (!ok) status = 1;
+        std::fprintf(stderr, "%-20s %s%s%s\n", checks[i].name, ok ? "ok" : "FAILED", ok ? "" : ": ", why.c_str());
+        json += JsonLine().Add("check", checks[i].name)
+                          .Add("ok", ok)
+                          .Add("why", why)
+                          .Str() + (i + 1 < sizeof(checks) / sizeof(checks[0]) ? ",\n" : "\n");
+    }
+    json += "]}\n";
+    std::error_code ec;
+    if (!config.keep) std::filesystem::remove_all(root, ec);
+    std::ofstream out(config.out, std::ios::binary | std::ios::trunc);
+    if (!(out << json).flush()) {
+        std::fprintf(stderr, "filemanager-bench: cannot write %s\n", config.out.c_str());
+        return 1;
+    }
+    return status;
+}
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    std::string error;
+    if (!ParseArgs(argc, argv, config, error)) {
+        if (error.empty()) {
+            std::fputs(kUsage, stdout);
+            return 0;
+        }
+        std::fprintf(stderr, "filemanager-bench: %s\n\n%s", error.c_str(), kUsage);
+        return 2;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(config.dir, ec);
+    if (!ec && !config.moveTo.empty()) std::filesystem::create_directories(config.moveTo, ec);
+    if (ec) {
+        std::fprintf(stderr, "filemanager-bench: %s\n", ec.message().c_str());
+        return 1;
+    }
+    if (config.syscalls) return RunSyscallChecks(config);
+    if (config.checks) return RunChecks(config);
+    // Probe once so the report says how cold the cold runs were
+    const ColdMethod coldMethod = config.cold ? DropCaches(config.dir) : ColdMethod::None;
+
+    std::vector<Result> results;
+    for (const std::string& shape : config.shapes) {
+        Tree tree;
+        std::fprintf(stderr, "building %s...\n", shape.c_str());
+        if (!BuildTree(config, shape, tree, ec)) {
+            std::fprintf(stderr, "filemanager-bench: cannot build %s: %s\n", shape.c_str(), ec.message().c_str());
+            return 1;
+        }
+        std::fprintf(stderr, "%s: %llu files, %llu dirs, %.1f MB\n", shape.c_str(),
+                     static_cast<unsigned long long>(tree.files), static_cast<unsigned long long>(tree.dirs),
+                     tree.bytes / (1024.0 * 1024.0));
+        for (const bool cold : {false, true}) {
+            if ((cold && !config.cold) || (!cold && !config.warm)) continue;
+            if (!RunTree(config, tree, cold, results, ec)) {
+                std::fprintf(stderr, "filemanager-bench: %s (%s): %s\n", shape.c_str(), cold ? "cold" : "warm",
+                             ec.message().c_str());
+                return 1;
+            }
+        }
+        for (const char* prefix : {"copy-", "renamed-", "moved-"}) {
+            std::filesystem::remove_all(config.dir / (prefix + shape), ec);
+        }
+        if (!config.moveTo.empty()) std::filesystem::remove_all(config.moveTo / ("moved-" + shape), ec);
+        if (!config.keep) std::filesystem::remove_all(tree.root, ec);
+    }
+
+    std::string json = "{\"run\":" + HostJson(config, coldMethod) + ",\"results\":[\n";
+    std::fprintf(stderr, "\n%-5s %-11s %-4s %10s %10s %12s %10s\n", "shape", "op", "cache",
+                 "median ms", "p99 ms", "files/s", "MB/s");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        json += ResultJson(r) + (i + 1 < results.size() ? ",\n" : "\n");
+        std::vector<double> sorted = r.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        const double median = Percentile(sorted, 0.5);
+        std::fprintf(stderr, "%-5s %-11s %-5s %10.3f %10.3f %12.0f %10.1f\n", r.shape.c_str(), r.op.c_str(),
+                     r.cache.c_str(), median * 1e3, Percentile(sorted, 0.99) * 1e3,
+                     median > 0 ? r.files / median : 0.0,
+                     median > 0 ? r.bytes / median / (1024.0 * 1024.0) : 0.0);
+    }
+    json += "]}\n";
+    std::ofstream out(config.out, std::ios::binary | std::ios::trunc);
+    if (!(out << json).flush()) {
+        std::fprintf(stderr, "filemanager-bench: cannot write %s\n", config.out.c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "\nresults: %s\n", config.out.c_str());
+    return 0;
+}
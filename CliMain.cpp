@@ -0,0 +1,631 @@
+/*
+    Description: Entry point of filemanager-cli, the headless front end of
+                 the file operations for scripts, cron jobs and servers.
+                 Reads path lists from stdin or a file, runs the whole batch
+                 in one process and prints JSON. Does not use wxWidgets.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "CopyEngine.h"
+#include "DeleteEngine.h"
+#include "DirScanner.h"
+#include "DirSync.h"
+#include "FileOp.h"
+#include "Json.h"
+#include "OpProgress.h"
+#include "Reclaimer.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+const char kUsage[] =
+    "usage: filemanager-cli [options] <command> [arguments]\n"
+    "\n"
+    "commands:\n"
+    "  copy [DEST_DIR]    copy every listed path into DEST_DIR\n"
+    "  move [DEST_DIR]    move every listed path into DEST_DIR\n"
+    "  delete             delete every listed path, recursively\n"
+    "  list [DIR...]      list directories as JSON lines (listed paths if none given)\n"
+    "  sync SRC DEST      bring directory DEST up to date with SRC\n"
+    "\n"
+    "Paths are read one per line from stdin, or from --from FILE. A line\n"
+    "\"SRC<tab>DEST\" gives copy and move a full destination path instead of\n"
+    "DEST_DIR/name. Results are JSON lines on stdout; the last line is a\n"
+    "summary with throughput and every failure. Exit status is 0 when\n"
+    "everything succeeded, 1 when something failed, 2 on bad usage.\n"
+    "\n"
+    "options:\n"
+    "  --from FILE        read the path list from FILE\n"
+    "  -0, --null         paths are separated by NUL (find -print0)\n"
+    "  -j, --threads N    concurrent files or directories (default: one per CPU)\n"
+    "  --overwrite        replace destinations that exist (default: report them)\n"
+    "  --verify           read every copied file back and check its XXH64\n"
+    "  --manifest FILE    write the checksums of verified copies to FILE\n"
+    "  --fsync            flush copies to disk before reporting them done\n"
+    "  -r, --recursive    list: descend into subdirectories\n"
+    "  --checksum         sync: compare file contents, not size and time\n"
+    "  --delete           sync: remove what SRC does not have\n"
+    "  -n, --dry-run      sync: print the plan and change nothing\n"
+    "  --progress         report progress on stderr every second\n"
+    "  --trace FILE       write a Chrome trace of the run to FILE and add\n"
+    "                     syscall and byte counters to the summary\n"
+    "  -h, --help         show this help\n";
+
+constexpr int kExitOk = 0;
+constexpr int kExitFailed = 1;
+constexpr int kExitUsage = 2;
+
+// Parsed command line
+struct CliOptions {
+    std::string command;
+    std::vector<std::string> args;
+    std::string from;          // Path list file, empty for stdin
+    std::string manifest;      // --manifest
+    std::string trace;         // --trace
+    bool nul = false;
+    unsigned threads = 0;
+    bool overwrite = false;
+    bool verify = false;
+    bool fsync = false;
+    bool recursive = false;
+    bool checksum = false;
+    bool removeExtra = false;
+    bool dryRun = false;
+    bool progress = false;
+};
+
+// One line of the path list
+struct BatchItem {
+    std::filesystem::path src;
+    std::filesystem::path dest; // Empty unless the line gave one
+};
+
+// Progress of the running command; cancelled by SIGINT and SIGTERM
+OpProgress* g_progress = nullptr;
+
+extern "C" void OnSignal(int) {
+    if (g_progress) g_progress->cancelled.store(true);
+}
+
+/* JSON array of failures
+* @param failures
+* @return array text
+*/
+std::string FailureArray(const std::vector<PathError>& failures) {
+    std::string out = "[";
+    for (std::size_t i = 0; i < failures.size(); ++i) {
+        if (i > 0) out += ',';
+        out += JsonLine().Add("path", failures[i].path)
+                         .Add("error", failures[i].ec.message())
+                         .Add("errno", static_cast<std::uint64_t>(failures[i].ec.value()))
+                         .Str();
+    }
+    return out + "]";
+}
+
+/* Parse argv
+* @param argc
+* @param argv
+* @param options
+* @param error: what was wrong, on failure
+* @return false on a usage error
+*/
+bool ParseArgs(int argc, char** argv, CliOptions& options, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) {
+                error = arg + " needs a value";
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
+        if (arg == "-h" || arg == "--help") {
+            options.command = "help";
+            return true;
+        } else if (arg == "--from") {
+            if (!value(options.from)) return false;
+        } else if (arg == "--manifest") {
+            if (!value(options.manifest)) return false;
+        } else if (arg == "--trace") {
+            if (!value(options.trace)) return false;
+        } else if (arg == "-j" || arg == "--threads") {
+            std::string n;
+            if (!value(n)) return false;
+            char* end = nullptr;
+            const unsigned long threads = std::strtoul(n.c_str(), &end, 10);
+            if (n.empty() || *end != '\0' || threads > 1024) {
+                error = "bad thread count: " + n;
+                return false;
+            }
+            options.threads = static_cast<unsigned>(threads);
+        } else if (arg == "-0" || arg == "--null") {
+            options.nul = true;
+        } else if (arg == "--overwrite") {
+            options.overwrite = true;
+        } else if (arg == "--verify") {
+            options.verify = true;
+        } else if (arg == "--fsync") {
+            options.fsync = true;
+        } else if (arg == "-r" || arg == "--recursive") {
+            options.recursive = true;
+        } else if (arg == "--checksum") {
+            options.checksum = true;
+        } else if (arg == "--delete") {
+            options.removeExtra = true;
+        } else if (arg == "-n" || arg == "--dry-run") {
+            options.dryRun = true;
+        } else if (arg == "--progress") {
+            options.progress = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            error = "unknown option: " + arg;
+            return false;
+        } else if (options.command.empty()) {
+            options.command = arg;
+        } else {
+            options.args.push_back(arg);
+        }
+    }
+    if (options.command.empty()) {
+        error = "no command given";
+        return false;
+    }
+    if (!options.manifest.empty()) options.verify = true;
+    return true;
+}
+
+/* Read the path list: one item per line (or per NUL), "SRC<tab>DEST"
+* for an explicit destination. Blank lines are skipped.
+* @param options
+* @param items
+* @param ec
+* @return false if the list could not be read
+*/
+bool ReadItems(const CliOptions& options, std::vector<BatchItem>& items, std::error_code& ec) {
+    std::ifstream file;
+    if (!options.from.empty()) {
+        file.open(options.from, std::ios::binary);
+        if (!file) {
+            ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            return false;
+        }
+    }
+    std::istream& in = options.from.empty() ? std::cin : file;
+    const char separator = options.nul ? '\0' : '\n';
+    std::string line;
+    while (std::getline(in, line, separator)) {
+        if (!options.nul && !line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        BatchItem item;
+        const std::size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            item.src = line;
+        } else {
+            item.src = line.substr(0, tab);
+            item.dest = line.substr(tab + 1);
+        }
+        items.push_back(std::move(item));
+    }
+    if (in.bad()) {
+        ec = std::make_error_code(std::errc::io_error);
+        return false;
+    }
+    return true;
+}
+
+/* Prints the counters to stderr once a second while a command runs
+*/
+class ProgressReporter {
+public:
+    ProgressReporter(const OpProgress& progress, bool enabled) : progress_(progress) {
+        if (enabled) thread_ = std::thread([this] { Run(); });
+    }
+    ~ProgressReporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, std::chrono::seconds(1), [this] { return stop_; })) {
+            std::fprintf(stderr, "%llu/%llu files, %.1f/%.1f MB, %.1f MB/s\n",
+                         static_cast<unsigned long long>(progress_.files.load()),
+                         static_cast<unsigned long long>(progress_.totalFiles.load()),
+                         progress_.bytes.load() / (1024.0 * 1024.0),
+                         progress_.totalBytes.load() / (1024.0 * 1024.0),
+                         progress_.MBPerSecond());
+        }
+    }
+
+    const OpProgress& progress_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+/* Destination of each item: its own, or DEST_DIR/name
+* @param options
+* @param items
+* @param pairs: receives (src, dest)
+* @param error
+* @return false when an item has no destination
+*/
+bool Destinations(const CliOptions& options, const std::vector<BatchItem>& items,
+                  std::vector<std::pair<std::filesystem::path, std::filesystem::path>>& pairs,
+                  std::string& error) {
+    std::filesystem::path destDir;
+    if (!options.args.empty()) destDir = options.args.front();
+    for (const BatchItem& item : items) {
+        if (!item.dest.empty()) {
+            pairs.emplace_back(item.src, item.dest);
+        } else if (!destDir.empty()) {
+            pairs.emplace_back(item.src, destDir / item.src.filename());
+        } else {
+            error = "no DEST_DIR for " + item.src.string();
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Split off items whose destination exists: with --overwrite they are
+* replaced one by one, without it they fail up front like a paste that
+* skips them would
+* @return pairs whose destination is free
+*/
+std::vector<std::pair<std::filesystem::path, std::filesystem::path>> SplitExisting(
+    const CliOptions& options,
+    const std::vector<std::pair<std::filesystem::path, std::filesystem::path>>& pairs,
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>>& existing,
+    std::vector<PathError>& failures) {
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> fresh;
+    for (const auto& pair : pairs) {
+        struct stat st;
+        if (::lstat(pair.second.c_str(), &st) != 0) {
+            fresh.push_back(pair);
+        } else if (options.overwrite) {
+            existing.push_back(pair);
+        } else {
+            failures.push_back(PathError{pair.second, std::make_error_code(std::errc::file_exists)});
+        }
+    }
+    return fresh;
+}
+
+/* Run one FileOp call per pair on a pool, merging their stats
+* @param pairs
+* @param threads
+* @param op: the operation, returns false with ec set on failure
+* @param stats
+* @param failures
+*/
+template <typename Op>
+void RunEach(const std::vector<std::pair<std::filesystem::path, std::filesystem::path>>& pairs,
+             unsigned threads, Op op, CopyStats& stats, std::vector<PathError>& failures) {
+    std::mutex mutex;
+    ThreadPool pool(threads);
+    for (const auto& pair : pairs) {
+        pool.Submit([&, pair]() {
+            CopyStats one;
+            std::error_code ec;
+            const bool ok = op(pair.first, pair.second, one, ec);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok) failures.push_back(PathError{one.errorPath.empty() ? pair.first : one.errorPath, ec});
+            stats.Add(one);
+        });
+    }
+    pool.Wait();
+}
+
+/* copy and move
+* @param options
+* @param items
+* @param progress
+* @param summary: receives the command specific fields
+* @param failures
+* @return exit status
+*/
+int RunTransfer(const CliOptions& options, const std::vector<BatchItem>& items, OpProgress& progress,
+                JsonLine& summary, std::vector<PathError>& failures) {
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> pairs;
+    std::string error;
+    if (!Destinations(options, items, pairs, error)) {
+        std::fprintf(stderr, "filemanager-cli: %s\n", error.c_str());
+        return kExitUsage;
+    }
+    const bool isCopy = options.command == "copy";
+    CopyOptions copyOptions;
+    copyOptions.threads = options.threads;
+    copyOptions.verify = options.verify;
+    copyOptions.fsync = options.fsync;
+    copyOptions.progress = &progress;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> existing;
+    const auto fresh = SplitExisting(options, pairs, existing, failures);
+    CopyStats stats;
+    if (isCopy) {
+        // Every new item shares one pool: thousands of small files overlap
+        std::vector<PathError> copyFailures;
+        CopyEngine::CopyTrees(fresh, copyOptions, stats, copyFailures);
+        failures.insert(failures.end(), copyFailures.begin(), copyFailures.end());
+        RunEach(existing, options.threads, [&](const std::filesystem::path& src, const std::filesystem::path& dest,
+                                               CopyStats& one, std::error_code& ec) {
+            return FileOp::CopyPath(src, dest, true, copyOptions, one, ec);
+        }, stats, failures);
+    } else {
+        auto move = [&](bool overwrite) {
+            return [&copyOptions, overwrite](const std::filesystem::path& src, const std::filesystem::path& dest,
+                                             CopyStats& one, std::error_code& ec) {
+                return FileOp::MovePath(src, dest, overwrite, copyOptions, one, ec);
+            };
+        };
+        RunEach(fresh, options.threads, move(false), stats, failures);
+        RunEach(existing, options.threads, move(true), stats, failures);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!stats.checksums.empty() && !options.manifest.empty()) {
+        std::error_code ec;
+        if (!CopyEngine::WriteManifest(options.manifest, stats.checksums, ec)) {
+            failures.push_back(PathError{options.manifest, ec});
+        }
+    }
+    summary.Add("items", static_cast<std::uint64_t>(pairs.size()))
+           .Add("files", stats.files)
+           .Add("dirs", stats.dirs)
+           .Add("links", stats.links)
+           .Add("bytes", stats.bytes)
+           .Add("seconds", stats.seconds)
+           .Add("files_per_sec", stats.FilesPerSecond())
+           .Add("mb_per_sec", stats.MBPerSecond());
+    if (options.verify) {
+        summary.Add("verified", stats.verified)
+               .Add("verified_uncached", stats.direct)
+               .Add("verify_overhead", stats.VerifyOverhead());
+    }
+    std::string strategies = "{";
+    for (int i = 0; i < kCopyStrategyCount; ++i) {
+        if (stats.strategyFiles[i] == 0) continue;
+        if (strategies.size() > 1) strategies += ',';
+        strategies += JsonQuote(CopyStrategyName(static_cast<CopyStrategy>(i))) + ":" +
+                      std::to_string(stats.strategyFiles[i]);
+    }
+    summary.Raw("strategies", strategies + "}");
+    return failures.empty() ? kExitOk : kExitFailed;
+}
+
+/* delete
+*/
+int RunDelete(const CliOptions& options, const std::vector<BatchItem>& items, OpProgress& progress,
+              JsonLine& summary, std::vector<PathError>& failures) {
+    std::vector<std::filesystem::path> paths;
+    for (const BatchItem& item : items) paths.push_back(item.src);
+    DeleteOptions deleteOptions;
+    deleteOptions.threads = options.threads;
+    deleteOptions.progress = &progress;
+    DeleteStats stats;
+    std::error_code ec;
+    FileOp::DeletePaths(paths, deleteOptions, stats, failures, ec);
+    summary.Add("items", static_cast<std::uint64_t>(paths.size()))
+           .Add("entries", stats.entries)
+           .Add("seconds", stats.seconds)
+           .Add("entries_per_sec", stats.EntriesPerSecond());
+    return failures.empty() ? kExitOk : kExitFailed;
+}
+
+// Name of an entry's kind in list output
+const char* KindName(const DirEntryInfo& info) {
+    if (info.symlink) return "link";
+    if (info.type == EntryType::Dir) return "dir";
+#if defined(S_IFMT)
+    if (info.mode != 0 && !S_ISREG(info.mode)) return "other";
+#endif
+    return "file";
+}
+
+/* list: one JSON line per entry, each directory printed as a block.
+* Directories are scanned in parallel, so blocks come in no fixed order.
+*/
+int RunList(const CliOptions& options, const std::vector<BatchItem>& items, OpProgress& progress,
+            JsonLine& summary, std::vector<PathError>& failures) {
+    std::vector<std::filesystem::path> dirs;
+    for (const auto& arg : options.args) dirs.emplace_back(arg);
+    for (const BatchItem& item : items) dirs.push_back(item.src);
+    std::mutex mutex; // Guards stdout and failures
+    std::atomic<std::uint64_t> entries{0};
+    std::atomic<std::uint64_t> scanned{0};
+    const auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(options.threads);
+        std::function<void(std::filesystem::path)> scan = [&](std::filesystem::path dir) {
+            if (!progress.Checkpoint()) return;
+            std::string block;
+            std::error_code ec;
+            DirScanner::Scan(dir, DirScanner::kWantStat | DirScanner::kNoFollow, [&](const DirEntryInfo& info) {
+                std::filesystem::path path = dir / std::string(info.name);
+                block += JsonLine().Add("path", path)
+                                   .Add("type", KindName(info))
+                                   .Add("size", info.size == EntryStore::kUnknownSize ? std::uint64_t(0) : info.size)
+                                   .Add("mtime_ns", static_cast<std::uint64_t>(std::max<std::int64_t>(info.mtimeNs, 0)))
+                                   .Str();
+                block += '\n';
+                entries.fetch_add(1, std::memory_order_relaxed);
+                if (options.recursive && info.type == EntryType::Dir && !info.symlink) {
+                    pool.Submit([&scan, path = std::move(path)]() { scan(path); });
+                }
+                return true;
+            }, ec);
+            scanned.fetch_add(1, std::memory_order_relaxed);
+            progress.files.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(mutex);
+            std::fwrite(block.data(), 1, block.size(), stdout);
+            if (ec) failures.push_back(PathError{dir, ec});
+        };
+        for (auto& dir : dirs) pool.Submit([&scan, dir]() { scan(dir); });
+        pool.Wait();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    summary.Add("dirs", scanned.load())
+           .Add("entries", entries.load())
+           .Add("seconds", seconds)
+           .Add("entries_per_sec", seconds > 0 ? entries.load() / seconds : 0.0);
+    return failures.empty() ? kExitOk : kExitFailed;
+}
+
+/* sync SRC DEST: compare, then apply unless --dry-run, which prints the
+* plan as JSON lines instead
+*/
+int RunSync(const CliOptions& options, OpProgress& progress, JsonLine& summary, std::vector<PathError>& failures) {
+    if (options.args.size() != 2) {
+        std::fprintf(stderr, "filemanager-cli: sync needs SRC and DEST\n");
+        return kExitUsage;
+    }
+    const std::filesystem::path src = options.args[0];
+    const std::filesystem::path dest = options.args[1];
+    SyncOptions syncOptions;
+    syncOptions.checksum = options.checksum;
+    syncOptions.removeExtra = options.removeExtra;
+    syncOptions.threads = options.threads;
+    syncOptions.fsync = options.fsync;
+    syncOptions.progress = &progress;
+    SyncPlan plan;
+    std::error_code ec;
+    const bool planned = DirSync::Plan(src, dest, syncOptions, plan, ec);
+    plan.Finish();
+    summary.Add("compared", plan.compared.load())
+           .Add("unchanged", plan.unchanged.load())
+           .Add("copy_bytes", plan.copyBytes.load())
+           .Add("plan_seconds", plan.Seconds());
+    if (!planned) {
+        failures.push_back(PathError{src, ec});
+        return kExitFailed;
+    }
+    const std::vector<SyncItem> items = plan.Items();
+    summary.Add("actions", static_cast<std::uint64_t>(items.size()));
+    if (options.dryRun) {
+        for (const SyncItem& item : items) {
+            std::printf("%s\n", JsonLine().Add("action", SyncActionName(item.action))
+                                          .Add("path", item.rel)
+                                          .Add("size", item.size)
+                                          .Str().c_str());
+        }
+        return kExitOk;
+    }
+    SyncStats stats;
+    DirSync::Apply(src, dest, items, syncOptions, stats, failures, ec);
+    summary.Add("created", stats.created)
+           .Add("updated", stats.updated)
+           .Add("delta_files", stats.deltaFiles)
+           .Add("touched", stats.touched)
+           .Add("removed", stats.removed)
+           .Add("bytes_copied", stats.bytesCopied)
+           .Add("bytes_written", stats.bytesWritten)
+           .Add("seconds", stats.seconds)
+           .Add("mb_per_sec", stats.seconds > 0
+                                  ? (stats.bytesCopied + stats.bytesWritten) / stats.seconds / (1024.0 * 1024.0)
+                                  : 0.0);
+    return failures.empty() ? kExitOk : kExitFailed;
+}
+}
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    std::string error;
+    if (!ParseArgs(argc, argv, options, error)) {
+        std::fprintf(stderr, "filemanager-cli: %s\n\n%s", error.c_str(), kUsage);
+        return kExitUsage;
+    }
+    if (options.command == "help") {
+        std::fputs(kUsage, stdout);
+        return kExitOk;
+    }
+    const std::string& command = options.command;
+    if (command != "copy" && command != "move" && command != "delete" && command != "list" && command != "sync") {
+        std::fprintf(stderr, "filemanager-cli: unknown command: %s\n\n%s", command.c_str(), kUsage);
+        return kExitUsage;
+    }
+
+    // list takes its directories as arguments; read stdin only when none are given
+    std::vector<BatchItem> items;
+    const bool readList = command == "copy" || command == "move" || command == "delete" ||
+                          (command == "list" && options.args.empty());
+    if (readList) {
+        std::error_code ec;
+        if (!ReadItems(options, items, ec)) {
+            std::fprintf(stderr, "filemanager-cli: cannot read the path list: %s\n", ec.message().c_str());
+            return kExitUsage;
+        }
+    }
+
+    if (!options.trace.empty()) Trace::SetEnabled(true);
+    OpProgress progress;
+    g_progress = &progress;
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    std::vector<PathError> failures;
+    JsonLine summary;
+    summary.Add("command", command);
+    int status;
+    {
+        ProgressReporter reporter(progress, options.progress);
+        if (command == "copy" || command == "move") {
+            status = RunTransfer(options, items, progress, summary, failures);
+        } else if (command == "delete") {
+            status = RunDelete(options, items, progress, summary, failures);
+        } else if (command == "list") {
+            status = RunList(options, items, progress, summary, failures);
+        } else {
+            status = RunSync(options, progress, summary, failures);
+        }
+    }
+    // Replaced destinations are deleted in the background; finish that before exiting
+    Reclaimer::Instance().WaitIdle();
+    if (status == kExitUsage) return status;
+
+    if (!options.trace.empty()) {
+        Trace::SetEnabled(false);
+        const Trace::Totals totals = Trace::Snapshot();
+        JsonLine counters;
+        for (unsigned c = 0; c < Trace::kCounters; ++c) {
+            counters.Add(Trace::CounterName(static_cast<Trace::Counter>(c)), totals.counters[c]);
+        }
+        std::uint64_t events = 0;
+        std::error_code ec;
+        if (!Trace::WriteChrome(options.trace, events, ec)) failures.push_back(PathError{options.trace, ec});
+        summary.Raw("trace", counters.Add("events", events).Str());
+    }
+    summary.Add("ok", failures.empty())
+           .Add("cancelled", progress.cancelled.load())
+           .Add("errors", static_cast<std::uint64_t>(failures.size()))
+           .Raw("failures", FailureArray(failures));
+    std::printf("%s\n", summary.Str().c_str());
+    std::fflush(stdout);
+    g_progress = nullptr;
+    return status;
+}
@@ -0,0 +1,344 @@
+/*
+    Description: Implementation of the content search and its result buffer.
+*/
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "ContentSearch.h"
+#include "DirScanner.h"
+#include "StrSearch.h"
+
+/* Keep the hits of one file, up to kMaxHits in total
+* @param hits
+*/
+void SearchResults::Add(std::vector<SearchHit>&& hits) {
+    if (hits.empty()) return;
+    matchedFiles.fetch_add(1, std::memory_order_relaxed);
+    totalHits.fetch_add(hits.size(), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::size_t room = kMaxHits - std::min(kMaxHits, hits_.size());
+    const std::size_t keep = std::min(room, hits.size());
+    hits_.insert(hits_.end(), std::make_move_iterator(hits.begin()),
+                 std::make_move_iterator(hits.begin() + keep));
+}
+std::size_t SearchResults::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_.size();
+}
+SearchHit SearchResults::At(std::size_t i) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_[i];
+}
+/* Stop the clock once; later calls keep the first end time
+*/
+void SearchResults::Finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done.load()) return;
+    end_ = Clock::now();
+    done.store(true);
+}
+/* Time since the search was created, up to Finish
+* @return seconds
+*/
+double SearchResults::Seconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Clock::time_point end = done.load() ? end_ : Clock::now();
+    return std::chrono::duration<double>(end - start_).count();
+}
+double SearchResults::GBPerSecond() const {
+    const double s = Seconds();
+    return s > 0 ? bytes.load(std::memory_order_relaxed) / s / 1e9 : 0.0;
+}
+/* Find the needle, record its line and continue after that line, so a
+* line is reported once however often it matches. Newlines are counted
+* only for the stretch between two hits.
+* @param data
+* @param needle
+* @param options
+* @param path
+* @param hits
+*/
+void ContentSearch::ScanBuffer(std::string_view data, const std::string& needle,
+                               const SearchOptions& options, const std::filesystem::path& path,
+                               std::vector<SearchHit>& hits) {
+    if (needle.empty()) return;
+    std::size_t pos = 0;  // Start of a line; the scan resumes here
+    std::uint64_t line = 1;
+    std::size_t found = 0;
+    while (pos < data.size() && found < options.maxHitsPerFile) {
+        const std::string_view rest = data.substr(pos);
+        const std::size_t at = options.matchCase ? StrSearch::Find(rest, needle)
+                                                 : StrSearch::FindCaseless(rest, needle);
+        if (at == StrSearch::npos) break;
+        const std::size_t hit = pos + at;
+        line += StrSearch::CountByte(data.substr(pos, hit - pos), '\n');
+
+        std::size_t begin = hit;
+        while (begin > pos && data[begin - 1] != '\n') --begin;
+        const void* newline = std::memchr(data.data() + hit, '\n', data.size() - hit);
+        const std::size_t end = newline ? static_cast<const char*>(newline) - data.data() : data.size();
+        // Long lines (minified code) are shown around the hit
+        if (end - begin > kMaxLineText && hit - begin > kMaxLineText / 2) begin = hit - kMaxLineText / 2;
+        std::size_t length = std::min(end - begin, kMaxLineText);
+        if (length > 0 && begin + length == end && data[end - 1] == '\r') --length;
+
+        SearchHit h;
+        h.path = path;
+        h.line = line;
+        h.text.assign(data.data() + begin, length);
+        hits.push_back(std::move(h));
+        ++found;
+        if (!newline) break;
+        pos = end + 1;
+        ++line;
+    }
+}
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ThreadPool.h"
+
+namespace {
+// State shared by every task of one search
+struct SearchJob {
+    ThreadPool* pool = nullptr;
+    const SearchOptions* options = nullptr;
+    const std::string* needle = nullptr;
+    SearchResults* results = nullptr;
+
+    bool Live() const { return !options->progress || options->progress->Checkpoint(); }
+};
+
+// Read buffer of the calling worker, big enough for any file below kMmapThreshold
+std::vector<char>& ReadBuffer() {
+    thread_local std::vector<char> buffer(ContentSearch::kMmapThreshold);
+    return buffer;
+}
+
+/* Read or map one file, skip it if it looks binary, scan it
+* @param job
+* @param path
+*/
+void ScanFile(SearchJob& job, const std::filesystem::path& path) {
+    SearchResults& results = *job.results;
+    // O_NONBLOCK so a FIFO is not waited on; it is skipped below
+    int fd = ::open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        results.unreadable.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return;
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    std::string_view data;
+    void* map = nullptr;
+    bool ok = true;
+    if (size >= ContentSearch::kMmapThreshold) {
+        // A file truncated while mapped would fault; big files that shrink
+        // under a search are rare enough to accept that
+        map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            map = nullptr;
+            ok = false;
+        } else {
+            ::madvise(map, size, MADV_SEQUENTIAL);
+            data = std::string_view(static_cast<const char*>(map), size);
+        }
+    } else if (size > 0) {
+        std::vector<char>& buffer = ReadBuffer();
+        std::size_t got = 0;
+        while (got < size) {
+            const ssize_t r = ::pread(fd, buffer.data() + got, size - got, static_cast<off_t>(got));
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) {
+                ok = false;
+                break;
+            }
+            if (r == 0) break; // Shrank since fstat
+            got += static_cast<std::size_t>(r);
+        }
+        data = std::string_view(buffer.data(), got);
+    }
+    ::close(fd); // A mapping outlives its fd
+    if (!ok) {
+        results.unreadable.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const bool binary = job.options->skipBinary &&
+        std::memchr(data.data(), 0, std::min(data.size(), ContentSearch::kBinaryProbe)) != nullptr;
+    std::vector<SearchHit> hits;
+    if (!binary) ContentSearch::ScanBuffer(data, *job.needle, *job.options, path, hits);
+    if (map) ::munmap(map, size);
+    if (binary) {
+        results.binary.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    results.files.fetch_add(1, std::memory_order_relaxed);
+    results.bytes.fetch_add(data.size(), std::memory_order_relaxed);
+    if (job.options->progress) {
+        job.options->progress->files.fetch_add(1, std::memory_order_relaxed);
+        job.options->progress->bytes.fetch_add(data.size(), std::memory_order_relaxed);
+    }
+    results.Add(std::move(hits));
+}
+
+/* Read one directory: subdirectories become tasks, files are scanned in
+* batches of kFilesPerTask on other tasks
+* @param job
+* @param dir
+*/
+void SearchDir(SearchJob& job, const std::filesystem::path& dir) {
+    if (!job.Live()) return;
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        job.results->unreadable.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::vector<std::filesystem::path> batch;
+    auto submitBatch = [&]() {
+        job.pool->Submit([&job, files = std::move(batch)]() {
+            for (const auto& file : files) {
+                if (!job.Live()) return;
+                ScanFile(job, file);
+            }
+        });
+        batch.clear();
+    };
+    std::error_code scanEc;
+    DirScanner::ScanFd(fd, DirScanner::kNamesOnly | DirScanner::kNoFollow,
+                       [&](const DirEntryInfo& info) {
+        if (info.symlink) return true;
+        std::filesystem::path child = dir / std::string(info.name);
+        if (info.type == EntryType::Dir) {
+            job.pool->Submit([&job, child = std::move(child)]() { SearchDir(job, child); });
+            return true;
+        }
+        batch.push_back(std::move(child));
+        if (batch.size() >= ContentSearch::kFilesPerTask) submitBatch();
+        return true;
+    }, scanEc);
+    ::close(fd);
+    if (scanEc) job.results->unreadable.fetch_add(1, std::memory_order_relaxed);
+    if (!batch.empty()) submitBatch();
+}
+}
+/* Search below root on a pool. The results are not finished here; the
+* caller does that once it knows the search will not run any more.
+* @param root
+* @param needle
+* @param options
+* @param results
+* @param ec
+* @return false if cancelled or root cannot be read
+*/
+bool ContentSearch::Run(const std::filesystem::path& root, const std::string& needle,
+                        const SearchOptions& options, SearchResults& results, std::error_code& ec) {
+    ec.clear();
+    if (needle.empty()) {
+        ec = std::make_error_code(std::errc::invalid_argument);
+        return false;
+    }
+    DirEntryInfo info;
+    if (!DirScanner::StatAt(AT_FDCWD, root.c_str(), false, info)) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    SearchJob job;
+    job.options = &options;
+    job.needle = &needle;
+    job.results = &results;
+    {
+        ThreadPool pool(options.threads);
+        job.pool = &pool;
+        if (info.type == EntryType::Dir && !info.symlink) {
+            pool.Submit([&job, &root]() { SearchDir(job, root); });
+        } else {
+            ScanFile(job, root);
+        }
+        pool.Wait();
+    }
+    if (options.progress && options.progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    return true;
+}
+
+#else // Portable fallback
+#include <fstream>
+#include <iterator>
+
+/* Walk with recursive_directory_iterator and read every file whole, on
+* the calling thread
+* @param root
+* @param needle
+* @param options
+* @param results
+* @param ec
+* @return false if cancelled or root cannot be read
+*/
+bool ContentSearch::Run(const std::filesystem::path& root, const std::string& needle,
+                        const SearchOptions& options, SearchResults& results, std::error_code& ec) {
+    namespace fs = std::filesystem;
+    ec.clear();
+    if (needle.empty()) {
+        ec = std::make_error_code(std::errc::invalid_argument);
+        return false;
+    }
+    auto scan = [&](const fs::path& file) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            results.unreadable.fetch_add(1);
+            return;
+        }
+        const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (options.skipBinary &&
+            data.find('\0') < std::min(data.size(), kBinaryProbe)) {
+            results.binary.fetch_add(1);
+            return;
+        }
+        std::vector<SearchHit> hits;
+        ScanBuffer(data, needle, options, file, hits);
+        results.files.fetch_add(1);
+        results.bytes.fetch_add(data.size());
+        if (options.progress) {
+            options.progress->files.fetch_add(1);
+            options.progress->bytes.fetch_add(data.size());
+        }
+        results.Add(std::move(hits));
+    };
+    if (!fs::is_directory(fs::symlink_status(root, ec))) {
+        if (ec) return false;
+        scan(root);
+        return true;
+    }
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec);
+    if (ec) return false;
+    for (; it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            results.unreadable.fetch_add(1);
+            ec.clear();
+            continue;
+        }
+        if (options.progress && !options.progress->Checkpoint()) break;
+        std::error_code ec2;
+        if (it->is_symlink(ec2) || !it->is_regular_file(ec2)) continue;
+        scan(it->path());
+    }
+    if (options.progress && options.progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    return true;
+}
+#endif
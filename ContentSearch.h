@@ -0,0 +1,117 @@
+/*
+    Description: Declare ContentSearch, the parallel find-in-files walker, and
+                 SearchResults, the hits it streams out while it runs
+*/
+#ifndef CONTENTSEARCH_H
+#define CONTENTSEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "OpProgress.h"
+
+// One matching line
+struct SearchHit {
+    std::filesystem::path path;
+    std::uint64_t line = 0;  // 1-based
+    std::string text;        // The line, cut at ContentSearch::kMaxLineText bytes
+};
+
+/* Hits of one search, filled by the workers and read by the UI while the
+   search is still running. Hits are only ever appended, so a reader can
+   remember how many it has shown.
+*/
+class SearchResults {
+public:
+    static constexpr std::size_t kMaxHits = 1000000; // Later hits are counted, not kept
+
+    // Append the hits of one file (worker threads)
+    void Add(std::vector<SearchHit>&& hits);
+    std::size_t Size() const;
+    // Copy of hit i, i < Size()
+    SearchHit At(std::size_t i) const;
+    // Mark the search finished and stop the clock
+    void Finish();
+
+    double Seconds() const;
+    // Data scanned per second, in GB (10^9 bytes)
+    double GBPerSecond() const;
+
+    std::atomic<std::uint64_t> files{0};        // Text files scanned
+    std::atomic<std::uint64_t> bytes{0};        // Bytes of them scanned
+    std::atomic<std::uint64_t> binary{0};       // Files skipped as binary
+    std::atomic<std::uint64_t> unreadable{0};   // Files or directories that could not be read
+    std::atomic<std::uint64_t> matchedFiles{0}; // Files with at least one hit
+    std::atomic<std::uint64_t> totalHits{0};    // Hits, kept or not
+    std::atomic<bool> done{false};
+
+private:
+    using Clock = std::chrono::steady_clock;
+    mutable std::mutex mutex_;
+    std::vector<SearchHit> hits_;
+    Clock::time_point start_ = Clock::now();
+    Clock::time_point end_;
+};
+
+// Tuning knobs for a content search
+struct SearchOptions {
+    unsigned threads = 0;            // Files read in parallel, 0 for auto
+    bool matchCase = false;          // false folds ASCII case
+    bool skipBinary = true;          // Skip files with a NUL byte near the start
+    std::size_t maxHitsPerFile = 1000;
+    OpProgress* progress = nullptr;  // files/bytes count what was scanned; checked per file
+};
+
+/* Finds the lines containing a string in every file below a directory.
+                 - Directories fan out across a work-stealing pool; their files
+                   are scanned in batches of kFilesPerTask so one huge
+                   directory still uses every worker
+                 - Files of kMmapThreshold bytes or more are mapped, smaller
+                   ones are read with pread into a per-thread buffer
+                 - The scan is StrSearch::Find/FindCaseless over the whole
+                   buffer; line numbers come from a vectorized newline count
+                   of the stretch between two hits, never per line
+                 - A file with a NUL byte in its first kBinaryProbe bytes is
+                   treated as binary and skipped
+                 - Symlinks are not followed, so the walk cannot loop
+*/
+class ContentSearch {
+public:
+    static constexpr std::uint64_t kMmapThreshold = 256 * 1024;
+    static constexpr std::size_t kBinaryProbe = 8192;
+    static constexpr std::size_t kFilesPerTask = 64;
+    static constexpr std::size_t kMaxLineText = 512;
+
+    /* Search every regular file below root
+    * @param root: directory to search (a file searches itself)
+    * @param needle: text to find, may not be empty
+    * @param options
+    * @param results: receives the hits and the counters as they come in;
+    *                 calling Finish is left to the caller
+    * @param ec: operation_canceled when cancelled, the error when root cannot be read
+    * @return false when cancelled or root is unreadable
+    */
+    static bool Run(const std::filesystem::path& root, const std::string& needle,
+                    const SearchOptions& options, SearchResults& results, std::error_code& ec);
+
+    /* Append the lines of data that contain needle
+    * @param data: file contents
+    * @param needle
+    * @param options: matchCase and maxHitsPerFile
+    * @param path: stored in each hit
+    * @param hits: receives the hits
+    */
+    static void ScanBuffer(std::string_view data, const std::string& needle,
+                           const SearchOptions& options, const std::filesystem::path& path,
+                           std::vector<SearchHit>& hits);
+};
+
+#endif
@@ -0,0 +1,406 @@
+/*
+    Description: Implementation of the parallel directory tree copier.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CopyEngine.h"
+#include "DirScanner.h"
+#include "FileStat.h"
+#include "ThreadPool.h"
+
+namespace {
+// Source attributes to put back on a destination directory at the end
+struct DirAttrs {
+    std::filesystem::path dest;
+    struct stat st;
+};
+// First error wins; later failures are dropped
+struct ErrorSlot {
+    std::mutex mutex;
+    std::atomic<bool> failed{false};
+    std::error_code ec;
+    std::filesystem::path path;
+
+    void Set(const std::error_code& e, const std::filesystem::path& p) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed.load()) return;
+        ec = e;
+        path = p;
+        failed.store(true);
+    }
+};
+std::error_code LastError() {
+    return std::error_code(errno, std::generic_category());
+}
+/* Apply source mode and times to a destination path
+* @param dest
+* @param st: source stat
+* @param options
+* @return 0 on success, -1 with errno set otherwise
+*/
+int ApplyAttrs(const std::filesystem::path& dest, const struct stat& st, const CopyOptions& options) {
+    if (options.preservePerms && ::chmod(dest.c_str(), st.st_mode & 07777) != 0) return -1;
+    if (options.preserveTimes) {
+#if defined(__APPLE__)
+        struct timespec times[2] = { st.st_atimespec, st.st_mtimespec };
+#else
+        struct timespec times[2] = { st.st_atim, st.st_mtim };
+#endif
+        if (::utimensat(AT_FDCWD, dest.c_str(), times, 0) != 0) return -1;
+    }
+    return 0;
+}
+/* True if child is src itself or lies inside it
+*/
+bool IsInside(const std::filesystem::path& child, const std::filesystem::path& parent) {
+    std::error_code ec;
+    auto c = std::filesystem::weakly_canonical(child, ec);
+    if (ec) return false;
+    auto p = std::filesystem::weakly_canonical(parent, ec);
+    if (ec) return false;
+    auto mismatch = std::mismatch(p.begin(), p.end(), c.begin(), c.end());
+    return mismatch.first == p.end();
+}
+}
+/* Flush a directory's entries to disk
+* @param dir
+* @param ec
+* @return true on success
+*/
+bool CopyEngine::SyncDir(const std::filesystem::path& dir, std::error_code& ec) {
+    ec.clear();
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        ec = LastError();
+        return false;
+    }
+    if (::fsync(fd) != 0) ec = LastError();
+    ::close(fd);
+    return !ec;
+}
+/* Copy a single regular file and its attributes
+* @param src
+* @param dest
+* @param overwrite
+* @param options
+* @param bytes
+* @param ec
+* @return strategy used
+*/
+CopyStrategy CopyEngine::CopyFile(const std::filesystem::path& src,
+                                  const std::filesystem::path& dest,
+                                  bool overwrite,
+                                  const CopyOptions& options,
+                                  std::uint64_t& bytes,
+                                  std::error_code& ec) {
+    FileCopy::Options fileOptions;
+    fileOptions.overwrite = overwrite;
+    fileOptions.preservePerms = options.preservePerms;
+    fileOptions.preserveTimes = options.preserveTimes;
+    fileOptions.fsync = options.fsync;
+    fileOptions.progress = options.progress;
+    return FileCopy::CopyFile(src, dest, fileOptions, bytes, ec);
+}
+/* Copy one regular file, verified when asked
+* @param src
+* @param dest
+* @param overwrite
+* @param options
+* @param bytes
+* @param verify: left empty for a plain copy
+* @param ec
+* @return strategy used
+*/
+CopyStrategy CopyEngine::CopyFile(const std::filesystem::path& src,
+                                  const std::filesystem::path& dest,
+                                  bool overwrite,
+                                  const CopyOptions& options,
+                                  std::uint64_t& bytes,
+                                  VerifyStats& verify,
+                                  std::error_code& ec) {
+    verify = VerifyStats();
+    if (!options.verify) return CopyFile(src, dest, overwrite, options, bytes, ec);
+    FileCopy::Options fileOptions;
+    fileOptions.overwrite = overwrite;
+    fileOptions.preservePerms = options.preservePerms;
+    fileOptions.preserveTimes = options.preserveTimes;
+    fileOptions.fsync = options.fsync;
+    fileOptions.progress = options.progress;
+    return FileCopy::CopyFileVerified(src, dest, fileOptions, bytes, verify, ec);
+}
+/* Sorted "<16 hex digits>  <path>" lines, written beside the manifest
+* and renamed over it
+* @param file
+* @param checksums
+* @param ec
+* @return true on success
+*/
+bool CopyEngine::WriteManifest(const std::filesystem::path& file,
+                               std::vector<FileChecksum> checksums,
+                               std::error_code& ec) {
+    ec.clear();
+    std::sort(checksums.begin(), checksums.end(),
+              [](const FileChecksum& a, const FileChecksum& b) { return a.path < b.path; });
+    if (file.has_parent_path()) {
+        std::filesystem::create_directories(file.parent_path(), ec);
+        if (ec) return false;
+    }
+    std::filesystem::path temp = file;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        char hex[17];
+        for (const FileChecksum& sum : checksums) {
+            std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(sum.hash));
+            out << hex << "  " << sum.path.string() << '\n';
+        }
+        out.flush();
+        if (!out) {
+            std::error_code ignored;
+            std::filesystem::remove(temp, ignored);
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp, file, ec);
+    return !ec;
+}
+/* Sum the counters of another copy into this one
+* @param other
+*/
+void CopyStats::Add(const CopyStats& other) {
+    files += other.files;
+    dirs += other.dirs;
+    links += other.links;
+    bytes += other.bytes;
+    for (int i = 0; i < kCopyStrategyCount; ++i) {
+        strategyFiles[i] += other.strategyFiles[i];
+    }
+    if (errorPath.empty()) errorPath = other.errorPath;
+    verified += other.verified;
+    direct += other.direct;
+    readBackBytes += other.readBackBytes;
+    fileSeconds += other.fileSeconds;
+    hashSeconds += other.hashSeconds;
+    readBackSeconds += other.readBackSeconds;
+    checksums.insert(checksums.end(), other.checksums.begin(), other.checksums.end());
+}
+/* Count one verified file
+* @param dest: the copy
+* @param verify: what CopyFileVerified reported
+* @param copySeconds: time the whole file copy took
+*/
+void CopyStats::AddVerified(const std::filesystem::path& dest, const VerifyStats& verify, double copySeconds) {
+    ++verified;
+    if (verify.direct) ++direct;
+    readBackBytes += verify.bytesReadBack;
+    fileSeconds += copySeconds;
+    hashSeconds += verify.hashSeconds;
+    readBackSeconds += verify.readBackSeconds;
+    checksums.push_back(FileChecksum{dest, verify.hash});
+}
+/* Copy one tree; see CopyTrees
+* @param src
+* @param dest
+* @param options
+* @param stats
+* @param ec
+* @return true on success
+*/
+bool CopyEngine::CopyTree(const std::filesystem::path& src,
+                          const std::filesystem::path& dest,
+                          const CopyOptions& options,
+                          CopyStats& stats,
+                          std::error_code& ec) {
+    std::vector<PathError> failures;
+    const bool ok = CopyTrees({{src, dest}}, options, stats, failures);
+    ec = ok ? std::error_code() : failures.front().ec;
+    return ok;
+}
+/* Walk every item on this thread, create directories, queue files on one
+* shared pool. Each item has its own error slot.
+* @param items
+* @param options
+* @param stats
+* @param failures
+* @return true on success
+*/
+bool CopyEngine::CopyTrees(const std::vector<std::pair<std::filesystem::path, std::filesystem::path>>& items,
+                           const CopyOptions& options,
+                           CopyStats& stats,
+                           std::vector<PathError>& failures) {
+    failures.clear();
+    stats = CopyStats();
+    const auto start = std::chrono::steady_clock::now();
+    const std::error_code cancelled = std::make_error_code(std::errc::operation_canceled);
+
+    std::vector<ErrorSlot> errors(items.size());
+    std::vector<std::vector<DirAttrs>> dirAttrs(items.size());
+    std::atomic<std::uint64_t> files{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> strategyFiles[kCopyStrategyCount] = {};
+    std::mutex verifyMutex; // Guards the verify fields of stats
+    {
+        ThreadPool pool(options.threads);
+        auto queueFile = [&](ErrorSlot& error, std::filesystem::path from, std::filesystem::path to) {
+            if (options.progress) {
+                options.progress->totalFiles.fetch_add(1, std::memory_order_relaxed);
+            }
+            pool.Submit([&, from = std::move(from), to = std::move(to)]() {
+                if (error.failed.load(std::memory_order_relaxed)) return;
+                if (options.progress && !options.progress->Checkpoint()) {
+                    error.Set(cancelled, from);
+                    return;
+                }
+                std::uint64_t n = 0;
+                std::error_code fileEc;
+                VerifyStats verify;
+                const auto fileStart = std::chrono::steady_clock::now();
+                CopyStrategy used = CopyFile(from, to, false, options, n, verify, fileEc);
+                if (used == CopyStrategy::None) {
+                    error.Set(fileEc, from);
+                    return;
+                }
+                if (options.verify) {
+                    const double fileSeconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - fileStart).count();
+                    std::lock_guard<std::mutex> lock(verifyMutex);
+                    stats.AddVerified(to, verify, fileSeconds);
+                }
+                strategyFiles[static_cast<int>(used)].fetch_add(1, std::memory_order_relaxed);
+                files.fetch_add(1, std::memory_order_relaxed);
+                if (options.progress) {
+                    options.progress->files.fetch_add(1, std::memory_order_relaxed);
+                }
+                bytes.fetch_add(n, std::memory_order_relaxed);
+            });
+        };
+
+        // After a cancel nothing more is copied; each item left says so
+        auto cancelFrom = [&](std::size_t first) {
+            for (std::size_t rest = first; rest < items.size(); ++rest) {
+                errors[rest].Set(cancelled, items[rest].first);
+            }
+        };
+        for (std::size_t item = 0; item < items.size(); ++item) {
+            ErrorSlot& error = errors[item];
+            const auto& [src, dest] = items[item];
+            if (options.progress && !options.progress->Checkpoint()) {
+                cancelFrom(item);
+                break;
+            }
+            // The caller has usually stat'ed the selection already
+            const FileStat srcStat = options.statCache ? options.statCache->Get(src) : FileStat::Of(src);
+            if (!srcStat.IsDir()) {
+                if (!srcStat.exists) error.Set(srcStat.ec, src);
+                else queueFile(error, src, dest);
+                continue;
+            }
+            if (IsInside(dest, src)) {
+                error.Set(std::make_error_code(std::errc::invalid_argument), dest);
+                continue;
+            }
+
+            std::vector<std::pair<std::filesystem::path, std::filesystem::path>> stack;
+            stack.emplace_back(src, dest);
+            while (!stack.empty() && !error.failed.load()) {
+                auto [from, to] = std::move(stack.back());
+                stack.pop_back();
+                if (options.progress && !options.progress->Checkpoint()) {
+                    error.Set(cancelled, from);
+                    break;
+                }
+
+                struct stat st;
+                if (::stat(from.c_str(), &st) != 0) {
+                    error.Set(LastError(), from);
+                    break;
+                }
+                // Owner-writable while we fill it; the real mode is applied at the end
+                if (::mkdir(to.c_str(), (st.st_mode & 07777) | S_IRWXU) != 0) {
+                    const std::error_code mkdirEc = LastError();
+                    // Merge only into a real directory, not a file or a symlink in the way
+                    struct stat existing;
+                    if (mkdirEc != std::errc::file_exists || ::lstat(to.c_str(), &existing) != 0 ||
+                        !S_ISDIR(existing.st_mode)) {
+                        error.Set(mkdirEc, to);
+                        break;
+                    }
+                }
+                ++stats.dirs;
+                dirAttrs[item].push_back(DirAttrs{to, st});
+
+                std::error_code scanEc;
+                DirScanner::Scan(from, DirScanner::kNamesOnly, [&](const DirEntryInfo& info) {
+                    if (error.failed.load(std::memory_order_relaxed)) return false;
+                    std::filesystem::path childFrom = from / std::string(info.name);
+                    std::filesystem::path childTo = to / std::string(info.name);
+                    if (info.symlink) {
+                        std::error_code linkEc;
+                        auto target = std::filesystem::read_symlink(childFrom, linkEc);
+                        if (!linkEc) std::filesystem::create_symlink(target, childTo, linkEc);
+                        if (linkEc) {
+                            error.Set(linkEc, childFrom);
+                            return false;
+                        }
+                        ++stats.links;
+                    } else if (info.type == EntryType::Dir) {
+                        stack.emplace_back(std::move(childFrom), std::move(childTo));
+                    } else {
+                        queueFile(error, std::move(childFrom), std::move(childTo));
+                    }
+                    return true;
+                }, scanEc);
+                if (scanEc) {
+                    error.Set(scanEc, from);
+                }
+            }
+            if (error.failed.load() && error.ec == cancelled) {
+                cancelFrom(item + 1);
+                break;
+            }
+        }
+        pool.Wait();
+    }
+
+    for (std::size_t item = 0; item < items.size(); ++item) {
+        ErrorSlot& error = errors[item];
+        // Deepest directories were pushed last; fix them up first
+        for (auto it = dirAttrs[item].rbegin(); it != dirAttrs[item].rend() && !error.failed.load(); ++it) {
+            if (ApplyAttrs(it->dest, it->st, options) != 0) {
+                error.Set(LastError(), it->dest);
+                break;
+            }
+            std::error_code syncEc;
+            if (options.fsync && !SyncDir(it->dest, syncEc)) {
+                error.Set(syncEc, it->dest);
+                break;
+            }
+        }
+        if (error.failed.load()) failures.push_back(PathError{error.path, error.ec});
+    }
+
+    stats.files = files.load();
+    stats.bytes = bytes.load();
+    for (int i = 0; i < kCopyStrategyCount; ++i) {
+        stats.strategyFiles[i] = strategyFiles[i].load();
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!failures.empty()) stats.errorPath = failures.front().path;
+    return failures.empty();
+}
@@ -0,0 +1,155 @@
+/*
+    Description: Declare CopyEngine, the parallel directory tree copier
+*/
+#ifndef COPYENGINE_H
+#define COPYENGINE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "FileCopy.h"
+#include "OpProgress.h"
+
+class StatCache;
+
+// Tuning knobs for a tree copy
+struct CopyOptions {
+    unsigned threads = 0;       // Concurrent file copies, 0 for one per hardware thread
+    bool preservePerms = true;  // Copy permission bits of files and dirs
+    bool preserveTimes = true;  // Copy access and modification times
+    bool fsync = false;         // fsync every file and directory before returning
+    bool verify = false;        // Hash files while copying and read each copy back to check it
+    OpProgress* progress = nullptr; // Optional live counters, pause and cancel
+    StatCache* statCache = nullptr; // Optional stats the caller already took; used on the calling thread only
+};
+
+// Hash of one verified copy, a line of the manifest
+struct FileChecksum {
+    std::filesystem::path path; // The copy
+    std::uint64_t hash = 0;     // XXH64 of its data
+};
+
+// Result of a tree copy
+struct CopyStats {
+    std::uint64_t files = 0;    // Regular files copied
+    std::uint64_t dirs = 0;     // Directories created
+    std::uint64_t links = 0;    // Symlinks recreated
+    std::uint64_t bytes = 0;    // File data bytes copied
+    double seconds = 0.0;       // Wall clock time of the whole copy
+    std::uint64_t strategyFiles[kCopyStrategyCount] = {}; // Files per CopyStrategy
+    std::filesystem::path errorPath; // Path that caused the first error
+    // Verified copies only
+    std::uint64_t verified = 0;       // Files read back and found equal
+    std::uint64_t direct = 0;         // Of which read back past the page cache
+    std::uint64_t readBackBytes = 0;
+    double fileSeconds = 0.0;         // Time spent in file copies, summed over threads
+    double hashSeconds = 0.0;         // Of which hashing, summed over threads
+    double readBackSeconds = 0.0;     // Of which flushing and reading back, summed over threads
+    std::vector<FileChecksum> checksums; // One per verified file, in no particular order
+
+    double FilesPerSecond() const { return seconds > 0 ? files / seconds : 0.0; }
+    double MBPerSecond() const { return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0; }
+    /* Time verification added to the file copies, as a fraction of what
+    * they would have taken without it. Hashing overlaps the writes, so
+    * this is an upper bound.
+    */
+    double VerifyOverhead() const {
+        const double plain = fileSeconds - hashSeconds - readBackSeconds;
+        return plain > 0 ? (hashSeconds + readBackSeconds) / plain : 0.0;
+    }
+    // Add the counts of another copy (seconds are left alone)
+    void Add(const CopyStats& other);
+    // Count a verified file copied to dest in copySeconds
+    void AddVerified(const std::filesystem::path& dest, const VerifyStats& verify, double copySeconds);
+};
+
+/* Copies a directory tree with a bounded work-stealing pool.
+                 - The caller thread walks the source and creates every
+                   directory before any file inside it is queued
+                 - File copies run on the pool
+                 - Symlinks are recreated as symlinks, not followed
+                 - Directory permissions and times are applied last,
+                   deepest first, so later writes don't disturb them
+                 - A batch of items shares one pool: the next item is walked
+                   while files of the previous one are still being copied
+*/
+class CopyEngine {
+public:
+    /* Copy src (a directory) to dest
+    * @param src: source directory
+    * @param dest: destination directory, created if missing
+    * @param options: concurrency and preservation options
+    * @param stats: receives counts, time and the error path
+    * @param ec: first error encountered; the copy stops at it
+    * @return true if everything was copied
+    */
+    static bool CopyTree(const std::filesystem::path& src,
+                         const std::filesystem::path& dest,
+                         const CopyOptions& options,
+                         CopyStats& stats,
+                         std::error_code& ec);
+
+    /* Copy many items (files or directories) in one pipelined pass. An
+    * error stops only the item it happened in.
+    * @param items: (src, dest) pairs; dest must not exist yet
+    * @param options
+    * @param stats: counts over all items; errorPath is the first failure
+    * @param failures: receives one entry per failed item
+    * @return true if every item was copied
+    */
+    static bool CopyTrees(const std::vector<std::pair<std::filesystem::path, std::filesystem::path>>& items,
+                          const CopyOptions& options,
+                          CopyStats& stats,
+                          std::vector<PathError>& failures);
+
+    /* Copy one regular file with FileCopy, preserving permissions and times as asked
+    * @param src
+    * @param dest
+    * @param overwrite: replace an existing dest
+    * @param options
+    * @param bytes: receives the number of bytes copied
+    * @param ec
+    * @return strategy used, None on error
+    */
+    static CopyStrategy CopyFile(const std::filesystem::path& src,
+                                 const std::filesystem::path& dest,
+                                 bool overwrite,
+                                 const CopyOptions& options,
+                                 std::uint64_t& bytes,
+                                 std::error_code& ec);
+
+    /* Same, checking the copy with FileCopy::CopyFileVerified when
+    * options.verify is set
+    * @param verify: receives the hash and costs of a verified copy
+    */
+    static CopyStrategy CopyFile(const std::filesystem::path& src,
+                                 const std::filesystem::path& dest,
+                                 bool overwrite,
+                                 const CopyOptions& options,
+                                 std::uint64_t& bytes,
+                                 VerifyStats& verify,
+                                 std::error_code& ec);
+
+    /* Write checksums as an xxh64sum manifest ("<hash>  <path>" lines,
+    * sorted), which `xxhsum -c` can check later
+    * @param file: manifest to create or replace; its directory is created
+    * @param checksums
+    * @param ec
+    * @return true on success
+    */
+    static bool WriteManifest(const std::filesystem::path& file,
+                              std::vector<FileChecksum> checksums,
+                              std::error_code& ec);
+
+    /* fsync a directory so the entries created in it are durable
+    * @param dir
+    * @param ec
+    * @return true on success
+    */
+    static bool SyncDir(const std::filesystem::path& dir, std::error_code& ec);
+};
+
+#endif
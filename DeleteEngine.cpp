@@ -0,0 +1,431 @@
+/*
+    Description: Implementation of the parallel recursive remover.
+*/
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DeleteEngine.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DirScanner.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+// One item of a batch; the first error inside it stops only that item
+struct DeleteRoot {
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::error_code ec;
+    std::filesystem::path errorPath;
+
+    void Fail(int err, const std::filesystem::path& p) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed.load()) return;
+        ec.assign(err, std::generic_category());
+        errorPath = p;
+        failed.store(true);
+    }
+};
+// An open directory, closed when the last node using it lets go
+struct DirFd {
+    int fd = -1;
+    std::atomic<int>* open = nullptr; // The job's count of held fds
+
+    DirFd(int f, std::atomic<int>* count) : fd(f), open(count) {}
+    ~DirFd() {
+        if (fd >= 0) ::close(fd);
+        if (open) open->fetch_sub(1);
+    }
+};
+/* A directory still being emptied. It is opened and removed relative to
+   its parent's fd, never by path, so a directory swapped for a symlink
+   mid-walk cannot lead the delete outside the tree.
+*/
+struct DirNode {
+    std::shared_ptr<DirNode> parent;
+    DeleteRoot* root = nullptr;
+    std::shared_ptr<DirFd> parentFd; // The directory that holds this one
+    std::shared_ptr<DirFd> fd;       // This one, open while its children need it
+    std::string name;                // Name in parentFd
+    std::filesystem::path path;      // For error reports only
+    std::atomic<int> pending{1};     // Own scan plus unfinished subdirectories
+};
+// State shared by every task of one delete
+struct DeleteJob {
+    ThreadPool* pool = nullptr;
+    OpProgress* progress = nullptr;
+    std::atomic<std::uint64_t> entries{0};
+    std::atomic<int> openDirs{0};        // DirFds alive, against kMaxOpenDirs
+    std::filesystem::path lastParent;    // Parent of the last root, and its fd,
+    std::shared_ptr<DirFd> lastParentFd; // shared by roots in the same directory
+
+    void Count() {
+        entries.fetch_add(1, std::memory_order_relaxed);
+        TRACE_COUNT(kFiles, 1);
+        if (progress) progress->files.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+void EmptyDir(DeleteJob& job, std::shared_ptr<DirNode> node);
+
+/* Empty the directory name in parentFd depth first, one fd at a time
+* (two while moving). Used past kMaxOpenDirs. Subdirectories are entered
+* relative to the current fd; going back up goes through ".." and must
+* arrive at the dev/inode it left, so a directory moved mid-walk stops
+* the delete instead of steering it elsewhere.
+* @param job
+* @param root
+* @param parentFd
+* @param name
+* @param path: of name, for error reports only
+* @return true if the directory is empty; the caller removes it
+*/
+bool EmptyDirSerial(DeleteJob& job, DeleteRoot& root, int parentFd, const std::string& name,
+                    const std::filesystem::path& path) {
+    struct Level {
+        std::string name;                 // In the level above
+        std::uint64_t dev = 0;
+        std::uint64_t ino = 0;
+        std::vector<std::string> subdirs; // Still to empty and remove
+    };
+    std::vector<Level> stack;
+    std::filesystem::path current = path;
+    int fd = -1;
+    // Open entry in atFd, unlink its non-directories and note its subdirectories
+    auto enter = [&](int atFd, const std::string& entry) {
+        const int child = ::openat(atFd, entry.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        TRACE_COUNT(kSyscalls, 3); // openat, fstat and close
+        struct stat st;
+        if (child < 0 || ::fstat(child, &st) != 0) {
+            root.Fail(errno, current);
+            if (child >= 0) ::close(child);
+            return false;
+        }
+        if (fd >= 0) ::close(fd);
+        fd = child;
+        Level level;
+        level.name = entry;
+        level.dev = st.st_dev;
+        level.ino = st.st_ino;
+        std::error_code scanEc;
+        DirScanner::ScanFd(fd, DirScanner::kNamesOnly | DirScanner::kNoFollow,
+                           [&](const DirEntryInfo& info) {
+            if (root.failed.load(std::memory_order_relaxed)) return false;
+            std::string sub(info.name);
+            if (info.type == EntryType::Dir && !info.symlink) {
+                level.subdirs.push_back(std::move(sub));
+                return true;
+            }
+            TRACE_TIME(kDelete);
+            TRACE_COUNT(kSyscalls, 1);
+            if (::unlinkat(fd, sub.c_str(), 0) != 0) {
+                if (errno == EISDIR) {
+                    level.subdirs.push_back(std::move(sub));
+                } else if (errno != ENOENT) {
+                    root.Fail(errno, current / sub);
+                    return false;
+                }
+                return true;
+            }
+            job.Count();
+            return true;
+        }, scanEc);
+        if (scanEc) root.Fail(scanEc.value(), current);
+        stack.push_back(std::move(level));
+        return !root.failed.load();
+    };
+    bool ok = enter(parentFd, name);
+    while (ok) {
+        if (job.progress && !job.progress->Checkpoint()) {
+            root.Fail(ECANCELED, current);
+            ok = false;
+            break;
+        }
+        if (!stack.back().subdirs.empty()) {
+            const std::string sub = std::move(stack.back().subdirs.back());
+            stack.back().subdirs.pop_back();
+            current /= sub;
+            ok = enter(fd, sub);
+            continue;
+        }
+        if (stack.size() == 1) break;
+        const Level done = std::move(stack.back());
+        stack.pop_back();
+        current = current.parent_path();
+        const int up = ::openat(fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        TRACE_COUNT(kSyscalls, 4); // openat, fstat, close and unlinkat
+        struct stat st;
+        if (up < 0 || ::fstat(up, &st) != 0) {
+            root.Fail(errno, current);
+            if (up >= 0) ::close(up);
+            ok = false;
+            break;
+        }
+        ::close(fd);
+        fd = up;
+        if (static_cast<std::uint64_t>(st.st_dev) != stack.back().dev ||
+            static_cast<std::uint64_t>(st.st_ino) != stack.back().ino) {
+            root.Fail(EIO, current); // Moved while being emptied
+            ok = false;
+            break;
+        }
+        TRACE_TIME(kDelete);
+        if (::unlinkat(fd, done.name.c_str(), AT_REMOVEDIR) != 0 && errno != ENOENT) {
+            root.Fail(errno, current / done.name);
+            ok = false;
+            break;
+        }
+        job.Count();
+    }
+    if (fd >= 0) ::close(fd);
+    return ok;
+}
+
+/* Drop one pending reference; the last one removes the directory and
+* walks up to the parent
+*/
+void Release(DeleteJob& job, std::shared_ptr<DirNode> node) {
+    while (node && node->pending.fetch_sub(1) == 1) {
+        if (node->root->failed.load()) return;
+        TRACE_TIME(kDelete);
+        TRACE_COUNT(kSyscalls, 1);
+        if (::unlinkat(node->parentFd->fd, node->name.c_str(), AT_REMOVEDIR) != 0 && errno != ENOENT) {
+            node->root->Fail(errno, node->path);
+            return;
+        }
+        node->fd.reset();
+        job.Count();
+        node = node->parent;
+    }
+}
+/* Open node relative to its parent, unlink every non-directory in it
+* relative to its own fd and queue subdirectories
+*/
+void EmptyDir(DeleteJob& job, std::shared_ptr<DirNode> node) {
+    DeleteRoot& root = *node->root;
+    if (root.failed.load(std::memory_order_relaxed)) return;
+    if (job.progress && !job.progress->Checkpoint()) {
+        root.Fail(ECANCELED, node->path);
+        return;
+    }
+    // Holding an fd per level would run out of them in a deep tree
+    if (job.openDirs.fetch_add(1) >= DeleteEngine::kMaxOpenDirs) {
+        job.openDirs.fetch_sub(1);
+        if (EmptyDirSerial(job, root, node->parentFd->fd, node->name, node->path)) Release(job, node);
+        return;
+    }
+    const int fd = ::openat(node->parentFd->fd, node->name.c_str(),
+                            O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    TRACE_COUNT(kSyscalls, 2); // openat and close
+    if (fd < 0) {
+        job.openDirs.fetch_sub(1);
+        root.Fail(errno, node->path);
+        return;
+    }
+    node->fd = std::make_shared<DirFd>(fd, &job.openDirs);
+    auto queueChild = [&](const std::string& name) {
+        auto child = std::make_shared<DirNode>();
+        child->parent = node;
+        child->root = node->root;
+        child->parentFd = node->fd;
+        child->name = name;
+        child->path = node->path / name;
+        node->pending.fetch_add(1);
+        job.pool->Submit([&job, child]() { EmptyDir(job, child); });
+    };
+    std::error_code scanEc;
+    DirScanner::ScanFd(fd, DirScanner::kNamesOnly | DirScanner::kNoFollow,
+                       [&](const DirEntryInfo& info) {
+        if (root.failed.load(std::memory_order_relaxed)) return false;
+        const std::string name(info.name);
+        if (info.type == EntryType::Dir && !info.symlink) {
+            queueChild(name);
+            return true;
+        }
+        TRACE_TIME(kDelete);
+        TRACE_COUNT(kSyscalls, 1);
+        if (::unlinkat(fd, name.c_str(), 0) != 0) {
+            // d_type can be stale; retry as a directory
+            if (errno == EISDIR) {
+                queueChild(name);
+                return true;
+            }
+            if (errno != ENOENT) {
+                root.Fail(errno, node->path / name);
+                return false;
+            }
+            return true;
+        }
+        job.Count();
+        return true;
+    }, scanEc);
+    if (scanEc) {
+        root.Fail(scanEc.value(), node->path);
+        return;
+    }
+    Release(job, node);
+}
+/* Remove one batch item: unlink a non-directory here, or queue the
+* emptying of a directory tree
+*/
+void StartRoot(DeleteJob& job, DeleteRoot& root, const std::filesystem::path& p) {
+    if (job.progress && !job.progress->Checkpoint()) {
+        root.Fail(ECANCELED, p);
+        return;
+    }
+    TRACE_COUNT(kSyscalls, 1);
+    TRACE_COUNT(kStats, 1);
+    struct stat st;
+    if (::lstat(p.c_str(), &st) != 0) {
+        if (errno != ENOENT) root.Fail(errno, p); // Already gone is fine
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        TRACE_TIME(kDelete);
+        TRACE_COUNT(kSyscalls, 1);
+        if (::unlink(p.c_str()) != 0) {
+            if (errno != ENOENT) root.Fail(errno, p);
+            return;
+        }
+        job.Count();
+        return;
+    }
+    // Only the root's own parent is opened by path; everything below is fd-relative
+    std::filesystem::path clean = p.lexically_normal();
+    if (!clean.has_filename()) clean = clean.parent_path();
+    const std::filesystem::path parent = clean.has_parent_path() ? clean.parent_path() : ".";
+    if (!job.lastParentFd || parent != job.lastParent) {
+        job.lastParentFd.reset();
+        const int parentFd = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        TRACE_COUNT(kSyscalls, 2); // open and close
+        if (parentFd < 0) {
+            root.Fail(errno, p);
+            return;
+        }
+        job.openDirs.fetch_add(1);
+        job.lastParentFd = std::make_shared<DirFd>(parentFd, &job.openDirs);
+        job.lastParent = parent;
+    }
+    auto node = std::make_shared<DirNode>();
+    node->root = &root;
+    node->parentFd = job.lastParentFd;
+    node->name = clean.filename().string();
+    node->path = p;
+    job.pool->Submit([&job, node]() { EmptyDir(job, node); });
+}
+}
+/* Delete one tree; see DeleteTrees
+* @param p
+* @param options
+* @param stats
+* @param ec
+* @return true on success
+*/
+bool DeleteEngine::DeleteTree(const std::filesystem::path& p,
+                              const DeleteOptions& options,
+                              DeleteStats& stats,
+                              std::error_code& ec) {
+    std::vector<PathError> failures;
+    const bool ok = DeleteTrees({p}, options, stats, failures);
+    ec = ok ? std::error_code() : failures.front().ec;
+    return ok;
+}
+/* Delete every path on one pool with fd-relative unlinks. Plain files are
+* unlinked as they come; trees fan out while later items are started.
+* @param paths
+* @param options
+* @param stats
+* @param failures
+* @return true on success
+*/
+bool DeleteEngine::DeleteTrees(const std::vector<std::filesystem::path>& paths,
+                               const DeleteOptions& options,
+                               DeleteStats& stats,
+                               std::vector<PathError>& failures) {
+    failures.clear();
+    stats = DeleteStats();
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<DeleteRoot> roots(paths.size());
+    DeleteJob job;
+    job.progress = options.progress;
+    {
+        ThreadPool pool(options.threads);
+        job.pool = &pool;
+        for (std::size_t i = 0; i < paths.size(); ++i) {
+            StartRoot(job, roots[i], paths[i]);
+        }
+        job.lastParentFd.reset();
+        pool.Wait();
+    }
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        if (roots[i].failed.load()) failures.push_back(PathError{roots[i].errorPath, roots[i].ec});
+    }
+    stats.entries = job.entries.load();
+    if (!failures.empty()) stats.errorPath = failures.front().path;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return failures.empty();
+}
+
+#else // Portable fallback
+
+/* Delete one tree; see DeleteTrees
+* @param p
+* @param options
+* @param stats
+* @param ec
+* @return true on success
+*/
+bool DeleteEngine::DeleteTree(const std::filesystem::path& p,
+                              const DeleteOptions& options,
+                              DeleteStats& stats,
+                              std::error_code& ec) {
+    std::vector<PathError> failures;
+    const bool ok = DeleteTrees({p}, options, stats, failures);
+    ec = ok ? std::error_code() : failures.front().ec;
+    return ok;
+}
+/* Delete each path with std::filesystem::remove_all
+* @param paths
+* @param options
+* @param stats
+* @param failures
+* @return true on success
+*/
+bool DeleteEngine::DeleteTrees(const std::vector<std::filesystem::path>& paths,
+                               const DeleteOptions& options,
+                               DeleteStats& stats,
+                               std::vector<PathError>& failures) {
+    failures.clear();
+    stats = DeleteStats();
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& p : paths) {
+        if (options.progress && !options.progress->Checkpoint()) {
+            failures.push_back(PathError{p, std::make_error_code(std::errc::operation_canceled)});
+            break;
+        }
+        std::error_code ec;
+        auto removed = std::filesystem::remove_all(p, ec);
+        if (ec) {
+            failures.push_back(PathError{p, ec});
+            continue;
+        }
+        stats.entries += static_cast<std::uint64_t>(removed);
+        if (options.progress) options.progress->files.fetch_add(static_cast<std::uint64_t>(removed));
+    }
+    if (!failures.empty()) stats.errorPath = failures.front().path;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return failures.empty();
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+    Description: Declare DeleteEngine, the parallel recursive remover
+*/
+#ifndef DELETEENGINE_H
+#define DELETEENGINE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#include "OpProgress.h"
+
+// Tuning knobs for a recursive delete
+struct DeleteOptions {
+    unsigned threads = 0;            // Directories processed in parallel, 0 for auto
+    OpProgress* progress = nullptr;  // files counts removed entries; checked per directory
+};
+
+// Result of a recursive delete
+struct DeleteStats {
+    std::uint64_t entries = 0;       // Files, links and directories removed
+    double seconds = 0.0;
+    std::filesystem::path errorPath; // Path that caused the first error
+
+    double EntriesPerSecond() const { return seconds > 0 ? entries / seconds : 0.0; }
+};
+
+/* Removes a tree without resolving a path below the item it was given.
+                 - Each directory is opened with openat relative to its
+                   parent's fd; its files are unlinked relative to its own
+                 - Directories are removed with unlinkat(AT_REMOVEDIR) on
+                   the parent's fd, so a directory swapped for a symlink
+                   mid-walk cannot send the delete outside the tree
+                 - A directory's fd stays open until its subtree is gone, up
+                   to kMaxOpenDirs fds. Past that (a very deep tree) a
+                   subtree is emptied depth first with two fds, climbing
+                   back through ".." checked against the dev/inode it came
+                   down from, the way fts does
+                 - Subdirectories fan out across a work-stealing pool
+                 - A directory is removed when its last child finishes
+                 - Symlinks are removed, never followed
+                 - A batch of paths shares one pool and fails item by item
+*/
+class DeleteEngine {
+public:
+    // Directory fds one delete keeps open before it goes depth first
+    static constexpr int kMaxOpenDirs = 128;
+
+    /* Delete p and everything below it. A missing p is not an error.
+    * @param p: file or directory
+    * @param options
+    * @param stats: receives counts, time and the error path
+    * @param ec: first error; the delete stops at it
+    * @return true if everything was removed
+    */
+    static bool DeleteTree(const std::filesystem::path& p,
+                           const DeleteOptions& options,
+                           DeleteStats& stats,
+                           std::error_code& ec);
+
+    /* Delete many paths in one pass. An error stops only the item it
+    * happened in; missing paths are not errors.
+    * @param paths: files or directories
+    * @param options
+    * @param stats: counts over all items; errorPath is the first failure
+    * @param failures: receives one entry per failed item
+    * @return true if every item was removed
+    */
+    static bool DeleteTrees(const std::vector<std::filesystem::path>& paths,
+                            const DeleteOptions& options,
+                            DeleteStats& stats,
+                            std::vector<PathError>& failures);
+};
+
+#endif
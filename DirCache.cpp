@@ -0,0 +1,145 @@
+/*
+    Description: Implementation of the directory listing cache.
+*/
+#include <system_error>
+
+#include "DirCache.h"
+#include "DirScanner.h"
+/* Create an empty cache
+* @param budgetBytes: memory budget for all listings
+*/
+DirCache::DirCache(std::size_t budgetBytes) {
+    stats_.budget = budgetBytes;
+}
+/* Stat dir (following symlinks) into a stamp
+* @param dir
+* @param out
+* @return true on success
+*/
+bool DirCache::Stamp(const std::filesystem::path& dir, DirStamp& out) {
+    DirEntryInfo info;
+    std::error_code ec;
+    if (!DirScanner::Stat(dir, info, ec)) return false;
+    out.dev = info.dev;
+    out.ino = info.ino;
+    out.mtimeNs = info.mtimeNs;
+    return true;
+}
+/* Stamp from an existing stat
+* @param st
+* @return DirStamp, not Valid() when st does not exist
+*/
+DirStamp DirCache::Stamp(const FileStat& st) {
+    DirStamp out;
+    if (!st.exists) return out;
+    out.dev = st.dev;
+    out.ino = st.ino;
+    out.mtimeNs = st.mtimeNs;
+    return out;
+}
+/* Map a path to its cache key
+* @param dir
+* @return normalized path string
+*/
+std::string DirCache::Key(const std::filesystem::path& dir) {
+    std::string key = dir.lexically_normal().string();
+    while (key.size() > 1 && key.back() == '/') key.pop_back();
+    return key;
+}
+/* Look up dir and check it against its current stamp
+* @param dir
+* @param stamp
+* @return listing on a hit
+*/
+std::shared_ptr<const EntryStore> DirCache::Lookup(const std::filesystem::path& dir, DirStamp& stamp) {
+    DirStamp now;
+    Stamp(dir, now); // Left invalid when dir cannot be stat'ed
+    return Lookup(dir, now, stamp);
+}
+/* Look up dir against a stamp the caller took
+* @param dir
+* @param now
+* @param stamp
+* @return listing on a hit
+*/
+std::shared_ptr<const EntryStore> DirCache::Lookup(const std::filesystem::path& dir, const DirStamp& now,
+                                                   DirStamp& stamp) {
+    const std::string key = Key(dir);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = map_.find(key);
+    if (found == map_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    if (!now.Valid() || found->second->stamp != now) {
+        ++stats_.misses;
+        ++stats_.stale;
+        EraseLocked(found->second);
+        return nullptr;
+    }
+    ++stats_.hits;
+    stamp = now;
+    lru_.splice(lru_.begin(), lru_, found->second);
+    return lru_.front().listing;
+}
+/* Insert or replace the listing of dir and evict down to the budget
+* @param dir
+* @param stamp
+* @param listing
+*/
+void DirCache::Store(const std::filesystem::path& dir, const DirStamp& stamp,
+                     std::shared_ptr<const EntryStore> listing) {
+    if (!listing || !stamp.Valid()) return;
+    const std::string key = Key(dir);
+    const std::size_t bytes = listing->MemoryBytes() + sizeof(Node) + key.size();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = map_.find(key);
+    if (found != map_.end()) EraseLocked(found->second);
+    if (bytes > stats_.budget) return;
+    lru_.push_front(Node{key, stamp, std::move(listing), bytes});
+    map_[key] = lru_.begin();
+    stats_.bytes += bytes;
+    ++stats_.entries;
+    EvictLocked();
+}
+/* Drop the listing of dir if cached
+* @param dir
+*/
+void DirCache::Invalidate(const std::filesystem::path& dir) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = map_.find(Key(dir));
+    if (found != map_.end()) EraseLocked(found->second);
+}
+/* Set the memory budget
+* @param bytes
+*/
+void DirCache::SetBudget(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.budget = bytes;
+    EvictLocked();
+}
+std::size_t DirCache::Budget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_.budget;
+}
+DirCache::Stats DirCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+/* Remove one node (mutex_ held)
+* @param it
+*/
+void DirCache::EraseLocked(List::iterator it) {
+    stats_.bytes -= it->bytes;
+    --stats_.entries;
+    map_.erase(it->key);
+    lru_.erase(it);
+}
+/* Drop least recently used listings until within budget (mutex_ held)
+*/
+void DirCache::EvictLocked() {
+    while (stats_.bytes > stats_.budget && !lru_.empty()) {
+        EraseLocked(std::prev(lru_.end()));
+        ++stats_.evictions;
+    }
+}
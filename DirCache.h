@@ -0,0 +1,110 @@
+/*
+    Description: Declare DirCache, the LRU cache of directory listings
+*/
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "EntryStore.h"
+#include "FileStat.h"
+
+/* Identity and version of a directory. Adding, removing or renaming an
+   entry changes the directory's mtime; replacing the directory changes
+   its inode.
+*/
+struct DirStamp {
+    std::uint64_t dev = 0;
+    std::uint64_t ino = 0;
+    std::int64_t mtimeNs = EntryStore::kUnknownTime;
+
+    bool Valid() const { return mtimeNs != EntryStore::kUnknownTime; }
+    bool operator==(const DirStamp& o) const {
+        return dev == o.dev && ino == o.ino && mtimeNs == o.mtimeNs;
+    }
+    bool operator!=(const DirStamp& o) const { return !(*this == o); }
+};
+
+/* Keeps the listings of recently shown directories.
+                 - Keyed by normalized path, least recently used evicted first
+                 - A listing is stored with the stamp it is known to be current
+                   for and only handed back while the directory still has it
+                 - Total size is bounded by a byte budget (EntryStore::MemoryBytes)
+*/
+class DirCache {
+public:
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;      // Not cached, or cached but stale
+        std::uint64_t stale = 0;       // Misses that dropped an outdated listing
+        std::uint64_t evictions = 0;
+        std::size_t entries = 0;       // Listings held
+        std::size_t bytes = 0;         // Memory held by those listings
+        std::size_t budget = 0;
+    };
+
+    static constexpr std::size_t kDefaultBudget = 64 * 1024 * 1024;
+
+    explicit DirCache(std::size_t budgetBytes = kDefaultBudget);
+
+    /* Read the current stamp of a directory
+    * @param dir
+    * @param out: receives dev, inode and mtime
+    * @return false if dir cannot be stat'ed
+    */
+    static bool Stamp(const std::filesystem::path& dir, DirStamp& out);
+    // The stamp in a stat the caller already has; invalid if it does not exist
+    static DirStamp Stamp(const FileStat& st);
+
+    /* Return the listing of dir if it was stored with the stamp dir has now
+    * @param dir
+    * @param stamp: receives the stamp of a hit
+    * @return the listing, or nullptr on a miss
+    */
+    std::shared_ptr<const EntryStore> Lookup(const std::filesystem::path& dir, DirStamp& stamp);
+    // Same, checked against a stamp the caller just took instead of a new stat
+    std::shared_ptr<const EntryStore> Lookup(const std::filesystem::path& dir, const DirStamp& now,
+                                             DirStamp& stamp);
+
+    /* Remember a complete listing. Listings larger than the budget are not kept.
+    * @param dir
+    * @param stamp: stamp the listing is current for (taken before it was read)
+    * @param listing
+    */
+    void Store(const std::filesystem::path& dir, const DirStamp& stamp,
+               std::shared_ptr<const EntryStore> listing);
+
+    // Forget dir
+    void Invalidate(const std::filesystem::path& dir);
+    // Change the budget, evicting as needed. 0 disables the cache
+    void SetBudget(std::size_t bytes);
+    std::size_t Budget() const;
+    Stats GetStats() const;
+
+private:
+    struct Node {
+        std::string key;
+        DirStamp stamp;
+        std::shared_ptr<const EntryStore> listing;
+        std::size_t bytes = 0;
+    };
+    using List = std::list<Node>;
+
+    static std::string Key(const std::filesystem::path& dir);
+    void EraseLocked(List::iterator it);
+    void EvictLocked();
+
+    mutable std::mutex mutex_;
+    List lru_;  // Most recently used first
+    std::unordered_map<std::string, List::iterator> map_;
+    Stats stats_;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+    Description: Implementation of the background directory enumerator.
+*/
+#include <chrono>
+
+#include "DirLoader.h"
+#include "DirScanner.h"
+#include "FileOp.h"
+#include "Trace.h"
+/* Cancel outstanding loads and wait for their threads
+*/
+DirLoader::~DirLoader() {
+    Shutdown();
+}
+/* Start enumerating a directory on a new worker. A worker blocked in a slow
+* filesystem call is not waited for; it is cancelled and reaped later.
+* @param dir: directory to list
+* @param onBatch: batch callback, runs on the worker thread
+* @return generation of this load
+*/
+std::uint64_t DirLoader::Start(const std::filesystem::path& dir, BatchFn onBatch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& w : workers_) {
+        w.cancel->store(true);
+    }
+    ReapFinished();
+    Worker w;
+    w.cancel = std::make_shared<std::atomic<bool>>(false);
+    w.finished = std::make_shared<std::atomic<bool>>(false);
+    const std::uint64_t generation = ++generation_;
+    auto finished = w.finished;
+    auto cancel = w.cancel;
+    w.thread = std::thread([dir, generation, onBatch, cancel, finished]() {
+        Run(dir, generation, onBatch, cancel);
+        finished->store(true);
+    });
+    workers_.push_back(std::move(w));
+    return generation;
+}
+/* Cancel the running load. The generation moves on so batches that are
+* already queued no longer match and callers drop them.
+*/
+void DirLoader::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    for (auto& w : workers_) {
+        w.cancel->store(true);
+    }
+    ReapFinished();
+}
+/* Cancel every worker and join them all
+*/
+void DirLoader::Shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& w : workers_) {
+        w.cancel->store(true);
+    }
+    for (auto& w : workers_) {
+        if (w.thread.joinable()) w.thread.join();
+    }
+    workers_.clear();
+}
+/* Join and drop workers whose thread has returned. Caller holds mutex_
+*/
+void DirLoader::ReapFinished() {
+    for (auto it = workers_.begin(); it != workers_.end();) {
+        if (it->finished->load()) {
+            if (it->thread.joinable()) it->thread.join();
+            it = workers_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+/* Worker body: walk the directory and flush batches by count or time
+* @param dir
+* @param generation
+* @param onBatch
+* @param cancel: set when the load is no longer wanted
+*/
+void DirLoader::Run(std::filesystem::path dir, std::uint64_t generation, BatchFn onBatch,
+                    std::shared_ptr<std::atomic<bool>> cancel) {
+    TRACE_SCOPE_ARG(scope, kOps, "LoadDir");
+    std::uint64_t entries = 0;
+    using Clock = std::chrono::steady_clock;
+    auto batch = std::make_shared<EntryStore>();
+    auto lastFlush = Clock::now();
+    std::size_t flushAt = kFirstBatchEntries; // Small first batch for a fast first paint
+    std::error_code ec;
+
+    // One getdents64 per 64 KiB of names and one statx per entry
+    DirScanner::Scan(dir, DirScanner::kWantStat, [&](const DirEntryInfo& info) {
+        if (cancel->load(std::memory_order_relaxed)) return false;
+        // Hidden like in MainFrame::ApplyDelta; the ones a crash left are cleaned up
+        if (FileOp::IsStagingName(info.name)) {
+            FileOp::ReclaimIfStale(dir, info.name);
+            return true;
+        }
+        ++entries;
+        batch->Append(info.name, info.type,
+                      info.type == EntryType::File ? info.size : EntryStore::kUnknownSize,
+                      info.mtimeNs);
+
+        auto now = Clock::now();
+        if (batch->Size() >= flushAt || now - lastFlush >= kBatchInterval) {
+            onBatch(generation, std::move(batch), false, std::error_code());
+            batch = std::make_shared<EntryStore>();
+            batch->Reserve(kBatchEntries, kBatchEntries * 16);
+            lastFlush = now;
+            flushAt = kBatchEntries;
+        }
+        return true;
+    }, ec);
+    TRACE_SET_ARG(scope, entries);
+    if (cancel->load()) return;
+    onBatch(generation, std::move(batch), true, ec);
+}
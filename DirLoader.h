@@ -0,0 +1,69 @@
+/*
+    Description: Declare DirLoader, the background directory enumerator
+*/
+#ifndef DIRLOADER_H
+#define DIRLOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "EntryStore.h"
+
+/* Enumerates one directory at a time on a worker thread.
+                 - Entries are handed out in batches (kBatchEntries or kBatchInterval)
+                 - Starting a new load cancels the previous one
+                 - Each load has a generation number so stale batches can be dropped
+*/
+class DirLoader {
+public:
+    /* Called on the worker thread for every batch
+    * @param generation: load the batch belongs to
+    * @param batch: entries read since the previous batch
+    * @param done: true for the last batch of the load
+    * @param ec: error that ended the load, only set when done
+    */
+    using BatchFn = std::function<void(std::uint64_t generation,
+                                       std::shared_ptr<EntryStore> batch,
+                                       bool done,
+                                       std::error_code ec)>;
+
+    static constexpr std::size_t kBatchEntries = 4096;
+    static constexpr std::size_t kFirstBatchEntries = 256;
+    static constexpr std::chrono::milliseconds kBatchInterval{50};
+
+    ~DirLoader();
+
+    // Cancel the current load and start enumerating dir, returns its generation
+    std::uint64_t Start(const std::filesystem::path& dir, BatchFn onBatch);
+    // Cancel the current load, if any; its queued batches become stale
+    void Cancel();
+    // Cancel everything and wait for all workers to exit
+    void Shutdown();
+    // Generation of the most recent Start
+    std::uint64_t Generation() const { return generation_; }
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> cancel;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+    // Join workers that have already exited
+    void ReapFinished();
+    static void Run(std::filesystem::path dir, std::uint64_t generation, BatchFn onBatch,
+                    std::shared_ptr<std::atomic<bool>> cancel);
+
+    std::mutex mutex_;
+    std::vector<Worker> workers_;  // Current load last; older ones are cancelled
+    std::uint64_t generation_ = 0;
+};
+
+#endif
@@ -0,0 +1,258 @@
+/*
+    Description: Implementation of the low level directory reader.
+*/
+#include <chrono>
+#include <string>
+
+#include "DirScanner.h"
+#include "Trace.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <memory>
+
+namespace {
+// Layout returned by getdents64
+struct LinuxDirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+constexpr std::size_t kDentsBufSize = 64 * 1024;
+
+// Owns a file descriptor for the duration of a scan
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+}
+
+/* Stat a name relative to a directory fd with a single statx call
+* @param dirFd
+* @param name
+* @param follow
+* @param info
+* @return true on success
+*/
+bool DirScanner::StatAt(int dirFd, const char* name, bool follow, DirEntryInfo& info) {
+    TRACE_TIME(kStat);
+    TRACE_COUNT(kSyscalls, 1);
+    TRACE_COUNT(kStats, 1);
+    struct statx stx;
+    const int flags = AT_STATX_SYNC_AS_STAT | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+    const unsigned mask = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_INO |
+                          STATX_SIZE | STATX_MTIME | STATX_BLOCKS;
+    if (::statx(dirFd, name, flags, mask, &stx) != 0) {
+        return false;
+    }
+    const mode_t fmt = stx.stx_mode & S_IFMT;
+    info.type = fmt == S_IFDIR ? EntryType::Dir : EntryType::File;
+    if (!follow && fmt == S_IFLNK) info.symlink = true;
+    info.size = stx.stx_size;
+    info.mtimeNs = static_cast<std::int64_t>(stx.stx_mtime.tv_sec) * 1000000000 +
+                   stx.stx_mtime.tv_nsec;
+    info.dev = (static_cast<std::uint64_t>(stx.stx_dev_major) << 32) | stx.stx_dev_minor;
+    info.ino = stx.stx_ino;
+    info.mode = stx.stx_mode;
+    info.nlink = stx.stx_nlink;
+    info.blocks = (stx.stx_mask & STATX_BLOCKS) ? stx.stx_blocks : 0;
+    return true;
+}
+/* Read all entries of an open directory with getdents64
+* @param dirFd
+* @param flags
+* @param fn
+* @param ec
+* @return true unless reading failed
+*/
+bool DirScanner::ScanFd(int dirFd, unsigned flags, const EntryFn& fn, std::error_code& ec) {
+    ec.clear();
+    std::unique_ptr<char[]> buf(new char[kDentsBufSize]);
+    const bool wantStat = (flags & kWantStat) != 0;
+    const bool follow = (flags & kNoFollow) == 0;
+    for (;;) {
+        long n;
+        {
+            TRACE_TIME(kEnumerate);
+            n = ::syscall(SYS_getdents64, dirFd, buf.get(), kDentsBufSize);
+        }
+        TRACE_COUNT(kSyscalls, 1);
+        TRACE_COUNT(kDirReads, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ec.assign(errno, std::generic_category());
+            return false;
+        }
+        if (n == 0) return true;
+        for (long off = 0; off < n;) {
+            auto* d = reinterpret_cast<LinuxDirent64*>(buf.get() + off);
+            off += d->d_reclen;
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            TRACE_COUNT(kEntries, 1);
+            DirEntryInfo info;
+            info.name = std::string_view(name);
+            info.ino = d->d_ino;
+            switch (d->d_type) {
+            case DT_DIR: info.type = EntryType::Dir; break;
+            case DT_LNK: info.symlink = true; break;
+            case DT_UNKNOWN: break;
+            default: info.type = EntryType::File; break;
+            }
+            // One statx per entry at most, except for symlinks of unknown d_type
+            if (d->d_type == DT_UNKNOWN || (wantStat && (!info.symlink || !follow))) {
+                StatAt(dirFd, name, false, info);
+            }
+            if (info.symlink && !follow) {
+                info.type = EntryType::File;
+            } else if (info.symlink) {
+                // Symlinks are reported with their target's type and size
+                DirEntryInfo target;
+                if (StatAt(dirFd, name, true, target)) {
+                    target.name = info.name;
+                    if (wantStat) info = target;
+                    else info.type = target.type;
+                } else {
+                    info.type = EntryType::File; // Dangling link
+                }
+                info.symlink = true;
+            }
+            if (!fn(info)) return true;
+        }
+    }
+}
+/* Open a directory and read it with ScanFd
+* @param dir
+* @param flags
+* @param fn
+* @param ec
+* @return true on success
+*/
+bool DirScanner::Scan(const std::filesystem::path& dir, unsigned flags,
+                      const EntryFn& fn, std::error_code& ec) {
+    FdGuard fd{::openat(AT_FDCWD, dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    TRACE_COUNT(kSyscalls, 2); // openat and close
+    if (fd.fd < 0) {
+        ec.assign(errno, std::generic_category());
+        return false;
+    }
+    return ScanFd(fd.fd, flags, fn, ec);
+}
+/* Stat one path with StatAt relative to the working directory
+* @param p
+* @param info
+* @param ec
+* @return true on success
+*/
+bool DirScanner::Stat(const std::filesystem::path& p, DirEntryInfo& info, std::error_code& ec) {
+    ec.clear();
+    if (!StatAt(AT_FDCWD, p.c_str(), false, info)) {
+        ec.assign(errno, std::generic_category());
+        return false;
+    }
+    if (info.symlink) {
+        DirEntryInfo target;
+        if (StatAt(AT_FDCWD, p.c_str(), true, target)) {
+            info = target;
+            info.symlink = true;
+        } else {
+            info.type = EntryType::File; // Dangling link
+        }
+    }
+    return true;
+}
+
+#else // Portable fallback
+
+/* Convert a filesystem time to nanoseconds since the Unix epoch
+* @param ftime: System time
+* @return int64: ns since epoch
+*/
+static std::int64_t FileTimeToNs(const std::filesystem::file_time_type& ftime) {
+    using namespace std::chrono;
+    auto sctp = time_point_cast<system_clock::duration>(ftime - std::filesystem::file_time_type::clock::now()
+        + system_clock::now());
+    return duration_cast<nanoseconds>(sctp.time_since_epoch()).count();
+}
+/* Read a directory with std::filesystem::directory_iterator
+* @param dir
+* @param flags
+* @param fn
+* @param ec
+* @return true on success
+*/
+bool DirScanner::Scan(const std::filesystem::path& dir, unsigned flags,
+                      const EntryFn& fn, std::error_code& ec) {
+    ec.clear();
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (ec) break;
+        const std::string name = entry.path().filename().string();
+        DirEntryInfo info;
+        info.name = name;
+        std::error_code ec2;
+        info.symlink = entry.is_symlink(ec2);
+        const bool isDir = entry.is_directory(ec2);
+        if (!ec2) {
+            info.type = isDir ? EntryType::Dir : EntryType::File;
+            if (flags & kWantStat) {
+                if (!isDir) {
+                    const auto fileSize = entry.file_size(ec2);
+                    if (!ec2) info.size = static_cast<std::uint64_t>(fileSize);
+                }
+                auto mt = entry.last_write_time(ec2);
+                if (!ec2) info.mtimeNs = FileTimeToNs(mt);
+                info.mode = static_cast<std::uint32_t>(entry.status(ec2).permissions());
+                auto links = entry.hard_link_count(ec2);
+                if (!ec2) info.nlink = static_cast<std::uint32_t>(links);
+            }
+        }
+        if (info.symlink && (flags & kNoFollow)) info.type = EntryType::File;
+        if (!fn(info)) return true;
+    }
+    return !ec;
+}
+
+/* Stat one path through std::filesystem
+* @param p
+* @param info
+* @param ec
+* @return true on success
+*/
+bool DirScanner::Stat(const std::filesystem::path& p, DirEntryInfo& info, std::error_code& ec) {
+    const auto linkStatus = std::filesystem::symlink_status(p, ec);
+    if (ec) return false;
+    if (!std::filesystem::exists(linkStatus)) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return false;
+    }
+    info.symlink = std::filesystem::is_symlink(linkStatus);
+    std::error_code ec2;
+    const auto st = std::filesystem::status(p, ec2);
+    if (ec2 || !std::filesystem::exists(st)) {
+        info.type = EntryType::File; // Dangling link
+        return true;
+    }
+    const bool isDir = std::filesystem::is_directory(st);
+    info.type = isDir ? EntryType::Dir : EntryType::File;
+    info.mode = static_cast<std::uint32_t>(st.permissions());
+    if (!isDir) {
+        const auto fileSize = std::filesystem::file_size(p, ec2);
+        if (!ec2) info.size = static_cast<std::uint64_t>(fileSize);
+    }
+    const auto mt = std::filesystem::last_write_time(p, ec2);
+    if (!ec2) info.mtimeNs = FileTimeToNs(mt);
+    const auto links = std::filesystem::hard_link_count(p, ec2);
+    if (!ec2) info.nlink = static_cast<std::uint32_t>(links);
+    return true;
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*
+    Description: Declare DirScanner, the low level directory reader
+*/
+#ifndef DIRSCANNER_H
+#define DIRSCANNER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <system_error>
+
+#include "EntryStore.h"
+
+/* One directory entry as seen by DirScanner. Fields marked (stat) are only
+   filled when the scan asked for kWantStat.
+*/
+struct DirEntryInfo {
+    std::string_view name;   // Valid during the callback only
+    EntryType type = EntryType::Unknown; // Type after following symlinks (unless kNoFollow)
+    bool symlink = false;    // The entry itself is a symlink
+    std::uint64_t ino = 0;
+    std::uint64_t size = EntryStore::kUnknownSize;   // (stat)
+    std::int64_t mtimeNs = EntryStore::kUnknownTime; // (stat)
+    std::uint64_t dev = 0;   // (stat)
+    std::uint32_t mode = 0;  // (stat) permission bits and file type
+    std::uint32_t nlink = 0; // (stat)
+    std::uint64_t blocks = 0; // (stat) 512-byte units allocated, 0 if unknown
+};
+
+/* Reads directories with as few syscalls as possible.
+                 - Linux: openat + getdents64, type taken from d_type
+                 - One statx per entry relative to the directory fd when
+                   size/mtime are wanted, none otherwise
+                 - Other systems fall back to std::filesystem
+*/
+class DirScanner {
+public:
+    enum Flags : unsigned {
+        kNamesOnly = 0,  // Names and types; stat only when d_type is unknown
+        kWantStat = 1,   // Also fill size, mtime, dev, mode, nlink and blocks
+        kNoFollow = 2    // Report symlinks as themselves, never stat the target
+    };
+    // Return false from the callback to stop the scan early
+    using EntryFn = std::function<bool(const DirEntryInfo&)>;
+
+    /* Read every entry of a directory, skipping "." and ".."
+    * @param dir: directory to read
+    * @param flags: combination of Flags
+    * @param fn: called once per entry
+    * @param ec: error opening or reading the directory
+    * @return true if the whole directory was read (or fn stopped it)
+    */
+    static bool Scan(const std::filesystem::path& dir, unsigned flags,
+                     const EntryFn& fn, std::error_code& ec);
+
+    /* Stat a single path the way Scan reports entries: symlinks carry the
+    * target's type and size and have symlink set; dangling links are Files.
+    * @param p: path to stat
+    * @param info: receives the columns (name is left empty)
+    * @param ec: error, e.g. no_such_file_or_directory when p is gone
+    * @return true on success
+    */
+    static bool Stat(const std::filesystem::path& p, DirEntryInfo& info, std::error_code& ec);
+
+#if defined(__linux__)
+    /* Same as Scan but on an already open directory fd. The fd is not closed
+    * and its read position is left at the end.
+    */
+    static bool ScanFd(int dirFd, unsigned flags, const EntryFn& fn, std::error_code& ec);
+
+    /* Stat one name relative to a directory fd into info
+    * @param dirFd: directory fd, or AT_FDCWD
+    * @param name: entry name (null terminated)
+    * @param follow: follow a final symlink
+    * @param info: receives type, size, mtime, dev, ino, mode, nlink and blocks
+    * @return true on success, errno is left set otherwise
+    */
+    static bool StatAt(int dirFd, const char* name, bool follow, DirEntryInfo& info);
+#endif
+};
+
+#endif
@@ -0,0 +1,465 @@
+/*
+    Description: Implementation of the directory compare and incremental sync.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "CopyEngine.h"
+#include "DeleteEngine.h"
+#include "DirScanner.h"
+#include "DirSync.h"
+#include "DupFinder.h"
+#include "FileOp.h"
+#include "ThreadPool.h"
+
+const char* SyncActionName(SyncAction action) {
+    switch (action) {
+    case SyncAction::Create: return "new";
+    case SyncAction::Update: return "changed";
+    case SyncAction::Touch: return "attributes";
+    case SyncAction::Replace: return "replaced";
+    case SyncAction::Remove: return "removed";
+    }
+    return "";
+}
+/* Keep the differences of one directory and count them
+* @param items
+*/
+void SyncPlan::Add(std::vector<SyncItem>&& items) {
+    if (items.empty()) return;
+    for (const SyncItem& item : items) {
+        actions[static_cast<int>(item.action)].fetch_add(1, std::memory_order_relaxed);
+        if (item.action != SyncAction::Remove && item.action != SyncAction::Touch) {
+            copyBytes.fetch_add(item.size, std::memory_order_relaxed);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    items_.insert(items_.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+}
+std::size_t SyncPlan::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+}
+SyncItem SyncPlan::At(std::size_t i) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_[i];
+}
+std::vector<SyncItem> SyncPlan::Items() const {
+    std::vector<SyncItem> items;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items = items_;
+    }
+    std::sort(items.begin(), items.end(), [](const SyncItem& a, const SyncItem& b) { return a.rel < b.rel; });
+    return items;
+}
+/* Stop the clock once; later calls keep the first end time
+*/
+void SyncPlan::Finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done.load()) return;
+    end_ = Clock::now();
+    done.store(true);
+}
+/* Time since the plan was created, up to Finish
+* @return seconds
+*/
+double SyncPlan::Seconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Clock::time_point end = done.load() ? end_ : Clock::now();
+    return std::chrono::duration<double>(end - start_).count();
+}
+
+namespace {
+// One entry of a directory listing, kept past the scan callback
+struct Entry {
+    std::string name;
+    EntryType type = EntryType::Unknown;
+    bool symlink = false;
+    bool regular = false;    // A regular file, not a FIFO, socket or device
+    std::uint64_t size = 0;
+    std::int64_t mtimeNs = 0;
+    std::uint32_t perms = 0;
+};
+
+// Kinds that can be updated into each other; anything else is replaced
+int Kind(const Entry& e) {
+    if (e.symlink) return 2;
+    return e.type == EntryType::Dir ? 1 : 0;
+}
+
+/* Read a directory with one stat per entry, sorted by name
+* @param dir
+* @param out
+* @param ec
+* @return true on success
+*/
+bool ListDir(const std::filesystem::path& dir, std::vector<Entry>& out, std::error_code& ec) {
+    DirScanner::Scan(dir, DirScanner::kWantStat | DirScanner::kNoFollow, [&](const DirEntryInfo& info) {
+        Entry e;
+        e.name.assign(info.name.data(), info.name.size());
+        e.type = info.type;
+        e.symlink = info.symlink;
+        e.regular = !info.symlink && (info.mode & S_IFMT) == S_IFREG;
+        e.size = info.size == EntryStore::kUnknownSize ? 0 : info.size;
+        e.mtimeNs = info.mtimeNs;
+        e.perms = info.mode & 07777;
+        out.push_back(std::move(e));
+        return true;
+    }, ec);
+    std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    return !ec;
+}
+
+// A same-size file pair left for the content compare
+struct Pending {
+    std::filesystem::path rel;
+    std::uint64_t size = 0;
+    bool attrsEqual = false;  // mtime and permissions already match
+};
+
+// State shared by every task of one Plan
+struct PlanJob {
+    ThreadPool* pool = nullptr;
+    const SyncOptions* options = nullptr;
+    SyncPlan* plan = nullptr;
+    std::filesystem::path src;
+    std::filesystem::path dest;
+
+    bool Live() const { return !options->progress || options->progress->Checkpoint(); }
+};
+
+/* Hash both sides of each pair; equal content needs at most a Touch
+* @param job
+* @param batch
+*/
+void CompareContent(PlanJob& job, const std::vector<Pending>& batch) {
+    std::vector<SyncItem> items;
+    for (const Pending& p : batch) {
+        if (!job.Live()) return;
+        std::uint64_t a = 0;
+        std::uint64_t b = 0;
+        const bool ok = DupFinder::HashFile(job.src / p.rel, p.size, nullptr, a) &&
+                        DupFinder::HashFile(job.dest / p.rel, p.size, nullptr, b);
+        job.plan->hashedBytes.fetch_add(2 * p.size, std::memory_order_relaxed);
+        if (job.options->progress) job.options->progress->bytes.fetch_add(2 * p.size, std::memory_order_relaxed);
+        if (!ok) job.plan->unreadable.fetch_add(1, std::memory_order_relaxed);
+        if (ok && a == b && p.attrsEqual) {
+            job.plan->unchanged.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        SyncItem item;
+        item.action = ok && a == b ? SyncAction::Touch : SyncAction::Update;
+        item.rel = p.rel;
+        item.size = p.size;
+        items.push_back(std::move(item));
+    }
+    job.plan->Add(std::move(items));
+}
+
+/* Compare one directory pair: subdirectories on both sides become tasks,
+* content compares go out in batches of kFilesPerTask
+* @param job
+* @param rel: the pair, relative to both roots
+*/
+void PlanDir(PlanJob& job, const std::filesystem::path& rel) {
+    if (!job.Live()) return;
+    std::vector<Entry> a;
+    std::vector<Entry> b;
+    std::error_code srcEc;
+    std::error_code destEc;
+    ListDir(job.src / rel, a, srcEc);
+    ListDir(job.dest / rel, b, destEc);
+    if (srcEc || destEc) {
+        // Half a listing would turn into bogus creates or removes
+        job.plan->unreadable.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    job.plan->dirs.fetch_add(1, std::memory_order_relaxed);
+    if (job.options->progress) job.options->progress->files.fetch_add(1, std::memory_order_relaxed);
+
+    const SyncOptions& options = *job.options;
+    std::vector<SyncItem> items;
+    std::vector<Pending> pending;
+    auto add = [&](SyncAction action, const Entry& e) {
+        SyncItem item;
+        item.action = action;
+        item.rel = rel / e.name;
+        item.type = e.type;
+        item.symlink = e.symlink;
+        item.size = e.type == EntryType::File && !e.symlink ? e.size : 0;
+        items.push_back(std::move(item));
+    };
+    auto submitPending = [&]() {
+        job.pool->Submit([&job, batch = std::move(pending)]() { CompareContent(job, batch); });
+        pending.clear();
+    };
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < a.size() || j < b.size()) {
+        const int order = i == a.size() ? 1 : j == b.size() ? -1 : a[i].name.compare(b[j].name);
+        if (order < 0) {
+            const Entry& e = a[i++];
+            if (e.type != EntryType::File || e.symlink || e.regular) add(SyncAction::Create, e);
+            continue;
+        }
+        if (order > 0) {
+            const Entry& e = b[j++];
+            if (options.removeExtra) {
+                add(SyncAction::Remove, e);
+                items.back().size = e.size;
+            }
+            continue;
+        }
+        const Entry& s = a[i++];
+        const Entry& d = b[j++];
+        if (s.type == EntryType::File && !s.symlink && !s.regular) continue; // FIFOs and devices are left alone
+        if (Kind(s) != Kind(d) || (Kind(s) == 0 && !d.regular)) {
+            add(SyncAction::Replace, s);
+            continue;
+        }
+        if (s.symlink) {
+            std::error_code linkEc;
+            const auto from = std::filesystem::read_symlink(job.src / rel / s.name, linkEc);
+            const auto to = std::filesystem::read_symlink(job.dest / rel / d.name, linkEc);
+            if (linkEc || from != to) add(SyncAction::Replace, s);
+            continue;
+        }
+        if (s.type == EntryType::Dir) {
+            job.pool->Submit([&job, child = rel / s.name]() { PlanDir(job, child); });
+            continue;
+        }
+        job.plan->compared.fetch_add(1, std::memory_order_relaxed);
+        const bool timesEqual = std::max(s.mtimeNs, d.mtimeNs) - std::min(s.mtimeNs, d.mtimeNs) <= options.modifyWindowNs;
+        const bool attrsEqual = timesEqual && s.perms == d.perms;
+        if (s.size != d.size) {
+            add(SyncAction::Update, s);
+        } else if (options.checksum && s.size > 0) {
+            pending.push_back(Pending{rel / s.name, s.size, attrsEqual});
+            if (pending.size() >= DirSync::kFilesPerTask) submitPending();
+        } else if (!timesEqual) {
+            add(SyncAction::Update, s);
+        } else if (!attrsEqual) {
+            add(SyncAction::Touch, s);
+        } else {
+            job.plan->unchanged.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!pending.empty()) submitPending();
+    job.plan->Add(std::move(items));
+}
+
+/* Give dest the permissions and times of src
+* @param src
+* @param dest
+* @param ec
+* @return true on success
+*/
+bool CopyAttrs(const std::filesystem::path& src, const std::filesystem::path& dest, std::error_code& ec) {
+    struct stat st;
+    if (::stat(src.c_str(), &st) != 0 || ::chmod(dest.c_str(), st.st_mode & 07777) != 0) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+#if defined(__APPLE__)
+    struct timespec times[2] = { st.st_atimespec, st.st_mtimespec };
+#else
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+#endif
+    if (::utimensat(AT_FDCWD, dest.c_str(), times, 0) != 0) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    return true;
+}
+}
+/* Walk both trees in step on a pool. The plan is not finished here; the
+* caller does that.
+* @param src
+* @param dest
+* @param options
+* @param plan
+* @param ec
+* @return false if cancelled or a root cannot be read
+*/
+bool DirSync::Plan(const std::filesystem::path& src, const std::filesystem::path& dest,
+                   const SyncOptions& options, SyncPlan& plan, std::error_code& ec) {
+    ec.clear();
+    for (const auto& root : {src, dest}) {
+        DirEntryInfo info;
+        if (!DirScanner::Stat(root, info, ec)) return false;
+        if (info.type != EntryType::Dir) {
+            ec = std::make_error_code(std::errc::not_a_directory);
+            return false;
+        }
+    }
+    PlanJob job;
+    job.options = &options;
+    job.plan = &plan;
+    job.src = src;
+    job.dest = dest;
+    {
+        ThreadPool pool(options.threads);
+        job.pool = &pool;
+        pool.Submit([&job]() { PlanDir(job, std::filesystem::path()); });
+        pool.Wait();
+    }
+    if (options.progress && options.progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    return true;
+}
+/* Remove, then create, then update; finally give the directories that
+* changed their source times back
+* @param src
+* @param dest
+* @param items
+* @param options
+* @param stats
+* @param failures
+* @param ec
+* @return true if every item was applied
+*/
+bool DirSync::Apply(const std::filesystem::path& src, const std::filesystem::path& dest,
+                    const std::vector<SyncItem>& items, const SyncOptions& options,
+                    SyncStats& stats, std::vector<PathError>& failures, std::error_code& ec) {
+    const auto start = std::chrono::steady_clock::now();
+    failures.clear();
+    stats = SyncStats();
+    CopyOptions copyOptions;
+    copyOptions.threads = options.threads;
+    copyOptions.fsync = options.fsync;
+    copyOptions.progress = options.progress;
+    if (options.progress) {
+        // CopyEngine counts the files it copies itself
+        const auto own = std::count_if(items.begin(), items.end(), [](const SyncItem& item) {
+            return item.action == SyncAction::Update || item.action == SyncAction::Touch || item.symlink;
+        });
+        options.progress->totalFiles.fetch_add(static_cast<std::uint64_t>(own), std::memory_order_relaxed);
+    }
+
+    // Removals first: they free space and clear the way for replacements
+    std::vector<std::filesystem::path> doomed;
+    for (const SyncItem& item : items) {
+        if (item.action == SyncAction::Remove || item.action == SyncAction::Replace) doomed.push_back(dest / item.rel);
+    }
+    std::set<std::filesystem::path> failed;
+    if (!doomed.empty()) {
+        DeleteOptions deleteOptions;
+        deleteOptions.threads = options.threads;
+        std::vector<PathError> deleteFailures;
+        DeleteStats deleteStats;
+        DeleteEngine::DeleteTrees(doomed, deleteOptions, deleteStats, deleteFailures);
+        stats.removed = deleteStats.entries;
+        for (const PathError& failure : deleteFailures) {
+            failed.insert(failure.path);
+            failures.push_back(failure);
+        }
+    }
+
+    // New items share one pipelined CopyEngine pass; symlinks are recreated as is
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> fresh;
+    for (const SyncItem& item : items) {
+        if (item.action != SyncAction::Create && item.action != SyncAction::Replace) continue;
+        if (options.progress && !options.progress->Checkpoint()) break;
+        if (failed.count(dest / item.rel)) continue;
+        if (!item.symlink) {
+            fresh.emplace_back(src / item.rel, dest / item.rel);
+            continue;
+        }
+        std::error_code linkEc;
+        const auto target = std::filesystem::read_symlink(src / item.rel, linkEc);
+        if (!linkEc) std::filesystem::create_symlink(target, dest / item.rel, linkEc);
+        if (linkEc) failures.push_back(PathError{src / item.rel, linkEc});
+        else ++stats.created;
+        if (options.progress) options.progress->files.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!fresh.empty()) {
+        CopyStats copyStats;
+        std::vector<PathError> copyFailures;
+        CopyEngine::CopyTrees(fresh, copyOptions, copyStats, copyFailures);
+        stats.created += fresh.size() - copyFailures.size();
+        stats.bytesCopied += copyStats.bytes;
+        failures.insert(failures.end(), copyFailures.begin(), copyFailures.end());
+    }
+
+    // Updates run in parallel; each one is a single file
+    std::mutex mutex;
+    {
+        ThreadPool pool(options.threads);
+        for (const SyncItem& item : items) {
+            if (item.action != SyncAction::Update && item.action != SyncAction::Touch) continue;
+            pool.Submit([&, item]() {
+                const std::filesystem::path from = src / item.rel;
+                const std::filesystem::path to = dest / item.rel;
+                if (options.progress && !options.progress->Checkpoint()) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failures.push_back(PathError{from, std::make_error_code(std::errc::operation_canceled)});
+                    return;
+                }
+                std::error_code itemEc;
+                bool ok = false;
+                if (item.action == SyncAction::Touch) {
+                    ok = CopyAttrs(from, to, itemEc);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (ok) ++stats.touched;
+                } else {
+                    DeltaStats delta;
+                    bool tried = false;
+                    if (options.delta && item.size >= kDeltaMinSize) {
+                        FileCopy::Options fileOptions;
+                        fileOptions.fsync = options.fsync;
+                        fileOptions.progress = options.progress;
+                        tried = true;
+                        ok = FileCopy::UpdateFile(from, to, fileOptions, delta, itemEc);
+                        // Other hard links or a special file: fall back to a full copy
+                        if (!ok && (itemEc == std::errc::too_many_links || itemEc == std::errc::not_supported)) {
+                            tried = false;
+                        }
+                    }
+                    CopyStats copyStats;
+                    if (!tried) {
+                        CopyOptions one = copyOptions;
+                        one.threads = 1;
+                        ok = FileOp::CopyPath(from, to, true, one, copyStats, itemEc);
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (ok) {
+                        ++stats.updated;
+                        if (tried) ++stats.deltaFiles;
+                        stats.bytesWritten += delta.bytesWritten;
+                        stats.bytesCompared += delta.bytesCompared;
+                        stats.bytesCopied += copyStats.bytes;
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok) failures.push_back(PathError{from, itemEc});
+                if (options.progress) options.progress->files.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        pool.Wait();
+    }
+
+    // Writing into a directory moved its mtime; put the source's back, deepest first
+    std::set<std::filesystem::path> dirs;
+    for (const SyncItem& item : items) dirs.insert(item.rel.parent_path());
+    for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+        std::error_code attrEc;
+        CopyAttrs(src / *it, dest / *it, attrEc);
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (options.progress && options.progress->cancelled.load() && failures.empty()) {
+        failures.push_back(PathError{src, std::make_error_code(std::errc::operation_canceled)});
+    }
+    stats.errorPath = failures.empty() ? std::filesystem::path() : failures.front().path;
+    ec = failures.empty() ? std::error_code() : failures.front().ec;
+    return failures.empty();
+}
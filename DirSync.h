@@ -0,0 +1,150 @@
+/*
+    Description: Declare DirSync, which compares two directory trees and
+                 brings the second up to date with the first, and SyncPlan,
+                 the list of differences it works from
+*/
+#ifndef DIRSYNC_H
+#define DIRSYNC_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "EntryStore.h"
+#include "OpProgress.h"
+
+// What a sync does to one path
+enum class SyncAction : std::uint8_t {
+    Create,   // Only in the source: copied (a directory with everything in it)
+    Update,   // File content differs: rewritten, block by block when large
+    Touch,    // Same content, other times or permissions (content compare only)
+    Replace,  // Different kinds (file, directory, symlink): removed, then copied
+    Remove    // Only in the destination: removed when asked to
+};
+constexpr int kSyncActionCount = 5;
+
+// Short lower case name of an action for lists and logs
+const char* SyncActionName(SyncAction action);
+
+// One difference between the trees
+struct SyncItem {
+    SyncAction action = SyncAction::Create;
+    std::filesystem::path rel;          // Relative to both roots
+    EntryType type = EntryType::File;   // Of the source entry (the destination one for Remove)
+    bool symlink = false;
+    std::uint64_t size = 0;             // File bytes to copy; the destination's for Remove
+};
+
+/* Differences found by DirSync::Plan, filled by the workers and read by
+   the UI while the compare is still running. Items are only appended.
+*/
+class SyncPlan {
+public:
+    // Append the differences of one directory (worker threads)
+    void Add(std::vector<SyncItem>&& items);
+    std::size_t Size() const;
+    // Copy of item i, i < Size()
+    SyncItem At(std::size_t i) const;
+    // Copy of every item, sorted by path
+    std::vector<SyncItem> Items() const;
+    // Mark the compare finished and stop the clock
+    void Finish();
+    double Seconds() const;
+
+    std::atomic<std::uint64_t> compared{0};    // Files present on both sides
+    std::atomic<std::uint64_t> unchanged{0};   // Of which equal
+    std::atomic<std::uint64_t> dirs{0};        // Directories walked on both sides
+    std::atomic<std::uint64_t> hashedBytes{0}; // Read by a content compare
+    std::atomic<std::uint64_t> copyBytes{0};   // File bytes of Create, Update and Replace items
+    std::atomic<std::uint64_t> unreadable{0};  // Directories or files that could not be read
+    std::atomic<std::uint64_t> actions[kSyncActionCount] = {};
+    std::atomic<bool> done{false};
+
+private:
+    using Clock = std::chrono::steady_clock;
+    mutable std::mutex mutex_;
+    std::vector<SyncItem> items_;
+    Clock::time_point start_ = Clock::now();
+    Clock::time_point end_;
+};
+
+// Tuning knobs for a sync
+struct SyncOptions {
+    bool checksum = false;        // Compare the content of same-size files, not size and mtime
+    bool removeExtra = false;     // Remove what the source does not have (mirror)
+    bool delta = true;            // Update files of kDeltaMinSize or more block by block
+    std::int64_t modifyWindowNs = 0; // mtimes this close count as equal (2 s for FAT)
+    unsigned threads = 0;         // 0 for auto
+    bool fsync = false;           // fsync what was written before returning
+    OpProgress* progress = nullptr; // files/bytes count work done; checked per file
+};
+
+// Result of DirSync::Apply
+struct SyncStats {
+    std::uint64_t created = 0;       // Items copied (a new directory counts once)
+    std::uint64_t updated = 0;       // Files rewritten
+    std::uint64_t deltaFiles = 0;    // Of which block by block
+    std::uint64_t touched = 0;       // Files that only got times or permissions
+    std::uint64_t removed = 0;       // Entries removed
+    std::uint64_t bytesCopied = 0;   // File data copied by Create and full updates
+    std::uint64_t bytesWritten = 0;  // Changed blocks written by delta updates
+    std::uint64_t bytesCompared = 0; // Destination bytes read by delta updates
+    double seconds = 0.0;
+    std::filesystem::path errorPath; // Path that caused the first error
+};
+
+/* Incremental one-way sync of a directory tree.
+                 - Plan walks both trees in step on a work-stealing pool, one
+                   task per directory pair. Files are equal when size and
+                   mtime match (quick-check), or, with checksum, when their
+                   XXH64 hashes do
+                 - Directories only in the source are copied whole and not
+                   walked; directories only in the destination are not
+                   walked either
+                 - Apply removes first, then copies new items with
+                   CopyEngine, then updates changed files in parallel
+                 - A changed file of kDeltaMinSize or more is compared block
+                   by block and only the differing blocks are written
+                   (FileCopy::UpdateFile); smaller ones, and files with other
+                   hard links, are copied beside the old one and swapped in
+                 - Times and permissions are always carried over, so the next
+                   quick-check of an unchanged file costs one stat per side
+*/
+class DirSync {
+public:
+    static constexpr std::uint64_t kDeltaMinSize = 8 * 1024 * 1024;
+    static constexpr std::size_t kFilesPerTask = 64; // Content compares one task does
+
+    /* Compare src with dest
+    * @param src: source directory
+    * @param dest: destination directory
+    * @param options: checksum, removeExtra, modifyWindowNs, threads, progress
+    * @param plan: receives the differences as they are found; calling
+    *              Finish is left to the caller
+    * @param ec: operation_canceled when cancelled, the error when a root cannot be read
+    * @return false when cancelled or a root is unreadable
+    */
+    static bool Plan(const std::filesystem::path& src, const std::filesystem::path& dest,
+                     const SyncOptions& options, SyncPlan& plan, std::error_code& ec);
+
+    /* Carry out a plan. An error stops only the item it happened in.
+    * @param src
+    * @param dest
+    * @param items: from a plan of the same two roots
+    * @param options: delta, threads, fsync, progress
+    * @param stats
+    * @param failures: receives one entry per failed item
+    * @param ec: the first failure
+    * @return true if every item was applied
+    */
+    static bool Apply(const std::filesystem::path& src, const std::filesystem::path& dest,
+                      const std::vector<SyncItem>& items, const SyncOptions& options,
+                      SyncStats& stats, std::vector<PathError>& failures, std::error_code& ec);
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+    Description: Implementation of the directory change watcher.
+*/
+#include <system_error>
+#include <unordered_set>
+
+#include "DirScanner.h"
+#include "DirWatcher.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+constexpr std::uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                     IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                     IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+constexpr std::size_t kEventBufSize = 64 * 1024;
+
+/* Read inotify events until the queue is empty
+* @param fd: inotify fd (non blocking)
+* @param changed: receives the names events were reported for
+* @param rescan: set when events were lost or the directory went away
+*/
+void DrainEvents(int fd, std::unordered_set<std::string>& changed, bool& rescan) {
+    alignas(inotify_event) char buf[kEventBufSize];
+    for (;;) {
+        const ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return; // EAGAIN: drained
+        }
+        for (ssize_t off = 0; off < n;) {
+            const auto* ev = reinterpret_cast<const inotify_event*>(buf + off);
+            off += sizeof(inotify_event) + ev->len;
+            if (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                rescan = true;
+            } else if (ev->len > 0) {
+                changed.emplace(ev->name); // name is null padded
+            }
+        }
+    }
+}
+
+/* Watch loop: collect names, flush them kCoalesceWindow after the first event
+* @param dir
+* @param generation
+* @param onDelta
+* @param inotifyFd: closed on exit
+* @param stopFd: readable when Stop is called
+*/
+void Run(std::filesystem::path dir, std::uint64_t generation, DirWatcher::DeltaFn onDelta,
+         int inotifyFd, int stopFd) {
+    using Clock = std::chrono::steady_clock;
+    std::unordered_set<std::string> changed;
+    bool rescan = false;
+    Clock::time_point deadline;
+    for (;;) {
+        int timeout = -1;
+        if (!changed.empty() || rescan) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - Clock::now()).count();
+            timeout = left > 0 ? static_cast<int>(left) : 0;
+        }
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        if (::poll(fds, 2, timeout) < 0 && errno != EINTR) break;
+        if (fds[1].revents) break;
+        if (fds[0].revents) {
+            const bool idle = changed.empty() && !rescan;
+            DrainEvents(inotifyFd, changed, rescan);
+            if (idle) deadline = Clock::now() + DirWatcher::kCoalesceWindow;
+        }
+        if (changed.empty() && !rescan) continue;
+        if (Clock::now() < deadline && changed.size() < DirWatcher::kMaxDeltaNames) continue;
+
+        auto delta = std::make_shared<DirDelta>();
+        if (!rescan) {
+            // Stamp first, then drain: any change older than the stamp has
+            // its event queued by now and is part of this delta
+            DirCache::Stamp(dir, delta->stamp);
+            DrainEvents(inotifyFd, changed, rescan);
+        }
+        if (!rescan) {
+            // A name touched several times is stat'ed once, in its final state
+            std::vector<std::string> names(changed.begin(), changed.end());
+            DirWatcher::StatNames(dir, names, *delta);
+        } else {
+            delta->stamp = DirStamp();
+        }
+        delta->rescan = rescan;
+        changed.clear();
+        onDelta(generation, std::move(delta));
+        if (rescan) break; // The watch is gone or incomplete; the owner restarts it
+    }
+    ::close(inotifyFd);
+}
+}
+
+/* Stop the watch before destruction
+*/
+DirWatcher::~DirWatcher() {
+    Stop();
+}
+/* Add an inotify watch on dir and start the worker. The watch exists when
+* this returns, so nothing done afterwards is missed.
+* @param dir
+* @param onDelta
+* @return true if the directory is being watched
+*/
+bool DirWatcher::Start(const std::filesystem::path& dir, DeltaFn onDelta) {
+    Stop();
+    const std::uint64_t generation = ++generation_;
+    const int inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) return false;
+    if (::inotify_add_watch(inotifyFd, dir.c_str(), kWatchMask) < 0) {
+        ::close(inotifyFd);
+        return false;
+    }
+    stopFd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (stopFd_ < 0) {
+        ::close(inotifyFd);
+        return false;
+    }
+    thread_ = std::thread(Run, dir, generation, std::move(onDelta), inotifyFd, stopFd_);
+    return true;
+}
+/* Wake the worker through the eventfd and join it
+*/
+void DirWatcher::Stop() {
+    if (thread_.joinable()) {
+        const std::uint64_t one = 1;
+        ssize_t rc = ::write(stopFd_, &one, sizeof(one));
+        (void)rc;
+        thread_.join();
+    }
+    if (stopFd_ >= 0) {
+        ::close(stopFd_);
+        stopFd_ = -1;
+    }
+}
+
+#else // Portable fallback: no live updates
+
+DirWatcher::~DirWatcher() {
+    Stop();
+}
+/* Watching is not supported here
+* @param dir
+* @param onDelta
+* @return false
+*/
+bool DirWatcher::Start(const std::filesystem::path& dir, DeltaFn onDelta) {
+    ++generation_;
+    return false;
+}
+void DirWatcher::Stop() {
+}
+
+#endif
+
+/* Stat each name once: existing ones become upserts, missing ones removals
+* @param dir
+* @param names
+* @param delta
+*/
+void DirWatcher::StatNames(const std::filesystem::path& dir,
+                           const std::vector<std::string>& names, DirDelta& delta) {
+    for (const std::string& name : names) {
+        DirEntryInfo info;
+        std::error_code ec;
+        if (DirScanner::Stat(dir / name, info, ec)) {
+            delta.upserts.Append(name, info.type, info.size, info.mtimeNs);
+        } else if (ec == std::errc::no_such_file_or_directory) {
+            delta.removed.push_back(name);
+        } else {
+            // Exists but cannot be stat'ed (e.g. permissions); show it without details
+            delta.upserts.Append(name, EntryType::Unknown,
+                                 EntryStore::kUnknownSize, EntryStore::kUnknownTime);
+        }
+    }
+}
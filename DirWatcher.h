@@ -0,0 +1,76 @@
+/*
+    Description: Declare DirWatcher, the live change feed for the shown directory
+*/
+#ifndef DIRWATCHER_H
+#define DIRWATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DirCache.h"
+#include "EntryStore.h"
+
+/* Row-level changes to apply to a listing. A name is either in upserts
+   (it exists now, with fresh columns) or in removed, never both.
+*/
+struct DirDelta {
+    EntryStore upserts;                // Created or modified entries
+    std::vector<std::string> removed;  // Names that no longer exist
+    bool rescan = false;               // Events were lost; reload the whole directory
+    DirStamp stamp;  // Watcher deltas: every change before this stamp is reflected
+};
+
+/* Watches one directory and reports what changed in it.
+                 - Linux: inotify on the directory, read on a worker thread
+                 - Events are collected per name for kCoalesceWindow, then every
+                   touched name is stat'ed once and delivered as one DirDelta
+                 - Queue overflow or the directory itself going away asks for a rescan
+                 - Other systems: Start returns false and nothing is reported
+*/
+class DirWatcher {
+public:
+    /* Called on the worker thread once per coalesced burst
+    * @param generation: watch the delta belongs to
+    * @param delta: changes since the previous delta
+    */
+    using DeltaFn = std::function<void(std::uint64_t generation, std::shared_ptr<DirDelta> delta)>;
+
+    static constexpr std::chrono::milliseconds kCoalesceWindow{100};
+    static constexpr std::size_t kMaxDeltaNames = 16384; // Flush early past this many names
+
+    ~DirWatcher();
+
+    /* Stop the current watch and start watching dir
+    * @param dir: directory to watch
+    * @param onDelta: delta callback, runs on the worker thread
+    * @return false if watching is unsupported or failed; no deltas will come
+    */
+    bool Start(const std::filesystem::path& dir, DeltaFn onDelta);
+    // Stop watching and wait for the worker to exit
+    void Stop();
+    // Generation of the most recent Start
+    std::uint64_t Generation() const { return generation_; }
+
+    /* Stat names in dir and sort them into delta. Used by the watcher and
+    * for changes the application made itself.
+    * @param dir: directory holding the names
+    * @param names: bare entry names
+    * @param delta: receives an upsert or a removal per name
+    */
+    static void StatNames(const std::filesystem::path& dir,
+                          const std::vector<std::string>& names, DirDelta& delta);
+
+private:
+    std::thread thread_;
+    int stopFd_ = -1;  // eventfd that wakes the worker to exit
+    std::uint64_t generation_ = 0;
+};
+
+#endif
@@ -0,0 +1,341 @@
+/*
+    Description: Implementation of the recursive size walker and its cache.
+*/
+#include <array>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+
+#include "DirScanner.h"
+#include "DiskUsage.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ThreadPool.h"
+
+namespace {
+// (dev, inode) of files with more than one link, split to keep locks short
+class InodeSet {
+public:
+    // True the first time a given inode is seen
+    bool Insert(std::uint64_t dev, std::uint64_t ino) {
+        const std::uint64_t key = ino * 0x9e3779b97f4a7c15ull ^ dev;
+        Shard& shard = shards_[key % kShards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.seen.insert(Key{dev, ino}).second;
+    }
+
+private:
+    using Key = std::pair<std::uint64_t, std::uint64_t>;
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const {
+            return std::hash<std::uint64_t>()(k.second * 0x9e3779b97f4a7c15ull ^ k.first);
+        }
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_set<Key, KeyHash> seen;
+    };
+    static constexpr std::size_t kShards = 64;
+    std::array<Shard, kShards> shards_;
+};
+// A directory still being counted
+struct DuNode {
+    std::shared_ptr<DuNode> parent;
+    std::size_t root = 0;
+    std::filesystem::path path;
+    std::uint64_t dev = 0;         // Filesystem of the root; not left
+    DirStamp stamp;
+    std::atomic<int> pending{1};   // Own scan plus unfinished subdirectories
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> allocated{0};
+    std::atomic<std::uint64_t> files{0};
+    std::atomic<std::uint64_t> dirs{0};
+    std::atomic<bool> partial{false};
+
+    DuTotal Total() const {
+        DuTotal t;
+        t.bytes = bytes.load();
+        t.allocated = allocated.load();
+        t.files = files.load();
+        t.dirs = dirs.load();
+        t.partial = partial.load();
+        return t;
+    }
+    void Add(const DuTotal& t) {
+        bytes.fetch_add(t.bytes, std::memory_order_relaxed);
+        allocated.fetch_add(t.allocated, std::memory_order_relaxed);
+        files.fetch_add(t.files, std::memory_order_relaxed);
+        dirs.fetch_add(t.dirs, std::memory_order_relaxed);
+        if (t.partial) partial.store(true, std::memory_order_relaxed);
+    }
+};
+// State shared by every task of one walk
+struct DuJob {
+    ThreadPool* pool = nullptr;
+    OpProgress* progress = nullptr;
+    const DiskUsage::DirDoneFn* onDir = nullptr;
+    std::vector<DuTotal>* totals = nullptr;
+    InodeSet inodes;
+};
+
+/* Drop one pending reference; the last one reports the directory and adds
+* its total to the parent
+*/
+void Release(DuJob& job, std::shared_ptr<DuNode> node) {
+    while (node && node->pending.fetch_sub(1) == 1) {
+        const DuTotal total = node->Total();
+        if (job.progress && job.progress->cancelled.load()) return;
+        if (*job.onDir) (*job.onDir)(node->root, node->path, node->stamp, total);
+        if (!node->parent) {
+            (*job.totals)[node->root] = total;
+            return;
+        }
+        DuTotal up = total;
+        up.dirs += 1; // The directory itself
+        node->parent->Add(up);
+        node = node->parent;
+    }
+}
+/* Stat the entries of node relative to its fd, count files, queue subdirectories
+*/
+void CountDir(DuJob& job, std::shared_ptr<DuNode> node) {
+    if (job.progress && !job.progress->Checkpoint()) return;
+    int fd = ::open(node->path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        node->partial.store(true);
+        Release(job, node);
+        return;
+    }
+    // Stamp before reading, so a change made during the scan moves it on
+    DirEntryInfo self;
+    if (DirScanner::StatAt(fd, ".", false, self)) {
+        node->stamp.dev = self.dev;
+        node->stamp.ino = self.ino;
+        node->stamp.mtimeNs = self.mtimeNs;
+    }
+    DuTotal local;
+    std::error_code scanEc;
+    DirScanner::ScanFd(fd, DirScanner::kWantStat | DirScanner::kNoFollow,
+                       [&](const DirEntryInfo& info) {
+        if (info.type == EntryType::Dir && !info.symlink) {
+            if (info.dev != node->dev) return true; // Mount point
+            auto child = std::make_shared<DuNode>();
+            child->parent = node;
+            child->root = node->root;
+            child->path = node->path / std::string(info.name);
+            child->dev = node->dev;
+            node->pending.fetch_add(1);
+            job.pool->Submit([&job, child]() { CountDir(job, child); });
+            return true;
+        }
+        if (info.size == EntryStore::kUnknownSize) {
+            local.partial = true; // Vanished or not stat-able
+            return true;
+        }
+        if (info.nlink > 1 && !job.inodes.Insert(info.dev, info.ino)) return true;
+        local.bytes += info.size;
+        local.allocated += info.blocks * 512;
+        ++local.files;
+        return true;
+    }, scanEc);
+    ::close(fd);
+    if (scanEc) local.partial = true;
+    node->Add(local);
+    if (job.progress) {
+        job.progress->files.fetch_add(local.files, std::memory_order_relaxed);
+        job.progress->bytes.fetch_add(local.bytes, std::memory_order_relaxed);
+    }
+    Release(job, node);
+}
+}
+/* Walk every root on one pool. Non-directory roots are stat'ed directly.
+* @param roots
+* @param options
+* @param onDir
+* @param totals
+* @param ec
+* @return false if cancelled
+*/
+bool DiskUsage::Walk(const std::vector<std::filesystem::path>& roots,
+                     const DuOptions& options,
+                     const DirDoneFn& onDir,
+                     std::vector<DuTotal>& totals,
+                     std::error_code& ec) {
+    ec.clear();
+    totals.assign(roots.size(), DuTotal());
+    DuJob job;
+    job.progress = options.progress;
+    job.onDir = &onDir;
+    job.totals = &totals;
+    {
+        ThreadPool pool(options.threads);
+        job.pool = &pool;
+        for (std::size_t i = 0; i < roots.size(); ++i) {
+            if (job.progress && !job.progress->Checkpoint()) break;
+            DirEntryInfo info;
+            if (!DirScanner::StatAt(AT_FDCWD, roots[i].c_str(), false, info)) {
+                totals[i].partial = true;
+                continue;
+            }
+            if (info.type != EntryType::Dir) {
+                if (info.nlink > 1 && !job.inodes.Insert(info.dev, info.ino)) continue;
+                totals[i].bytes = info.size;
+                totals[i].allocated = info.blocks * 512;
+                totals[i].files = 1;
+                continue;
+            }
+            auto node = std::make_shared<DuNode>();
+            node->root = i;
+            node->path = roots[i];
+            node->dev = info.dev;
+            pool.Submit([&job, node]() { CountDir(job, node); });
+        }
+        pool.Wait();
+    }
+    if (options.progress && options.progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    return true;
+}
+
+#else // Portable fallback
+
+/* Walk each root with recursive_directory_iterator on the calling thread.
+* Only the roots are reported to onDir.
+* @param roots
+* @param options
+* @param onDir
+* @param totals
+* @param ec
+* @return false if cancelled
+*/
+bool DiskUsage::Walk(const std::vector<std::filesystem::path>& roots,
+                     const DuOptions& options,
+                     const DirDoneFn& onDir,
+                     std::vector<DuTotal>& totals,
+                     std::error_code& ec) {
+    namespace fs = std::filesystem;
+    ec.clear();
+    totals.assign(roots.size(), DuTotal());
+    for (std::size_t i = 0; i < roots.size(); ++i) {
+        if (options.progress && !options.progress->Checkpoint()) break;
+        DirStamp stamp;
+        DirCache::Stamp(roots[i], stamp);
+        DuTotal& total = totals[i];
+        std::error_code walkEc;
+        fs::recursive_directory_iterator it(roots[i], fs::directory_options::skip_permission_denied,
+                                            walkEc);
+        for (; !walkEc && it != fs::recursive_directory_iterator(); it.increment(walkEc)) {
+            std::error_code ec2;
+            if (it->is_directory(ec2) && !it->is_symlink(ec2)) {
+                ++total.dirs;
+                continue;
+            }
+            const auto size = it->is_symlink(ec2) ? 0 : it->file_size(ec2);
+            if (ec2) {
+                total.partial = true;
+                continue;
+            }
+            total.bytes += size;
+            total.allocated += size;
+            ++total.files;
+        }
+        if (walkEc) total.partial = true;
+        if (onDir) onDir(i, roots[i], stamp, total);
+    }
+    if (options.progress && options.progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+/* Map a path to its cache key, like DirCache does
+* @param dir
+* @return normalized path string
+*/
+static std::string CacheKey(const std::filesystem::path& dir) {
+    std::string key = dir.lexically_normal().string();
+    while (key.size() > 1 && key.back() == '/') key.pop_back();
+    return key;
+}
+/* Look up dir and check it against its current stamp
+* @param dir
+* @param out
+* @return true on a hit
+*/
+bool DiskUsageCache::Lookup(const std::filesystem::path& dir, DuTotal& out) {
+    const std::string key = CacheKey(dir);
+    DirStamp now;
+    const bool statted = DirCache::Stamp(dir, now);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = map_.find(key);
+    if (found == map_.end()) return false;
+    if (!statted || found->second->stamp != now) {
+        lru_.erase(found->second);
+        map_.erase(found);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, found->second);
+    out = lru_.front().total;
+    out.cached = true;
+    return true;
+}
+/* Insert or replace the total of dir, evicting the least recently used
+* @param dir
+* @param stamp
+* @param total
+*/
+void DiskUsageCache::Store(const std::filesystem::path& dir, const DirStamp& stamp,
+                           const DuTotal& total) {
+    if (total.partial || !stamp.Valid() || maxDirs_ == 0) return;
+    std::string key = CacheKey(dir);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = map_.find(key);
+    if (found != map_.end()) {
+        found->second->stamp = stamp;
+        found->second->total = total;
+        lru_.splice(lru_.begin(), lru_, found->second);
+        return;
+    }
+    lru_.push_front(Node{key, stamp, total});
+    map_.emplace(std::move(key), lru_.begin());
+    while (map_.size() > maxDirs_) {
+        map_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+/* Drop p and its ancestors; their totals include whatever changed at p
+* @param p
+*/
+void DiskUsageCache::InvalidateUp(const std::filesystem::path& p) {
+    std::string key = CacheKey(p);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (;;) {
+        auto found = map_.find(key);
+        if (found != map_.end()) {
+            lru_.erase(found->second);
+            map_.erase(found);
+        }
+        const std::size_t slash = key.find_last_of('/');
+        if (slash == std::string::npos || key.size() <= 1) break;
+        key.erase(slash == 0 ? 1 : slash);
+    }
+}
+void DiskUsageCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    map_.clear();
+    lru_.clear();
+}
+std::size_t DiskUsageCache::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return map_.size();
+}
@@ -0,0 +1,132 @@
+/*
+    Description: Declare DiskUsage, the parallel recursive size walker, and
+                 DiskUsageCache, the per-directory totals it produces
+*/
+#ifndef DISKUSAGE_H
+#define DISKUSAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "DirCache.h"
+#include "OpProgress.h"
+
+// Totals of one directory tree
+struct DuTotal {
+    std::uint64_t bytes = 0;      // Apparent size of the files (st_size)
+    std::uint64_t allocated = 0;  // Space taken on disk (st_blocks)
+    std::uint64_t files = 0;      // Files, links and other non-directories
+    std::uint64_t dirs = 0;       // Directories below the root
+    bool partial = false;         // Part of the tree could not be read
+    bool cached = false;          // From DiskUsageCache; may miss deeper changes
+
+    void Add(const DuTotal& o) {
+        bytes += o.bytes;
+        allocated += o.allocated;
+        files += o.files;
+        dirs += o.dirs;
+        partial = partial || o.partial;
+        cached = cached || o.cached;
+    }
+};
+
+// Recursive totals of the directories in a listing, by name
+using DirTotals = std::unordered_map<std::string, DuTotal>;
+
+// Tuning knobs for a size walk
+struct DuOptions {
+    unsigned threads = 0;            // Directories read in parallel, 0 for auto
+    OpProgress* progress = nullptr;  // files/bytes count what was seen; checked per directory
+};
+
+/* Adds up directory trees the way du -x does.
+                 - Each directory is opened once and its entries are stat'ed
+                   relative to that fd; subdirectories fan out across a
+                   work-stealing pool
+                 - A file with several hard links is counted once per walk,
+                   by (dev, inode)
+                 - Symlinks are counted as themselves, never followed
+                 - Other filesystems mounted below a root are not entered
+                 - Unreadable directories mark the total partial instead of
+                   failing the walk
+*/
+class DiskUsage {
+public:
+    /* Called on a worker thread when a directory and everything below it
+    * has been counted, children before parents
+    * @param root: index of the root the directory belongs to
+    * @param dir: the directory
+    * @param stamp: its stamp, taken before it was read
+    * @param total: its final total
+    */
+    using DirDoneFn = std::function<void(std::size_t root, const std::filesystem::path& dir,
+                                         const DirStamp& stamp, const DuTotal& total)>;
+
+    /* Total every root on one shared pool
+    * @param roots: directories (a file root totals to itself)
+    * @param options
+    * @param onDir: per-directory callback, may be empty
+    * @param totals: receives one total per root
+    * @param ec: operation_canceled when cancelled
+    * @return false only when cancelled
+    */
+    static bool Walk(const std::vector<std::filesystem::path>& roots,
+                     const DuOptions& options,
+                     const DirDoneFn& onDir,
+                     std::vector<DuTotal>& totals,
+                     std::error_code& ec);
+};
+
+/* Totals of recently walked directories, so re-entering a subtree shows
+   its sizes without a walk.
+                 - Keyed by normalized path, least recently used evicted first
+                 - A total is handed back only while the directory still has
+                   the stamp it was walked with. That catches changes to its
+                   own entries, not deeper ones, files growing in place or
+                   hard links shared with another walk; callers drop the
+                   ancestors of paths they change (InvalidateUp)
+                 - So a hit is marked cached, for the UI to show as possibly
+                   out of date until a fresh walk
+*/
+class DiskUsageCache {
+public:
+    static constexpr std::size_t kDefaultMaxDirs = 1 << 18;
+
+    explicit DiskUsageCache(std::size_t maxDirs = kDefaultMaxDirs) : maxDirs_(maxDirs) {}
+
+    /* Return the total of dir if its own stamp is unchanged
+    * @param dir
+    * @param out: receives the total on a hit, with cached set
+    * @return true on a hit
+    */
+    bool Lookup(const std::filesystem::path& dir, DuTotal& out);
+    // Remember a complete total; partial ones are not kept
+    void Store(const std::filesystem::path& dir, const DirStamp& stamp, const DuTotal& total);
+    // Forget p and every directory above it
+    void InvalidateUp(const std::filesystem::path& p);
+    void Clear();
+    std::size_t Size() const;
+
+private:
+    struct Node {
+        std::string key;
+        DirStamp stamp;
+        DuTotal total;
+    };
+    using List = std::list<Node>;
+
+    mutable std::mutex mutex_;
+    List lru_;  // Most recently used first
+    std::unordered_map<std::string, List::iterator> map_;
+    std::size_t maxDirs_;
+};
+
+#endif
@@ -0,0 +1,529 @@
+/*
+    Description: Implementation of the duplicate finder and its result buffer.
+*/
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+#include "DirScanner.h"
+#include "DupFinder.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+
+/* Keep a group and add it to the totals
+* @param group
+*/
+void DupResults::Add(DupGroup&& group) {
+    duplicates.fetch_add(group.copies - 1, std::memory_order_relaxed);
+    wasted.fetch_add(group.Wasted(), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    groups_.push_back(std::move(group));
+}
+std::size_t DupResults::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return groups_.size();
+}
+DupGroup DupResults::At(std::size_t i) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return groups_[i];
+}
+/* Stop the clock once; later calls keep the first end time
+*/
+void DupResults::Finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done.load()) return;
+    end_ = Clock::now();
+    done.store(true);
+}
+/* Time since the run was created, up to Finish
+* @return seconds
+*/
+double DupResults::Seconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Clock::time_point end = done.load() ? end_ : Clock::now();
+    return std::chrono::duration<double>(end - start_).count();
+}
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+/* One file opened for hashing; it must still be a regular file of the
+   size the walk saw
+*/
+class Reader {
+public:
+    ~Reader() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+    bool Open(const std::filesystem::path& path, std::uint64_t size) {
+        // O_NONBLOCK so a FIFO swapped in since the walk is not waited on
+        fd_ = ::open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+        if (fd_ < 0) return false;
+        struct stat st;
+        return ::fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && static_cast<std::uint64_t>(st.st_size) == size;
+    }
+    // Tell the kernel the whole file will be read front to back
+    void Sequential() {
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    // Read exactly size bytes at offset; false on error or a short file
+    bool ReadAt(char* buffer, std::size_t size, std::uint64_t offset) {
+        std::size_t got = 0;
+        while (got < size) {
+            const ssize_t r = ::pread(fd_, buffer + got, size - got, static_cast<off_t>(offset + got));
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) return false;
+            got += static_cast<std::size_t>(r);
+        }
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+};
+}
+
+#else // Portable fallback
+#include <fstream>
+
+namespace {
+/* One file opened for hashing with std::ifstream
+*/
+class Reader {
+public:
+    bool Open(const std::filesystem::path& path, std::uint64_t size) {
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(std::filesystem::symlink_status(path, ec))) return false;
+        if (std::filesystem::file_size(path, ec) != size || ec) return false;
+        in_.open(path, std::ios::binary);
+        return static_cast<bool>(in_);
+    }
+    void Sequential() {}
+    bool ReadAt(char* buffer, std::size_t size, std::uint64_t offset) {
+        in_.seekg(static_cast<std::streamoff>(offset));
+        in_.read(buffer, static_cast<std::streamsize>(size));
+        return in_ && static_cast<std::size_t>(in_.gcount()) == size;
+    }
+
+private:
+    std::ifstream in_;
+};
+}
+#endif
+
+namespace {
+// Read buffer of the calling worker
+std::vector<char>& ReadBuffer() {
+    thread_local std::vector<char> buffer(DupFinder::kReadChunk);
+    return buffer;
+}
+
+// A regular file found by the walk
+struct Seen {
+    std::filesystem::path path;
+    std::uint64_t size = 0;
+    std::uint64_t dev = 0;
+    std::uint64_t ino = 0;
+    std::int64_t mtimeNs = 0;
+};
+
+// One inode of a size bucket; its paths are paths[first, first + links)
+struct Inode {
+    std::size_t first = 0;
+    std::size_t links = 0;
+    std::uint64_t hash = 0;
+    bool ok = false;  // hash is valid
+};
+
+// Inodes of one size, at least two
+struct Bucket {
+    std::uint64_t size = 0;
+    std::vector<Inode> inodes;
+    std::atomic<std::size_t> pending{0}; // Hashes of the current pass still to finish
+};
+
+// Edge hashes of inodes [begin, end) of a bucket
+struct EdgeChunk {
+    Bucket* bucket = nullptr;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+};
+
+// State shared by every task of one run
+struct DupJob {
+    ThreadPool* pool = nullptr;
+    const DupOptions* options = nullptr;
+    DupResults* results = nullptr;
+
+    std::mutex walkMutex;
+    std::vector<Seen> seen;        // Filled by the walk
+
+    std::vector<DupFile> paths;    // Paths of every candidate inode
+    std::vector<std::unique_ptr<Bucket>> buckets; // Largest size first
+    std::vector<EdgeChunk> chunks; // In bucket order
+    std::atomic<std::size_t> nextChunk{0};
+    std::mutex fullMutex;
+    std::deque<std::pair<Bucket*, std::size_t>> full; // Inodes waiting for a full hash
+
+    bool Live() const { return !options->progress || options->progress->Checkpoint(); }
+};
+
+void Drain(DupJob& job);
+
+/* Read one directory: subdirectories become tasks, regular files of at
+* least minSize are kept for bucketing
+* @param job
+* @param dir
+*/
+void WalkDir(DupJob& job, const std::filesystem::path& dir) {
+    if (!job.Live()) return;
+    std::vector<Seen> found;
+    std::uint64_t files = 0;
+    std::error_code scanEc;
+    DirScanner::Scan(dir, DirScanner::kWantStat | DirScanner::kNoFollow, [&](const DirEntryInfo& info) {
+        if (info.symlink) return true;
+        std::filesystem::path child = dir / std::string(info.name);
+        if (info.type == EntryType::Dir) {
+            job.pool->Submit([&job, child = std::move(child)]() { WalkDir(job, child); });
+            return true;
+        }
+        if (info.type != EntryType::File || info.size == EntryStore::kUnknownSize) return true;
+        ++files;
+        if (info.size < job.options->minSize) return true;
+        found.push_back(Seen{std::move(child), info.size, info.dev, info.ino, info.mtimeNs});
+        return true;
+    }, scanEc);
+    if (scanEc) job.results->unreadable.fetch_add(1, std::memory_order_relaxed);
+    job.results->files.fetch_add(files, std::memory_order_relaxed);
+    if (found.empty()) return;
+    std::lock_guard<std::mutex> lock(job.walkMutex);
+    job.seen.insert(job.seen.end(), std::make_move_iterator(found.begin()),
+                    std::make_move_iterator(found.end()));
+}
+
+/* Turn the walk into size buckets of two or more inodes. Extra paths of
+* one inode are counted as hard links; files alone in their size are
+* dropped here, before anything is read.
+* @param job
+*/
+void MakeBuckets(DupJob& job) {
+    std::vector<Seen> seen;
+    seen.swap(job.seen);
+    std::sort(seen.begin(), seen.end(), [](const Seen& a, const Seen& b) {
+        return std::tie(b.size, a.dev, a.ino, a.path) < std::tie(a.size, b.dev, b.ino, b.path);
+    });
+    std::uint64_t hardLinks = 0;
+    std::uint64_t candidates = 0;
+    std::size_t i = 0;
+    while (i < seen.size()) {
+        std::size_t end = i;
+        std::size_t inodes = 0;
+        while (end < seen.size() && seen[end].size == seen[i].size) {
+            if (end == i || seen[end].dev != seen[end - 1].dev || seen[end].ino != seen[end - 1].ino) ++inodes;
+            else ++hardLinks;
+            ++end;
+        }
+        if (inodes >= 2) {
+            auto bucket = std::make_unique<Bucket>();
+            bucket->size = seen[i].size;
+            for (std::size_t k = i; k < end; ++k) {
+                if (k == i || seen[k].dev != seen[k - 1].dev || seen[k].ino != seen[k - 1].ino) {
+                    Inode inode;
+                    inode.first = job.paths.size();
+                    bucket->inodes.push_back(inode);
+                }
+                ++bucket->inodes.back().links;
+                job.paths.push_back(DupFile{std::move(seen[k].path), seen[k].dev, seen[k].ino, seen[k].mtimeNs});
+            }
+            candidates += inodes;
+            job.buckets.push_back(std::move(bucket));
+        }
+        i = end;
+    }
+    for (const auto& bucket : job.buckets) {
+        const std::size_t n = bucket->inodes.size();
+        bucket->pending.store((n + DupFinder::kInodesPerTask - 1) / DupFinder::kInodesPerTask);
+        for (std::size_t begin = 0; begin < n; begin += DupFinder::kInodesPerTask) {
+            job.chunks.push_back(EdgeChunk{bucket.get(), begin, std::min(n, begin + DupFinder::kInodesPerTask)});
+        }
+    }
+    job.results->hardLinks.store(hardLinks);
+    job.results->candidates.store(candidates);
+    if (job.options->progress) job.options->progress->totalFiles.store(candidates);
+}
+
+/* Emit every run of two or more inodes with the same hash as a group.
+* Within a group the inode whose path sorts first leads.
+* @param job
+* @param bucket
+*/
+void EmitGroups(DupJob& job, Bucket& bucket) {
+    std::vector<Inode>& inodes = bucket.inodes;
+    auto byHash = [&](const Inode& a, const Inode& b) {
+        if (a.ok != b.ok) return a.ok;
+        if (a.hash != b.hash) return a.hash < b.hash;
+        return job.paths[a.first].path < job.paths[b.first].path;
+    };
+    std::sort(inodes.begin(), inodes.end(), byHash);
+    for (std::size_t i = 0; i < inodes.size() && inodes[i].ok;) {
+        std::size_t end = i + 1;
+        while (end < inodes.size() && inodes[end].ok && inodes[end].hash == inodes[i].hash) ++end;
+        if (end - i >= 2) {
+            DupGroup group;
+            group.size = bucket.size;
+            group.hash = inodes[i].hash;
+            group.copies = end - i;
+            for (std::size_t k = i; k < end; ++k) {
+                for (std::size_t p = 0; p < inodes[k].links; ++p) {
+                    group.files.push_back(job.paths[inodes[k].first + p]);
+                }
+            }
+            job.results->Add(std::move(group));
+        }
+        i = end;
+    }
+}
+
+/* All edge hashes of a bucket are in. Small files were hashed whole and
+* are grouped now; for the others the inodes that share an edge hash are
+* queued for a full hash and everything else is dropped.
+* @param job
+* @param bucket
+*/
+void EdgesDone(DupJob& job, Bucket& bucket) {
+    if (!job.Live()) return;
+    if (bucket.size <= 2 * DupFinder::kEdgeBytes) {
+        EmitGroups(job, bucket);
+        return;
+    }
+    std::vector<Inode>& inodes = bucket.inodes;
+    std::sort(inodes.begin(), inodes.end(), [](const Inode& a, const Inode& b) {
+        return std::tie(b.ok, a.hash) < std::tie(a.ok, b.hash);
+    });
+    std::vector<Inode> survivors;
+    for (std::size_t i = 0; i < inodes.size() && inodes[i].ok;) {
+        std::size_t end = i + 1;
+        while (end < inodes.size() && inodes[end].ok && inodes[end].hash == inodes[i].hash) ++end;
+        if (end - i >= 2) survivors.insert(survivors.end(), inodes.begin() + i, inodes.begin() + end);
+        i = end;
+    }
+    inodes.swap(survivors);
+    if (inodes.empty()) return;
+    bucket.pending.store(inodes.size());
+    {
+        std::lock_guard<std::mutex> lock(job.fullMutex);
+        for (std::size_t i = 0; i < inodes.size(); ++i) job.full.emplace_back(&bucket, i);
+    }
+    // Workers that already ran out of edge chunks have left; bring some back
+    const std::size_t helpers = std::min<std::size_t>(inodes.size(), job.pool->Size());
+    for (std::size_t i = 0; i < helpers; ++i) {
+        job.pool->Submit([&job]() { Drain(job); });
+    }
+}
+
+/* Hash an inode through the first of its paths that can be read
+* @param job
+* @param bucket
+* @param inode
+* @param whole: full hash instead of edge hash
+*/
+void HashInode(DupJob& job, const Bucket& bucket, Inode& inode, bool whole) {
+    inode.ok = false;
+    if (!job.Live()) return;
+    for (std::size_t p = 0; p < inode.links && !inode.ok; ++p) {
+        const std::filesystem::path& path = job.paths[inode.first + p].path;
+        if (whole) {
+            inode.ok = DupFinder::HashFile(path, bucket.size, job.options->progress, inode.hash);
+            if (inode.ok) job.results->bytesRead.fetch_add(bucket.size, std::memory_order_relaxed);
+        } else {
+            std::uint64_t read = 0;
+            inode.ok = DupFinder::HashEdges(path, bucket.size, inode.hash, read);
+            job.results->bytesRead.fetch_add(read, std::memory_order_relaxed);
+            if (job.options->progress) job.options->progress->bytes.fetch_add(read, std::memory_order_relaxed);
+        }
+    }
+    if (!inode.ok && job.Live()) job.results->unreadable.fetch_add(1, std::memory_order_relaxed);
+    if (whole) {
+        job.results->fullHashed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        job.results->edgeHashed.fetch_add(1, std::memory_order_relaxed);
+        if (job.options->progress) job.options->progress->files.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/* Worker loop of the hashing passes. Queued full hashes go first so the
+* buckets already started finish, and show up, before new ones begin.
+* @param job
+*/
+void Drain(DupJob& job) {
+    for (;;) {
+        std::pair<Bucket*, std::size_t> item(nullptr, 0);
+        {
+            std::lock_guard<std::mutex> lock(job.fullMutex);
+            if (!job.full.empty()) {
+                item = job.full.front();
+                job.full.pop_front();
+            }
+        }
+        if (item.first) {
+            Bucket& bucket = *item.first;
+            HashInode(job, bucket, bucket.inodes[item.second], true);
+            if (bucket.pending.fetch_sub(1) == 1 && job.Live()) EmitGroups(job, bucket);
+            continue;
+        }
+        const std::size_t next = job.nextChunk.fetch_add(1);
+        if (next >= job.chunks.size()) return;
+        const EdgeChunk& chunk = job.chunks[next];
+        Bucket& bucket = *chunk.bucket;
+        for (std::size_t i = chunk.begin; i < chunk.end; ++i) {
+            HashInode(job, bucket, bucket.inodes[i], false);
+        }
+        if (bucket.pending.fetch_sub(1) == 1) EdgesDone(job, bucket);
+    }
+}
+}
+
+/* Hash both ends of a file, or all of it when the ends would overlap
+* @param path
+* @param size
+* @param hash
+* @param read
+* @return false if it cannot be read or changed size
+*/
+bool DupFinder::HashEdges(const std::filesystem::path& path, std::uint64_t size,
+                          std::uint64_t& hash, std::uint64_t& read) {
+    read = 0;
+    Reader reader;
+    if (!reader.Open(path, size)) return false;
+    std::vector<char>& buffer = ReadBuffer();
+    if (size <= 2 * kEdgeBytes) {
+        if (!reader.ReadAt(buffer.data(), static_cast<std::size_t>(size), 0)) return false;
+        read = size;
+    } else {
+        if (!reader.ReadAt(buffer.data(), kEdgeBytes, 0) ||
+            !reader.ReadAt(buffer.data() + kEdgeBytes, kEdgeBytes, size - kEdgeBytes)) {
+            return false;
+        }
+        read = 2 * kEdgeBytes;
+    }
+    hash = Xxh64::Hash(buffer.data(), static_cast<std::size_t>(read));
+    return true;
+}
+/* Hash a file in kReadChunk pieces
+* @param path
+* @param size
+* @param progress
+* @param hash
+* @return false if it cannot be read, changed size or was cancelled
+*/
+bool DupFinder::HashFile(const std::filesystem::path& path, std::uint64_t size,
+                         OpProgress* progress, std::uint64_t& hash) {
+    Reader reader;
+    if (!reader.Open(path, size)) return false;
+    reader.Sequential();
+    std::vector<char>& buffer = ReadBuffer();
+    Xxh64 state;
+    for (std::uint64_t offset = 0; offset < size;) {
+        if (progress && !progress->Checkpoint()) return false;
+        const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(kReadChunk, size - offset));
+        if (!reader.ReadAt(buffer.data(), n, offset)) return false;
+        state.Update(buffer.data(), n);
+        offset += n;
+        if (progress) progress->bytes.fetch_add(n, std::memory_order_relaxed);
+    }
+    hash = state.Digest();
+    return true;
+}
+/* Stat both files, then compare them chunk by chunk
+* @param kept
+* @param file
+* @param size
+* @param progress
+* @param ec
+* @return true if file is still a copy of kept
+*/
+bool DupFinder::Recheck(const DupFile& kept, const DupFile& file, std::uint64_t size,
+                        OpProgress* progress, std::error_code& ec) {
+    ec.clear();
+    for (const DupFile* f : {&kept, &file}) {
+        DirEntryInfo info;
+        if (!DirScanner::Stat(f->path, info, ec)) return false;
+        if (info.symlink || info.type != EntryType::File || info.size != size || info.mtimeNs != f->mtimeNs ||
+            info.dev != f->dev || info.ino != f->ino) {
+            ec = std::make_error_code(std::errc::io_error); // Changed since the search
+            return false;
+        }
+    }
+    if (kept.dev == file.dev && kept.ino == file.ino) return true; // Two names of one file
+    Reader keptReader;
+    Reader fileReader;
+    if (!keptReader.Open(kept.path, size) || !fileReader.Open(file.path, size)) {
+        ec = std::make_error_code(std::errc::io_error);
+        return false;
+    }
+    keptReader.Sequential();
+    fileReader.Sequential();
+    std::vector<char>& keptBuffer = ReadBuffer();
+    thread_local std::vector<char> fileBuffer(kReadChunk);
+    for (std::uint64_t offset = 0; offset < size;) {
+        if (progress && !progress->Checkpoint()) {
+            ec = std::make_error_code(std::errc::operation_canceled);
+            return false;
+        }
+        const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(kReadChunk, size - offset));
+        if (!keptReader.ReadAt(keptBuffer.data(), n, offset) || !fileReader.ReadAt(fileBuffer.data(), n, offset) ||
+            std::memcmp(keptBuffer.data(), fileBuffer.data(), n) != 0) {
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        offset += n;
+        if (progress) progress->bytes.fetch_add(2 * n, std::memory_order_relaxed);
+    }
+    return true;
+}
+/* Walk root, bucket by size, then run both hash passes on one pool. The
+* results are not finished here; the caller does that.
+* @param root
+* @param options
+* @param results
+* @param ec
+* @return false if cancelled or root cannot be read
+*/
+bool DupFinder::Run(const std::filesystem::path& root, const DupOptions& options,
+                    DupResults& results, std::error_code& ec) {
+    ec.clear();
+    DirEntryInfo info;
+    if (!DirScanner::Stat(root, info, ec)) return false;
+    if (info.type != EntryType::Dir) {
+        ec = std::make_error_code(std::errc::not_a_directory);
+        return false;
+    }
+    DupJob job;
+    job.options = &options;
+    job.results = &results;
+    {
+        ThreadPool pool(options.threads);
+        job.pool = &pool;
+        pool.Submit([&job, &root]() { WalkDir(job, root); });
+        pool.Wait();
+        if (job.Live()) {
+            MakeBuckets(job);
+            for (unsigned i = 0; i < pool.Size(); ++i) {
+                pool.Submit([&job]() { Drain(job); });
+            }
+            pool.Wait();
+        }
+    }
+    if (options.progress && options.progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    return true;
+}
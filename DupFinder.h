@@ -0,0 +1,146 @@
+/*
+    Description: Declare DupFinder, the parallel duplicate file finder, and
+                 DupResults, the groups it streams out while it runs
+*/
+#ifndef DUPFINDER_H
+#define DUPFINDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "OpProgress.h"
+
+// One path of a duplicate group
+struct DupFile {
+    std::filesystem::path path;
+    std::uint64_t dev = 0;
+    std::uint64_t ino = 0;
+    std::int64_t mtimeNs = 0; // As the walk saw it
+};
+
+/* Files with the same size and content. Paths of one inode (hard links)
+   are adjacent; only distinct inodes take up space.
+*/
+struct DupGroup {
+    std::uint64_t size = 0;
+    std::uint64_t hash = 0;      // XXH64 of the content
+    std::vector<DupFile> files;
+    std::size_t copies = 0;      // Distinct inodes among files, at least 2
+
+    // Bytes freed by keeping one copy
+    std::uint64_t Wasted() const { return copies > 1 ? size * (copies - 1) : 0; }
+};
+
+/* Groups of one run, filled by the workers and read by the UI while the
+   run is still going. Groups are only ever appended.
+*/
+class DupResults {
+public:
+    // Append a group (worker threads)
+    void Add(DupGroup&& group);
+    std::size_t Size() const;
+    // Copy of group i, i < Size()
+    DupGroup At(std::size_t i) const;
+    // Mark the run finished and stop the clock
+    void Finish();
+    double Seconds() const;
+
+    std::atomic<std::uint64_t> files{0};        // Regular files found by the walk
+    std::atomic<std::uint64_t> candidates{0};   // Inodes sharing their size with another
+    std::atomic<std::uint64_t> edgeHashed{0};   // Inodes whose ends were hashed
+    std::atomic<std::uint64_t> fullHashed{0};   // Inodes hashed whole
+    std::atomic<std::uint64_t> bytesRead{0};    // Content read by both hash passes
+    std::atomic<std::uint64_t> hardLinks{0};    // Extra paths of an inode already counted
+    std::atomic<std::uint64_t> duplicates{0};   // Redundant copies in the groups so far
+    std::atomic<std::uint64_t> wasted{0};       // Their bytes
+    std::atomic<std::uint64_t> unreadable{0};   // Files or directories that could not be read
+    std::atomic<bool> done{false};
+
+private:
+    using Clock = std::chrono::steady_clock;
+    mutable std::mutex mutex_;
+    std::vector<DupGroup> groups_;
+    Clock::time_point start_ = Clock::now();
+    Clock::time_point end_;
+};
+
+// Tuning knobs for a duplicate search
+struct DupOptions {
+    unsigned threads = 0;            // Files hashed in parallel, 0 for auto
+    std::uint64_t minSize = 1;       // Smaller files are ignored; empty files are all alike
+    OpProgress* progress = nullptr;  // files/bytes count what was hashed; checked per file
+};
+
+/* Finds files with identical content below a directory.
+                 - The walk fans out across a work-stealing pool and keeps
+                   size, device and inode of every regular file
+                 - Files are bucketed by size; a bucket with one inode has
+                   no duplicate. Paths sharing (dev, ino) are hard links of
+                   one copy: they are listed but never counted as waste
+                 - In each bucket the first and last kEdgeBytes of every
+                   inode are hashed; only inodes whose edges collide are
+                   then read whole, in kReadChunk pieces
+                 - Buckets are processed largest size first and a group is
+                   emitted as soon as its bucket is done, so the biggest
+                   savings show up early
+                 - Symlinks are not followed
+*/
+class DupFinder {
+public:
+    static constexpr std::size_t kEdgeBytes = 4096;
+    static constexpr std::size_t kReadChunk = 1024 * 1024;
+    static constexpr std::size_t kInodesPerTask = 64; // Edge hashes one task computes
+
+    /* Find the duplicate files below root
+    * @param root: directory to search
+    * @param options
+    * @param results: receives the groups and counters as they come in;
+    *                 calling Finish is left to the caller
+    * @param ec: operation_canceled when cancelled, the error when root cannot be read
+    * @return false when cancelled or root is unreadable
+    */
+    static bool Run(const std::filesystem::path& root, const DupOptions& options,
+                    DupResults& results, std::error_code& ec);
+
+    /* Hash the first and last kEdgeBytes of a file; a file of at most
+    * 2 * kEdgeBytes is hashed whole, which makes this its full hash
+    * @param path
+    * @param size: expected size; a file that changed size fails
+    * @param hash: receives the hash
+    * @param read: receives the bytes read
+    * @return false if the file cannot be read
+    */
+    static bool HashEdges(const std::filesystem::path& path, std::uint64_t size,
+                          std::uint64_t& hash, std::uint64_t& read);
+
+    /* Hash a whole file
+    * @param path
+    * @param size: expected size; a file that changed size fails
+    * @param progress: bytes counts what was read, checked per chunk; may be nullptr
+    * @param hash: receives the hash
+    * @return false if the file cannot be read or the run was cancelled
+    */
+    static bool HashFile(const std::filesystem::path& path, std::uint64_t size,
+                         OpProgress* progress, std::uint64_t& hash);
+
+    /* Check right before a delete or link that file is still a copy of
+    * kept. A hash match is not proof and either file may have changed
+    * since the search, so both are stat'ed again and compared byte by byte.
+    * @param kept: the copy that stays
+    * @param file: the copy about to go
+    * @param size: the size of the group
+    * @param progress: bytes counts what was read, checked per chunk; may be nullptr
+    * @param ec: io_error when either file changed or they differ
+    * @return true if it is safe to drop file
+    */
+    static bool Recheck(const DupFile& kept, const DupFile& file, std::uint64_t size,
+                        OpProgress* progress, std::error_code& ec);
+};
+
+#endif
@@ -0,0 +1,423 @@
+/*
+    Description: Implementation of the duplicate finder window.
+*/
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "DupFrame.h"
+#include "FileOp.h"
+
+namespace {
+// Smallest file size searched, per m_minSize choice
+constexpr std::uint64_t kMinSizes[] = {1, 4 * 1024, 1024 * 1024, 100 * 1024 * 1024};
+constexpr std::size_t kMaxListedFailures = 10;
+
+wxString FormatBytes(std::uint64_t bytes) {
+    if (bytes >= 1024ULL * 1024 * 1024) return wxString::Format("%.1f GB", bytes / (1024.0 * 1024 * 1024));
+    if (bytes >= 1024ULL * 1024) return wxString::Format("%.1f MB", bytes / (1024.0 * 1024));
+    if (bytes >= 1024) return wxString::Format("%.1f KB", bytes / 1024.0);
+    return wxString::Format("%llu bytes", static_cast<unsigned long long>(bytes));
+}
+}
+
+/* Virtual list over the rows of a DupFrame: size, group, path and what the
+   row is, formatted only for the rows on screen
+*/
+class DupResultList : public wxListCtrl {
+    public:
+        DupResultList(wxWindow* parent, const std::vector<DupGroup>& groups,
+                      const std::vector<DupFrame::Row>& rows, const std::filesystem::path& root)
+            : wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxLC_REPORT | wxLC_VIRTUAL),
+              groups_(groups), rows_(rows), root_(root)
+        {
+            InsertColumn(0, _("Size"), wxLIST_FORMAT_RIGHT, 110);
+            InsertColumn(1, _("Group"), wxLIST_FORMAT_RIGHT, 70);
+            InsertColumn(2, _("File"), wxLIST_FORMAT_LEFT, 480);
+            InsertColumn(3, _("Note"), wxLIST_FORMAT_LEFT, 200);
+        }
+
+    protected:
+        wxString OnGetItemText(long item, long column) const override {
+            if (item < 0 || static_cast<std::size_t>(item) >= rows_.size()) return wxString();
+            const DupFrame::Row& row = rows_[static_cast<std::size_t>(item)];
+            const DupGroup& group = groups_[row.group];
+            const DupFile& file = group.files[row.file];
+            switch (column) {
+            case 0:
+                return FormatBytes(group.size);
+            case 1:
+                return wxString::Format("%u", row.group + 1);
+            case 2:
+                return wxString(file.path.lexically_relative(root_).wstring());
+            case 3:
+                switch (row.state) {
+                case DupFrame::RowState::Deleted: return "deleted";
+                case DupFrame::RowState::Linked: return "replaced by a hard link";
+                case DupFrame::RowState::Failed: return "failed";
+                default: break;
+                }
+                if (row.file == 0) {
+                    return wxString::Format("kept; %llu copies, %s wasted",
+                                            static_cast<unsigned long long>(group.copies),
+                                            FormatBytes(group.Wasted()));
+                }
+                if (file.dev == group.files[row.file - 1].dev && file.ino == group.files[row.file - 1].ino) {
+                    return "hard link, no extra space";
+                }
+                return "duplicate";
+            default:
+                return wxString();
+            }
+        }
+
+    private:
+        const std::vector<DupGroup>& groups_;
+        const std::vector<DupFrame::Row>& rows_;
+        std::filesystem::path root_;
+};
+
+/* Lay out the option row, result list and counters, then start searching
+* @param parent
+* @param jobs
+* @param root
+* @param onOpen
+*/
+DupFrame::DupFrame(wxWindow* parent, JobQueue& jobs, const std::filesystem::path& root, OpenFn onOpen)
+    : wxFrame(parent, wxID_ANY, "Find Duplicates - " + wxString(root.wstring()),
+              wxDefaultPosition, wxSize(900, 560)),
+      jobs_(jobs), root_(root), onOpen_(std::move(onOpen)), timer_(this)
+{
+    wxPanel* panel = new wxPanel(this);
+    const wxString sizes[] = {"Any size", "4 KB or more", "1 MB or more", "100 MB or more"};
+    m_minSize = new wxChoice(panel, wxID_ANY, wxDefaultPosition, wxDefaultSize, 4, sizes);
+    m_minSize->SetSelection(1);
+    wxButton* findButton = new wxButton(panel, ID_Find, "&Find");
+    m_stopButton = new wxButton(panel, ID_Stop, "S&top");
+    m_stopButton->Disable();
+    m_deleteButton = new wxButton(panel, ID_DeleteSelected, "&Delete Selected");
+    m_linkButton = new wxButton(panel, ID_LinkSelected, "&Link Selected");
+    m_list = new DupResultList(panel, groups_, rows_, root_);
+    m_status = new wxStaticText(panel, wxID_ANY, "Searching " + wxString(root.wstring()));
+
+    m_list->Bind(wxEVT_LIST_ITEM_ACTIVATED, &DupFrame::OnActivated, this);
+    Bind(wxEVT_BUTTON, &DupFrame::OnFind, this, ID_Find);
+    Bind(wxEVT_BUTTON, &DupFrame::OnStop, this, ID_Stop);
+    Bind(wxEVT_BUTTON, &DupFrame::OnDeleteSelected, this, ID_DeleteSelected);
+    Bind(wxEVT_BUTTON, &DupFrame::OnLinkSelected, this, ID_LinkSelected);
+    Bind(wxEVT_TIMER, &DupFrame::OnTimer, this);
+
+    wxBoxSizer* optionRow = new wxBoxSizer(wxHORIZONTAL);
+    optionRow->Add(new wxStaticText(panel, wxID_ANY, "Files of"), 0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 5);
+    optionRow->Add(m_minSize, 0, wxRIGHT, 5);
+    optionRow->Add(findButton, 0, wxRIGHT, 5);
+    optionRow->Add(m_stopButton, 0);
+    optionRow->AddStretchSpacer();
+    optionRow->Add(m_deleteButton, 0, wxRIGHT, 5);
+    optionRow->Add(m_linkButton, 0);
+    wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+    sizer->Add(optionRow, 0, wxEXPAND | wxALL, 5);
+    sizer->Add(m_list, 1, wxEXPAND | wxLEFT | wxRIGHT, 5);
+    sizer->Add(m_status, 0, wxEXPAND | wxALL, 5);
+    panel->SetSizer(sizer);
+    StartSearch();
+}
+/* A search nobody can see any more is not worth finishing. A running
+* delete or link is left to complete; it only touches its own Action.
+*/
+DupFrame::~DupFrame() {
+    timer_.Stop();
+    StopSearch();
+}
+/* Queue a search job. It only writes to its DupResults, which the window
+* polls; the job never touches the UI.
+*/
+void DupFrame::StartSearch() {
+    StopSearch();
+    auto results = std::make_shared<DupResults>();
+    DupOptions options;
+    const int choice = m_minSize->GetSelection();
+    if (choice >= 0 && choice < static_cast<int>(std::size(kMinSizes))) options.minSize = kMinSizes[choice];
+    const std::filesystem::path root = root_;
+    const wxString title = "Find duplicates in " + wxString(root.wstring());
+    jobId_ = jobs_.Submit(std::string(title.utf8_str()), {root},
+                          [results, root, options](OpProgress& progress, std::error_code& ec,
+                                                   std::filesystem::path& errorPath) mutable {
+        options.progress = &progress;
+        const bool ok = DupFinder::Run(root, options, *results, ec);
+        if (!ok) errorPath = root;
+        return ok;
+    }, [results](const JobInfo& info) {
+        results->Finish(); // Also when cancelled before it started
+    });
+    results_ = results;
+    groups_.clear();
+    rows_.clear();
+    m_list->SetItemCount(0);
+    m_list->Refresh();
+    m_stopButton->Enable();
+    RefreshResults();
+    timer_.Start(kRefreshMs);
+}
+/* Cancel the job of the latest search
+*/
+void DupFrame::StopSearch() {
+    if (results_ && !results_->done.load()) jobs_.Cancel(jobId_);
+}
+/* Append the groups that came in since the last refresh. Groups are only
+* appended, so rows already shown keep their place.
+*/
+void DupFrame::RefreshResults() {
+    if (action_ && action_->done.load()) FinishAction();
+    if (!results_) return;
+    const DupResults& r = *results_;
+    const bool done = r.done.load();
+    const std::size_t count = r.Size();
+    for (std::size_t i = groups_.size(); i < count; ++i) {
+        groups_.push_back(r.At(i));
+        const DupGroup& group = groups_.back();
+        for (std::size_t f = 0; f < group.files.size(); ++f) {
+            rows_.push_back(Row{static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(f), RowState::Listed});
+        }
+    }
+    if (static_cast<std::size_t>(m_list->GetItemCount()) != rows_.size()) {
+        m_list->SetItemCount(static_cast<long>(rows_.size()));
+    }
+
+    wxString text = wxString::Format("%llu groups, %llu redundant copies, %s wasted; "
+                                     "%llu files, %llu same-size candidates, %s read",
+                                     static_cast<unsigned long long>(count),
+                                     static_cast<unsigned long long>(r.duplicates.load()),
+                                     FormatBytes(r.wasted.load()),
+                                     static_cast<unsigned long long>(r.files.load()),
+                                     static_cast<unsigned long long>(r.candidates.load()),
+                                     FormatBytes(r.bytesRead.load()));
+    if (r.hardLinks.load() > 0) {
+        text += wxString::Format(", %llu hard links not counted", static_cast<unsigned long long>(r.hardLinks.load()));
+    }
+    if (r.unreadable.load() > 0) {
+        text += wxString::Format(", %llu unreadable", static_cast<unsigned long long>(r.unreadable.load()));
+    }
+    if (deleted_ > 0 || linked_ > 0) {
+        text += wxString::Format(" | %llu deleted, %llu linked",
+                                 static_cast<unsigned long long>(deleted_), static_cast<unsigned long long>(linked_));
+    }
+    if (!done) {
+        text = "Searching... " + text;
+    } else {
+        text = wxString::Format("Finished in %.2f s: ", r.Seconds()) + text;
+        for (const JobInfo& info : jobs_.Snapshot()) {
+            if (info.id != jobId_) continue;
+            if (info.state == JobState::Cancelled) text = "Stopped. " + text;
+            if (info.state == JobState::Failed) text = "Search failed: " + wxString(info.ec.message());
+        }
+        m_stopButton->Disable();
+        if (!action_) timer_.Stop();
+    }
+    m_status->SetLabel(text);
+}
+/* Mark the rows of the finished action and report what failed
+*/
+void DupFrame::FinishAction() {
+    std::shared_ptr<Action> action = std::move(action_);
+    std::set<std::filesystem::path> failed;
+    for (const PathError& failure : action->failures) failed.insert(failure.path);
+    for (std::size_t index : action->rows) {
+        Row& row = rows_[index];
+        if (failed.count(groups_[row.group].files[row.file].path)) {
+            row.state = RowState::Failed;
+        } else if (action->link) {
+            row.state = RowState::Linked;
+            ++linked_;
+        } else {
+            row.state = RowState::Deleted;
+            ++deleted_;
+        }
+    }
+    m_list->Refresh();
+    m_deleteButton->Enable();
+    m_linkButton->Enable();
+    if (action->failures.empty()) return;
+    wxString list;
+    const std::size_t shown = std::min(action->failures.size(), kMaxListedFailures);
+    for (std::size_t i = 0; i < shown; ++i) {
+        list += "\n" + wxString(action->failures[i].path.wstring()) + ": " +
+                wxString(action->failures[i].ec.message());
+    }
+    if (action->failures.size() > shown) {
+        list += wxString::Format("\n... and %llu more",
+                                 static_cast<unsigned long long>(action->failures.size() - shown));
+    }
+    for (const PathError& failure : action->failures) {
+        if (failure.ec != std::errc::io_error) continue;
+        list += "\n\nFiles that changed since the search or no longer match byte for byte were left alone.";
+        break;
+    }
+    wxMessageBox(wxString::Format("%s failed for %llu files.", action->link ? "Linking" : "Deleting",
+                                  static_cast<unsigned long long>(action->failures.size())) + list,
+                 "Error", wxOK | wxICON_ERROR, this);
+}
+/* Selected rows whose file is still there
+* @return row indices
+*/
+std::vector<std::size_t> DupFrame::SelectedRows() const {
+    std::vector<std::size_t> rows;
+    long row = -1;
+    while ((row = m_list->GetNextItem(row, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED)) != -1) {
+        const RowState state = rows_[static_cast<std::size_t>(row)].state;
+        if (state == RowState::Listed || state == RowState::Failed) rows.push_back(static_cast<std::size_t>(row));
+    }
+    return rows;
+}
+/* Run a delete or link over rows as one job. Linking points every row at
+* the kept file of its group; deleting keeps a file of the group that is
+* not selected. Each pair is checked again with DupFinder::Recheck first.
+* @param link
+* @param rows
+*/
+void DupFrame::SubmitAction(bool link, std::vector<std::size_t> rows) {
+    auto action = std::make_shared<Action>();
+    action->link = link;
+    action->rows = std::move(rows);
+    std::set<std::size_t> selected(action->rows.begin(), action->rows.end());
+    std::vector<std::tuple<DupFile, DupFile, std::uint64_t>> items; // (kept, file, size)
+    for (std::size_t index : action->rows) {
+        const Row& row = rows_[index];
+        const DupGroup& group = groups_[row.group];
+        std::size_t kept = 0;
+        if (!link) {
+            // Rows of a group are adjacent; OnDeleteSelected made sure one stays
+            const std::size_t first = index - row.file;
+            while (kept + 1 < group.files.size() &&
+                   (selected.count(first + kept) || rows_[first + kept].state == RowState::Deleted)) {
+                ++kept;
+            }
+        }
+        items.emplace_back(group.files[kept], group.files[row.file], group.size);
+    }
+    const wxString title = wxString::Format("%s %llu duplicates in ", link ? "Link" : "Delete",
+                                            static_cast<unsigned long long>(items.size())) +
+                           wxString(root_.wstring());
+    jobs_.Submit(std::string(title.utf8_str()), {root_},
+                 [action, items, link](OpProgress& progress, std::error_code& ec,
+                                       std::filesystem::path& errorPath) {
+        progress.totalFiles.store(items.size());
+        std::vector<std::filesystem::path> paths; // Checked and ready to delete
+        for (const auto& [kept, file, size] : items) {
+            if (!progress.Checkpoint()) {
+                action->failures.push_back(PathError{file.path, std::make_error_code(std::errc::operation_canceled)});
+                continue;
+            }
+            std::error_code itemEc;
+            if (!DupFinder::Recheck(kept, file, size, &progress, itemEc)) {
+                action->failures.push_back(PathError{file.path, itemEc});
+            } else if (!link) {
+                paths.push_back(file.path);
+                continue;
+            } else if (!FileOp::LinkPath(kept.path, file.path, itemEc)) {
+                action->failures.push_back(PathError{file.path, itemEc});
+            }
+            progress.files.fetch_add(1);
+        }
+        if (!paths.empty()) {
+            DeleteOptions options;
+            options.progress = &progress;
+            DeleteStats stats;
+            FileOp::DeletePaths(paths, options, stats, action->failures, ec);
+        }
+        if (!action->failures.empty()) {
+            ec = action->failures.front().ec;
+            errorPath = action->failures.front().path;
+        }
+        return action->failures.empty();
+    }, [action](const JobInfo& info) {
+        action->done.store(true);
+    });
+    action_ = action;
+    m_deleteButton->Disable();
+    m_linkButton->Disable();
+    timer_.Start(kRefreshMs);
+}
+/* Find button
+* @param event
+*/
+void DupFrame::OnFind(wxCommandEvent& event) {
+    if (action_) return; // Rows must stay put until the action is applied
+    StartSearch();
+}
+/* Stop button
+* @param event
+*/
+void DupFrame::OnStop(wxCommandEvent& event) {
+    StopSearch();
+}
+/* Delete the selected files once confirmed. A group must keep at least
+* one file that is not selected.
+* @param event
+*/
+void DupFrame::OnDeleteSelected(wxCommandEvent& event) {
+    std::vector<std::size_t> rows = SelectedRows();
+    if (rows.empty() || action_) return;
+    std::vector<std::size_t> left(groups_.size(), 0); // Files of each group that stay
+    for (const Row& row : rows_) {
+        if (row.state != RowState::Deleted) ++left[row.group];
+    }
+    for (std::size_t index : rows) --left[rows_[index].group];
+    for (std::size_t index : rows) {
+        if (left[rows_[index].group] > 0) continue;
+        wxMessageBox(wxString::Format("Every file of group %u is selected. Leave at least one of them.",
+                                      rows_[index].group + 1),
+                     "Find Duplicates", wxOK | wxICON_WARNING, this);
+        return;
+    }
+    std::uint64_t bytes = 0;
+    for (std::size_t index : rows) bytes += groups_[rows_[index].group].size;
+    int answer = wxMessageBox(wxString::Format("Delete %llu files (%s)?",
+                                               static_cast<unsigned long long>(rows.size()), FormatBytes(bytes)),
+                              "Confirm Deletion", wxYES_NO | wxICON_QUESTION, this);
+    if (answer != wxYES) return;
+    SubmitAction(false, std::move(rows));
+}
+/* Replace the selected files with hard links to the kept file of their
+* group. Kept files and links of it are skipped; the group and its size
+* stay listed.
+* @param event
+*/
+void DupFrame::OnLinkSelected(wxCommandEvent& event) {
+    if (action_) return;
+    std::vector<std::size_t> rows;
+    for (std::size_t index : SelectedRows()) {
+        const Row& row = rows_[index];
+        const DupGroup& group = groups_[row.group];
+        const DupFile& file = group.files[row.file];
+        if (row.file == 0) continue;
+        if (file.dev == group.files.front().dev && file.ino == group.files.front().ino) continue;
+        if (rows_[index - row.file].state == RowState::Deleted) continue; // Kept file is gone
+        rows.push_back(index);
+    }
+    if (rows.empty()) return;
+    int answer = wxMessageBox(wxString::Format("Replace %llu files with hard links to the kept copy? "
+                                               "They will share one content from then on.",
+                                               static_cast<unsigned long long>(rows.size())),
+                              "Confirm Link", wxYES_NO | wxICON_QUESTION, this);
+    if (answer != wxYES) return;
+    SubmitAction(true, std::move(rows));
+}
+/* Periodic refresh while a search or action runs
+* @param event
+*/
+void DupFrame::OnTimer(wxTimerEvent& event) {
+    RefreshResults();
+}
+/* Show the activated file in the main window
+* @param event
+*/
+void DupFrame::OnActivated(wxListEvent& event) {
+    const long row = event.GetIndex();
+    if (row < 0 || static_cast<std::size_t>(row) >= rows_.size()) return;
+    const Row& r = rows_[static_cast<std::size_t>(row)];
+    if (onOpen_) onOpen_(groups_[r.group].files[r.file].path);
+}
@@ -0,0 +1,110 @@
+/*
+    Description: Declare DupFrame, the duplicate finder window
+*/
+#ifndef DUPFRAME_H
+#define DUPFRAME_H
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+#include <wx/timer.h>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "DupFinder.h"
+#include "JobQueue.h"
+
+class DupResultList;
+
+/* Lists the files below a directory that have identical content, one
+   group after another, and folds the redundant copies away.
+                 - The search runs as a job of the shared JobQueue; groups
+                   are polled on a timer as the finder emits them
+                 - The first file of each group is the one kept; hard links
+                   of a file already listed are marked and cost no space
+                 - Delete and Link act on the selected rows through FileOp,
+                   as jobs too, and never remove the last copy of a group
+*/
+class DupFrame : public wxFrame {
+    public:
+        // Reveal a file in the main window
+        using OpenFn = std::function<void(const std::filesystem::path& path)>;
+
+        /* Create the window
+        * @param parent
+        * @param jobs: queue to run the search and actions on, must outlive the window
+        * @param root: directory searched
+        * @param onOpen: called when a row is activated
+        */
+        DupFrame(wxWindow* parent, JobQueue& jobs, const std::filesystem::path& root, OpenFn onOpen);
+        ~DupFrame() override;
+
+        static constexpr int kRefreshMs = 250;
+
+        // What became of a listed file
+        enum class RowState : std::uint8_t { Listed, Deleted, Linked, Failed };
+
+        // One list row: file f of group g
+        struct Row {
+            std::uint32_t group = 0;
+            std::uint32_t file = 0;
+            RowState state = RowState::Listed;
+        };
+
+    private:
+        enum {
+            ID_Find = wxID_HIGHEST + 220,
+            ID_Stop,
+            ID_DeleteSelected,
+            ID_LinkSelected
+        };
+        // A delete or link job; the job fills failures, the timer reads them after done
+        struct Action {
+            bool link = false;
+            std::vector<std::size_t> rows;
+            std::vector<PathError> failures;
+            std::atomic<bool> done{false};
+        };
+
+        // Start a search, cancelling the previous one
+        void StartSearch();
+        // Cancel the running search, if any
+        void StopSearch();
+        // Take in the groups found so far and update the counters
+        void RefreshResults();
+        // Apply a finished action to its rows
+        void FinishAction();
+        // Selected rows that still exist
+        std::vector<std::size_t> SelectedRows() const;
+        // Queue the delete or link of rows
+        void SubmitAction(bool link, std::vector<std::size_t> rows);
+
+        void OnFind(wxCommandEvent& event);
+        void OnStop(wxCommandEvent& event);
+        void OnDeleteSelected(wxCommandEvent& event);
+        void OnLinkSelected(wxCommandEvent& event);
+        void OnTimer(wxTimerEvent& event);
+        void OnActivated(wxListEvent& event);
+
+        JobQueue& jobs_;
+        std::filesystem::path root_;
+        OpenFn onOpen_;
+        wxChoice* m_minSize;
+        wxButton* m_stopButton;
+        wxButton* m_deleteButton;
+        wxButton* m_linkButton;
+        DupResultList* m_list;
+        wxStaticText* m_status;
+        wxTimer timer_;
+        std::shared_ptr<DupResults> results_;    // Latest search, nullptr before the first
+        std::uint64_t jobId_ = 0;                // Its job
+        std::vector<DupGroup> groups_;           // Groups taken in so far (UI thread only)
+        std::vector<Row> rows_;
+        std::shared_ptr<Action> action_;         // Running delete or link, nullptr when idle
+        std::uint64_t deleted_ = 0;              // Files removed or linked by actions
+        std::uint64_t linked_ = 0;
+};
+
+#endif
@@ -0,0 +1,219 @@
+/*
+    Description: Implementation of the listing sort.
+*/
+#include <algorithm>
+#include <memory>
+
+#include "EntrySort.h"
+#include "ThreadPool.h"
+
+namespace {
+// One row while sorting: the primary key, a name prefix to break most
+// ties without leaving the array, and where the entry lives
+struct Item {
+    std::uint64_t key;
+    std::uint64_t tie;
+    std::uint32_t index;
+};
+
+/* First 8 bytes of a key, big-endian and zero padded, so comparing two
+* prefixes as integers agrees with comparing the keys bytewise
+*/
+std::uint64_t KeyPrefix(std::string_view key) {
+    std::uint64_t prefix = 0;
+    const std::size_t n = std::min<std::size_t>(key.size(), 8);
+    for (std::size_t i = 0; i < 8; ++i) {
+        prefix <<= 8;
+        if (i < n) prefix |= static_cast<unsigned char>(key[i]);
+    }
+    return prefix;
+}
+
+/* Run fn(slice, begin, end) over [0, n) in one slice per worker
+* @param pool
+* @param n
+* @param fn
+*/
+template <typename Fn>
+void ForSlices(ThreadPool& pool, std::size_t n, const Fn& fn) {
+    const std::size_t slices = pool.Size();
+    for (std::size_t s = 0; s < slices; ++s) {
+        const std::size_t begin = n * s / slices;
+        const std::size_t end = n * (s + 1) / slices;
+        pool.Submit([&fn, s, begin, end]() { fn(s, begin, end); });
+    }
+    pool.Wait();
+}
+
+/* Sort items: one chunk per worker, then rounds of pairwise merges that
+* also run in parallel
+* @param items
+* @param less
+* @param pool: nullptr to sort on the calling thread
+*/
+template <typename Less>
+void MergeSort(std::vector<Item>& items, const Less& less, ThreadPool* pool) {
+    if (!pool || pool->Size() < 2) {
+        std::sort(items.begin(), items.end(), less);
+        return;
+    }
+    const std::size_t n = items.size();
+    std::vector<std::size_t> bounds;
+    for (std::size_t s = 0; s <= pool->Size(); ++s) bounds.push_back(n * s / pool->Size());
+    for (std::size_t r = 0; r + 1 < bounds.size(); ++r) {
+        const std::size_t begin = bounds[r];
+        const std::size_t end = bounds[r + 1];
+        pool->Submit([&items, &less, begin, end]() {
+            std::sort(items.begin() + begin, items.begin() + end, less);
+        });
+    }
+    pool->Wait();
+
+    std::vector<Item> buffer(n);
+    while (bounds.size() > 2) {
+        std::vector<std::size_t> merged;
+        for (std::size_t r = 0; r + 1 < bounds.size(); r += 2) {
+            const std::size_t begin = bounds[r];
+            const std::size_t mid = bounds[r + 1];
+            const std::size_t end = r + 2 < bounds.size() ? bounds[r + 2] : mid;
+            merged.push_back(begin);
+            pool->Submit([&items, &buffer, &less, begin, mid, end]() {
+                std::merge(items.begin() + begin, items.begin() + mid,
+                           items.begin() + mid, items.begin() + end,
+                           buffer.begin() + begin, less);
+            });
+        }
+        merged.push_back(n);
+        pool->Wait();
+        items.swap(buffer);
+        bounds.swap(merged);
+    }
+}
+}
+/* Encode a name so that bytewise order is natural order. A digit run
+* becomes '0', its significant digit count as two bytes, then the digits;
+* the marker sorts where digits sort, and a longer number wins before
+* its digits are looked at.
+* @param name
+* @param out
+*/
+void EntrySort::NaturalKey(std::string_view name, std::string& out) {
+    out.clear();
+    out.reserve(name.size() + 4);
+    for (std::size_t i = 0; i < name.size();) {
+        const char c = name[i];
+        if (c >= '0' && c <= '9') {
+            std::size_t start = i;
+            while (i < name.size() && name[i] >= '0' && name[i] <= '9') ++i;
+            while (start + 1 < i && name[start] == '0') ++start; // Leading zeros
+            const std::size_t digits = std::min<std::size_t>(i - start, 0xffff);
+            out.push_back('0');
+            out.push_back(static_cast<char>(digits >> 8));
+            out.push_back(static_cast<char>(digits & 0xff));
+            out.append(name.data() + start, i - start);
+            continue;
+        }
+        out.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+        ++i;
+    }
+}
+/* Build the keys, sort them and return the permutation
+* @param store
+* @param column
+* @param ascending
+* @param dirTotals
+* @param threads
+* @return row to store index
+*/
+std::vector<std::size_t> EntrySort::Order(const EntryStore& store, SortColumn column, bool ascending,
+                                          const DirTotals* dirTotals, unsigned threads) {
+    const std::size_t n = store.Size();
+    std::vector<std::size_t> order(n);
+    if (column == SortColumn::None || n < 2) {
+        for (std::size_t i = 0; i < n; ++i) order[i] = i;
+        return order;
+    }
+    std::unique_ptr<ThreadPool> pool;
+    if (n >= kParallelThreshold) {
+        pool = std::make_unique<ThreadPool>(threads);
+        if (pool->Size() < 2) pool.reset();
+    }
+    auto forSlices = [&](auto fn) {
+        if (pool) ForSlices(*pool, n, fn);
+        else fn(std::size_t(0), std::size_t(0), n);
+    };
+
+    // Name keys are needed by every column, for ties. Each slice fills its
+    // own arena and takes views into it once it has stopped growing.
+    const std::size_t slices = pool ? pool->Size() : 1;
+    std::vector<std::string> arenas(slices);
+    std::vector<std::string_view> nameKeys(n);
+    std::vector<Item> items(n);
+    forSlices([&](std::size_t slice, std::size_t begin, std::size_t end) {
+        std::string& arena = arenas[slice];
+        std::string key;
+        std::vector<std::size_t> offsets;
+        offsets.reserve(end - begin + 1);
+        for (std::size_t i = begin; i < end; ++i) {
+            offsets.push_back(arena.size());
+            NaturalKey(store.Name(i), key);
+            arena += key;
+        }
+        offsets.push_back(arena.size());
+        for (std::size_t i = begin; i < end; ++i) {
+            const std::size_t k = i - begin;
+            nameKeys[i] = std::string_view(arena.data() + offsets[k], offsets[k + 1] - offsets[k]);
+
+            std::uint64_t key64 = 0;
+            std::uint64_t tie = KeyPrefix(nameKeys[i]);
+            switch (column) {
+            case SortColumn::Name:
+                key64 = tie;
+                tie = nameKeys[i].size() > 8 ? KeyPrefix(nameKeys[i].substr(8)) : 0;
+                break;
+            case SortColumn::Type: {
+                // Few distinct types: fold the name into the low bits so
+                // entries of one type still mostly differ in key
+                const std::uint64_t type = store.Type(i) == EntryType::Dir ? 0
+                                           : store.Type(i) == EntryType::File ? 1 : 2;
+                key64 = type << 62 | tie >> 2;
+                break;
+            }
+            case SortColumn::Size:
+                if (store.Type(i) == EntryType::Dir) {
+                    if (dirTotals) {
+                        auto found = dirTotals->find(std::string(store.Name(i)));
+                        if (found != dirTotals->end()) key64 = found->second.bytes;
+                    }
+                } else if (store.FileSize(i) != EntryStore::kUnknownSize) {
+                    key64 = store.FileSize(i);
+                }
+                break;
+            case SortColumn::Modified:
+                // Flip the sign bit so signed times order as unsigned keys
+                key64 = static_cast<std::uint64_t>(store.MTime(i)) ^ (std::uint64_t(1) << 63);
+                break;
+            case SortColumn::None:
+                break;
+            }
+            items[i] = Item{key64, tie, static_cast<std::uint32_t>(i)};
+        }
+    });
+
+    // Type keys already hold the name, so descending reverses it all
+    const bool byName = column == SortColumn::Name || column == SortColumn::Type;
+    auto less = [&](const Item& a, const Item& b) {
+        if (a.key != b.key) return (a.key < b.key) == ascending;
+        if (a.tie != b.tie) return byName ? (a.tie < b.tie) == ascending : a.tie < b.tie;
+        int c = nameKeys[a.index].compare(nameKeys[b.index]);
+        if (c == 0) c = store.Name(a.index).compare(store.Name(b.index));
+        if (c != 0) return byName ? (c < 0) == ascending : c < 0;
+        return a.index < b.index;
+    };
+    MergeSort(items, less, pool.get());
+
+    forSlices([&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) order[i] = items[i].index;
+    });
+    return order;
+}
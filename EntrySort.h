@@ -0,0 +1,53 @@
+/*
+    Description: Declare EntrySort, the row order of an EntryStore by column
+*/
+#ifndef ENTRYSORT_H
+#define ENTRYSORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DiskUsage.h"
+#include "EntryStore.h"
+
+enum class SortColumn : std::uint8_t { None, Name, Type, Size, Modified };
+
+/* Computes the display order of a listing without touching the store.
+                 - Keys are built once per sort from the raw columns: natural
+                   order name keys, integer sizes and raw mtimes; nothing is
+                   formatted or parsed while comparing
+                 - Every key carries a 64-bit prefix so most comparisons are
+                   a single integer compare
+                 - Listings of kParallelThreshold entries or more are sorted
+                   in chunks on a thread pool and merged in parallel rounds
+                 - Ties fall back to the name, so the order is total and the
+                   same on every run
+*/
+class EntrySort {
+public:
+    static constexpr std::size_t kParallelThreshold = 1 << 15;
+
+    /* Order the entries of store by a column
+    * @param store: entries to order
+    * @param column: key column; None gives store order
+    * @param ascending: false for largest, newest or last first
+    * @param dirTotals: directory sizes for the Size column, may be nullptr
+    * @param threads: sorting threads, 0 for one per CPU
+    * @return row to store index, a permutation of [0, store.Size())
+    */
+    static std::vector<std::size_t> Order(const EntryStore& store, SortColumn column, bool ascending,
+                                          const DirTotals* dirTotals = nullptr, unsigned threads = 0);
+
+    /* Build the natural order key of a name. Keys compare with memcmp the
+    * way names compare for people: ASCII case is folded and digit runs
+    * compare by value ("file9" < "file10").
+    * @param name
+    * @param out: receives the key (may contain zero bytes)
+    */
+    static void NaturalKey(std::string_view name, std::string& out);
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+    Description: Implementation of the columnar directory entry store.
+*/
+#include <algorithm>
+#include <functional>
+
+#include "EntryStore.h"
+/* Remove every entry, keeping capacity for the next listing
+*/
+void EntryStore::Clear() {
+    names_.clear();
+    nameEnd_.clear();
+    sizes_.clear();
+    mtimes_.clear();
+    types_.clear();
+    indexValid_ = false;
+}
+/* Reserve capacity ahead of a bulk load
+* @param n: expected number of entries
+* @param nameBytes: expected total length of all names
+*/
+void EntryStore::Reserve(std::size_t n, std::size_t nameBytes) {
+    names_.reserve(nameBytes);
+    nameEnd_.reserve(n);
+    sizes_.reserve(n);
+    mtimes_.reserve(n);
+    types_.reserve(n);
+}
+/* Append one entry to the end of the store
+* @param name: file name without any directory part
+* @param type: file, dir or unknown
+* @param size: size in bytes or kUnknownSize
+* @param mtimeNs: modified time in ns since the epoch or kUnknownTime
+*/
+void EntryStore::Append(std::string_view name, EntryType type,
+                        std::uint64_t size, std::int64_t mtimeNs) {
+    names_.append(name.data(), name.size());
+    nameEnd_.push_back(names_.size());
+    sizes_.push_back(size);
+    mtimes_.push_back(mtimeNs);
+    types_.push_back(type);
+    if (indexValid_) IndexInsert(static_cast<std::uint32_t>(types_.size() - 1));
+}
+/* Append all entries of another store, e.g. a batch from a scan
+* @param other: store to copy from
+*/
+void EntryStore::Append(const EntryStore& other) {
+    const std::uint64_t base = names_.size();
+    names_.append(other.names_);
+    nameEnd_.reserve(nameEnd_.size() + other.nameEnd_.size());
+    for (std::uint64_t end : other.nameEnd_) {
+        nameEnd_.push_back(base + end);
+    }
+    sizes_.insert(sizes_.end(), other.sizes_.begin(), other.sizes_.end());
+    mtimes_.insert(mtimes_.end(), other.mtimes_.begin(), other.mtimes_.end());
+    types_.insert(types_.end(), other.types_.begin(), other.types_.end());
+    indexValid_ = false;
+}
+/* Name of entry i, pointing into the arena
+* @param i: entry index
+* @return view valid until the store is modified
+*/
+std::string_view EntryStore::Name(std::size_t i) const {
+    const std::uint64_t begin = i == 0 ? 0 : nameEnd_[i - 1];
+    return std::string_view(names_.data() + begin, nameEnd_[i] - begin);
+}
+/* Heap usage of the arena and the column arrays
+* @return bytes
+*/
+std::size_t EntryStore::MemoryBytes() const {
+    return names_.capacity() +
+           nameEnd_.capacity() * sizeof(std::uint64_t) +
+           sizes_.capacity() * sizeof(std::uint64_t) +
+           mtimes_.capacity() * sizeof(std::int64_t) +
+           types_.capacity() * sizeof(EntryType) +
+           index_.capacity() * sizeof(std::uint32_t);
+}
+/* Overwrite the type, size and time of one entry
+* @param i: entry index
+* @param type
+* @param size
+* @param mtimeNs
+*/
+void EntryStore::Update(std::size_t i, EntryType type, std::uint64_t size, std::int64_t mtimeNs) {
+    types_[i] = type;
+    sizes_[i] = size;
+    mtimes_[i] = mtimeNs;
+}
+/* Remove a set of entries in one pass over the columns and the arena
+* @param indices: entries to drop
+*/
+void EntryStore::Remove(std::vector<std::size_t> indices) {
+    if (indices.empty()) return;
+    std::sort(indices.begin(), indices.end());
+    std::string names;
+    names.reserve(names_.size());
+    std::size_t out = 0;
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < Size(); ++i) {
+        while (next < indices.size() && indices[next] < i) ++next;
+        if (next < indices.size() && indices[next] == i) continue;
+        std::string_view name = Name(i);
+        names.append(name.data(), name.size());
+        nameEnd_[out] = names.size();
+        sizes_[out] = sizes_[i];
+        mtimes_[out] = mtimes_[i];
+        types_[out] = types_[i];
+        ++out;
+    }
+    names_.swap(names);
+    nameEnd_.resize(out);
+    sizes_.resize(out);
+    mtimes_.resize(out);
+    types_.resize(out);
+    indexValid_ = false;
+}
+/* Look up an entry by name through the hash index
+* @param name
+* @return index or npos
+*/
+std::size_t EntryStore::Find(std::string_view name) const {
+    if (!indexValid_) BuildIndex();
+    const std::size_t mask = index_.size() - 1;
+    for (std::size_t slot = std::hash<std::string_view>()(name) & mask;; slot = (slot + 1) & mask) {
+        const std::uint32_t v = index_[slot];
+        if (v == 0) return npos;
+        if (Name(v - 1) == name) return v - 1;
+    }
+}
+/* Size the index to twice the entry count (power of two) and fill it
+*/
+void EntryStore::BuildIndex() const {
+    std::size_t cap = 16;
+    while (cap < Size() * 2) cap *= 2;
+    index_.assign(cap, 0);
+    indexValid_ = true;
+    for (std::size_t i = 0; i < Size(); ++i) {
+        IndexInsert(static_cast<std::uint32_t>(i));
+    }
+}
+/* Insert entry i into the index, growing it past half full
+* @param i
+*/
+void EntryStore::IndexInsert(std::uint32_t i) const {
+    if (Size() * 2 > index_.size()) {
+        BuildIndex(); // Includes i
+        return;
+    }
+    const std::size_t mask = index_.size() - 1;
+    std::size_t slot = std::hash<std::string_view>()(Name(i)) & mask;
+    while (index_[slot] != 0) slot = (slot + 1) & mask;
+    index_[slot] = i + 1;
+}
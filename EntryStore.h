@@ -0,0 +1,70 @@
+/*
+    Description: Declare EntryStore, the compact columnar listing of a directory
+*/
+#ifndef ENTRYSTORE_H
+#define ENTRYSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class EntryType : std::uint8_t { File, Dir, Unknown };
+
+/* Column-oriented storage for the entries of one directory.
+                 - All names live back to back in a single string arena
+                 - Size, modified time and type are kept in parallel arrays
+                 - Nothing is formatted here; the list formats on demand
+*/
+class EntryStore {
+public:
+    static constexpr std::uint64_t kUnknownSize = UINT64_MAX;
+    static constexpr std::int64_t kUnknownTime = INT64_MIN;
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Drop all entries but keep the allocated capacity
+    void Clear();
+    // Reserve room for n entries with nameBytes of names in total
+    void Reserve(std::size_t n, std::size_t nameBytes);
+    // Append one entry. mtimeNs is nanoseconds since the Unix epoch
+    void Append(std::string_view name, EntryType type,
+                std::uint64_t size, std::int64_t mtimeNs);
+    // Append every entry of another store
+    void Append(const EntryStore& other);
+    // Replace the columns of entry i; the name stays
+    void Update(std::size_t i, EntryType type, std::uint64_t size, std::int64_t mtimeNs);
+    // Remove the given entries (any order, duplicates allowed) and compact
+    void Remove(std::vector<std::size_t> indices);
+    // Index of the entry with this name or npos. Builds a hash index on first use
+    std::size_t Find(std::string_view name) const;
+
+    std::size_t Size() const { return types_.size(); }
+    bool Empty() const { return types_.empty(); }
+    std::string_view Name(std::size_t i) const;
+    EntryType Type(std::size_t i) const { return types_[i]; }
+    std::uint64_t FileSize(std::size_t i) const { return sizes_[i]; }
+    std::int64_t MTime(std::size_t i) const { return mtimes_[i]; }
+    // Every name back to back, for scans over the whole listing
+    std::string_view Arena() const { return names_; }
+    // Offset in Arena() just past name i
+    std::uint64_t NameEnd(std::size_t i) const { return nameEnd_[i]; }
+
+    // Approximate heap bytes held by the store
+    std::size_t MemoryBytes() const;
+
+private:
+    void BuildIndex() const;
+    void IndexInsert(std::uint32_t i) const;
+
+    std::string names_;                 // Every name, no separators
+    std::vector<std::uint64_t> nameEnd_; // End offset of name i in names_
+    std::vector<std::uint64_t> sizes_;
+    std::vector<std::int64_t> mtimes_;
+    std::vector<EntryType> types_;
+    // Open addressing name index: slot holds entry + 1, 0 is empty
+    mutable std::vector<std::uint32_t> index_;
+    mutable bool indexValid_ = false;
+};
+
+#endif
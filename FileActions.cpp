@@ -0,0 +1,95 @@
+/*
+    Description: Implementation of the navigate and paste decisions.
+*/
+#include <algorithm>
+
+#include "FileActions.h"
+#include "FileOp.h"
+/* Look dir up in the cache against the stamp of dirStat
+* @param dir
+* @param dirStat
+* @param useCache
+* @param cache
+* @param now
+* @param stamp
+* @return the listing of a hit, else nullptr
+*/
+std::shared_ptr<const EntryStore> FileActions::CachedListing(const std::filesystem::path& dir,
+                                                             const FileStat& dirStat,
+                                                             bool useCache,
+                                                             DirCache& cache,
+                                                             DirStamp& now,
+                                                             DirStamp& stamp) {
+    // Taken before reading, so any change made during the load moves the stamp on
+    now = DirCache::Stamp(dirStat);
+    if (!useCache) {
+        cache.Invalidate(dir);
+        return nullptr;
+    }
+    return cache.Lookup(dir, now, stamp);
+}
+/* Stat each dest name once; the same stats serve the sync check
+* @param srcs
+* @param destDir
+* @param isCopy
+* @param cache
+* @return the plan
+*/
+PastePlan FileActions::PlanPaste(const std::vector<std::filesystem::path>& srcs,
+                                 const std::filesystem::path& destDir,
+                                 bool isCopy,
+                                 StatCache& cache) {
+    PastePlan plan;
+    for (const auto& src : srcs) {
+        if (cache.Get(destDir / src.filename()).exists) plan.existing.push_back(src);
+    }
+    // Folders pasted over copies of themselves can be synced instead
+    plan.syncable = isCopy && !plan.existing.empty();
+    for (const auto& src : plan.existing) {
+        if (!plan.syncable) break;
+        const FileStat srcStat = cache.Get(src);
+        const FileStat destStat = cache.Get(destDir / src.filename());
+        plan.syncable = srcStat.IsDir() && destStat.IsDir() && !destStat.SameFile(srcStat);
+    }
+    return plan;
+}
+/* Drop the existing sources unless they are overwritten
+* @param srcs
+* @param plan
+* @param overwrite
+* @return the sources to paste, in order
+*/
+std::vector<std::filesystem::path> FileActions::PasteSources(const std::vector<std::filesystem::path>& srcs,
+                                                             const PastePlan& plan,
+                                                             bool overwrite) {
+    std::vector<std::filesystem::path> out;
+    for (const auto& src : srcs) {
+        const bool skip = !overwrite &&
+                          std::find(plan.existing.begin(), plan.existing.end(), src) != plan.existing.end();
+        if (!skip) out.push_back(src);
+    }
+    return out;
+}
+/* Run the paste
+* @param srcs
+* @param destDir
+* @param overwrite
+* @param isCopy
+* @param options
+* @param stats
+* @param failures
+* @param ec
+* @return true if every item was pasted
+*/
+bool FileActions::Paste(const std::vector<std::filesystem::path>& srcs,
+                        const std::filesystem::path& destDir,
+                        bool overwrite,
+                        bool isCopy,
+                        const CopyOptions& options,
+                        CopyStats& stats,
+                        std::vector<PathError>& failures,
+                        std::error_code& ec) {
+    if (isCopy) return FileOp::CopyPaths(srcs, destDir, overwrite, options, stats, failures, ec);
+    // Across filesystems this becomes copy + fsync + delete
+    return FileOp::MovePaths(srcs, destDir, overwrite, options, stats, failures, ec);
+}
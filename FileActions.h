@@ -0,0 +1,69 @@
+/*
+    Description: Declare FileActions, the stat and decision logic behind the
+                 navigate and paste commands, kept free of wxWidgets so the
+                 syscall bench runs exactly what the UI runs
+*/
+#ifndef FILEACTIONS_H
+#define FILEACTIONS_H
+
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "CopyEngine.h"
+#include "DirCache.h"
+#include "EntryStore.h"
+#include "FileStat.h"
+
+// What a paste would run into before anything is asked
+struct PastePlan {
+    std::vector<std::filesystem::path> existing; // Sources whose name exists in the dest dir
+    bool syncable = false;  // Every existing one is a folder over another folder
+};
+
+class FileActions {
+public:
+    /* Entering a directory: the listing to show straight away, if the cache
+       has it for the stamp the directory has now
+    * @param dir
+    * @param dirStat: stat of dir the caller already took
+    * @param useCache: false for a reload, which also drops the cached listing
+    * @param cache
+    * @param now: receives the stamp of dirStat, for storing a fresh listing
+    * @param stamp: receives the stamp of a hit
+    * @return the cached listing, or nullptr when dir has to be read
+    */
+    static std::shared_ptr<const EntryStore> CachedListing(const std::filesystem::path& dir,
+                                                           const FileStat& dirStat,
+                                                           bool useCache,
+                                                           DirCache& cache,
+                                                           DirStamp& now,
+                                                           DirStamp& stamp);
+    /* Find which sources already exist in destDir and whether they can be synced
+    * @param srcs
+    * @param destDir
+    * @param isCopy: only copies can become a sync
+    * @param cache: shared with the paste job that follows
+    * @return the plan
+    */
+    static PastePlan PlanPaste(const std::vector<std::filesystem::path>& srcs,
+                               const std::filesystem::path& destDir,
+                               bool isCopy,
+                               StatCache& cache);
+    // The sources to paste: all with overwrite, else those not in plan.existing
+    static std::vector<std::filesystem::path> PasteSources(const std::vector<std::filesystem::path>& srcs,
+                                                           const PastePlan& plan,
+                                                           bool overwrite);
+    // Copy or move srcs into destDir (FileOp::CopyPaths or FileOp::MovePaths)
+    static bool Paste(const std::vector<std::filesystem::path>& srcs,
+                      const std::filesystem::path& destDir,
+                      bool overwrite,
+                      bool isCopy,
+                      const CopyOptions& options,
+                      CopyStats& stats,
+                      std::vector<PathError>& failures,
+                      std::error_code& ec);
+};
+
+#endif
@@ -0,0 +1,912 @@
+/*
+    Description: Implementation of the single file copy primitive.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <linux/magic.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/vfs.h>
+#endif
+
+#include "FileCopy.h"
+#include "Hash.h"
+#include "Trace.h"
+
+namespace {
+constexpr std::size_t kBufferSize = 1024 * 1024;
+constexpr std::size_t kChunk = 64 * 1024 * 1024; // Max bytes per kernel copy call
+
+/* Report copied bytes and stop at a pause or cancel
+* @return false if the copy should stop (ec set)
+*/
+bool AddProgress(OpProgress* progress, std::uint64_t n, std::error_code& ec) {
+    if (!progress) return true;
+    progress->bytes.fetch_add(n, std::memory_order_relaxed);
+    if (progress->Checkpoint()) return true;
+    ec = std::make_error_code(std::errc::operation_canceled);
+    return false;
+}
+
+std::error_code LastError() {
+    return std::error_code(errno, std::generic_category());
+}
+// Owns a file descriptor
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+// Errors that mean "this mechanism does not apply here", not a real failure
+bool IsUnsupported(int err) {
+    return err == ENOSYS || err == EOPNOTSUPP || err == ENOTSUP || err == EXDEV ||
+           err == EINVAL || err == ENOTTY || err == EBADF || err == ETXTBSY || err == EPERM;
+}
+/* procfs and sysfs make up their content on read: the reported size
+* (0, or a page) says nothing about how much there is
+* @param fd
+* @return true for a file on such a filesystem
+*/
+bool IsPseudoFile(int fd) {
+#if defined(__linux__)
+    struct statfs fs;
+    TRACE_COUNT(kSyscalls, 1);
+    if (::fstatfs(fd, &fs) != 0) return false;
+    return fs.f_type == PROC_SUPER_MAGIC || fs.f_type == SYSFS_MAGIC;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+/* Give dest the permissions and times of src as asked, then fsync it
+* @param destFd
+* @param st: stat of the source
+* @param options
+* @param ec
+* @return true on success
+*/
+bool FinishFile(int destFd, const struct stat& st, const FileCopy::Options& options, std::error_code& ec) {
+    TRACE_COUNT(kSyscalls, (options.preservePerms ? 1 : 0) + (options.preserveTimes ? 1 : 0) + (options.fsync ? 1 : 0));
+    if (options.preservePerms && ::fchmod(destFd, st.st_mode & 07777) != 0) {
+        ec = LastError();
+        return false;
+    }
+    if (options.preserveTimes) {
+#if defined(__APPLE__)
+        struct timespec times[2] = { st.st_atimespec, st.st_mtimespec };
+#else
+        struct timespec times[2] = { st.st_atim, st.st_mtim };
+#endif
+        if (::futimens(destFd, times) != 0) {
+            ec = LastError();
+            return false;
+        }
+    }
+    if (options.fsync && ::fsync(destFd) != 0) {
+        ec = LastError();
+        return false;
+    }
+    return true;
+}
+/* pread until n bytes or end of file
+* @return bytes read, -1 on error (errno set)
+*/
+ssize_t ReadFull(int fd, char* buffer, std::size_t n, std::uint64_t off) {
+    std::size_t got = 0;
+    while (got < n) {
+        const ssize_t r = ::pread(fd, buffer + got, n - got, static_cast<off_t>(off + got));
+        TRACE_COUNT(kSyscalls, 1);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (r == 0) break;
+        got += static_cast<std::size_t>(r);
+    }
+    TRACE_COUNT(kBytesRead, got);
+    return static_cast<ssize_t>(got);
+}
+/* pwrite all of buffer
+* @return true on success
+*/
+bool WriteFull(int fd, const char* buffer, std::size_t n, std::uint64_t off, std::error_code& ec) {
+    for (std::size_t done = 0; done < n;) {
+        const ssize_t w = ::pwrite(fd, buffer + done, n - done, static_cast<off_t>(off + done));
+        TRACE_COUNT(kSyscalls, 1);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            ec = LastError();
+            return false;
+        }
+        done += static_cast<std::size_t>(w);
+    }
+    TRACE_COUNT(kBytesWritten, n);
+    return true;
+}
+/* Copy [off, end) with pread/pwrite
+* @return true on success
+*/
+bool CopyRangeReadWrite(int srcFd, int destFd, std::uint64_t off, std::uint64_t end,
+                        OpProgress* progress, std::error_code& ec) {
+    thread_local std::unique_ptr<char[]> buffer(new char[kBufferSize]);
+    while (off < end) {
+        std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(kBufferSize, end - off));
+        ssize_t n = ::pread(srcFd, buffer.get(), want, static_cast<off_t>(off));
+        TRACE_COUNT(kSyscalls, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ec = LastError();
+            return false;
+        }
+        if (n == 0) {
+            // The source shrank under us; the size-long copy would end in zeros
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = ::pwrite(destFd, buffer.get() + done, n - done, static_cast<off_t>(off + done));
+            TRACE_COUNT(kSyscalls, 1);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                ec = LastError();
+                return false;
+            }
+            done += w;
+        }
+        off += static_cast<std::uint64_t>(n);
+        TRACE_COUNT(kBytesRead, static_cast<std::uint64_t>(n));
+        TRACE_COUNT(kBytesWritten, static_cast<std::uint64_t>(n));
+        if (!AddProgress(progress, static_cast<std::uint64_t>(n), ec)) return false;
+    }
+    return true;
+}
+/* Read to EOF regardless of the reported size (pseudo files report 0)
+* @return true on success
+*/
+bool CopyStream(int srcFd, int destFd, OpProgress* progress, std::error_code& ec) {
+    thread_local std::unique_ptr<char[]> buffer(new char[kBufferSize]);
+    for (;;) {
+        ssize_t n = ::read(srcFd, buffer.get(), kBufferSize);
+        TRACE_COUNT(kSyscalls, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ec = LastError();
+            return false;
+        }
+        if (n == 0) return true;
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = ::write(destFd, buffer.get() + done, n - done);
+            TRACE_COUNT(kSyscalls, 1);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                ec = LastError();
+                return false;
+            }
+            done += w;
+        }
+        TRACE_COUNT(kBytesRead, static_cast<std::uint64_t>(n));
+        TRACE_COUNT(kBytesWritten, static_cast<std::uint64_t>(n));
+        if (!AddProgress(progress, static_cast<std::uint64_t>(n), ec)) return false;
+    }
+}
+
+/* Two buffers shared by the thread that reads and hashes and a writer
+   thread, so hashing one buffer overlaps writing the other. Buffers are
+   written in the order they are pushed.
+*/
+class WritePipeline {
+public:
+    explicit WritePipeline(int fd) : fd_(fd) {
+        for (Slot& slot : slots_) slot.data.reset(new char[kBufferSize]);
+        writer_ = std::thread([this] { Run(); });
+    }
+    ~WritePipeline() {
+        std::error_code ignored;
+        Finish(ignored);
+    }
+    // Buffer to fill next; waits until its previous content is written
+    char* Next() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Slot& slot = slots_[next_];
+        ready_.wait(lock, [&] { return !slot.full; });
+        return slot.data.get();
+    }
+    // Queue n bytes of the buffer from Next for writing at off
+    void Push(std::size_t n, std::uint64_t off) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Slot& slot = slots_[next_];
+            slot.n = n;
+            slot.off = off;
+            slot.full = true;
+            next_ ^= 1;
+        }
+        ready_.notify_all();
+    }
+    // A write failed; pushing more is pointless
+    bool Failed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<bool>(error_);
+    }
+    /* Wait for the queued writes and stop the writer
+    * @return false with the first write error
+    */
+    bool Finish(std::error_code& ec) {
+        if (writer_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closing_ = true;
+            }
+            ready_.notify_all();
+            writer_.join();
+        }
+        ec = error_;
+        return !error_;
+    }
+
+private:
+    struct Slot {
+        std::unique_ptr<char[]> data;
+        std::size_t n = 0;
+        std::uint64_t off = 0;
+        bool full = false;
+    };
+    void Run() {
+        for (int i = 0;; i ^= 1) {
+            Slot& slot = slots_[i];
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [&] { return slot.full || closing_; });
+            if (!slot.full) return;
+            const bool skip = static_cast<bool>(error_);
+            lock.unlock();
+            std::error_code ec;
+            if (!skip) WriteFull(fd_, slot.data.get(), slot.n, slot.off, ec);
+            lock.lock();
+            if (ec) error_ = ec;
+            slot.full = false;
+            lock.unlock();
+            ready_.notify_all();
+        }
+    }
+
+    int fd_;
+    Slot slots_[2];
+    int next_ = 0;          // Slot the reader fills next
+    bool closing_ = false;
+    std::error_code error_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::thread writer_;
+};
+// Seconds since start, for hash and read-back accounting
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+/* Feed n zero bytes to a hash: a hole reads back as zeros
+*/
+void HashZeros(Xxh64& hash, std::uint64_t n) {
+    static const char zeros[64 * 1024] = {};
+    while (n > 0) {
+        const std::size_t len = static_cast<std::size_t>(std::min<std::uint64_t>(sizeof(zeros), n));
+        hash.Update(zeros, len);
+        n -= len;
+    }
+}
+/* Copy [off, end) through the file's pipeline, or inline without one,
+* hashing every buffer as it goes by
+* @param pipeline: writer shared by all extents of the file, may be nullptr
+* @return false on error; a failed write of the pipeline sets ec only at
+* its Finish
+*/
+bool CopyRangeHashed(int srcFd, int destFd, WritePipeline* pipeline, std::uint64_t off, std::uint64_t end,
+                     Xxh64& hash, double& hashSeconds, OpProgress* progress, std::error_code& ec) {
+    thread_local std::unique_ptr<char[]> single(new char[kBufferSize]);
+    while (off < end) {
+        char* buffer = pipeline ? pipeline->Next() : single.get();
+        const std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(kBufferSize, end - off));
+        const ssize_t n = ReadFull(srcFd, buffer, want, off);
+        if (n < 0) {
+            ec = LastError();
+            break;
+        }
+        if (static_cast<std::size_t>(n) < want) {
+            // The source shrank while being copied: what was hashed is not the file
+            ec = std::make_error_code(std::errc::io_error);
+            break;
+        }
+        const auto hashStart = std::chrono::steady_clock::now();
+        hash.Update(buffer, want);
+        hashSeconds += SecondsSince(hashStart);
+        if (pipeline) {
+            pipeline->Push(want, off);
+            if (pipeline->Failed()) break;
+        } else if (!WriteFull(destFd, buffer, want, off, ec)) {
+            break;
+        }
+        off += want;
+        if (!AddProgress(progress, want, ec)) break;
+    }
+    return !ec && !(pipeline && pipeline->Failed());
+}
+/* Read a pseudo file to EOF, hashing it (see CopyStream)
+* @return bytes copied, ec set on error
+*/
+std::uint64_t CopyStreamHashed(int srcFd, int destFd, Xxh64& hash, double& hashSeconds,
+                               OpProgress* progress, std::error_code& ec) {
+    thread_local std::unique_ptr<char[]> buffer(new char[kBufferSize]);
+    std::uint64_t off = 0;
+    for (;;) {
+        const ssize_t n = ::read(srcFd, buffer.get(), kBufferSize);
+        TRACE_COUNT(kSyscalls, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ec = LastError();
+            return off;
+        }
+        if (n == 0) return off;
+        TRACE_COUNT(kBytesRead, static_cast<std::uint64_t>(n));
+        const auto hashStart = std::chrono::steady_clock::now();
+        hash.Update(buffer.get(), static_cast<std::size_t>(n));
+        hashSeconds += SecondsSince(hashStart);
+        if (!WriteFull(destFd, buffer.get(), static_cast<std::size_t>(n), off, ec)) return off;
+        off += static_cast<std::uint64_t>(n);
+        if (!AddProgress(progress, static_cast<std::uint64_t>(n), ec)) return off;
+    }
+}
+/* Open a written file for reading from the device rather than from the
+* page cache that still holds what was just written
+* @param path
+* @param allowDirect: false after O_DIRECT reads were refused
+* @param direct: set when the cache is bypassed
+* @return fd, -1 on error (errno set)
+*/
+int OpenUncached(const std::filesystem::path& path, bool allowDirect, bool& direct) {
+    direct = false;
+#if defined(__linux__)
+    if (allowDirect) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_DIRECT);
+        if (fd >= 0) {
+            direct = true;
+            return fd;
+        }
+        if (errno != EINVAL) return -1; // tmpfs and some FUSE filesystems refuse O_DIRECT
+    }
+#endif
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) return -1;
+#if defined(__APPLE__)
+    direct = ::fcntl(fd, F_NOCACHE, 1) == 0;
+#elif defined(POSIX_FADV_DONTNEED)
+    // Flushed pages are clean; dropping them makes the reads go to the device
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    return fd;
+}
+/* Flush dest, read it back and hash it
+* @param destFd: the written file, to flush
+* @param dest: its path, reopened for the read-back
+* @param size: bytes expected
+* @param verify: bytesReadBack, readBackSeconds and direct are filled
+* @param ec
+* @return hash of what was read, ec set on error
+*/
+std::uint64_t ReadBack(int destFd, const std::filesystem::path& dest, std::uint64_t size,
+                       VerifyStats& verify, std::error_code& ec) {
+    const auto start = std::chrono::steady_clock::now();
+    Xxh64 hash;
+    if (::fdatasync(destFd) != 0) {
+        ec = LastError();
+        return 0;
+    }
+    FdGuard back{OpenUncached(dest, true, verify.direct)};
+    if (back.fd < 0) {
+        ec = LastError();
+        return 0;
+    }
+    // O_DIRECT wants aligned buffers; offsets stay multiples of kBufferSize
+    struct FreeDeleter { void operator()(char* p) const { std::free(p); } };
+    thread_local std::unique_ptr<char, FreeDeleter> buffer([] {
+        void* p = nullptr;
+        return static_cast<char*>(::posix_memalign(&p, 4096, kBufferSize) == 0 ? p : nullptr);
+    }());
+    if (!buffer) {
+        ec = std::make_error_code(std::errc::not_enough_memory);
+        return 0;
+    }
+    std::uint64_t off = 0;
+    while (off < size) {
+        const ssize_t n = ::pread(back.fd, buffer.get(), kBufferSize, static_cast<off_t>(off));
+        TRACE_COUNT(kSyscalls, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL && verify.direct) {
+                // The device wants a larger alignment; read through the cache instead
+                ::close(back.fd);
+                back.fd = OpenUncached(dest, false, verify.direct);
+                if (back.fd >= 0) continue;
+            }
+            ec = LastError();
+            return 0;
+        }
+        if (n == 0) break;
+        const std::size_t len = static_cast<std::size_t>(std::min<std::uint64_t>(static_cast<std::uint64_t>(n), size - off));
+        hash.Update(buffer.get(), len);
+        off += len;
+        TRACE_COUNT(kBytesRead, len);
+    }
+    verify.bytesReadBack = off;
+    verify.readBackSeconds = SecondsSince(start);
+    if (off != size) ec = std::make_error_code(std::errc::io_error);
+    return hash.Digest();
+}
+
+#if defined(__linux__)
+/* Copy [off, end) with copy_file_range
+* @param fellBack: set when the call is not supported or reads nothing, before anything was copied
+* @return true on success
+*/
+bool CopyRangeKernel(int srcFd, int destFd, std::uint64_t off, std::uint64_t end,
+                     OpProgress* progress, bool& fellBack, std::error_code& ec) {
+    fellBack = false;
+    bool copiedAny = false;
+    while (off < end) {
+        loff_t in = static_cast<loff_t>(off);
+        loff_t out = static_cast<loff_t>(off);
+        std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(kChunk, end - off));
+        ssize_t n = ::copy_file_range(srcFd, &in, destFd, &out, want, 0);
+        TRACE_COUNT(kSyscalls, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (!copiedAny && IsUnsupported(errno)) {
+                fellBack = true;
+                return true;
+            }
+            ec = LastError();
+            return false;
+        }
+        if (n == 0) {
+            // Nothing at all: a pseudo or FUSE file these calls cannot read,
+            // so let read/write try. Later it means the source shrank.
+            if (!copiedAny) {
+                fellBack = true;
+                return true;
+            }
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        copiedAny = true;
+        off += static_cast<std::uint64_t>(n);
+        TRACE_COUNT(kBytesRead, static_cast<std::uint64_t>(n));
+        TRACE_COUNT(kBytesWritten, static_cast<std::uint64_t>(n));
+        if (!AddProgress(progress, static_cast<std::uint64_t>(n), ec)) return false;
+    }
+    return true;
+}
+/* Copy [off, end) with sendfile
+* @param fellBack: set when the call is not supported or reads nothing, before anything was copied
+* @return true on success
+*/
+bool CopyRangeSendfile(int srcFd, int destFd, std::uint64_t off, std::uint64_t end,
+                       OpProgress* progress, bool& fellBack, std::error_code& ec) {
+    fellBack = false;
+    bool copiedAny = false;
+    if (::lseek(destFd, static_cast<off_t>(off), SEEK_SET) < 0) {
+        ec = LastError();
+        return false;
+    }
+    while (off < end) {
+        off_t in = static_cast<off_t>(off);
+        std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(kChunk, end - off));
+        ssize_t n = ::sendfile(destFd, srcFd, &in, want);
+        TRACE_COUNT(kSyscalls, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (!copiedAny && IsUnsupported(errno)) {
+                fellBack = true;
+                return true;
+            }
+            ec = LastError();
+            return false;
+        }
+        if (n == 0) {
+            // Nothing at all: a pseudo or FUSE file these calls cannot read,
+            // so let read/write try. Later it means the source shrank.
+            if (!copiedAny) {
+                fellBack = true;
+                return true;
+            }
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        copiedAny = true;
+        off += static_cast<std::uint64_t>(n);
+        TRACE_COUNT(kBytesRead, static_cast<std::uint64_t>(n));
+        TRACE_COUNT(kBytesWritten, static_cast<std::uint64_t>(n));
+        if (!AddProgress(progress, static_cast<std::uint64_t>(n), ec)) return false;
+    }
+    return true;
+}
+#endif
+}
+/* Name of a strategy
+* @param strategy
+* @return static string
+*/
+const char* CopyStrategyName(CopyStrategy strategy) {
+    switch (strategy) {
+    case CopyStrategy::Reflink: return "reflink";
+    case CopyStrategy::CopyFileRange: return "copy_file_range";
+    case CopyStrategy::Sendfile: return "sendfile";
+    case CopyStrategy::ReadWrite: return "read/write";
+    default: return "none";
+    }
+}
+/* Copy file data extent by extent, stepping down to slower mechanisms as needed
+* @param srcFd
+* @param destFd
+* @param size
+* @param progress
+* @param ec
+* @return strategy used
+*/
+CopyStrategy FileCopy::CopyData(int srcFd, int destFd, std::uint64_t size,
+                                OpProgress* progress, std::error_code& ec) {
+    ec.clear();
+#if defined(__linux__)
+    // Reflink shares the extents outright: instant and holes are kept
+    TRACE_COUNT(kSyscalls, size > 0 ? 1 : 0);
+    if (size > 0 && ::ioctl(destFd, FICLONE, srcFd) == 0) {
+        if (progress) progress->bytes.fetch_add(size, std::memory_order_relaxed);
+        return CopyStrategy::Reflink;
+    }
+    CopyStrategy strategy = CopyStrategy::CopyFileRange;
+#else
+    CopyStrategy strategy = CopyStrategy::ReadWrite;
+#endif
+    if (size == 0 || IsPseudoFile(srcFd)) {
+        // Pseudo files report no size, or a made-up one, but have content
+        return CopyStream(srcFd, destFd, progress, ec) ? CopyStrategy::ReadWrite : CopyStrategy::None;
+    }
+
+    std::uint64_t pos = 0;
+    while (pos < size) {
+        // Find the next data extent; without SEEK_DATA the file is one extent
+        std::uint64_t dataStart = pos;
+        std::uint64_t dataEnd = size;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+        off_t d = ::lseek(srcFd, static_cast<off_t>(pos), SEEK_DATA);
+        TRACE_COUNT(kSyscalls, d < 0 ? 1 : 2);
+        if (d < 0) {
+            if (errno == ENXIO) break; // Only a hole remains
+        } else {
+            off_t h = ::lseek(srcFd, d, SEEK_HOLE);
+            dataStart = static_cast<std::uint64_t>(d);
+            if (h > d) dataEnd = std::min<std::uint64_t>(size, static_cast<std::uint64_t>(h));
+        }
+#endif
+        if (dataStart >= size) break;
+
+        bool ok = false;
+        bool fellBack = true;
+#if defined(__linux__)
+        if (strategy == CopyStrategy::CopyFileRange) {
+            ok = CopyRangeKernel(srcFd, destFd, dataStart, dataEnd, progress, fellBack, ec);
+            if (fellBack) strategy = CopyStrategy::Sendfile;
+        }
+        if (fellBack && strategy == CopyStrategy::Sendfile) {
+            ok = CopyRangeSendfile(srcFd, destFd, dataStart, dataEnd, progress, fellBack, ec);
+            if (fellBack) strategy = CopyStrategy::ReadWrite;
+        }
+#endif
+        if (fellBack) {
+            strategy = CopyStrategy::ReadWrite;
+            ok = CopyRangeReadWrite(srcFd, destFd, dataStart, dataEnd, progress, ec);
+        }
+        if (!ok) return CopyStrategy::None;
+        pos = dataEnd;
+    }
+    // Extend over a trailing hole without writing it
+    TRACE_COUNT(kSyscalls, 1);
+    if (::ftruncate(destFd, static_cast<off_t>(size)) != 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    return strategy;
+}
+/* Open both files, copy the data and apply attributes
+* @param src
+* @param dest
+* @param options
+* @param bytes
+* @param ec
+* @return strategy used, None on error
+*/
+CopyStrategy FileCopy::CopyFile(const std::filesystem::path& src,
+                                const std::filesystem::path& dest,
+                                const Options& options,
+                                std::uint64_t& bytes,
+                                std::error_code& ec) {
+    TRACE_SCOPE_ARG(scope, kCopy, "CopyFile");
+    ec.clear();
+    bytes = 0;
+    // O_NONBLOCK keeps a FIFO from blocking the open; it has no effect on files
+    FdGuard in{::open(src.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK)};
+    if (in.fd < 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    struct stat st;
+    if (::fstat(in.fd, &st) != 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        ec = std::make_error_code(std::errc::not_supported);
+        return CopyStrategy::None;
+    }
+
+    const int createFlags = O_WRONLY | O_CREAT | O_CLOEXEC | (options.overwrite ? 0 : O_EXCL);
+    FdGuard out{::open(dest.c_str(), createFlags, st.st_mode & 07777)};
+    if (out.fd < 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    struct stat dst;
+    if (::fstat(out.fd, &dst) != 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    if (dst.st_dev == st.st_dev && dst.st_ino == st.st_ino) {
+        // Never truncate the source by copying it onto itself
+        ec = std::make_error_code(std::errc::file_exists);
+        return CopyStrategy::None;
+    }
+    TRACE_COUNT(kSyscalls, 7); // open, fstat and close of both files, ftruncate
+
+    if (options.progress) {
+        options.progress->totalBytes.fetch_add(static_cast<std::uint64_t>(st.st_size),
+                                               std::memory_order_relaxed);
+    }
+    CopyStrategy strategy = CopyStrategy::None;
+    if (::ftruncate(out.fd, 0) != 0) {
+        ec = LastError();
+    } else {
+        strategy = CopyData(in.fd, out.fd, static_cast<std::uint64_t>(st.st_size),
+                            options.progress, ec);
+    }
+    if (!ec) FinishFile(out.fd, st, options, ec);
+    if (ec) {
+        ::unlink(dest.c_str());
+        return CopyStrategy::None;
+    }
+    bytes = static_cast<std::uint64_t>(st.st_size);
+    TRACE_SET_ARG(scope, bytes);
+    TRACE_COUNT(kFiles, 1);
+    return strategy;
+}
+/* Compare src and dest chunk by chunk and write back only the blocks
+* that differ, coalescing neighbours into one write. Both files are read
+* whole, but for a file with a few changes almost nothing is written,
+* and extents shared with snapshots or reflinks stay shared.
+* @param src
+* @param dest
+* @param options: overwrite is implied; progress counts source bytes compared
+* @param stats
+* @param ec
+* @return true if dest now equals src
+*/
+bool FileCopy::UpdateFile(const std::filesystem::path& src,
+                          const std::filesystem::path& dest,
+                          const Options& options,
+                          DeltaStats& stats,
+                          std::error_code& ec) {
+    TRACE_SCOPE_ARG(scope, kCopy, "UpdateFile");
+    TRACE_COUNT(kSyscalls, 6); // open, fstat and close of both files
+    ec.clear();
+    stats = DeltaStats();
+    FdGuard in{::open(src.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK)};
+    if (in.fd < 0) {
+        ec = LastError();
+        return false;
+    }
+    FdGuard out{::open(dest.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK | O_NOFOLLOW)};
+    if (out.fd < 0) {
+        ec = LastError();
+        return false;
+    }
+    struct stat st;
+    struct stat dst;
+    if (::fstat(in.fd, &st) != 0 || ::fstat(out.fd, &dst) != 0) {
+        ec = LastError();
+        return false;
+    }
+    if (!S_ISREG(st.st_mode) || !S_ISREG(dst.st_mode)) {
+        ec = std::make_error_code(std::errc::not_supported);
+        return false;
+    }
+    if (dst.st_dev == st.st_dev && dst.st_ino == st.st_ino) return true;
+    if (dst.st_nlink > 1) {
+        // Writing in place would change every other name of dest too
+        ec = std::make_error_code(std::errc::too_many_links);
+        return false;
+    }
+    const std::uint64_t size = static_cast<std::uint64_t>(st.st_size);
+    const std::uint64_t destSize = static_cast<std::uint64_t>(dst.st_size);
+#if defined(__linux__)
+    ::posix_fadvise(in.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    ::posix_fadvise(out.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    if (options.progress) options.progress->totalBytes.fetch_add(size, std::memory_order_relaxed);
+    thread_local std::unique_ptr<char[]> source(new char[kBufferSize]);
+    thread_local std::unique_ptr<char[]> target(new char[kBufferSize]);
+    for (std::uint64_t off = 0; off < size;) {
+        const std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(kBufferSize, size - off));
+        const ssize_t n = ReadFull(in.fd, source.get(), want, off);
+        if (n < 0) {
+            ec = LastError();
+            return false;
+        }
+        if (static_cast<std::size_t>(n) < want) {
+            // The source shrank while being read; the next sync sees it again
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        ssize_t m = 0;
+        if (off < destSize) {
+            m = ReadFull(out.fd, target.get(), static_cast<std::size_t>(std::min<std::uint64_t>(want, destSize - off)), off);
+            if (m < 0) {
+                ec = LastError();
+                return false;
+            }
+        }
+        std::size_t runStart = 0;
+        std::size_t runEnd = 0;  // Pending run of changed blocks [runStart, runEnd)
+        auto flush = [&]() {
+            if (runEnd == runStart) return true;
+            stats.bytesWritten += runEnd - runStart;
+            return WriteFull(out.fd, source.get() + runStart, runEnd - runStart, off + runStart, ec);
+        };
+        for (std::size_t block = 0; block < want; block += kDeltaBlock) {
+            const std::size_t len = std::min(kDeltaBlock, want - block);
+            ++stats.blocks;
+            const bool same = block + len <= static_cast<std::size_t>(m) &&
+                              std::memcmp(source.get() + block, target.get() + block, len) == 0;
+            if (same) continue;
+            ++stats.changedBlocks;
+            if (runEnd != block) {
+                if (!flush()) return false;
+                runStart = block;
+            }
+            runEnd = block + len;
+        }
+        if (!flush()) return false;
+        stats.bytesCompared += static_cast<std::uint64_t>(m);
+        off += want;
+        if (!AddProgress(options.progress, want, ec)) return false;
+    }
+    if (destSize != size && ::ftruncate(out.fd, static_cast<off_t>(size)) != 0) {
+        ec = LastError();
+        return false;
+    }
+    TRACE_SET_ARG(scope, stats.bytesWritten);
+    TRACE_COUNT(kFiles, 1);
+    return FinishFile(out.fd, st, options, ec);
+}
+/* Copy extent by extent like CopyData, but always through user space so
+* every byte is hashed; holes are hashed as zeros and stay holes. Then
+* read the copy back and compare.
+* @param src
+* @param dest
+* @param options
+* @param bytes
+* @param verify
+* @param ec
+* @return ReadWrite, None on error
+*/
+CopyStrategy FileCopy::CopyFileVerified(const std::filesystem::path& src,
+                                        const std::filesystem::path& dest,
+                                        const Options& options,
+                                        std::uint64_t& bytes,
+                                        VerifyStats& verify,
+                                        std::error_code& ec) {
+    TRACE_SCOPE_ARG(scope, kCopy, "CopyFileVerified");
+    ec.clear();
+    bytes = 0;
+    verify = VerifyStats();
+    FdGuard in{::open(src.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK)};
+    if (in.fd < 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    struct stat st;
+    if (::fstat(in.fd, &st) != 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        ec = std::make_error_code(std::errc::not_supported);
+        return CopyStrategy::None;
+    }
+    const int createFlags = O_WRONLY | O_CREAT | O_CLOEXEC | (options.overwrite ? 0 : O_EXCL);
+    FdGuard out{::open(dest.c_str(), createFlags, st.st_mode & 07777)};
+    if (out.fd < 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    struct stat dst;
+    if (::fstat(out.fd, &dst) != 0) {
+        ec = LastError();
+        return CopyStrategy::None;
+    }
+    if (dst.st_dev == st.st_dev && dst.st_ino == st.st_ino) {
+        ec = std::make_error_code(std::errc::file_exists);
+        return CopyStrategy::None;
+    }
+    std::uint64_t size = static_cast<std::uint64_t>(st.st_size);
+    if (options.progress) options.progress->totalBytes.fetch_add(size, std::memory_order_relaxed);
+#if defined(__linux__)
+    ::posix_fadvise(in.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    TRACE_COUNT(kSyscalls, 7); // open, fstat and close of both files, ftruncate
+
+    Xxh64 hash;
+    if (::ftruncate(out.fd, 0) != 0) {
+        ec = LastError();
+    } else if (size == 0) {
+        size = CopyStreamHashed(in.fd, out.fd, hash, verify.hashSeconds, options.progress, ec);
+    } else {
+        // One writer thread for the whole file, however many extents it has
+        std::unique_ptr<WritePipeline> pipeline;
+        if (size > kBufferSize) pipeline.reset(new WritePipeline(out.fd));
+        for (std::uint64_t pos = 0; pos < size && !ec;) {
+            std::uint64_t dataStart = pos;
+            std::uint64_t dataEnd = size;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+            off_t d = ::lseek(in.fd, static_cast<off_t>(pos), SEEK_DATA);
+            if (d < 0) {
+                if (errno == ENXIO) dataStart = size; // Only a hole remains
+            } else {
+                off_t h = ::lseek(in.fd, d, SEEK_HOLE);
+                dataStart = std::min<std::uint64_t>(size, static_cast<std::uint64_t>(d));
+                if (h > d) dataEnd = std::min<std::uint64_t>(size, static_cast<std::uint64_t>(h));
+            }
+#endif
+            HashZeros(hash, dataStart - pos);
+            if (dataStart >= size) break;
+            if (!CopyRangeHashed(in.fd, out.fd, pipeline.get(), dataStart, dataEnd, hash, verify.hashSeconds,
+                                 options.progress, ec)) {
+                break;
+            }
+            pos = dataEnd;
+        }
+        std::error_code writeEc;
+        if (pipeline && !pipeline->Finish(writeEc) && !ec) ec = writeEc;
+        if (!ec && ::ftruncate(out.fd, static_cast<off_t>(size)) != 0) ec = LastError();
+    }
+    if (!ec) {
+        verify.hash = hash.Digest();
+        const std::uint64_t readBack = ReadBack(out.fd, dest, size, verify, ec);
+        if (!ec && readBack != verify.hash) ec = std::make_error_code(std::errc::io_error);
+    }
+    // Attributes last: reading back may bump the access time
+    if (!ec) FinishFile(out.fd, st, options, ec);
+    if (ec) {
+        ::unlink(dest.c_str());
+        return CopyStrategy::None;
+    }
+    bytes = size;
+    TRACE_SET_ARG(scope, bytes);
+    TRACE_COUNT(kFiles, 1);
+    return CopyStrategy::ReadWrite;
+}
@@ -0,0 +1,130 @@
+/*
+    Description: Declare FileCopy, the single file copy primitive
+*/
+#ifndef FILECOPY_H
+#define FILECOPY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+
+#include "OpProgress.h"
+
+// How the data of a file was transferred, fastest first
+enum class CopyStrategy : std::uint8_t {
+    None,           // Nothing was copied (error)
+    Reflink,        // ioctl(FICLONE): shared extents, no data moved
+    CopyFileRange,  // copy_file_range: in-kernel copy, may be offloaded
+    Sendfile,       // sendfile: in-kernel copy through the page cache
+    ReadWrite       // User space read/write with a large buffer
+};
+constexpr int kCopyStrategyCount = 5;
+
+// Result of FileCopy::UpdateFile
+struct DeltaStats {
+    std::uint64_t blocks = 0;        // Blocks of kDeltaBlock bytes compared
+    std::uint64_t changedBlocks = 0; // Of which rewritten
+    std::uint64_t bytesCompared = 0; // Bytes read from dest to compare against
+    std::uint64_t bytesWritten = 0;
+};
+
+// Result of FileCopy::CopyFileVerified
+struct VerifyStats {
+    std::uint64_t hash = 0;          // XXH64 of the data, as read from the source and from the copy
+    std::uint64_t bytesReadBack = 0; // Copy bytes read to check it
+    double hashSeconds = 0.0;        // Hashing the source data while it was copied
+    double readBackSeconds = 0.0;    // Flushing the copy and reading it back
+    bool direct = false;             // Read back past the page cache (O_DIRECT, F_NOCACHE)
+};
+
+// Short lower case name of a strategy for logs and status messages
+const char* CopyStrategyName(CopyStrategy strategy);
+
+/* Copies one regular file using the fastest mechanism the system accepts.
+                 - Linux: FICLONE, then copy_file_range, then sendfile,
+                   then a read/write loop; each step falls back to the next
+                 - Only the data extents reported by SEEK_DATA/SEEK_HOLE are
+                   copied, so holes stay holes in the destination
+                 - UpdateFile brings an existing copy up to date in place,
+                   rewriting only the blocks that differ
+                 - CopyFileVerified hashes the data on its way through and
+                   checks the copy by reading it back from the device
+*/
+class FileCopy {
+public:
+    static constexpr std::size_t kDeltaBlock = 64 * 1024;
+
+    struct Options {
+        bool overwrite = false;     // Replace an existing dest (never src itself)
+        bool preservePerms = true;  // Copy permission bits
+        bool preserveTimes = true;  // Copy access and modification times
+        bool fsync = false;         // fsync dest before returning
+        OpProgress* progress = nullptr; // bytes/totalBytes bumped; pause and cancel honored
+    };
+
+    /* Copy src to dest
+    * @param src: regular file
+    * @param dest: destination file
+    * @param options
+    * @param bytes: receives the logical size copied
+    * @param ec: error, a partially written dest is removed
+    * @return strategy used for the data, None on error
+    */
+    static CopyStrategy CopyFile(const std::filesystem::path& src,
+                                 const std::filesystem::path& dest,
+                                 const Options& options,
+                                 std::uint64_t& bytes,
+                                 std::error_code& ec);
+
+    /* Copy src to dest and prove the copy. The data goes through user
+    * space: each buffer is hashed while the previous one is being written
+    * by a second thread. The copy is then flushed and read back bypassing
+    * the page cache where the filesystem allows it, and its hash compared.
+    * @param src: regular file
+    * @param dest: destination file
+    * @param options: as for CopyFile
+    * @param bytes: receives the logical size copied
+    * @param verify: receives the hash and what checking cost
+    * @param ec: io_error when the copy does not read back as the source
+    *            was read; dest is removed on any error
+    * @return ReadWrite, None on error
+    */
+    static CopyStrategy CopyFileVerified(const std::filesystem::path& src,
+                                         const std::filesystem::path& dest,
+                                         const Options& options,
+                                         std::uint64_t& bytes,
+                                         VerifyStats& verify,
+                                         std::error_code& ec);
+
+    /* Copy size bytes of data between two open files, keeping holes
+    * @param srcFd: readable regular file
+    * @param destFd: writable, empty regular file
+    * @param size: bytes to copy
+    * @param progress: optional; bytes bumped as data is copied, checked
+    *                  between chunks (ec is operation_canceled on cancel)
+    * @param ec
+    * @return strategy used, None on error
+    */
+    static CopyStrategy CopyData(int srcFd, int destFd, std::uint64_t size,
+                                 OpProgress* progress, std::error_code& ec);
+
+    /* Make dest equal to src in place, writing only the kDeltaBlock blocks
+    * that differ, then truncate or extend it to src's size. Not atomic: an
+    * interrupted update leaves dest partly new, with a fresh mtime, so the
+    * next quick-check sync picks it up again.
+    * @param src: regular file
+    * @param dest: existing regular file with a single link
+    * @param options: permissions, times and fsync as in CopyFile
+    * @param stats: receives what was compared and written
+    * @param ec: too_many_links when dest has other names
+    * @return true on success
+    */
+    static bool UpdateFile(const std::filesystem::path& src,
+                           const std::filesystem::path& dest,
+                           const Options& options,
+                           DeltaStats& stats,
+                           std::error_code& ec);
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+    Description: Implementation of the virtual file list.
+*/
+#include <algorithm>
+#include <ctime>
+
+#include "FileListCtrl.h"
+#include "Trace.h"
+/* Convert a machine time to a readable time for Date Modified
+* @param mtimeNs: nanoseconds since the Unix epoch
+* @return wxStirng: Formatted time
+*/
+static wxString FormatFileTime(std::int64_t mtimeNs) {
+    std::time_t cftime = static_cast<std::time_t>(mtimeNs / 1000000000);
+    std::tm* timeinfo = std::localtime(&cftime);
+    if (!timeinfo) return "N/A";
+    wxString formattedTime = wxString::Format("%04d-%02d-%02d %02d:%02d:%02d",
+        timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday,
+        timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
+    return formattedTime;
+}
+/* Create an empty report list in virtual mode
+* @param parent
+* @param id
+*/
+FileListCtrl::FileListCtrl(wxWindow* parent, wxWindowID id)
+    : wxListCtrl(parent, id, wxDefaultPosition, wxDefaultSize,
+                 wxLC_REPORT | wxLC_VIRTUAL)
+{
+}
+/* Point the list at a store and resize it; only visible rows get redrawn
+* @param store
+* @param hasParentRow
+* @param resort
+*/
+void FileListCtrl::SetEntries(const EntryStore* store, bool hasParentRow, bool resort) {
+    TRACE_SCOPE(kUi, resort ? "SetEntries (sort)" : "SetEntries");
+    store_ = store;
+    hasParentRow_ = hasParentRow;
+    if (resort) Rebuild(true, true);
+    else MatchAppended();
+    SetItemCount(static_cast<long>(VisibleCount()) + (hasParentRow_ ? 1 : 0));
+    Refresh();
+}
+/* Point the size column at a set of directory totals
+* @param totals
+*/
+void FileListCtrl::SetDirTotals(const DirTotals* totals) {
+    dirTotals_ = totals;
+    RefreshRows();
+}
+/* Switch the row order and move the header arrow
+* @param column
+* @param ascending
+*/
+void FileListCtrl::SetSort(SortColumn column, bool ascending) {
+    sortColumn_ = column;
+    sortAscending_ = ascending;
+#if wxCHECK_VERSION(3, 1, 6)
+    if (column == SortColumn::None) RemoveSortIndicator();
+    else ShowSortIndicator(ColumnOf(column), ascending);
+#endif
+    Rebuild(true, false);
+    Refresh();
+}
+/* Header column of a sort column
+* @param column
+* @return 0 name, 1 type, 2 size, 3 date modified, -1 for None
+*/
+int FileListCtrl::ColumnOf(SortColumn column) {
+    switch (column) {
+    case SortColumn::Name: return 0;
+    case SortColumn::Type: return 1;
+    case SortColumn::Size: return 2;
+    case SortColumn::Modified: return 3;
+    case SortColumn::None: break;
+    }
+    return -1;
+}
+/* Sort column of a header column
+* @param column
+* @return SortColumn::None for an unknown column
+*/
+SortColumn FileListCtrl::SortColumnAt(int column) {
+    switch (column) {
+    case 0: return SortColumn::Name;
+    case 1: return SortColumn::Type;
+    case 2: return SortColumn::Size;
+    case 3: return SortColumn::Modified;
+    default: return SortColumn::None;
+    }
+}
+/* Re-sort if the order depends on directory totals and redraw the visible rows
+*/
+void FileListCtrl::RefreshRows() {
+    if (sortColumn_ == SortColumn::Size) Rebuild(true, false);
+    Refresh();
+}
+/* Match the names against a new pattern; the sort order is reused
+* @param mode
+* @param pattern
+*/
+void FileListCtrl::SetFilter(MatchMode mode, const std::string& pattern) {
+    if (mode == filterMode_ && pattern == filterPattern_) return;
+    filterMode_ = mode;
+    filterPattern_ = pattern;
+    Rebuild(false, true);
+    SetItemCount(static_cast<long>(VisibleCount()) + (hasParentRow_ ? 1 : 0));
+    Refresh();
+}
+/* Number of entry rows
+* @return rows without ".."
+*/
+std::size_t FileListCtrl::VisibleCount() const {
+    if (!store_) return 0;
+    return IsFiltered() ? rows_.size() : store_->Size();
+}
+/* Collect the store indices of the selected rows
+* @return indices
+*/
+std::vector<std::size_t> FileListCtrl::SelectedEntries() const {
+    std::vector<std::size_t> selected;
+    long row = -1;
+    std::size_t index = 0;
+    while ((row = GetNextItem(row, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED)) != -1) {
+        if (RowToEntry(row, index)) selected.push_back(index);
+    }
+    return selected;
+}
+/* Sort with EntrySort and filter with StrSearch as asked, then lay out
+* the rows: sorted entries first, entries appended since the sort after
+* them in store order. The selection and focus are carried over by store
+* index, so they stay on the same entries as long as the store was only
+* appended to; entries the filter hides lose it.
+* @param resort
+* @param rematch
+*/
+void FileListCtrl::Rebuild(bool resort, bool rematch) {
+    const std::size_t n = store_ ? store_->Size() : 0;
+    if (order_.empty() && rows_.empty() && match_.empty() &&
+        sortColumn_ == SortColumn::None && !IsFiltered()) {
+        return; // Store order, nothing to undo
+    }
+    const std::vector<std::size_t> selected = SelectedEntries();
+    std::size_t focused = n;
+    const long focusRow = GetNextItem(-1, wxLIST_NEXT_ALL, wxLIST_STATE_FOCUSED);
+    if (focusRow != -1 && !RowToEntry(focusRow, focused)) focused = n;
+
+    if (resort || order_.size() > n) {
+        order_.clear();
+        rank_.clear();
+        if (sortColumn_ != SortColumn::None && n > 0) {
+            order_ = EntrySort::Order(*store_, sortColumn_, sortAscending_, dirTotals_);
+            rank_.resize(n);
+            for (std::size_t row = 0; row < n; ++row) rank_[order_[row]] = row;
+        }
+    }
+    if (rematch || match_.size() > n) {
+        match_.clear();
+        if (IsFiltered() && n > 0) StrSearch::Match(*store_, filterMode_, filterPattern_, match_);
+    }
+    rows_.clear();
+    if (IsFiltered()) {
+        // Scatter only the hits into sort order, then compact in one
+        // sequential pass; walking order_ and probing match_ would miss
+        // the cache on every row
+        std::vector<std::uint8_t> hitAt(n, 0);
+        for (std::size_t index = 0; index < match_.size(); ++index) {
+            if (match_[index]) hitAt[Rank(index)] = 1;
+        }
+        rows_.resize(n);
+        std::size_t count = 0;
+        for (std::size_t rank = 0; rank < n; ++rank) {
+            rows_[count] = rank < order_.size() ? order_[rank] : rank;
+            count += hitAt[rank];
+        }
+        rows_.resize(count);
+    }
+    SetItemCount(static_cast<long>(VisibleCount()) + (hasParentRow_ ? 1 : 0));
+
+    if (!selected.empty()) {
+        SetItemState(-1, 0, wxLIST_STATE_SELECTED);
+        for (std::size_t index : selected) {
+            const long row = EntryToRow(index);
+            if (row != -1) SetItemState(row, wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED);
+        }
+    }
+    if (focused < n) {
+        const long row = EntryToRow(focused);
+        if (row != -1) SetItemState(row, wxLIST_STATE_FOCUSED, wxLIST_STATE_FOCUSED);
+    }
+}
+/* Filter entries a batch appended. Their ranks are above every sorted
+* entry, so matches go at the end of rows_ and it stays in rank order.
+*/
+void FileListCtrl::MatchAppended() {
+    if (!IsFiltered() || !store_) return;
+    const std::size_t n = store_->Size();
+    for (std::size_t index = match_.size(); index < n; ++index) {
+        const bool hit = StrSearch::MatchName(filterMode_, filterPattern_, store_->Name(index));
+        match_.push_back(hit ? 1 : 0);
+        if (hit) rows_.push_back(index);
+    }
+}
+/* Find the row of a store index: its rank when unfiltered, a binary
+* search of rows_ by rank otherwise
+* @param index
+* @return row, -1 if hidden
+*/
+long FileListCtrl::EntryToRow(std::size_t index) const {
+    const long offset = hasParentRow_ ? 1 : 0;
+    if (!IsFiltered()) return static_cast<long>(Rank(index)) + offset;
+    if (index >= match_.size() || !match_[index]) return -1;
+    const std::size_t rank = Rank(index);
+    auto found = std::lower_bound(rows_.begin(), rows_.end(), rank,
+                                  [this](std::size_t row, std::size_t r) { return Rank(row) < r; });
+    if (found == rows_.end() || *found != index) return -1;
+    return static_cast<long>(found - rows_.begin()) + offset;
+}
+/* Translate a list row into a store index
+* @param row
+* @param outIndex
+* @return true if the row is a real entry
+*/
+bool FileListCtrl::RowToEntry(long row, std::size_t& outIndex) const {
+    if (hasParentRow_) {
+        if (row == 0) return false;
+        --row;
+    }
+    if (!store_ || row < 0 || row >= static_cast<long>(VisibleCount())) {
+        return false;
+    }
+    // Rows appended since the last sort are still in store order
+    const std::size_t r = static_cast<std::size_t>(row);
+    if (IsFiltered()) outIndex = rows_[r];
+    else outIndex = r < order_.size() ? order_[r] : r;
+    if (outIndex >= store_->Size()) return false;
+    return true;
+}
+/* Format a single cell. Called by wx for visible rows only
+* @param item: row
+* @param column: 0 name, 1 type, 2 size, 3 date modified
+* @return cell text
+*/
+wxString FileListCtrl::OnGetItemText(long item, long column) const {
+    TRACE_TIME(kFormat);
+    if (IsParentRow(item)) {
+        return column == 0 ? wxString("..") : column == 1 ? wxString("Dir") : wxString();
+    }
+    std::size_t i = 0;
+    if (!RowToEntry(item, i)) return wxString();
+
+    const EntryType type = store_->Type(i);
+    switch (column) {
+    case 0: {
+        std::string_view name = store_->Name(i);
+        return wxString(name.data(), wxConvFile, name.size());
+    }
+    case 1:
+        if (type == EntryType::Unknown) return "N/A";
+        return type == EntryType::Dir ? "Dir" : "File";
+    case 2: {
+        if (type == EntryType::Unknown) return "N/A";
+        if (type == EntryType::Dir) {
+            if (!dirTotals_) return wxString();
+            auto found = dirTotals_->find(std::string(store_->Name(i)));
+            if (found == dirTotals_->end()) return "...";
+            // "~" for a cached total, which changes deep below may have outdated
+            return wxString::Format(found->second.partial ? "%s%llu+ bytes" : "%s%llu bytes",
+                                    found->second.cached ? "~" : "",
+                                    static_cast<unsigned long long>(found->second.bytes));
+        }
+        const std::uint64_t size = store_->FileSize(i);
+        if (size == EntryStore::kUnknownSize) return "N/A";
+        return wxString::Format("%llu bytes", static_cast<unsigned long long>(size));
+    }
+    case 3: {
+        const std::int64_t mt = store_->MTime(i);
+        if (type == EntryType::Unknown || mt == EntryStore::kUnknownTime) return "N/A";
+        return FormatFileTime(mt);
+    }
+    default:
+        return wxString();
+    }
+}
@@ -0,0 +1,102 @@
+/*
+    Description: Declare FileListCtrl, the virtual list showing an EntryStore
+*/
+#ifndef FILELISTCTRL_H
+#define FILELISTCTRL_H
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+#include <vector>
+
+#include "DiskUsage.h"
+#include "EntrySort.h"
+#include "EntryStore.h"
+#include "StrSearch.h"
+
+/* Report list in virtual mode. Rows are never inserted; wx asks for the
+   text of visible cells only and it is formatted from the EntryStore.
+   Row 0 is the ".." entry when the directory has a parent.
+   Rows can be shown in a sorted order without touching the store; the
+   selection follows its entries when the order changes.
+   A name filter hides non-matching rows. The sort order is kept apart
+   from the visible rows, so changing the filter never re-sorts.
+*/
+class FileListCtrl : public wxListCtrl {
+    public:
+        FileListCtrl(wxWindow* parent, wxWindowID id);
+
+        /* Show the given store. The store must outlive the list or be
+        * replaced by another SetEntries call.
+        * @param store: entries to display, nullptr for an empty list
+        * @param hasParentRow: true to show ".." as the first row
+        * @param resort: false to leave new rows at the end until a later call
+        */
+        void SetEntries(const EntryStore* store, bool hasParentRow, bool resort = true);
+
+        /* Show directory totals in the size column. Directories without a
+        * total show "..." while totals is set, nothing otherwise.
+        * @param totals: must outlive the list, nullptr to hide them
+        */
+        void SetDirTotals(const DirTotals* totals);
+        /* Order the rows by a column and mark its header. Only the order
+        * changes; the store and the filesystem are not touched.
+        * @param column: SortColumn::None for store order
+        * @param ascending: false for descending
+        */
+        void SetSort(SortColumn column, bool ascending);
+        SortColumn SortedBy() const { return sortColumn_; }
+        bool SortAscending() const { return sortAscending_; }
+        // Header column showing a sort column, -1 for None
+        static int ColumnOf(SortColumn column);
+        // Sort column of a header column
+        static SortColumn SortColumnAt(int column);
+        // Redraw after the totals changed; re-sorts when sorted by size
+        void RefreshRows();
+        /* Show only the entries whose names match. The ".." row stays.
+        * @param mode
+        * @param pattern: empty to show every entry
+        */
+        void SetFilter(MatchMode mode, const std::string& pattern);
+        bool IsFiltered() const { return !filterPattern_.empty(); }
+        // Entries shown, without the ".." row
+        std::size_t VisibleCount() const;
+
+        /* Map a row to an index in the store
+        * @param row: list row
+        * @param outIndex: output store index
+        * @return: false for the ".." row or an out of range row
+        */
+        bool RowToEntry(long row, std::size_t& outIndex) const;
+        bool IsParentRow(long row) const { return hasParentRow_ && row == 0; }
+        // Row showing a store index, -1 if the filter hides it
+        long EntryToRow(std::size_t index) const;
+
+    protected:
+        wxString OnGetItemText(long item, long column) const override;
+
+    private:
+        // Store indices of the selected rows
+        std::vector<std::size_t> SelectedEntries() const;
+        /* Rebuild the visible rows, keeping the selected entries selected
+        * @param resort: recompute order_ for the sort column
+        * @param rematch: recompute match_ for the filter
+        */
+        void Rebuild(bool resort, bool rematch);
+        // Filter entries appended since the last Rebuild
+        void MatchAppended();
+        // Position of a store index in sorted order; appended entries follow in store order
+        std::size_t Rank(std::size_t index) const { return index < rank_.size() ? rank_[index] : index; }
+
+        const EntryStore* store_ = nullptr;
+        const DirTotals* dirTotals_ = nullptr;
+        bool hasParentRow_ = false;
+        SortColumn sortColumn_ = SortColumn::None;
+        bool sortAscending_ = true;
+        MatchMode filterMode_ = MatchMode::Substring;
+        std::string filterPattern_;
+        std::vector<std::size_t> order_;  // Sorted store indices; empty for store order
+        std::vector<std::size_t> rank_;   // Inverse of order_
+        std::vector<std::uint8_t> match_; // Store index to 1 if it passes the filter
+        std::vector<std::size_t> rows_;   // Filtered row (without "..") to store index, by rank
+};
+
+#endif
@@ -3,14 +3,31 @@
     Date: Jan 26, 2026
     Description: Implementation of file operations used by wxWidgets file manager.
 */
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
 #include <filesystem>
+#include <string>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "FileOp.h"
+#include "Reclaimer.h"
+#include "Trace.h"
 /* Check if a path exists.
 * @param p The path to check.
 * @param ec Error code to capture any filesystem errors.
 * @return true if the path exists, false otherwise.
 */
 bool FileOp::Exists(const std::filesystem::path& p, std::error_code& ec){
+    TRACE_TIME(kStat);
+    TRACE_COUNT(kSyscalls, 1);
+    TRACE_COUNT(kStats, 1);
     return std::filesystem::exists(p, ec);
 }
 /* Check if a path is a directory.
@@ -19,6 +36,9 @@ bool FileOp::Exists(const std::filesystem::path& p, std::error_code& ec){
 * @return true if the path is a directory, false otherwise.
 */
 bool FileOp::IsDir(const std::filesystem::path& p, std::error_code& ec){
+    TRACE_TIME(kStat);
+    TRACE_COUNT(kSyscalls, 1);
+    TRACE_COUNT(kStats, 1);
     return std::filesystem::is_directory(p, ec);
 }
 /* Create a directory at the specified path.
@@ -31,6 +51,7 @@ bool FileOp::CreateDir(const std::filesystem::path& p, std::error_code& ec){
     return !ec;
 }
 /* Rename a file or directory from oldPath to newPath.
+* An existing newPath is swapped out atomically and deleted in the background.
 * @param oldPath The current path of the file or directory.
 * @param newPath The new path for the file or directory.
 * @param overwrite If true, overwrite the destination if it exists.
@@ -41,11 +62,35 @@ bool FileOp::RenamePath(const std::filesystem::path& oldPath,
                         const std::filesystem::path& newPath,
                         bool overwrite,
                         std::error_code& ec){
+    StatCache cache;
+    return RenamePath(oldPath, newPath, overwrite, cache, ec);
+}
+/* Rename with the stats of the surrounding action. Both paths are dropped
+* from the cache afterwards.
+* @param oldPath The current path of the file or directory.
+* @param newPath The new path for the file or directory.
+* @param overwrite If true, overwrite the destination if it exists.
+* @param cache Stats already taken, e.g. by the overwrite check.
+* @param ec Error code to capture any filesystem errors.
+* @return true if the rename was successful, false otherwise.
+*/
+bool FileOp::RenamePath(const std::filesystem::path& oldPath,
+                        const std::filesystem::path& newPath,
+                        bool overwrite,
+                        StatCache& cache,
+                        std::error_code& ec){
+    TRACE_SCOPE(kOps, "RenamePath");
     ec.clear();
-    if (overwrite && std::filesystem::exists(newPath, ec)) {
-        std::filesystem::remove_all(newPath, ec);
-        if (ec) return false;
+    const bool replace = overwrite && NeedsReplace(oldPath, newPath, cache);
+    cache.Invalidate(oldPath);
+    cache.Invalidate(newPath);
+    if (replace) {
+        std::filesystem::path displaced;
+        if (!SwapInto(oldPath, newPath, displaced, ec)) return false;
+        if (!displaced.empty()) Reclaimer::Instance().Enqueue(displaced);
+        return true;
     }
+    TRACE_COUNT(kSyscalls, 1);
     std::filesystem::rename(oldPath, newPath, ec);
     return !ec;
 }
@@ -55,9 +100,22 @@ bool FileOp::RenamePath(const std::filesystem::path& oldPath,
 * @return true if the deletion was successful, false otherwise.
 */
 bool FileOp::DeletePath(const std::filesystem::path& p, std::error_code& ec){
-    ec.clear();
-    std::filesystem::remove_all(p, ec);
-    return !ec;
+    DeleteStats stats;
+    return DeletePath(p, DeleteOptions(), stats, ec);
+}
+/* Delete a file or directory tree with DeleteEngine.
+* @param p The path to delete.
+* @param options Concurrency and progress options.
+* @param stats Receives the number of entries removed and the first error path.
+* @param ec Error code to capture any filesystem errors.
+* @return true if the deletion was successful, false otherwise.
+*/
+bool FileOp::DeletePath(const std::filesystem::path& p,
+                        const DeleteOptions& options,
+                        DeleteStats& stats,
+                        std::error_code& ec){
+    TRACE_SCOPE(kOps, "DeletePath");
+    return DeleteEngine::DeleteTree(p, options, stats, ec);
 }
 /* Copy a file or directory from source to destination.
 * @param src The source path.
@@ -70,21 +128,63 @@ bool FileOp::CopyPath(const std::filesystem::path& src,
                       const std::filesystem::path& dest,
                       bool overwrite,
                       std::error_code& ec) {
-    ec.clear();
-    // If overwrite is true and destination exists, remove it first
-    if (overwrite && std::filesystem::exists(dest, ec)) {
-        std::filesystem::remove_all(dest, ec);
-        if (ec) return false;
+    CopyStats stats;
+    return CopyPath(src, dest, overwrite, CopyOptions(), stats, ec);
+}
+/* Point the checksums of a copy made under a staging name at the name it
+* was swapped in as.
+* @param checksums Manifest entries of the copy.
+* @param staging The staging path the copy was made at.
+* @param dest The path it now has.
+*/
+static void RebaseChecksums(std::vector<FileChecksum>& checksums,
+                            const std::filesystem::path& staging,
+                            const std::filesystem::path& dest) {
+    for (FileChecksum& sum : checksums) {
+        const std::filesystem::path rel = sum.path.lexically_relative(staging);
+        sum.path = rel == "." ? dest : dest / rel;
     }
-    // Dir or file copy
-    if (std::filesystem::is_directory(src, ec)) {
-        std::filesystem::copy(src, dest, std::filesystem::copy_options::recursive, ec);
-    } else {
-        auto option = overwrite ? std::filesystem::copy_options::overwrite_existing
-                     : std::filesystem::copy_options::none;
-        std::filesystem::copy_file(src, dest, option, ec);
+}
+/* Copy a file or directory from source to destination.
+* Directories are copied by CopyEngine on a thread pool.
+* @param src The source path.
+* @param dest The destination path.
+* @param overwrite If true, overwrite the destination if it exists.
+* @param options Concurrency and preservation options.
+* @param stats Receives file/byte counts and elapsed time.
+* @param ec Error code to capture any filesystem errors.
+* @return true if the copy was successful, false otherwise.
+*/
+bool FileOp::CopyPath(const std::filesystem::path& src,
+                      const std::filesystem::path& dest,
+                      bool overwrite,
+                      const CopyOptions& options,
+                      CopyStats& stats,
+                      std::error_code& ec) {
+    TRACE_SCOPE(kOps, "CopyPath");
+    ec.clear();
+    stats = CopyStats();
+    StatCache localCache;
+    StatCache& cache = options.statCache ? *options.statCache : localCache;
+    const FileStat srcStat = cache.Get(src);
+    const bool replace = overwrite && NeedsReplace(src, dest, cache);
+    cache.Invalidate(dest);
+    // If overwrite is true and destination exists, build the copy next to
+    // it and swap it in; the old content is deleted in the background
+    if (replace) {
+        const std::filesystem::path staging = StagingPath(dest);
+        std::filesystem::path displaced;
+        std::error_code cleanupEc;
+        if (!CopyNew(src, srcStat, staging, options, stats, ec) ||
+            !SwapInto(staging, dest, displaced, ec)) {
+            std::filesystem::remove_all(staging, cleanupEc);
+            return false;
+        }
+        RebaseChecksums(stats.checksums, staging, dest);
+        Reclaimer::Instance().Enqueue(displaced);
+        return true;
     }
-    return !ec;
+    return CopyNew(src, srcStat, dest, options, stats, ec);
 }
 /* Move a file or directory from source to destination.
 * @param src The source path.
@@ -97,13 +197,207 @@ bool FileOp::MovePath(const std::filesystem::path& src,
                       const std::filesystem::path& dest,
                       bool overwrite,
                       std::error_code& ec) {
-    if (overwrite && std::filesystem::exists(dest, ec)) {
-        std::filesystem::remove_all(dest, ec);
-        if (ec) return false;
+    CopyStats stats;
+    return MovePath(src, dest, overwrite, CopyOptions(), stats, ec);
+}
+/* Move a file or directory from source to destination.
+* If src and dest are on different filesystems the move becomes a copy
+* followed by deletion of the source.
+* @param src The source path.
+* @param dest The destination path.
+* @param overwrite If true, overwrite the destination if it exists.
+* @param options Copy options used for a cross-filesystem move.
+* @param stats Receives copy stats for a cross-filesystem move.
+* @param ec Error code to capture any filesystem errors.
+* @return true if the move was successful, false otherwise.
+*/
+bool FileOp::MovePath(const std::filesystem::path& src,
+                      const std::filesystem::path& dest,
+                      bool overwrite,
+                      const CopyOptions& options,
+                      CopyStats& stats,
+                      std::error_code& ec) {
+    TRACE_SCOPE(kOps, "MovePath");
+    ec.clear();
+    stats = CopyStats();
+    StatCache localCache;
+    StatCache& cache = options.statCache ? *options.statCache : localCache;
+    const bool replace = overwrite && NeedsReplace(src, dest, cache);
+    cache.Invalidate(dest); // src stays cached for a copy across devices
+    if (replace) {
+        std::filesystem::path displaced;
+        if (SwapInto(src, dest, displaced, ec)) {
+            if (!displaced.empty()) Reclaimer::Instance().Enqueue(displaced);
+            cache.Invalidate(src);
+            return true;
+        }
+        if (ec != std::errc::cross_device_link) return false;
+        // Different filesystems: stage a durable copy beside dest, swap it
+        // in, and only then remove the source
+        const std::filesystem::path staging = StagingPath(dest);
+        std::error_code cleanupEc;
+        if (!CopyForMove(src, staging, options, stats, cache, ec)) return false;
+        if (!SwapInto(staging, dest, displaced, ec)) {
+            std::filesystem::remove_all(staging, cleanupEc);
+            return false;
+        }
+        RebaseChecksums(stats.checksums, staging, dest);
+        Reclaimer::Instance().Enqueue(displaced);
+        cache.Invalidate(src);
+        return DeletePath(src, ec);
     }
+    TRACE_COUNT(kSyscalls, 1);
     std::filesystem::rename(src, dest, ec);
+    if (ec == std::errc::cross_device_link) {
+        return MoveAcrossDevices(src, dest, options, stats, cache, ec);
+    }
+    cache.Invalidate(src);
     return !ec;
 }
+/* Replace a file with a hard link to another, e.g. to fold a duplicate.
+* The link is made under a staging name and renamed over dest, so dest is
+* never missing; the old content goes once its last link does.
+* @param target The file to link to.
+* @param dest The file to replace; must be on the same filesystem.
+* @param ec Error code to capture any filesystem errors.
+* @return true if dest is now a link to target.
+*/
+bool FileOp::LinkPath(const std::filesystem::path& target,
+                      const std::filesystem::path& dest,
+                      std::error_code& ec) {
+    TRACE_SCOPE(kOps, "LinkPath");
+    ec.clear();
+    if (std::filesystem::equivalent(target, dest, ec)) return true;
+    if (ec) return false;
+    if (!std::filesystem::is_regular_file(std::filesystem::symlink_status(dest, ec))) {
+        if (!ec) ec = std::make_error_code(std::errc::invalid_argument);
+        return false;
+    }
+    const std::filesystem::path staging = StagingPath(dest);
+    std::filesystem::create_hard_link(target, staging, ec);
+    if (ec) return false;
+    std::filesystem::rename(staging, dest, ec);
+    if (ec) {
+        std::error_code cleanupEc;
+        std::filesystem::remove(staging, cleanupEc);
+        return false;
+    }
+    return true;
+}
+/* Delete a selection as one batch.
+* @param paths The paths to delete.
+* @param options Concurrency and progress options.
+* @param stats Receives the number of entries removed.
+* @param failures Receives every item that could not be removed.
+* @param ec The first failure.
+* @return true if every path was removed.
+*/
+bool FileOp::DeletePaths(const std::vector<std::filesystem::path>& paths,
+                         const DeleteOptions& options,
+                         DeleteStats& stats,
+                         std::vector<PathError>& failures,
+                         std::error_code& ec) {
+    TRACE_SCOPE_ARG(scope, kOps, "DeletePaths");
+    TRACE_SET_ARG(scope, paths.size());
+    const bool ok = DeleteEngine::DeleteTrees(paths, options, stats, failures);
+    ec = ok ? std::error_code() : failures.front().ec;
+    return ok;
+}
+/* Copy a selection into a directory as one batch. Items that need no
+* replacing share one pipelined CopyEngine pass; replacements go through
+* CopyPath one by one so each is swapped in atomically.
+* @param srcs The paths to copy.
+* @param destDir The directory to copy into.
+* @param overwrite If true, replace existing entries of the same name.
+* @param options Concurrency and progress options.
+* @param stats Receives totals over all items.
+* @param failures Receives every item that failed.
+* @param ec The first failure.
+* @return true if every item was copied.
+*/
+bool FileOp::CopyPaths(const std::vector<std::filesystem::path>& srcs,
+                       const std::filesystem::path& destDir,
+                       bool overwrite,
+                       const CopyOptions& options,
+                       CopyStats& stats,
+                       std::vector<PathError>& failures,
+                       std::error_code& ec) {
+    TRACE_SCOPE_ARG(scope, kOps, "CopyPaths");
+    TRACE_SET_ARG(scope, srcs.size());
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> fresh;
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> replace;
+    // The checks below and the CopyPath calls share one set of stats
+    StatCache localCache;
+    CopyOptions itemOptions = options;
+    if (!itemOptions.statCache) itemOptions.statCache = &localCache;
+    StatCache& cache = *itemOptions.statCache;
+    for (const auto& src : srcs) {
+        std::filesystem::path dest = destDir / src.filename();
+        if (overwrite && NeedsReplace(src, dest, cache)) replace.emplace_back(src, std::move(dest));
+        else fresh.emplace_back(src, std::move(dest));
+    }
+    CopyEngine::CopyTrees(fresh, options, stats, failures);
+    for (const auto& item : fresh) cache.Invalidate(item.second);
+    for (const auto& [src, dest] : replace) {
+        if (options.progress && !options.progress->Checkpoint()) {
+            failures.push_back(PathError{src, std::make_error_code(std::errc::operation_canceled)});
+            break;
+        }
+        CopyStats one;
+        std::error_code itemEc;
+        if (!CopyPath(src, dest, true, itemOptions, one, itemEc)) {
+            failures.push_back(PathError{one.errorPath.empty() ? src : one.errorPath, itemEc});
+        }
+        stats.Add(one);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.errorPath = failures.empty() ? std::filesystem::path() : failures.front().path;
+    ec = failures.empty() ? std::error_code() : failures.front().ec;
+    return failures.empty();
+}
+/* Move a selection into a directory as one batch. Same-filesystem items
+* are renames; the rest are copied durably and then deleted by MovePath.
+* @param srcs The paths to move.
+* @param destDir The directory to move into.
+* @param overwrite If true, replace existing entries of the same name.
+* @param options Copy options used for cross-filesystem items.
+* @param stats Receives copy totals over all items.
+* @param failures Receives every item that failed.
+* @param ec The first failure.
+* @return true if every item was moved.
+*/
+bool FileOp::MovePaths(const std::vector<std::filesystem::path>& srcs,
+                       const std::filesystem::path& destDir,
+                       bool overwrite,
+                       const CopyOptions& options,
+                       CopyStats& stats,
+                       std::vector<PathError>& failures,
+                       std::error_code& ec) {
+    TRACE_SCOPE_ARG(scope, kOps, "MovePaths");
+    TRACE_SET_ARG(scope, srcs.size());
+    const auto start = std::chrono::steady_clock::now();
+    failures.clear();
+    stats = CopyStats();
+    for (const auto& src : srcs) {
+        if (options.progress && !options.progress->Checkpoint()) {
+            failures.push_back(PathError{src, std::make_error_code(std::errc::operation_canceled)});
+            break;
+        }
+        CopyStats one;
+        std::error_code itemEc;
+        if (!MovePath(src, destDir / src.filename(), overwrite, options, one, itemEc)) {
+            failures.push_back(PathError{one.errorPath.empty() ? src : one.errorPath, itemEc});
+        } else if (options.progress && one.files == 0) {
+            options.progress->files.fetch_add(1); // A rename counts as one item
+        }
+        stats.Add(one);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.errorPath = failures.empty() ? std::filesystem::path() : failures.front().path;
+    ec = failures.empty() ? std::error_code() : failures.front().ec;
+    return failures.empty();
+}
 /* Remove a file or directory if it exists.
 * @param p The path to remove.
 * @param ec Error code to capture any filesystem errors.  
@@ -114,4 +408,229 @@ bool FileOp::RemoveIfExists(const std::filesystem::path& p, std::error_code& ec)
     if (!std::filesystem::exists(p, ec) || ec) return !ec;
     std::filesystem::remove_all(p, ec);
     return !ec;
-}
\ No newline at end of file
+}
+/* Move between filesystems: copy, fsync the copy, then delete the source.
+* The source is only touched once the destination is safely on disk.
+* @param src The source path.
+* @param dest The destination path, must not exist.
+* @param options Copy options; fsync is forced on.
+* @param stats Receives copy stats.
+* @param cache Stats of the move; src is dropped once deleted.
+* @param ec Error code to capture any filesystem errors.
+* @return true if the move was successful, false otherwise.
+*/
+bool FileOp::MoveAcrossDevices(const std::filesystem::path& src,
+                               const std::filesystem::path& dest,
+                               const CopyOptions& options,
+                               CopyStats& stats,
+                               StatCache& cache,
+                               std::error_code& ec) {
+    if (!CopyForMove(src, dest, options, stats, cache, ec)) return false;
+    cache.Invalidate(src);
+    return DeletePath(src, ec);
+}
+/* Durable copy for a move: symlinks are recreated, everything is fsynced
+* including dest's parent. If the copy fails the partial dest is removed.
+* @param src The source path.
+* @param dest The destination path, must not exist.
+* @param options Copy options; fsync is forced on.
+* @param stats Receives copy stats.
+* @param cache Stats of the move; src is taken from it.
+* @param ec Error code to capture any filesystem errors.
+* @return true if dest is complete and on disk.
+*/
+bool FileOp::CopyForMove(const std::filesystem::path& src,
+                         const std::filesystem::path& dest,
+                         const CopyOptions& options,
+                         CopyStats& stats,
+                         StatCache& cache,
+                         std::error_code& ec) {
+    ec.clear();
+    CopyOptions durable = options;
+    durable.fsync = true;
+    const auto start = std::chrono::steady_clock::now();
+    const FileStat srcStat = cache.Get(src);
+    if (!srcStat.exists) {
+        ec = srcStat.ec;
+        return false;
+    }
+    // Anything at dest from here on is ours to clean up on failure; ask the
+    // disk, not the cache
+    if (FileStat::Of(dest).exists) {
+        ec = std::make_error_code(std::errc::file_exists);
+        return false;
+    }
+
+    bool copied = false;
+    if (srcStat.symlink) {
+        auto target = std::filesystem::read_symlink(src, ec);
+        if (!ec) std::filesystem::create_symlink(target, dest, ec);
+        copied = !ec;
+        if (copied) stats.links = 1;
+    } else {
+        copied = CopyNew(src, srcStat, dest, durable, stats, ec);
+    }
+    if (!copied) {
+        std::error_code cleanupEc;
+        std::filesystem::remove_all(dest, cleanupEc);
+        return false;
+    }
+    // The new entry itself lives in the parent directory
+    auto parent = dest.parent_path().empty() ? std::filesystem::path(".") : dest.parent_path();
+    if (!CopyEngine::SyncDir(parent, ec)) return false;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+/* Copy src to a dest that does not exist yet; dirs go through CopyEngine.
+* @param src The source path.
+* @param srcStat The stat of src, which decides between dir and file copy.
+* @param dest The destination path.
+* @param options Copy options.
+* @param stats Receives copy stats.
+* @param ec Error code to capture any filesystem errors.
+* @return true if the copy was successful, false otherwise.
+*/
+bool FileOp::CopyNew(const std::filesystem::path& src,
+                     const FileStat& srcStat,
+                     const std::filesystem::path& dest,
+                     const CopyOptions& options,
+                     CopyStats& stats,
+                     std::error_code& ec) {
+    ec.clear();
+    if (!srcStat.exists) {
+        ec = srcStat.ec;
+        return false;
+    }
+    // Dir or file copy
+    if (srcStat.IsDir()) {
+        return CopyEngine::CopyTree(src, dest, options, stats, ec);
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t bytes = 0;
+    VerifyStats verify;
+    CopyStrategy used = CopyEngine::CopyFile(src, dest, false, options, bytes, verify, ec);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (used != CopyStrategy::None) {
+        stats.files = 1;
+        stats.bytes = bytes;
+        stats.strategyFiles[static_cast<int>(used)] = 1;
+        if (options.verify) stats.AddVerified(dest, verify, stats.seconds);
+        if (options.progress) options.progress->files.fetch_add(1);
+    }
+    return !ec;
+}
+/* Whether an overwrite has something to replace: dest exists and is not
+* src itself (a rename to the same name, or a case-only rename).
+* A symlink is compared as the link itself, as lstat sees it: a link at
+* dest that points to src is replaced, not taken for src. A dangling
+* symlink at dest exists and is replaced too.
+* @param src The path that will end up at dest.
+* @param dest The destination path.
+* @param cache Stats of the action; both paths usually are in it already.
+* @return true if dest must be swapped out.
+*/
+bool FileOp::NeedsReplace(const std::filesystem::path& src, const std::filesystem::path& dest,
+                          StatCache& cache) {
+    const FileStat destStat = cache.Get(dest);
+    if (!destStat.exists) return false;
+    const FileStat srcStat = cache.Get(src);
+    if (!destStat.symlink && !srcStat.symlink) return !destStat.SameFile(srcStat);
+    // FileStat describes the target of a link; only the links themselves tell
+    TRACE_COUNT(kSyscalls, 2);
+    TRACE_COUNT(kStats, 2);
+    struct stat destLink;
+    struct stat srcLink;
+    if (::lstat(dest.c_str(), &destLink) != 0 || ::lstat(src.c_str(), &srcLink) != 0) return true;
+    return destLink.st_dev != srcLink.st_dev || destLink.st_ino != srcLink.st_ino;
+}
+/* Hidden sibling name used to build new content or park old content.
+* @param p The path the staging name is for.
+* @return A path in the same directory that does not exist yet.
+*/
+std::filesystem::path FileOp::StagingPath(const std::filesystem::path& p) {
+    static std::atomic<unsigned> counter{0};
+    const std::string name = "." + p.filename().string() + ".fm-" +
+                             std::to_string(static_cast<long>(::getpid())) + "-" +
+                             std::to_string(counter.fetch_add(1));
+    return p.parent_path() / name;
+}
+/* Recognize a name produced by StagingPath (".<name>.fm-<pid>-<n>")
+* @param name A bare file name.
+* @return true if it looks like a staging name.
+*/
+bool FileOp::IsStagingName(std::string_view name) {
+    if (name.size() < 2 || name[0] != '.') return false;
+    const std::size_t tag = name.rfind(".fm-");
+    if (tag == std::string_view::npos || tag == 0) return false;
+    const std::string_view rest = name.substr(tag + 4);
+    const std::size_t dash = rest.find('-');
+    if (dash == 0 || dash == std::string_view::npos || dash + 1 == rest.size()) return false;
+    return rest.find_first_not_of("0123456789-") == std::string_view::npos;
+}
+/* Staging names normally live for one operation; a crash leaves them
+* behind. The pid in the name tells whether their owner is still running.
+* @param dir The directory holding the entry.
+* @param name A bare file name, e.g. from a listing.
+* @return true if it is a stale staging name, now queued on the Reclaimer.
+*/
+bool FileOp::ReclaimIfStale(const std::filesystem::path& dir, std::string_view name) {
+    if (!IsStagingName(name)) return false;
+    const std::string_view rest = name.substr(name.rfind(".fm-") + 4);
+    long pid = 0;
+    std::from_chars(rest.data(), rest.data() + rest.find('-'), pid);
+    if (pid <= 0 || pid == static_cast<long>(::getpid())) return false;
+    // Signal 0 only probes; EPERM means it runs as another user
+    if (::kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH) return false;
+    Reclaimer::Instance().Enqueue(dir / std::string(name));
+    return true;
+}
+/* Atomically put replacement at dest. With RENAME_EXCHANGE the two entries
+* trade places in one step, and the old content, now at the replacement's
+* name, is moved on to a staging name; otherwise dest is parked under a
+* staging name first and restored if the second rename fails.
+* @param replacement The new content.
+* @param dest The path to replace.
+* @param displaced Receives the staging name the old content of dest now
+* has, for the Reclaimer; empty if it could not be moved off the
+* replacement's name, where it is then left alone.
+* @param ec Error code to capture any filesystem errors.
+* @return true if dest now holds the replacement.
+*/
+bool FileOp::SwapInto(const std::filesystem::path& replacement,
+                      const std::filesystem::path& dest,
+                      std::filesystem::path& displaced,
+                      std::error_code& ec) {
+    ec.clear();
+#if defined(__linux__) && defined(RENAME_EXCHANGE)
+    TRACE_COUNT(kSyscalls, 1);
+    if (::renameat2(AT_FDCWD, replacement.c_str(), AT_FDCWD, dest.c_str(), RENAME_EXCHANGE) == 0) {
+        displaced = replacement;
+        if (IsStagingName(replacement.filename().native())) return true;
+        // Do not leave it under a visible name: the Reclaimer deletes
+        // whatever is at the path it gets, and only staging names are ours
+        const std::filesystem::path parked = StagingPath(dest);
+        TRACE_COUNT(kSyscalls, 1);
+        std::error_code parkEc;
+        std::filesystem::rename(replacement, parked, parkEc);
+        if (parkEc) displaced.clear();
+        else displaced = parked;
+        return true;
+    }
+    if (errno != EINVAL && errno != ENOSYS && errno != ENOTSUP && errno != EOPNOTSUPP) {
+        ec.assign(errno, std::generic_category());
+        return false;
+    }
+#endif
+    const std::filesystem::path parked = StagingPath(dest);
+    TRACE_COUNT(kSyscalls, 2);
+    std::filesystem::rename(dest, parked, ec);
+    if (ec) return false;
+    std::filesystem::rename(replacement, dest, ec);
+    if (ec) {
+        std::error_code undoEc;
+        std::filesystem::rename(parked, dest, undoEc);
+        return false;
+    }
+    displaced = parked;
+    return true;
+}
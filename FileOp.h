@@ -7,7 +7,13 @@
 #define FILEOP_H
 
 #include <filesystem>
+#include <string_view>
 #include <system_error>
+#include <vector>
+
+#include "CopyEngine.h"
+#include "DeleteEngine.h"
+#include "FileStat.h"
 
 class FileOp {
 public:
@@ -22,22 +28,114 @@ public:
                            const std::filesystem::path& newPath,
                            bool overwrite,
                            std::error_code& ec);
+    // Same, reusing and updating the stats of the caller's action
+    static bool RenamePath(const std::filesystem::path& oldPath,
+                           const std::filesystem::path& newPath,
+                           bool overwrite,
+                           StatCache& cache,
+                           std::error_code& ec);
     // Delete a file or dir by recursion
     static bool DeletePath(const std::filesystem::path& p, std::error_code& ec);
+    // Same, with delete engine options and stats (first error path included)
+    static bool DeletePath(const std::filesystem::path& p,
+                           const DeleteOptions& options,
+                           DeleteStats& stats,
+                           std::error_code& ec);
     // Copy a file from src to dest, dir by recursion
     static bool CopyPath(const std::filesystem::path& src,
                          const std::filesystem::path& dest,
                          bool overwrite,
                          std::error_code& ec);
+    // Same, with copy engine options and throughput stats; options.statCache
+    // lets it reuse stats the caller took
+    static bool CopyPath(const std::filesystem::path& src,
+                         const std::filesystem::path& dest,
+                         bool overwrite,
+                         const CopyOptions& options,
+                         CopyStats& stats,
+                         std::error_code& ec);
     // Move a file or dir from src to dest  
     static bool MovePath(const std::filesystem::path& src,
                          const std::filesystem::path& dest,
                          bool overwrite,
                          std::error_code& ec);
+    // Same; across filesystems it copies with options, fsyncs, then deletes src
+    static bool MovePath(const std::filesystem::path& src,
+                         const std::filesystem::path& dest,
+                         bool overwrite,
+                         const CopyOptions& options,
+                         CopyStats& stats,
+                         std::error_code& ec);
+    // Replace the file dest with a hard link to target, in one rename
+    static bool LinkPath(const std::filesystem::path& target,
+                         const std::filesystem::path& dest,
+                         std::error_code& ec);
+    /* Batch versions: one call for a whole selection. Every item is tried;
+    * failures are collected per item instead of stopping the batch (a
+    * cancel still stops it). ec is the first failure.
+    */
+    // Delete every path on one shared pool
+    static bool DeletePaths(const std::vector<std::filesystem::path>& paths,
+                            const DeleteOptions& options,
+                            DeleteStats& stats,
+                            std::vector<PathError>& failures,
+                            std::error_code& ec);
+    // Copy every src into destDir under its own name
+    static bool CopyPaths(const std::vector<std::filesystem::path>& srcs,
+                          const std::filesystem::path& destDir,
+                          bool overwrite,
+                          const CopyOptions& options,
+                          CopyStats& stats,
+                          std::vector<PathError>& failures,
+                          std::error_code& ec);
+    // Move every src into destDir under its own name
+    static bool MovePaths(const std::vector<std::filesystem::path>& srcs,
+                          const std::filesystem::path& destDir,
+                          bool overwrite,
+                          const CopyOptions& options,
+                          CopyStats& stats,
+                          std::vector<PathError>& failures,
+                          std::error_code& ec);
+    // True for the hidden temporary names used while overwriting
+    static bool IsStagingName(std::string_view name);
+    // Queue a staging name whose process is gone (a crash left it) for deletion
+    static bool ReclaimIfStale(const std::filesystem::path& dir, std::string_view name);
 
 private:
     // Remove a path if exists
     static bool RemoveIfExists(const std::filesystem::path& p, std::error_code& ec);
+    // Copy src to dest durably and remove src; used when rename gives EXDEV
+    static bool MoveAcrossDevices(const std::filesystem::path& src,
+                                  const std::filesystem::path& dest,
+                                  const CopyOptions& options,
+                                  CopyStats& stats,
+                                  StatCache& cache,
+                                  std::error_code& ec);
+    // The copy half of MoveAcrossDevices, fsynced and cleaned up on failure
+    static bool CopyForMove(const std::filesystem::path& src,
+                            const std::filesystem::path& dest,
+                            const CopyOptions& options,
+                            CopyStats& stats,
+                            StatCache& cache,
+                            std::error_code& ec);
+    // Copy to a dest that does not exist yet; srcStat is the stat of src
+    static bool CopyNew(const std::filesystem::path& src,
+                        const FileStat& srcStat,
+                        const std::filesystem::path& dest,
+                        const CopyOptions& options,
+                        CopyStats& stats,
+                        std::error_code& ec);
+    // True if dest exists and is not the same file as src
+    static bool NeedsReplace(const std::filesystem::path& src,
+                             const std::filesystem::path& dest,
+                             StatCache& cache);
+    // Unique hidden sibling of p for staging new or parking old content
+    static std::filesystem::path StagingPath(const std::filesystem::path& p);
+    // Atomically place replacement at dest; displaced gets the old content's path
+    static bool SwapInto(const std::filesystem::path& replacement,
+                         const std::filesystem::path& dest,
+                         std::filesystem::path& displaced,
+                         std::error_code& ec);
 };
 
 #endif
\ No newline at end of file
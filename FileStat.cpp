@@ -0,0 +1,66 @@
+/*
+    Description: Implementation of FileStat and the per-action stat cache.
+*/
+#include "DirScanner.h"
+#include "FileStat.h"
+/* One statx through DirScanner::Stat, which already reports symlinks the
+* way the file list shows them
+* @param p
+* @return FileStat
+*/
+FileStat FileStat::Of(const std::filesystem::path& p) {
+    FileStat st;
+    DirEntryInfo info;
+    if (!DirScanner::Stat(p, info, st.ec)) return st;
+    st.exists = true;
+    st.symlink = info.symlink;
+    st.type = info.type;
+    st.size = info.size == EntryStore::kUnknownSize ? 0 : info.size;
+    st.dev = info.dev;
+    st.ino = info.ino;
+    st.mtimeNs = info.mtimeNs;
+    st.mode = info.mode;
+    st.nlink = info.nlink;
+    return st;
+}
+/* Normalize so "a/b" and "a/./b/" share an entry
+* @param p
+* @return key
+*/
+static std::string CacheKey(const std::filesystem::path& p) {
+    std::string key = p.lexically_normal().string();
+    while (key.size() > 1 && key.back() == '/') key.pop_back();
+    return key;
+}
+/* Cached stat of p, taken again once older than kMaxAge
+* @param p
+* @return FileStat
+*/
+FileStat StatCache::Get(const std::filesystem::path& p) {
+    const auto now = std::chrono::steady_clock::now();
+    const std::string key = CacheKey(p);
+    auto found = items_.find(key);
+    if (found != items_.end() && now - found->second.when < kMaxAge) {
+        ++hits_;
+        return found->second.stat;
+    }
+    ++misses_;
+    Item& item = items_[key];
+    item.stat = FileStat::Of(p);
+    item.when = now;
+    return item.stat;
+}
+/* Drop p and its descendants; a rename or delete of a directory changes
+* them all
+* @param p
+*/
+void StatCache::Invalidate(const std::filesystem::path& p) {
+    const std::string key = CacheKey(p);
+    for (auto it = items_.begin(); it != items_.end();) {
+        const std::string& k = it->first;
+        const bool below = k.size() > key.size() && k.compare(0, key.size(), key) == 0 &&
+                           (k[key.size()] == '/' || key == "/");
+        if (k == key || below) it = items_.erase(it);
+        else ++it;
+    }
+}
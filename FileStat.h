@@ -0,0 +1,77 @@
+/*
+    Description: Declare FileStat, the metadata of one path from a single
+                 statx, and StatCache, which shares them within one action
+*/
+#ifndef FILESTAT_H
+#define FILESTAT_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#include "EntryStore.h"
+
+/* Everything the UI and FileOp ask about a path: whether it exists, its
+   type, identity and version. Taken with one statx (a second one only for
+   a symlink, to read its target), so callers stop asking exists, then
+   is_directory, then equivalent, each a round trip of its own.
+*/
+struct FileStat {
+    bool exists = false;
+    bool symlink = false;            // The path itself is a symlink
+    EntryType type = EntryType::Unknown; // Of the target for a symlink; File if it dangles
+    std::uint64_t size = 0;
+    std::uint64_t dev = 0;           // Of the target for a symlink
+    std::uint64_t ino = 0;
+    std::int64_t mtimeNs = EntryStore::kUnknownTime;
+    std::uint32_t mode = 0;
+    std::uint32_t nlink = 0;
+    std::error_code ec;              // Why exists is false
+
+    bool IsDir() const { return exists && type == EntryType::Dir; }
+    // Both exist and are the same file (what std::filesystem::equivalent answers)
+    bool SameFile(const FileStat& other) const {
+        return exists && other.exists && dev == other.dev && ino == other.ino;
+    }
+
+    /* Stat a path
+    * @param p
+    * @return the stat; exists is false with ec set when p is missing or unreadable
+    */
+    static FileStat Of(const std::filesystem::path& p);
+};
+
+/* Stats of the paths one user action looks at, so each is fetched once
+   even when the dialog, the checks and the job all ask about it.
+                 - Entries expire after kMaxAge: a cache handed from a dialog
+                   to a job does not act on what the user saw minutes ago
+                 - Operations invalidate the paths they change
+                 - Not thread safe; one action uses it on one thread at a
+                   time (the GUI thread, then its job)
+*/
+class StatCache {
+public:
+    static constexpr std::chrono::milliseconds kMaxAge{2000};
+
+    // Stat of p, from the cache while it is fresh
+    FileStat Get(const std::filesystem::path& p);
+    // Forget p and everything below it
+    void Invalidate(const std::filesystem::path& p);
+    void Clear() { items_.clear(); }
+    std::uint64_t Hits() const { return hits_; }
+    std::uint64_t Misses() const { return misses_; }
+
+private:
+    struct Item {
+        FileStat stat;
+        std::chrono::steady_clock::time_point when;
+    };
+    std::unordered_map<std::string, Item> items_; // Keyed by lexically normal path
+    std::uint64_t hits_ = 0;
+    std::uint64_t misses_ = 0;
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+    Description: Implementation of XXH64, following the reference algorithm.
+*/
+#include <cstring>
+
+#include "Hash.h"
+
+namespace {
+constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline std::uint64_t Rotl(std::uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+// Little-endian loads; memcpy compiles to a plain load on x86
+inline std::uint64_t Read64(const unsigned char* p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+inline std::uint32_t Read32(const unsigned char* p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+inline std::uint64_t Round(std::uint64_t acc, std::uint64_t input) {
+    acc += input * kPrime2;
+    acc = Rotl(acc, 31);
+    return acc * kPrime1;
+}
+inline std::uint64_t Merge(std::uint64_t acc, std::uint64_t v) {
+    acc ^= Round(0, v);
+    return acc * kPrime1 + kPrime4;
+}
+}
+
+Xxh64::Xxh64(std::uint64_t seed)
+    : seed_(seed)
+{
+    v_[0] = seed + kPrime1 + kPrime2;
+    v_[1] = seed + kPrime2;
+    v_[2] = seed;
+    v_[3] = seed - kPrime1;
+}
+/* Consume whole 32-byte stripes; keep the remainder for the next call
+* @param data
+* @param size
+*/
+void Xxh64::Update(const void* data, std::size_t size) {
+    if (size == 0) return; // data may be null
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    total_ += size;
+    if (buffered_ + size < sizeof(buf_)) {
+        std::memcpy(buf_ + buffered_, p, size);
+        buffered_ += size;
+        return;
+    }
+    if (buffered_ > 0) {
+        const std::size_t fill = sizeof(buf_) - buffered_;
+        std::memcpy(buf_ + buffered_, p, fill);
+        for (int i = 0; i < 4; ++i) v_[i] = Round(v_[i], Read64(buf_ + 8 * i));
+        p += fill;
+        size -= fill;
+        buffered_ = 0;
+    }
+    std::uint64_t v0 = v_[0], v1 = v_[1], v2 = v_[2], v3 = v_[3];
+    for (; size >= 32; p += 32, size -= 32) {
+        v0 = Round(v0, Read64(p));
+        v1 = Round(v1, Read64(p + 8));
+        v2 = Round(v2, Read64(p + 16));
+        v3 = Round(v3, Read64(p + 24));
+    }
+    v_[0] = v0;
+    v_[1] = v1;
+    v_[2] = v2;
+    v_[3] = v3;
+    std::memcpy(buf_, p, size);
+    buffered_ = size;
+}
+/* Fold the lanes and the buffered tail into the final value
+* @return hash
+*/
+std::uint64_t Xxh64::Digest() const {
+    std::uint64_t h;
+    if (total_ >= 32) {
+        h = Rotl(v_[0], 1) + Rotl(v_[1], 7) + Rotl(v_[2], 12) + Rotl(v_[3], 18);
+        for (int i = 0; i < 4; ++i) h = Merge(h, v_[i]);
+    } else {
+        h = seed_ + kPrime5;
+    }
+    h += total_;
+    const unsigned char* p = buf_;
+    std::size_t left = buffered_;
+    for (; left >= 8; p += 8, left -= 8) {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (left >= 4) {
+        h ^= static_cast<std::uint64_t>(Read32(p)) * kPrime1;
+        h = Rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+        left -= 4;
+    }
+    for (; left > 0; ++p, --left) {
+        h ^= (*p) * kPrime5;
+        h = Rotl(h, 11) * kPrime1;
+    }
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+std::uint64_t Xxh64::Hash(const void* data, std::size_t size, std::uint64_t seed) {
+    Xxh64 hash(seed);
+    hash.Update(data, size);
+    return hash.Digest();
+}
@@ -0,0 +1,32 @@
+/*
+    Description: Declare Xxh64, the streaming content hash used to compare files
+*/
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* XXH64 (xxHash, 64-bit variant), fed in pieces of any size. Hashing a
+   file in chunks gives the same value as hashing it in one go.
+*/
+class Xxh64 {
+public:
+    explicit Xxh64(std::uint64_t seed = 0);
+
+    void Update(const void* data, std::size_t size);
+    // Hash of everything fed so far; more can still be fed afterwards
+    std::uint64_t Digest() const;
+
+    // One-shot hash of a buffer
+    static std::uint64_t Hash(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+private:
+    std::uint64_t seed_;
+    std::uint64_t v_[4];
+    std::uint64_t total_ = 0;
+    unsigned char buf_[32];   // Input not yet consumed by a full stripe
+    std::size_t buffered_ = 0;
+};
+
+#endif
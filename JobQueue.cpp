@@ -0,0 +1,270 @@
+/*
+    Description: Implementation of the background job scheduler.
+*/
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include "DirScanner.h"
+#include "JobQueue.h"
+/* Name of a state
+* @param state
+* @return static string
+*/
+const char* JobStateName(JobState state) {
+    switch (state) {
+    case JobState::Queued: return "Waiting";
+    case JobState::Running: return "Running";
+    case JobState::Paused: return "Paused";
+    case JobState::Done: return "Done";
+    case JobState::Failed: return "Failed";
+    case JobState::Cancelled: return "Cancelled";
+    }
+    return "";
+}
+/* Estimate the time left. Trees are estimated by files (their byte total
+* is not known up front), single files by bytes.
+* @return seconds, -1 if unknown
+*/
+double JobInfo::EtaSeconds() const {
+    if (totalFiles > 1 && files < totalFiles && FilesPerSecond() > 0) {
+        return (totalFiles - files) / FilesPerSecond();
+    }
+    if (totalBytes > 0 && bytes < totalBytes && BytesPerSecond() > 0) {
+        return (totalBytes - bytes) / BytesPerSecond();
+    }
+    return -1.0;
+}
+/* Cancel and join everything
+*/
+JobQueue::~JobQueue() {
+    Shutdown();
+}
+/* Register a job and start its thread; the thread resolves and waits for its devices
+* @param title
+* @param touches
+* @param work
+* @param onDone
+* @return id
+*/
+std::uint64_t JobQueue::Submit(std::string title, const std::vector<std::filesystem::path>& touches,
+                               Work work, DoneFn onDone) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.emplace_back();
+    Job& job = jobs_.back();
+    job.info.id = nextId_++;
+    job.info.title = std::move(title);
+    job.progress = std::make_shared<OpProgress>();
+    job.thread = std::thread(&JobQueue::Run, this, &job, touches, std::move(work), std::move(onDone));
+    return job.info.id;
+}
+/* Job thread: find the devices, wait for their slots, run, record the outcome.
+* The stats behind the devices can block on a slow mount, so they are taken
+* here rather than in Submit; the job stays Queued meanwhile.
+* @param job: stays valid until threadDone is set
+* @param touches
+* @param work
+* @param onDone
+*/
+void JobQueue::Run(Job* job, std::vector<std::filesystem::path> touches, Work work, DoneFn onDone) {
+    std::vector<std::uint64_t> devices = DevicesOf(touches);
+    std::vector<unsigned> slots;
+    for (std::uint64_t dev : devices) {
+        slots.push_back(IsRotational(dev) ? kRotationalSlots : kFastDeviceSlots);
+    }
+    OpProgress& progress = *job->progress;
+    JobInfo result;
+    bool start = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < devices.size(); ++i) {
+            slots_.emplace(devices[i], slots[i]);
+        }
+        job->devices = std::move(devices);
+        deviceFreed_.wait(lock, [&]() {
+            return progress.cancelled.load() || DevicesFree(*job);
+        });
+        start = !progress.cancelled.load();
+        job->started = Clock::now();
+        if (start) {
+            for (std::uint64_t dev : job->devices) ++busy_[dev];
+            progress.start = job->started;
+            job->pausedAt = job->started;
+            job->info.state = progress.paused.load() ? JobState::Paused : JobState::Running;
+        } else {
+            job->ended = job->started;
+            job->info.state = JobState::Cancelled;
+            job->info.ec = std::make_error_code(std::errc::operation_canceled);
+            result = InfoLocked(*job);
+        }
+    }
+    if (start) {
+        std::error_code ec;
+        std::filesystem::path errorPath;
+        const bool ok = work(progress, ec, errorPath);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (std::uint64_t dev : job->devices) --busy_[dev];
+            job->ended = Clock::now();
+            if (job->info.state == JobState::Paused) job->pausedFor += job->ended - job->pausedAt;
+            if (ok) job->info.state = JobState::Done;
+            else job->info.state = progress.cancelled.load() ? JobState::Cancelled : JobState::Failed;
+            job->info.ec = ec;
+            job->info.errorPath = errorPath;
+            result = InfoLocked(*job);
+        }
+        deviceFreed_.notify_all();
+    }
+    if (onDone) onDone(result);
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->threadDone = true;
+}
+/* True if every device of job has a free slot (mutex_ held)
+* @param job
+*/
+bool JobQueue::DevicesFree(const Job& job) const {
+    for (std::uint64_t dev : job.devices) {
+        auto busy = busy_.find(dev);
+        if (busy != busy_.end() && busy->second >= slots_.at(dev)) return false;
+    }
+    return true;
+}
+/* Copy the state of a job with live counters (mutex_ held)
+* @param job
+* @return info
+*/
+JobInfo JobQueue::InfoLocked(const Job& job) const {
+    JobInfo info = job.info;
+    const OpProgress& p = *job.progress;
+    info.files = p.files.load(std::memory_order_relaxed);
+    info.bytes = p.bytes.load(std::memory_order_relaxed);
+    info.totalFiles = p.totalFiles.load(std::memory_order_relaxed);
+    info.totalBytes = p.totalBytes.load(std::memory_order_relaxed);
+    if (info.state != JobState::Queued) {
+        const Clock::time_point now = Clock::now();
+        Clock::duration ran = (info.Finished() ? job.ended : now) - job.started - job.pausedFor;
+        if (info.state == JobState::Paused) ran -= now - job.pausedAt;
+        info.seconds = std::max(0.0, std::chrono::duration<double>(ran).count());
+    }
+    return info;
+}
+/* Set the cancel flag and wake jobs waiting for a device
+* @param id
+*/
+void JobQueue::Cancel(std::uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Job& job : jobs_) {
+            if (job.info.id == id) job.progress->cancelled.store(true);
+        }
+    }
+    deviceFreed_.notify_all();
+}
+/* Pause or resume; paused time is left out of rates and ETA
+* @param id
+* @param paused
+*/
+void JobQueue::SetPaused(std::uint64_t id, bool paused) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Job& job : jobs_) {
+        if (job.info.id != id || job.info.Finished()) continue;
+        job.progress->paused.store(paused);
+        if (paused && job.info.state == JobState::Running) {
+            job.pausedAt = Clock::now();
+            job.info.state = JobState::Paused;
+        } else if (!paused && job.info.state == JobState::Paused) {
+            job.pausedFor += Clock::now() - job.pausedAt;
+            job.info.state = JobState::Running;
+        }
+    }
+}
+/* Copy out every job
+* @return infos, oldest first
+*/
+std::vector<JobInfo> JobQueue::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<JobInfo> out;
+    out.reserve(jobs_.size());
+    for (const Job& job : jobs_) out.push_back(InfoLocked(job));
+    return out;
+}
+/* Drop finished jobs whose threads have exited
+*/
+void JobQueue::ClearFinished() {
+    std::list<Job> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = jobs_.begin(); it != jobs_.end();) {
+            auto next = std::next(it);
+            if (it->threadDone) done.splice(done.end(), jobs_, it);
+            it = next;
+        }
+    }
+    for (Job& job : done) job.thread.join();
+}
+/* True if a job has not finished yet
+*/
+bool JobQueue::Busy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Job& job : jobs_) {
+        if (!job.info.Finished()) return true;
+    }
+    return false;
+}
+/* Cancel all jobs and join their threads
+*/
+void JobQueue::Shutdown() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Job& job : jobs_) {
+            job.progress->cancelled.store(true);
+            if (job.thread.joinable()) threads.push_back(std::move(job.thread));
+        }
+    }
+    deviceFreed_.notify_all();
+    for (auto& t : threads) t.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+}
+/* Stat each path, walking up to the nearest existing ancestor
+* @param paths
+* @return sorted unique device ids
+*/
+std::vector<std::uint64_t> JobQueue::DevicesOf(const std::vector<std::filesystem::path>& paths) {
+    std::vector<std::uint64_t> devices;
+    for (std::filesystem::path p : paths) {
+        for (;;) {
+            DirEntryInfo info;
+            std::error_code ec;
+            if (DirScanner::Stat(p, info, ec)) {
+                devices.push_back(info.dev);
+                break;
+            }
+            if (!p.has_relative_path() || p.parent_path() == p) break;
+            p = p.parent_path();
+        }
+    }
+    std::sort(devices.begin(), devices.end());
+    devices.erase(std::unique(devices.begin(), devices.end()), devices.end());
+    return devices;
+}
+/* Ask sysfs whether a block device spins. Partitions keep the flag in the
+* parent disk's queue directory. Virtual filesystems have no block device.
+* @param dev: major << 32 | minor
+* @return true for rotational disks
+*/
+bool JobQueue::IsRotational(std::uint64_t dev) {
+#if defined(__linux__)
+    const unsigned major = static_cast<unsigned>(dev >> 32);
+    const unsigned minor = static_cast<unsigned>(dev & 0xffffffffu);
+    if (major == 0) return false;
+    const std::string base = "/sys/dev/block/" + std::to_string(major) + ":" + std::to_string(minor);
+    for (const char* rel : {"/queue/rotational", "/../queue/rotational"}) {
+        std::ifstream in(base + rel);
+        int flag = 0;
+        if (in >> flag) return flag != 0;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,129 @@
+/*
+    Description: Declare JobQueue, the background scheduler for file operations
+*/
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "OpProgress.h"
+
+enum class JobState : std::uint8_t { Queued, Running, Paused, Done, Failed, Cancelled };
+
+// Name shown for a state
+const char* JobStateName(JobState state);
+
+// Copy of a job's state for display
+struct JobInfo {
+    std::uint64_t id = 0;
+    std::string title;
+    JobState state = JobState::Queued;
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t totalFiles = 0;   // 0 when unknown; may grow while a tree is walked
+    std::uint64_t totalBytes = 0;
+    double seconds = 0.0;           // Running time, pauses excluded
+    std::error_code ec;
+    std::filesystem::path errorPath;
+
+    bool Finished() const {
+        return state == JobState::Done || state == JobState::Failed || state == JobState::Cancelled;
+    }
+    double BytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0.0; }
+    double FilesPerSecond() const { return seconds > 0 ? files / seconds : 0.0; }
+    // Seconds left, or -1 when there is nothing to estimate from
+    double EtaSeconds() const;
+};
+
+/* Runs file operations on background threads, one thread per job.
+                 - A job declares the paths it touches; its thread finds their
+                   devices (Submit never stats) and waits until every
+                   device (st_dev) under them has a free slot, so jobs on the
+                   same disk run one after another instead of seeking against
+                   each other. Rotational disks get 1 slot, others kFastDeviceSlots
+                 - Jobs can be paused and cancelled through their OpProgress
+                 - Finished jobs stay listed until ClearFinished
+*/
+class JobQueue {
+public:
+    /* The operation. Runs on the job's thread.
+    * @param progress: counters to update; call Checkpoint between units of work
+    * @param ec: receives the error
+    * @param errorPath: receives the path that failed
+    * @return true on success
+    */
+    using Work = std::function<bool(OpProgress& progress, std::error_code& ec,
+                                    std::filesystem::path& errorPath)>;
+    // Called on the job's thread after the work returns
+    using DoneFn = std::function<void(const JobInfo& info)>;
+
+    static constexpr unsigned kRotationalSlots = 1;
+    static constexpr unsigned kFastDeviceSlots = 2;
+
+    ~JobQueue();
+
+    /* Queue a job
+    * @param title: shown in the jobs panel
+    * @param touches: sources and destinations; their devices are reserved
+    * @param work: the operation
+    * @param onDone: completion callback, may be empty
+    * @return job id
+    */
+    std::uint64_t Submit(std::string title, const std::vector<std::filesystem::path>& touches,
+                         Work work, DoneFn onDone);
+    // Ask a job to stop at its next checkpoint
+    void Cancel(std::uint64_t id);
+    // Pause or resume a job
+    void SetPaused(std::uint64_t id, bool paused);
+    // State of every listed job, oldest first
+    std::vector<JobInfo> Snapshot() const;
+    // Forget finished jobs
+    void ClearFinished();
+    // True while any job is queued or running
+    bool Busy() const;
+    // Cancel every job and wait for their threads
+    void Shutdown();
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Job {
+        JobInfo info;
+        std::vector<std::uint64_t> devices;   // Set by Run before it waits
+        std::shared_ptr<OpProgress> progress;
+        std::thread thread;
+        bool threadDone = false;
+        Clock::time_point started;
+        Clock::time_point ended;
+        Clock::time_point pausedAt;
+        Clock::duration pausedFor{0};
+    };
+
+    void Run(Job* job, std::vector<std::filesystem::path> touches, Work work, DoneFn onDone);
+    bool DevicesFree(const Job& job) const;
+    JobInfo InfoLocked(const Job& job) const;
+    // Device ids of the paths, or of their nearest existing ancestors
+    static std::vector<std::uint64_t> DevicesOf(const std::vector<std::filesystem::path>& paths);
+    // True if the block device behind dev reports itself as rotational
+    static bool IsRotational(std::uint64_t dev);
+
+    mutable std::mutex mutex_;
+    std::condition_variable deviceFreed_;
+    std::list<Job> jobs_;
+    std::map<std::uint64_t, unsigned> busy_;   // Running jobs per device
+    std::map<std::uint64_t, unsigned> slots_;  // Cached slot count per device
+    std::uint64_t nextId_ = 1;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+    Description: Implementation of the jobs panel.
+*/
+#include "JobsPanel.h"
+/* Format seconds as h:mm:ss or m:ss
+* @param seconds: -1 for unknown
+* @return wxString
+*/
+static wxString FormatDuration(double seconds) {
+    if (seconds < 0) return "-";
+    const unsigned long long s = static_cast<unsigned long long>(seconds + 0.5);
+    if (s >= 3600) return wxString::Format("%llu:%02llu:%02llu", s / 3600, s / 60 % 60, s % 60);
+    return wxString::Format("%llu:%02llu", s / 60, s % 60);
+}
+/* Describe what a job has done so far, with totals when known
+* @param info
+* @return wxString
+*/
+static wxString FormatDone(const JobInfo& info) {
+    const double mb = info.bytes / (1024.0 * 1024.0);
+    wxString text = info.totalFiles > 0
+        ? wxString::Format("%llu of %llu files", static_cast<unsigned long long>(info.files),
+                           static_cast<unsigned long long>(info.totalFiles))
+        : wxString::Format("%llu items", static_cast<unsigned long long>(info.files));
+    if (info.totalBytes > 0) {
+        text += wxString::Format(", %.1f of %.1f MB", mb, info.totalBytes / (1024.0 * 1024.0));
+    } else if (info.bytes > 0) {
+        text += wxString::Format(", %.1f MB", mb);
+    }
+    return text;
+}
+/* Create the list, buttons and refresh timer
+* @param parent
+* @param jobs
+*/
+JobsPanel::JobsPanel(wxWindow* parent, JobQueue& jobs)
+    : wxPanel(parent, wxID_ANY), jobs_(jobs), timer_(this)
+{
+    m_list = new wxListCtrl(this, wxID_ANY, wxDefaultPosition, wxSize(-1, 110),
+                            wxLC_REPORT | wxLC_SINGLE_SEL);
+    m_list->InsertColumn(0, _("Job"), wxLIST_FORMAT_LEFT, 260);
+    m_list->InsertColumn(1, _("State"), wxLIST_FORMAT_LEFT, 80);
+    m_list->InsertColumn(2, _("Done"), wxLIST_FORMAT_LEFT, 220);
+    m_list->InsertColumn(3, _("Rate"), wxLIST_FORMAT_RIGHT, 110);
+    m_list->InsertColumn(4, _("ETA"), wxLIST_FORMAT_RIGHT, 70);
+
+    m_pauseButton = new wxButton(this, ID_Pause, "&Pause");
+    wxButton* cancelButton = new wxButton(this, ID_Cancel, "&Cancel Job");
+    wxButton* clearButton = new wxButton(this, ID_Clear, "C&lear Finished");
+
+    Bind(wxEVT_BUTTON, &JobsPanel::OnPause, this, ID_Pause);
+    Bind(wxEVT_BUTTON, &JobsPanel::OnCancel, this, ID_Cancel);
+    Bind(wxEVT_BUTTON, &JobsPanel::OnClear, this, ID_Clear);
+    Bind(wxEVT_TIMER, &JobsPanel::OnTimer, this);
+
+    wxBoxSizer* buttons = new wxBoxSizer(wxVERTICAL);
+    buttons->Add(m_pauseButton, 0, wxEXPAND | wxBOTTOM, 5);
+    buttons->Add(cancelButton, 0, wxEXPAND | wxBOTTOM, 5);
+    buttons->Add(clearButton, 0, wxEXPAND);
+    wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL);
+    sizer->Add(m_list, 1, wxEXPAND | wxRIGHT, 5);
+    sizer->Add(buttons, 0);
+    SetSizer(sizer);
+
+    timer_.Start(kRefreshMs);
+}
+/* Copy the queue into the list. Rows are rebuilt only when jobs come or
+* go; otherwise just their text changes.
+*/
+void JobsPanel::RefreshJobs() {
+    std::vector<JobInfo> infos = jobs_.Snapshot();
+    bool sameRows = infos.size() == shown_.size();
+    for (std::size_t i = 0; sameRows && i < infos.size(); ++i) {
+        sameRows = infos[i].id == shown_[i].id;
+    }
+    if (!sameRows) {
+        JobInfo selected;
+        const bool hadSelection = SelectedJob(selected);
+        m_list->DeleteAllItems();
+        for (std::size_t i = 0; i < infos.size(); ++i) {
+            m_list->InsertItem(static_cast<long>(i), wxString::FromUTF8(infos[i].title.c_str()));
+            if (hadSelection && infos[i].id == selected.id) {
+                m_list->SetItemState(static_cast<long>(i), wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED);
+            }
+        }
+    }
+    for (std::size_t i = 0; i < infos.size(); ++i) {
+        const JobInfo& info = infos[i];
+        const long row = static_cast<long>(i);
+        wxString state = JobStateName(info.state);
+        if (info.state == JobState::Failed) state += ": " + wxString(info.ec.message());
+        m_list->SetItem(row, 1, state);
+        m_list->SetItem(row, 2, FormatDone(info));
+        wxString rate;
+        if (info.state == JobState::Running || info.state == JobState::Paused || info.Finished()) {
+            rate = info.bytes > 0
+                ? wxString::Format("%.1f MB/s", info.BytesPerSecond() / (1024.0 * 1024.0))
+                : wxString::Format("%.0f items/s", info.FilesPerSecond());
+        }
+        m_list->SetItem(row, 3, rate);
+        m_list->SetItem(row, 4, info.Finished() ? FormatDuration(info.seconds)
+                                                : FormatDuration(info.EtaSeconds()));
+    }
+    shown_ = std::move(infos);
+
+    JobInfo selected;
+    const bool paused = SelectedJob(selected) && selected.state == JobState::Paused;
+    m_pauseButton->SetLabel(paused ? "&Resume" : "&Pause");
+}
+/* Job of the selected row
+* @param out
+* @return true if a row is selected
+*/
+bool JobsPanel::SelectedJob(JobInfo& out) const {
+    long row = m_list->GetNextItem(-1, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED);
+    if (row < 0 || row >= static_cast<long>(shown_.size())) return false;
+    out = shown_[static_cast<std::size_t>(row)];
+    return true;
+}
+/* Periodic refresh
+* @param event
+*/
+void JobsPanel::OnTimer(wxTimerEvent& event) {
+    RefreshJobs();
+}
+/* Pause the selected job, or resume it if paused
+* @param event
+*/
+void JobsPanel::OnPause(wxCommandEvent& event) {
+    JobInfo info;
+    if (!SelectedJob(info) || info.Finished()) return;
+    jobs_.SetPaused(info.id, info.state != JobState::Paused);
+    RefreshJobs();
+}
+/* Cancel the selected job
+* @param event
+*/
+void JobsPanel::OnCancel(wxCommandEvent& event) {
+    JobInfo info;
+    if (!SelectedJob(info) || info.Finished()) return;
+    jobs_.Cancel(info.id);
+    RefreshJobs();
+}
+/* Remove finished jobs from the list
+* @param event
+*/
+void JobsPanel::OnClear(wxCommandEvent& event) {
+    jobs_.ClearFinished();
+    RefreshJobs();
+}
@@ -0,0 +1,54 @@
+/*
+    Description: Declare JobsPanel, the list of background file operations
+*/
+#ifndef JOBSPANEL_H
+#define JOBSPANEL_H
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+#include <wx/timer.h>
+#include <vector>
+
+#include "JobQueue.h"
+
+/* Shows every job of a JobQueue with its progress, rate and ETA, and lets
+   the user pause, resume or cancel the selected one. Polls the queue on a
+   timer; the jobs never touch the UI themselves.
+*/
+class JobsPanel : public wxPanel {
+    public:
+        /* Create the panel
+        * @param parent
+        * @param jobs: queue to show, must outlive the panel
+        */
+        JobsPanel(wxWindow* parent, JobQueue& jobs);
+
+        static constexpr int kRefreshMs = 250;
+
+        // Re-read the queue now
+        void RefreshJobs();
+
+    private:
+        enum {
+            ID_Pause = wxID_HIGHEST + 100,
+            ID_Cancel,
+            ID_Clear
+        };
+        /* Selected job
+        * @param out: receives its info
+        * @return false when nothing is selected
+        */
+        bool SelectedJob(JobInfo& out) const;
+
+        void OnTimer(wxTimerEvent& event);
+        void OnPause(wxCommandEvent& event);
+        void OnCancel(wxCommandEvent& event);
+        void OnClear(wxCommandEvent& event);
+
+        JobQueue& jobs_;
+        wxListCtrl* m_list;
+        wxButton* m_pauseButton;
+        wxTimer timer_;
+        std::vector<JobInfo> shown_; // Row i shows shown_[i]
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+    Description: Implementation of the JSON object writer.
+*/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#include "Json.h"
+
+namespace {
+/* Length of the well formed UTF-8 sequence at s[i]
+* @param s
+* @param i
+* @return 1 to 4, or 0 if the bytes there are not valid UTF-8
+*/
+std::size_t Utf8Length(std::string_view s, std::size_t i) {
+    const unsigned char c = static_cast<unsigned char>(s[i]);
+    if (c < 0x80) return 1;
+    std::size_t len;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) len = 2;
+    else if (c >= 0xe0 && c <= 0xef) {
+        len = 3;
+        if (c == 0xe0) lo = 0xa0;       // Overlong
+        else if (c == 0xed) hi = 0x9f;  // Surrogates
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        len = 4;
+        if (c == 0xf0) lo = 0x90;       // Overlong
+        else if (c == 0xf4) hi = 0x8f;  // Past U+10FFFF
+    } else {
+        return 0;
+    }
+    if (s.size() - i < len) return 0;
+    const unsigned char second = static_cast<unsigned char>(s[i + 1]);
+    if (second < lo || second > hi) return 0;
+    for (std::size_t k = 2; k < len; ++k) {
+        const unsigned char next = static_cast<unsigned char>(s[i + k]);
+        if (next < 0x80 || next > 0xbf) return 0;
+    }
+    return len;
+}
+/* Standard base64 with padding
+* @param s
+* @return encoded text
+*/
+std::string Base64(std::string_view s) {
+    static const char kDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((s.size() + 2) / 3 * 4);
+    for (std::size_t i = 0; i < s.size(); i += 3) {
+        const std::size_t n = std::min<std::size_t>(3, s.size() - i);
+        std::uint32_t v = static_cast<std::uint32_t>(static_cast<unsigned char>(s[i])) << 16;
+        if (n > 1) v |= static_cast<std::uint32_t>(static_cast<unsigned char>(s[i + 1])) << 8;
+        if (n > 2) v |= static_cast<unsigned char>(s[i + 2]);
+        out += kDigits[(v >> 18) & 63];
+        out += kDigits[(v >> 12) & 63];
+        out += n > 1 ? kDigits[(v >> 6) & 63] : '=';
+        out += n > 2 ? kDigits[v & 63] : '=';
+    }
+    return out;
+}
+}
+/* Check every sequence of s
+* @param s
+* @return true if all of s is valid UTF-8
+*/
+bool IsUtf8(std::string_view s) {
+    for (std::size_t i = 0; i < s.size();) {
+        const std::size_t len = Utf8Length(s, i);
+        if (len == 0) return false;
+        i += len;
+    }
+    return true;
+}
+/* Escape per RFC 8259; bytes that are not UTF-8 as \u00XX
+* @param s
+* @return quoted string
+*/
+std::string JsonQuote(std::string_view s) {
+    std::string out;
+    out.reserve(s.size() + 2);
+    out += '"';
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        const char c = s[i];
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            const std::size_t len = Utf8Length(s, i);
+            if (len == 0) {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                out += hex;
+            } else {
+                out.append(s.data() + i, len);
+                i += len - 1;
+            }
+            continue;
+        }
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                out += hex;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+    return out;
+}
+/* Append a string field, and its exact bytes when they are not UTF-8
+* @param name
+* @param value
+* @return *this
+*/
+JsonLine& JsonLine::Add(const char* name, std::string_view value) {
+    Raw(name, JsonQuote(value));
+    if (!IsUtf8(value)) Raw((std::string(name) + "_b64").c_str(), JsonQuote(Base64(value)));
+    return *this;
+}
+/* Append a counter
+* @param name
+* @param value
+* @return *this
+*/
+JsonLine& JsonLine::Add(const char* name, std::uint64_t value) {
+    return Raw(name, std::to_string(value));
+}
+/* Append a measurement, three decimals
+* @param name
+* @param value
+* @return *this
+*/
+JsonLine& JsonLine::Add(const char* name, double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", value);
+    return Raw(name, buf);
+}
+/* Append a flag
+* @param name
+* @param value
+* @return *this
+*/
+JsonLine& JsonLine::Add(const char* name, bool value) {
+    return Raw(name, value ? "true" : "false");
+}
+/* Append name:json
+* @param name
+* @param json
+* @return *this
+*/
+JsonLine& JsonLine::Raw(const char* name, const std::string& json) {
+    text_ += text_.empty() ? "{" : ",";
+    text_ += JsonQuote(name);
+    text_ += ':';
+    text_ += json;
+    return *this;
+}
+/* The object so far, closed
+* @return JSON text
+*/
+std::string JsonLine::Str() const {
+    return (text_.empty() ? "{" : text_) + "}";
+}
@@ -0,0 +1,46 @@
+/*
+    Description: Declare JsonLine, the small JSON object writer used by the
+                 command line tools
+*/
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+/* Quote a string for JSON. Paths are bytes, not always UTF-8: valid UTF-8
+* is passed through, control characters, quotes and backslashes are
+* escaped, and each byte of an invalid sequence becomes \u00XX, so the
+* output is always valid JSON.
+* @param s
+* @return quoted string
+*/
+std::string JsonQuote(std::string_view s);
+// True if s is well formed UTF-8 (no overlongs, surrogates or values past U+10FFFF)
+bool IsUtf8(std::string_view s);
+
+/* Builds one JSON object, one field at a time, in insertion order.
+   A string field that is not valid UTF-8 (a file name in another
+   encoding) gets a second field, name_b64, holding its exact bytes in
+   base64; the field itself is readable but lossy.
+*/
+class JsonLine {
+public:
+    JsonLine& Add(const char* name, std::string_view value);
+    JsonLine& Add(const char* name, const char* value) { return Add(name, std::string_view(value)); }
+    JsonLine& Add(const char* name, const std::string& value) { return Add(name, std::string_view(value)); }
+    JsonLine& Add(const char* name, const std::filesystem::path& value) { return Add(name, std::string_view(value.native())); }
+    JsonLine& Add(const char* name, std::uint64_t value);
+    JsonLine& Add(const char* name, double value);
+    JsonLine& Add(const char* name, bool value);
+    // Add a value that is already JSON (an array or another object)
+    JsonLine& Raw(const char* name, const std::string& json);
+    std::string Str() const;
+
+private:
+    std::string text_;
+};
+
+#endif
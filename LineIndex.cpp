@@ -0,0 +1,226 @@
+/*
+    Description: Implementation of the background line-offset index.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LineIndex.h"
+#include "StrSearch.h"
+#include "Trace.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+LineIndex::~LineIndex() {
+    Stop();
+}
+/* Cancel the running index and start a worker for file. The old worker
+* stops within one chunk, so joining it here is quick.
+* @param file
+*/
+void LineIndex::Start(const std::filesystem::path& file) {
+    Stop();
+    state_ = std::make_shared<State>();
+    state_->marks.push_back(0); // Line 0 starts at byte 0
+    worker_ = std::thread(Run, file, state_);
+}
+
+void LineIndex::Stop() {
+    if (state_) state_->cancel.store(true);
+    if (worker_.joinable()) worker_.join();
+}
+
+LineIndex::Progress LineIndex::GetProgress() const {
+    if (!state_) return Progress();
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->progress;
+}
+/* Index the file chunk by chunk with pread, publishing each chunk's
+* checkpoints. The file is read, not mapped: a log truncated by rotation
+* while it is indexed just ends the index early instead of raising SIGBUS.
+* @param file
+* @param state
+*/
+void LineIndex::Run(std::filesystem::path file, std::shared_ptr<State> state) {
+    TRACE_SCOPE_ARG(scope, kEnumerate, "LineIndex");
+    std::error_code ec;
+    const int fd = ::open(file.c_str(), O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    TRACE_COUNT(kSyscalls, 3); // open, fstat and close
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        ec.assign(errno, std::generic_category());
+    } else if (!S_ISREG(st.st_mode)) {
+        ec = std::make_error_code(std::errc::invalid_argument);
+    }
+    if (ec) {
+        if (fd >= 0) ::close(fd);
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->progress.ec = ec;
+        state->progress.done = true;
+        return;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    const std::uint64_t size = static_cast<std::uint64_t>(st.st_size);
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->progress.size = size;
+    }
+    std::unique_ptr<char[]> buffer(new char[kChunkBytes]);
+    std::uint64_t lines = 0;
+    std::vector<std::uint64_t> marks;
+    bool truncated = false;
+    for (std::uint64_t offset = 0; offset < size && !state->cancel.load();) {
+        const std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(kChunkBytes, size - offset));
+        const ssize_t n = ::pread(fd, buffer.get(), want, static_cast<off_t>(offset));
+        TRACE_COUNT(kSyscalls, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            ec.assign(errno, std::generic_category());
+            break;
+        }
+        if (n == 0) {
+            truncated = true; // The index covers what was there
+            break;
+        }
+        const std::string_view chunk(buffer.get(), static_cast<std::size_t>(n));
+        marks.clear();
+        ScanNewlines(chunk, offset, lines, marks);
+        offset += chunk.size();
+        TRACE_COUNT(kBytesRead, chunk.size());
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->marks.insert(state->marks.end(), marks.begin(), marks.end());
+        state->progress.scanned = offset;
+        state->progress.lines = lines;
+        state->progress.openEnd = chunk.back() != '\n';
+    }
+    ::close(fd);
+    TRACE_SET_ARG(scope, lines);
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->progress.ec = ec;
+    if (truncated) state->progress.size = state->progress.scanned;
+    state->progress.done = !state->cancel.load();
+}
+/* Count newlines 64 bytes at a time. A block that does not reach the next
+* checkpoint only needs a popcount; one that does is walked bit by bit.
+* @param data
+* @param base
+* @param lines
+* @param marks
+*/
+void LineIndex::ScanNewlines(std::string_view data, std::uint64_t base, std::uint64_t& lines,
+                             std::vector<std::uint64_t>& marks) {
+    const char* t = data.data();
+    const std::size_t n = data.size();
+    std::uint64_t untilMark = kStride - lines % kStride;
+    auto newline = [&](std::size_t at) {
+        ++lines;
+        if (--untilMark == 0) {
+            marks.push_back(base + at + 1);
+            untilMark = kStride;
+        }
+    };
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    auto maskOf = [&](std::size_t at) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + at));
+        return static_cast<std::uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl))));
+    };
+    for (; i + 64 <= n; i += 64) {
+        std::uint64_t mask = maskOf(i) | maskOf(i + 16) << 16 | maskOf(i + 32) << 32 | maskOf(i + 48) << 48;
+        if (mask == 0) continue;
+        const std::uint64_t count = static_cast<std::uint64_t>(__builtin_popcountll(mask));
+        if (count < untilMark) {
+            lines += count;
+            untilMark -= count;
+            continue;
+        }
+        while (mask != 0) {
+            newline(i + static_cast<std::size_t>(__builtin_ctzll(mask)));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (t[i] == '\n') newline(i);
+    }
+}
+/* Start at the checkpoint of line and step over the remaining newlines
+* with memchr, one window at a time
+* @param line
+* @param file
+* @param offset
+* @param ec
+* @return true if the line exists and is indexed
+*/
+bool LineIndex::LineToOffset(std::uint64_t line, MappedFile& file, std::uint64_t& offset,
+                             std::error_code& ec) const {
+    ec.clear();
+    if (!state_) return false;
+    std::uint64_t pos = 0;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        const std::uint64_t mark = line / kStride;
+        // Lines up to the newline count so far start inside the scanned part
+        if (mark >= state_->marks.size() || line > state_->progress.lines) return false;
+        pos = state_->marks[mark];
+    }
+    std::uint64_t remaining = line % kStride;
+    while (remaining > 0) {
+        const std::string_view w = file.Window(pos, MappedFile::kMaxWindow, ec);
+        if (ec || w.empty()) return false;
+        const char* p = w.data();
+        const char* end = p + w.size();
+        while (remaining > 0) {
+            const void* found = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+            if (!found) {
+                p = end;
+                break;
+            }
+            p = static_cast<const char*>(found) + 1;
+            --remaining;
+        }
+        pos += static_cast<std::uint64_t>(p - w.data());
+    }
+    // After a final newline there is no further line
+    if (line > 0 && pos >= file.Size()) return false;
+    offset = pos;
+    return true;
+}
+/* Nearest checkpoint at or before offset, plus the newlines between
+* @param offset
+* @param file
+* @param line
+* @param ec
+* @return true if offset is indexed
+*/
+bool LineIndex::OffsetToLine(std::uint64_t offset, MappedFile& file, std::uint64_t& line,
+                             std::error_code& ec) const {
+    ec.clear();
+    if (!state_ || offset >= file.Size()) return false;
+    std::uint64_t pos = 0;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->progress.done && offset >= state_->progress.scanned) return false;
+        const auto& marks = state_->marks;
+        const std::size_t mark = static_cast<std::size_t>(
+            std::upper_bound(marks.begin(), marks.end(), offset) - marks.begin() - 1);
+        line = mark * kStride;
+        pos = marks[mark];
+    }
+    while (pos < offset) {
+        const std::string_view w = file.Window(pos, static_cast<std::size_t>(
+            std::min<std::uint64_t>(offset - pos, MappedFile::kMaxWindow)), ec);
+        if (ec || w.empty()) return false;
+        line += StrSearch::CountByte(w, '\n');
+        pos += w.size();
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+/*
+    Description: Declare LineIndex, the background line-offset index of a
+                 file shown in the preview
+*/
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+
+/* Finds line starts in files of any size without holding them.
+                 - A worker preads the file kChunkBytes at a time and counts
+                   newlines with SSE2 (scalar elsewhere); it never maps it,
+                   so a truncated file ends the index instead of faulting
+                 - Only every kStride-th line start is kept, so 100 million
+                   lines cost about 800 KB; a lookup walks at most
+                   kStride - 1 newlines from the nearest checkpoint
+                 - Lookups work on the part scanned so far while it runs
+                 - Starting a new index cancels the previous one
+*/
+class LineIndex {
+public:
+    static constexpr std::uint64_t kStride = 1024;
+    static constexpr std::size_t kChunkBytes = 4 * 1024 * 1024;
+
+    struct Progress {
+        std::uint64_t scanned = 0; // Bytes indexed
+        std::uint64_t size = 0;    // File size when the index started
+        std::uint64_t lines = 0;   // Newlines seen so far
+        bool done = false;
+        bool openEnd = false;      // The last byte is not a newline
+        std::error_code ec;        // Why it stopped early
+
+        // Lines of the whole file, counting an unterminated last one
+        std::uint64_t Lines() const { return lines + (openEnd ? 1 : 0); }
+    };
+
+    ~LineIndex();
+
+    // Cancel the current index and start one for file
+    void Start(const std::filesystem::path& file);
+    // Cancel and wait for the worker
+    void Stop();
+    Progress GetProgress() const;
+
+    /* Offset where a line starts, walking from its checkpoint in file
+    * @param line: 0-based
+    * @param file: the same file, open; its window moves
+    * @param offset: receives the line's first byte
+    * @param ec
+    * @return false if the line is not indexed yet or past the end
+    */
+    bool LineToOffset(std::uint64_t line, MappedFile& file, std::uint64_t& offset, std::error_code& ec) const;
+
+    /* Line that contains a byte
+    * @param offset
+    * @param file: the same file, open; its window moves
+    * @param line: receives the 0-based line
+    * @param ec
+    * @return false if offset is not indexed yet
+    */
+    bool OffsetToLine(std::uint64_t offset, MappedFile& file, std::uint64_t& line, std::error_code& ec) const;
+
+    /* The scan kernel: count the newlines of data, which starts at byte
+    * base of the file, and append the start of every kStride-th line
+    * @param data
+    * @param base
+    * @param lines: newlines before data; advanced past it
+    * @param marks: receives the checkpoints crossed
+    */
+    static void ScanNewlines(std::string_view data, std::uint64_t base, std::uint64_t& lines,
+                             std::vector<std::uint64_t>& marks);
+
+private:
+    struct State {
+        mutable std::mutex mutex;
+        std::vector<std::uint64_t> marks; // marks[k] is where line k * kStride starts
+        Progress progress;
+        std::atomic<bool> cancel{false};
+    };
+    static void Run(std::filesystem::path file, std::shared_ptr<State> state);
+
+    std::shared_ptr<State> state_;
+    std::thread worker_;
+};
+
+#endif
@@ -3,41 +3,39 @@
     Date: Jan 26, 2026
     Description: Implement UI part
 */
-#include <chrono>
+#include <algorithm>
+#include <ctime>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
 
+#include <wx/filedlg.h>
 #include <wx/msgdlg.h>
+#include <wx/numdlg.h>
 #include <wx/utils.h>
 
+#include "FileActions.h"
 #include "FileOp.h"
 #include "MainFrame.h"
-/* Convert a machine time to a readable time for Date Modified
-* @param ftime: System time
-* @return wxStirng: Formatted time
-*/
-static wxString FormatFileTime(const std::filesystem::file_time_type& ftime) {
-    using namespace std::chrono;
-    auto sctp = time_point_cast<system_clock::duration>(ftime - std::filesystem::file_time_type::clock::now()
-        + system_clock::now());
-    std::time_t cftime = system_clock::to_time_t(sctp); 
-    std::tm* timeinfo = std::localtime(&cftime);
-    wxString formattedTime = wxString::Format("%04d-%02d-%02d %02d:%02d:%02d",
-        timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday,
-        timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
-    return formattedTime;
-}
+#include "SearchFrame.h"
+#include "DupFrame.h"
+#include "SyncFrame.h"
+#include "Trace.h"
 /* Create the main window and bind events
 * @param title
 */
 MainFrame::MainFrame(const wxString& title)
-    : wxFrame(nullptr, wxID_ANY, title, wxDefaultPosition, wxSize(800, 600))
+    : wxFrame(nullptr, wxID_ANY, title, wxDefaultPosition, wxSize(800, 600)),
+      nameIndex_(NameIndex::DefaultFile())
 {
     // Initialize and shortcuts
-    CreateStatusBar();
+    CreateStatusBar(2);
     SetStatusText("Ready");
     wxMenu* fileMenu = new wxMenu();
     fileMenu->Append(ID_NewDir, "&New...\tCtrl-N");
     fileMenu->Append(ID_Open,  "&Open...\tCtrl-O");
+    fileMenu->Append(ID_OpenExternal, "Open E&xternally\tCtrl-Shift-O");
     fileMenu->Append(ID_Rename,"&Rename...\tCtrl-E");
     fileMenu->Append(ID_Delete,"&Delete...\tDEL");
     fileMenu->AppendSeparator();
@@ -47,9 +45,28 @@ MainFrame::MainFrame(const wxString& title)
     editMenu->Append(ID_Copy,  "&Copy\tCtrl-C");
     editMenu->Append(ID_Cut,   "Cu&t\tCtrl-X");
     editMenu->Append(ID_Paste, "&Paste\tCtrl-V");
+    editMenu->AppendSeparator();
+    editMenu->Append(ID_FindInFiles, "&Find in Files...\tCtrl-Shift-F");
+    editMenu->Append(ID_FindDuplicates, "Find &Duplicates...\tCtrl-Shift-D");
+    editMenu->AppendSeparator();
+    editMenu->Append(ID_CopyThreads, "Copy &Threads...");
+    editMenu->AppendCheckItem(ID_VerifyCopies, "&Verify Copies");
 
     wxMenu* viewMenu = new wxMenu();
     viewMenu->Append(ID_Refresh, "&Refresh\tF5");
+    viewMenu->AppendCheckItem(ID_Preview, "&Preview Pane\tF3");
+    viewMenu->AppendSeparator();
+    viewMenu->Append(ID_CacheBudget, "Cache &Budget...");
+    viewMenu->Append(ID_CacheStats, "Cache &Statistics");
+    viewMenu->AppendSeparator();
+    viewMenu->AppendCheckItem(ID_DirSizes, "Directory Si&zes\tCtrl-U");
+    viewMenu->AppendCheckItem(ID_SortBySize, "Sort by &Size");
+    viewMenu->AppendSeparator();
+    viewMenu->Append(ID_NameIndex, "Name &Index...");
+    viewMenu->AppendSeparator();
+    viewMenu->AppendCheckItem(ID_Tracing, "&Tracing");
+    viewMenu->AppendCheckItem(ID_TraceStats, "Trace Statistics &Panel");
+    viewMenu->Append(ID_SaveTrace, "Save Trace...");
 
     wxMenu* helpMenu = new wxMenu();
     helpMenu->Append(ID_About, "&About");
@@ -63,35 +80,87 @@ MainFrame::MainFrame(const wxString& title)
     // Create UI components
     wxPanel* panel = new wxPanel(this);
     m_pathBar = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
-    m_fileList = new wxListCtrl(panel, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxLC_REPORT | wxLC_SINGLE_SEL);
+    m_filterBox = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxSize(200, -1));
+    m_filterBox->SetHint("Filter");
+    const wxString filterModes[] = { "Substring", "Glob", "Fuzzy" };
+    m_filterMode = new wxChoice(panel, wxID_ANY, wxDefaultPosition, wxDefaultSize, 3, filterModes);
+    m_filterMode->SetSelection(0);
+    m_nameMatches = new wxListBox(panel, wxID_ANY, wxDefaultPosition, wxSize(-1, 160), 0, nullptr, wxLB_SINGLE);
+    m_nameMatches->Hide();
+    m_fileList = new FileListCtrl(panel, wxID_ANY);
     SetupListColumns();
+    m_jobsPanel = new JobsPanel(panel, jobs_);
+    m_statsPanel = new StatsPanel(panel);
+    m_statsPanel->Hide();
+    m_previewPanel = new PreviewPanel(panel);
+    m_previewPanel->Hide();
   
     m_pathBar->Bind(wxEVT_TEXT_ENTER, &MainFrame::OnPathEnter, this);
+    m_pathBar->Bind(wxEVT_TEXT, &MainFrame::OnPathText, this);
+    m_nameMatches->Bind(wxEVT_LISTBOX_DCLICK, &MainFrame::OnNameMatch, this);
+    m_filterBox->Bind(wxEVT_TEXT, &MainFrame::OnFilter, this);
+    m_filterMode->Bind(wxEVT_CHOICE, &MainFrame::OnFilter, this);
     m_fileList->Bind(wxEVT_LIST_ITEM_ACTIVATED, &MainFrame::OnFileActivated, this);
+    m_fileList->Bind(wxEVT_LIST_ITEM_SELECTED, &MainFrame::OnItemSelected, this);
+    m_fileList->Bind(wxEVT_LIST_COL_CLICK, &MainFrame::OnColumnClick, this);
 
     // Bind events
     Bind(wxEVT_MENU, &MainFrame::OnNewDir, this, ID_NewDir);
     Bind(wxEVT_MENU, &MainFrame::OnOpen,   this, ID_Open);
+    Bind(wxEVT_MENU, &MainFrame::OnOpenExternal, this, ID_OpenExternal);
     Bind(wxEVT_MENU, &MainFrame::OnRename, this, ID_Rename);
     Bind(wxEVT_MENU, &MainFrame::OnDelete, this, ID_Delete);
 
     Bind(wxEVT_MENU, &MainFrame::OnCopy,   this, ID_Copy);
     Bind(wxEVT_MENU, &MainFrame::OnCut,    this, ID_Cut);
     Bind(wxEVT_MENU, &MainFrame::OnPaste,  this, ID_Paste);
+    Bind(wxEVT_MENU, &MainFrame::OnFindInFiles, this, ID_FindInFiles);
+    Bind(wxEVT_MENU, &MainFrame::OnFindDuplicates, this, ID_FindDuplicates);
+    Bind(wxEVT_MENU, &MainFrame::OnCopyThreads, this, ID_CopyThreads);
+    Bind(wxEVT_MENU, &MainFrame::OnVerifyCopies, this, ID_VerifyCopies);
+    Bind(wxEVT_MENU, &MainFrame::OnCacheBudget, this, ID_CacheBudget);
+    Bind(wxEVT_MENU, &MainFrame::OnCacheStats, this, ID_CacheStats);
+    Bind(wxEVT_MENU, &MainFrame::OnDirSizes, this, ID_DirSizes);
+    Bind(wxEVT_MENU, &MainFrame::OnSortBySize, this, ID_SortBySize);
+    Bind(wxEVT_MENU, &MainFrame::OnNameIndex, this, ID_NameIndex);
+    Bind(wxEVT_MENU, &MainFrame::OnTracing, this, ID_Tracing);
+    Bind(wxEVT_MENU, &MainFrame::OnTraceStats, this, ID_TraceStats);
+    Bind(wxEVT_MENU, &MainFrame::OnSaveTrace, this, ID_SaveTrace);
+    Bind(wxEVT_MENU, &MainFrame::OnPreview, this, ID_Preview);
 
     Bind(wxEVT_MENU, &MainFrame::OnRefresh,this, ID_Refresh);
     Bind(wxEVT_MENU, &MainFrame::OnAbout,  this, ID_About);
     Bind(wxEVT_MENU, &MainFrame::OnExit,   this, wxID_EXIT);
+    Bind(wxEVT_CLOSE_WINDOW, &MainFrame::OnClose, this);
     
     // Sizer
     wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
-    sizer->Add(m_pathBar, 0, wxEXPAND | wxALL, 5);
-    sizer->Add(m_fileList, 1, wxEXPAND | wxALL, 5);
+    wxBoxSizer *barSizer = new wxBoxSizer(wxHORIZONTAL);
+    barSizer->Add(m_pathBar, 1, wxEXPAND | wxRIGHT, 5);
+    barSizer->Add(m_filterBox, 0, wxEXPAND | wxRIGHT, 5);
+    barSizer->Add(m_filterMode, 0, wxEXPAND);
+    sizer->Add(barSizer, 0, wxEXPAND | wxALL, 5);
+    sizer->Add(m_nameMatches, 0, wxEXPAND | wxLEFT | wxRIGHT, 5);
+    wxBoxSizer *listSizer = new wxBoxSizer(wxHORIZONTAL);
+    listSizer->Add(m_fileList, 1, wxEXPAND);
+    listSizer->Add(m_previewPanel, 1, wxEXPAND | wxLEFT, 5);
+    sizer->Add(listSizer, 1, wxEXPAND | wxALL, 5);
+    sizer->Add(m_jobsPanel, 0, wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM, 5);
+    sizer->Add(m_statsPanel, 0, wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM, 5);
     panel->SetSizer(sizer);
 
     // Get current file info
     currentPath_ = std::filesystem::current_path();
     RefreshFileList(currentPath_);
+    StartNameIndex();
+}
+/* Stop the background loader before the window goes away
+*/
+MainFrame::~MainFrame() {
+    jobs_.Shutdown(); // Cancels what is still running
+    nameIndex_.StopWatching();
+    watcher_.Stop();
+    loader_.Shutdown();
 }
 /* Read selection and return the corresponding path
 * @param outPath: ouput receiving the selected path
@@ -99,19 +168,69 @@ MainFrame::MainFrame(const wxString& title)
 */
 bool MainFrame::TryGetSelectedPath(std::filesystem::path& outPath) const {
     long item = m_fileList->GetNextItem(-1, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED);
-    if (item == -1 || item >=(long)(rowPaths_.size())) {
+    if (item == -1) {
+        return false;
+    }
+    return TryGetRowPath(item, outPath);
+}
+/* Show the pane if hidden and load p into it
+* @param p
+*/
+void MainFrame::ShowPreview(const std::filesystem::path& p) {
+    if (!m_previewPanel->IsShown()) {
+        m_previewPanel->Show();
+        GetMenuBar()->Check(ID_Preview, true);
+        m_previewPanel->GetParent()->Layout();
+    }
+    m_previewPanel->ShowFile(p);
+}
+/* Read every selected row; the ".." row is not an entry and is skipped
+* @param outPaths: ouput receiving the selected paths
+* @return true if at least one entry is selected
+*/
+bool MainFrame::TryGetSelectedPaths(std::vector<std::filesystem::path>& outPaths) const {
+    outPaths.clear();
+    long item = -1;
+    while ((item = m_fileList->GetNextItem(item, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED)) != -1) {
+        std::size_t index = 0;
+        if (m_fileList->RowToEntry(item, index)) {
+            outPaths.push_back(currentPath_ / std::string(entries_.Name(index)));
+        }
+    }
+    return !outPaths.empty();
+}
+/* Name a set of paths for messages: the path itself, or a count
+* @param paths
+* @return wxString
+*/
+static wxString DescribePaths(const std::vector<std::filesystem::path>& paths) {
+    if (paths.size() == 1) return wxString(paths.front().wstring());
+    return wxString::Format("%llu items", static_cast<unsigned long long>(paths.size()));
+}
+/* Build the path of a row from currentPath_ and the stored name
+* @param row: list row
+* @param outPath: ouput receiving the row path
+* @return true if the row exists
+*/
+bool MainFrame::TryGetRowPath(long row, std::filesystem::path& outPath) const {
+    if (m_fileList->IsParentRow(row)) {
+        outPath = currentPath_.parent_path();
+        return true;
+    }
+    std::size_t index = 0;
+    if (!m_fileList->RowToEntry(row, index)) {
         return false;
     }
-    outPath = rowPaths_[item];
+    outPath = currentPath_ / std::string(entries_.Name(index));
     return true;
 }
 /* Prompting the user for confirmation before deletion
 * @param dest: destination path
+* @param destStat: stat of dest
 * @return true if user wants to overwrite/dest dne
 */
-bool MainFrame::ConfirmOverwriteIfExists(const std::filesystem::path& dest) {
-    std::error_code ec;
-    if (std::filesystem::exists(dest, ec)) {
+bool MainFrame::ConfirmOverwriteIfExists(const std::filesystem::path& dest, const FileStat& destStat) {
+    if (destStat.exists) {
         int response = wxMessageBox("The file or directory \"" + wxString(dest.filename().wstring()) +
                                     "\" already exists. Do you want to overwrite it?",
                                     "Confirm Overwrite",
@@ -145,7 +264,7 @@ void MainFrame::OnExit(wxCommandEvent& event) {
 * @return void
 */
 void MainFrame::OnRefresh(wxCommandEvent& event) {
-    RefreshFileList(currentPath_);
+    RefreshFileList(currentPath_, false);
 }
 /* Display the program info
 * @param event
@@ -166,74 +285,111 @@ void MainFrame::UpdatePathUI() {
         SetTitle("File Manager - " + p);
     }
 }
-/* Validates the dir, and add entry for parent navi
+/* Validates the dir, and add entry for parent navi. The listing being left
+* is kept in dirCache_; the new one comes from there if its stamp still
+* matches, otherwise it is loaded in the background. One stat of path
+* serves the check, the cache lookup and the new listing's stamp.
 * @param path: Dir path
+* @param useCache: false to skip dirCache_
+* @param known: stat of path if the caller has one
 */
-void MainFrame::RefreshFileList(const std::filesystem::path& path) {
+void MainFrame::RefreshFileList(const std::filesystem::path& path, bool useCache, const FileStat* known) {
+    TRACE_SCOPE(kUi, "RefreshFileList");
+    const FileStat dirStat = known ? *known : FileStat::Of(path);
     // Error for filesystem
-    std::error_code ec;
-    if (!std::filesystem::exists(path, ec) || !std::filesystem::is_directory(path, ec)) {
+    if (!dirStat.IsDir()) {
         wxMessageBox("Invalid directory:\n" + wxString(path.string()),
                      "Error",
                      wxOK | wxICON_ERROR,
                      this);
         return;
     }
+    if (useCache && listingComplete_) {
+        dirCache_.Store(currentPath_, listingStamp_,
+                        std::make_shared<const EntryStore>(std::move(entries_)));
+    }
+    listingComplete_ = false;
+    if (path != currentPath_) {
+        // A filter belongs to the listing it was typed for
+        m_filterBox->ChangeValue("");
+        m_fileList->SetFilter(static_cast<MatchMode>(m_filterMode->GetSelection()), "");
+    }
     currentPath_ = path;
     UpdatePathUI();
-    m_fileList->DeleteAllItems();
-    rowPaths_.clear(); // Clear previous paths
+    entries_.Clear();
+    pendingDeltas_.clear();
+    CancelDirSizes();
+    dirTotals_.clear();
+    sizesUseCache_ = useCache;
+    // Watch before listing so nothing that changes during the load is missed
+    watcher_.Start(path, [this](std::uint64_t generation, std::shared_ptr<DirDelta> delta) {
+        CallAfter([this, generation, delta]() {
+            OnDirDelta(generation, delta);
+        });
+    });
+    const bool hasParentRow = currentPath_ != currentPath_.root_path();
 
-    // Go back to parent directory
-    if (currentPath_ != currentPath_.root_path()) {
-        long row = m_fileList->InsertItem(m_fileList->GetItemCount(), "..");
-        m_fileList->SetItem(row, 1, "Dir");
-        m_fileList->SetItem(row, 2, "");
-        m_fileList->SetItem(row, 3, "");
-        rowPaths_.push_back(currentPath_.parent_path()); // Store parent path
+    DirStamp now;
+    DirStamp stamp;
+    std::shared_ptr<const EntryStore> cached = FileActions::CachedListing(path, dirStat, useCache,
+                                                                          dirCache_, now, stamp);
+    if (cached) {
+        loader_.Cancel();
+        loading_ = false;
+        listingComplete_ = true;
+        listingStamp_ = stamp;
+        entries_ = *cached;
+        m_fileList->SetEntries(&entries_, hasParentRow);
+        SetStatusText(wxString::Format("%llu entries (cached)",
+                                      static_cast<unsigned long long>(entries_.Size())), 1);
+        SelectPending();
+        StartDirSizes();
+        return;
     }
+    listingStamp_ = now;
+    loading_ = true;
+    // Go back to parent directory is row 0 when there is a parent
+    m_fileList->SetEntries(&entries_, hasParentRow);
+    SetStatusText("Loading...", 1);
 
-    // Iterate through directory entries
-    for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
-        if(ec)break;
-        // Get file path and name
-        const auto p = entry.path();
-        wxString name = p.filename().wstring();
-        // Insert
-        long row = m_fileList->InsertItem(m_fileList->GetItemCount(), name);
-        // Store path to the row
-        rowPaths_.push_back(p);
-        std::error_code ec2;
-        // Type
-        const bool isDir = entry.is_directory(ec2);
-        if (ec2) {
-            // If cannot determine the type, mark unknown but still keep a row
-            m_fileList->SetItem(row, 1, "N/A");
-            m_fileList->SetItem(row, 2, "N/A");
-            m_fileList->SetItem(row, 3, "N/A");
-            continue;
-        }
-        m_fileList->SetItem(row, 1, isDir ? "Dir" : "File");
-        // File Size
-        if (!isDir) {
-            const auto size = entry.file_size(ec2);
-            if (!ec2) {
-                m_fileList->SetItem(row, 2,
-                    wxString::Format("%llu bytes", static_cast<unsigned long long>(size)));
-            } else {
-                m_fileList->SetItem(row, 2, "N/A");
-            }
-        } else {
-            m_fileList->SetItem(row, 2, "");
-        }
-        // Update modified time
-        auto mt = entry.last_write_time(ec2);
-        if (!ec2) {
-            m_fileList->SetItem(row, 3, FormatFileTime(mt));
-        }else{
-            m_fileList->SetItem(row, 3, "N/A");
-        }
+    // Enumerate on a worker; starting a new load cancels the previous one
+    loader_.Start(path, [this](std::uint64_t generation, std::shared_ptr<EntryStore> batch,
+                               bool done, std::error_code err) {
+        CallAfter([this, generation, batch, done, err]() {
+            OnDirBatch(generation, batch, done, err);
+        });
+    });
+}
+/* Append a batch of entries and update the live count
+* @param generation
+* @param batch
+* @param done
+* @param ec
+*/
+void MainFrame::OnDirBatch(std::uint64_t generation, std::shared_ptr<EntryStore> batch,
+                           bool done, std::error_code ec) {
+    if (generation != loader_.Generation()) return; // Stale batch from a cancelled load
+    TRACE_SCOPE_ARG(scope, kUi, "InsertBatch");
+    TRACE_SET_ARG(scope, batch->Size());
+    entries_.Append(*batch);
+    // Sorting every batch of a huge directory would be quadratic; new rows
+    // stay at the end until the last batch is in
+    m_fileList->SetEntries(&entries_, currentPath_ != currentPath_.root_path(), done);
+    if (!done) {
+        SetStatusText(wxString::Format("Loading... %llu entries",
+                                      static_cast<unsigned long long>(entries_.Size())), 1);
+        return;
     }
+    loading_ = false;
+    listingComplete_ = !ec;
+    // Changes seen while loading; upserts match by name so overlap is harmless
+    for (const auto& delta : pendingDeltas_) {
+        ApplyDelta(*delta);
+    }
+    pendingDeltas_.clear();
+    SelectPending();
+    StartDirSizes();
+    UpdateEntryCount();
     // Error handle
     if (ec){
         wxMessageBox("Failed to list directory:\n" + wxString(currentPath_.wstring()) +
@@ -243,15 +399,258 @@ void MainFrame::RefreshFileList(const std::filesystem::path& path) {
                     this);   
     }     
 }
+/* Queue or apply a coalesced change set from the watcher
+* @param generation
+* @param delta
+*/
+void MainFrame::OnDirDelta(std::uint64_t generation, std::shared_ptr<DirDelta> delta) {
+    if (generation != watcher_.Generation()) return; // From a previous directory
+    if (delta->rescan) {
+        RefreshFileList(currentPath_, false); // Events were lost
+        return;
+    }
+    if (loading_) {
+        pendingDeltas_.push_back(delta);
+        return;
+    }
+    ApplyDelta(*delta);
+    StartDirSizes();
+    UpdateEntryCount();
+}
+/* Remove, update and append rows by name. Applying the same delta twice
+* gives the same result, so our own changes and the watcher's echo of them
+* can both be applied.
+* @param delta
+*/
+void MainFrame::ApplyDelta(const DirDelta& delta) {
+    TRACE_SCOPE(kUi, "ApplyDelta");
+    std::vector<std::size_t> gone;
+    for (const std::string& name : delta.removed) {
+        const std::size_t i = entries_.Find(name);
+        if (i != EntryStore::npos) gone.push_back(i);
+    }
+    // Rows after a removed entry shift up; remember the selection by name
+    std::vector<std::string> selectedNames;
+    std::string focusedName;
+    if (!gone.empty()) {
+        std::size_t index = 0;
+        long row = -1;
+        while ((row = m_fileList->GetNextItem(row, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED)) != -1) {
+            if (m_fileList->RowToEntry(row, index)) selectedNames.emplace_back(entries_.Name(index));
+        }
+        row = m_fileList->GetNextItem(-1, wxLIST_NEXT_ALL, wxLIST_STATE_FOCUSED);
+        if (row != -1 && m_fileList->RowToEntry(row, index)) focusedName = std::string(entries_.Name(index));
+    }
+    const bool rowsShift = !gone.empty();
+    entries_.Remove(std::move(gone));
+    // Changed names need new totals, and so does everything above them
+    bool sizesChanged = false;
+    for (const std::string& name : delta.removed) {
+        sizesChanged |= dirTotals_.erase(name) + sizesPending_.erase(name) > 0;
+    }
+    for (std::size_t u = 0; u < delta.upserts.Size(); ++u) {
+        const std::string_view name = delta.upserts.Name(u);
+        if (FileOp::IsStagingName(name)) continue; // Transient, part of an overwrite (DirLoader skips them too)
+        if (delta.upserts.Type(u) == EntryType::Dir) {
+            const std::string key(name);
+            dirTotals_.erase(key);
+            sizesPending_.erase(key);
+            sizesChanged = true;
+        }
+        const std::size_t i = entries_.Find(name);
+        if (i == EntryStore::npos) {
+            entries_.Append(name, delta.upserts.Type(u), delta.upserts.FileSize(u),
+                            delta.upserts.MTime(u));
+        } else {
+            entries_.Update(i, delta.upserts.Type(u), delta.upserts.FileSize(u),
+                            delta.upserts.MTime(u));
+        }
+    }
+    // Only watcher deltas move the stamp; a local delta may race with
+    // changes the watcher has not reported yet
+    if (delta.stamp.Valid()) listingStamp_ = delta.stamp;
+    if (sizesChanged) duCache_.InvalidateUp(currentPath_);
+    m_fileList->SetEntries(&entries_, currentPath_ != currentPath_.root_path());
+
+    if (rowsShift) {
+        m_fileList->SetItemState(-1, 0, wxLIST_STATE_SELECTED); // Clear every row
+        for (const std::string& name : selectedNames) {
+            const std::size_t i = entries_.Find(name);
+            const long row = i == EntryStore::npos ? -1 : m_fileList->EntryToRow(i);
+            if (row != -1) {
+                m_fileList->SetItemState(row, wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED);
+            }
+        }
+        const std::size_t i = focusedName.empty() ? EntryStore::npos : entries_.Find(focusedName);
+        const long row = i == EntryStore::npos ? -1 : m_fileList->EntryToRow(i);
+        if (row != -1) {
+            m_fileList->SetItemState(row, wxLIST_STATE_FOCUSED, wxLIST_STATE_FOCUSED);
+        }
+    }
+}
+/* Stat the affected names in currentPath_ and apply them as a delta
+* @param paths
+*/
+void MainFrame::ApplyLocalChanges(const std::vector<std::filesystem::path>& paths) {
+    std::vector<std::string> names;
+    for (const auto& p : paths) {
+        if (p.parent_path() == currentPath_) names.push_back(p.filename().string());
+    }
+    if (names.empty()) return;
+    auto delta = std::make_shared<DirDelta>();
+    DirWatcher::StatNames(currentPath_, names, *delta);
+    if (loading_) {
+        pendingDeltas_.push_back(delta);
+        return;
+    }
+    ApplyDelta(*delta);
+    StartDirSizes();
+    UpdateEntryCount();
+}
+/* Entry count in the second status field, with the total size of the
+* directory once every directory total is in
+*/
+void MainFrame::UpdateEntryCount() {
+    wxString text = wxString::Format("%llu entries", static_cast<unsigned long long>(entries_.Size()));
+    if (m_fileList->IsFiltered()) {
+        text = wxString::Format("%llu of %s", static_cast<unsigned long long>(m_fileList->VisibleCount()), text);
+    }
+    if (dirSizes_) {
+        DuTotal total;
+        bool complete = sizesPending_.empty();
+        for (std::size_t i = 0; i < entries_.Size(); ++i) {
+            if (entries_.Type(i) == EntryType::Dir) {
+                auto found = dirTotals_.find(std::string(entries_.Name(i)));
+                if (found == dirTotals_.end()) complete = false;
+                else total.Add(found->second);
+            } else if (entries_.FileSize(i) != EntryStore::kUnknownSize) {
+                total.bytes += entries_.FileSize(i);
+            }
+        }
+        if (!complete) text += ", calculating sizes...";
+        else text += wxString::Format(total.cached ? ", ~%.1f MB (cached, F5 to recount)" : ", %.1f MB",
+                                      total.bytes / (1024.0 * 1024.0));
+    }
+    SetStatusText(text, 1);
+}
+/* Look up or walk the directories of entries_ that have no total yet. One
+* walk covers all of them on a shared pool; totals are handed to the list
+* every kSizesFlushInterval, and every subdirectory it finishes is cached.
+*/
+void MainFrame::StartDirSizes() {
+    if (!dirSizes_ || loading_) return;
+    std::vector<std::filesystem::path> roots;
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < entries_.Size(); ++i) {
+        if (entries_.Type(i) != EntryType::Dir) continue;
+        std::string name(entries_.Name(i));
+        if (dirTotals_.count(name) || sizesPending_.count(name)) continue;
+        std::filesystem::path dir = currentPath_ / name;
+        DuTotal total;
+        if (sizesUseCache_ && duCache_.Lookup(dir, total)) {
+            dirTotals_.emplace(std::move(name), total);
+            continue;
+        }
+        roots.push_back(std::move(dir));
+        names.push_back(std::move(name));
+    }
+    m_fileList->RefreshRows();
+    if (roots.empty()) return;
+
+    const std::uint64_t token = ++sizesToken_;
+    for (const std::string& name : names) sizesPending_[name] = token;
+    const wxString title = "Sizes of " + wxString(currentPath_.wstring());
+    const std::uint64_t id = jobs_.Submit(std::string(title.utf8_str()), roots,
+                                          [this, dir = currentPath_, roots, names, token](
+                                              OpProgress& progress, std::error_code& ec,
+                                              std::filesystem::path& errorPath) {
+        using Clock = std::chrono::steady_clock;
+        std::mutex mutex;
+        std::vector<std::pair<std::string, DuTotal>> ready;
+        Clock::time_point lastFlush = Clock::now();
+        auto flush = [this, token, &ready]() {
+            if (ready.empty()) return;
+            CallAfter([this, token, batch = std::move(ready)]() {
+                OnDirTotals(token, batch);
+            });
+            ready.clear();
+        };
+        DuOptions options;
+        options.progress = &progress;
+        std::vector<DuTotal> totals;
+        const bool ok = DiskUsage::Walk(roots, options, [&](std::size_t root, const std::filesystem::path& walked,
+                                                            const DirStamp& stamp, const DuTotal& total) {
+            duCache_.Store(walked, stamp, total);
+            if (walked != roots[root]) return;
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.emplace_back(names[root], total);
+            if (Clock::now() - lastFlush >= kSizesFlushInterval) {
+                flush();
+                lastFlush = Clock::now();
+            }
+        }, totals, ec);
+        if (!ok) errorPath = dir;
+        std::lock_guard<std::mutex> lock(mutex);
+        flush();
+        return ok;
+    }, [this, token](const JobInfo& info) {
+        CallAfter([this, token, id = info.id]() {
+            // Names a cancelled walk never delivered stay without a total
+            for (auto it = sizesPending_.begin(); it != sizesPending_.end();) {
+                it = it->second == token ? sizesPending_.erase(it) : std::next(it);
+            }
+            sizeJobs_.erase(std::remove(sizeJobs_.begin(), sizeJobs_.end(), id), sizeJobs_.end());
+            m_jobsPanel->RefreshJobs();
+            UpdateEntryCount();
+        });
+    });
+    sizeJobs_.push_back(id);
+    m_jobsPanel->RefreshJobs();
+    UpdateEntryCount();
+}
+/* Show totals from a walk that still belongs to the current listing
+* @param token
+* @param totals
+*/
+void MainFrame::OnDirTotals(std::uint64_t token, std::vector<std::pair<std::string, DuTotal>> totals) {
+    for (auto& [name, total] : totals) {
+        auto pending = sizesPending_.find(name);
+        if (pending == sizesPending_.end() || pending->second != token) continue; // Stale
+        sizesPending_.erase(pending);
+        dirTotals_[name] = total;
+    }
+    m_fileList->RefreshRows();
+    UpdateEntryCount();
+}
+/* Stop walking the subdirectories of the directory being left
+*/
+void MainFrame::CancelDirSizes() {
+    for (std::uint64_t id : sizeJobs_) jobs_.Cancel(id);
+    sizesPending_.clear();
+}
 /* Handle path input
 * @param event
 */
 void MainFrame::OnPathEnter(wxCommandEvent& event) {
     wxString pathStr = m_pathBar->GetValue();
+    wxString name;
+    if (pathStr.StartsWith("?", &name)) {
+        // Enter takes the highlighted hit, the first one unless moved
+        const int row = m_nameMatches->IsShown() ? m_nameMatches->GetSelection() : wxNOT_FOUND;
+        if (row == wxNOT_FOUND) {
+            SetStatusText("No indexed name contains \"" + name + "\"");
+            return;
+        }
+        const std::filesystem::path match(m_nameMatches->GetString(row).ToStdWstring());
+        HideNameMatches();
+        UpdatePathUI();
+        Reveal(match);
+        return;
+    }
     std::filesystem::path newPath(pathStr.ToStdWstring());
-    std::error_code ec;
-    if (std::filesystem::exists(newPath, ec) && std::filesystem::is_directory(newPath, ec)) {
-        RefreshFileList(newPath);
+    const FileStat newStat = FileStat::Of(newPath);
+    if (newStat.IsDir()) {
+        RefreshFileList(newPath, true, &newStat);
     } else {
         wxMessageBox("Invalid path:\n" + pathStr,
                      "Error",
@@ -264,24 +663,16 @@ void MainFrame::OnPathEnter(wxCommandEvent& event) {
 * @param event
 */
 void MainFrame::OnFileActivated(wxListEvent& event) {
-    long itemIndex = event.GetIndex();
-    if (itemIndex < 0 || itemIndex >= (long)(rowPaths_.size())) {
+    std::filesystem::path selectedPath;
+    if (!TryGetRowPath(event.GetIndex(), selectedPath)) {
         return; // Invalid index
     }
-    std::filesystem::path selectedPath = rowPaths_[itemIndex];
-    std::error_code ec;
-    if (std::filesystem::is_directory(selectedPath, ec)) {
-        RefreshFileList(selectedPath);
+    const FileStat selectedStat = FileStat::Of(selectedPath);
+    if (selectedStat.IsDir()) {
+        RefreshFileList(selectedPath, true, &selectedStat);
         return;
     } else {
-        // Open file with default application
-        wxString filePathStr = selectedPath.wstring();
-        if (!wxLaunchDefaultApplication(filePathStr)) {
-            wxMessageBox("Failed to open file:\n" + filePathStr,
-                         "Error",
-                         wxOK | wxICON_ERROR,
-                         this);
-        }
+        ShowPreview(selectedPath);
     }
 }
 
@@ -298,18 +689,32 @@ void MainFrame::OnOpen(wxCommandEvent& event) {
                      this);
         return;
     }
-    std::error_code ec;
-    if (std::filesystem::is_directory(selectedPath, ec)) {
-        RefreshFileList(selectedPath);
+    const FileStat selectedStat = FileStat::Of(selectedPath);
+    if (selectedStat.IsDir()) {
+        RefreshFileList(selectedPath, true, &selectedStat);
     } else {
-        // Open file with default application
-        wxString filePathStr = selectedPath.wstring();
-        if (!wxLaunchDefaultApplication(filePathStr)) {
-            wxMessageBox("Failed to open file:\n" + filePathStr,
-                         "Error",
-                         wxOK | wxICON_ERROR,
-                         this);
-        }
+        ShowPreview(selectedPath);
+    }
+}
+/* Open the selected item with its default application
+* @param event
+* @return void
+*/
+void MainFrame::OnOpenExternal(wxCommandEvent& event) {
+    std::filesystem::path selectedPath;
+    if (!TryGetSelectedPath(selectedPath)) {
+        wxMessageBox("No file or directory selected to open.",
+                     "Error",
+                     wxOK | wxICON_ERROR,
+                     this);
+        return;
+    }
+    wxString filePathStr = selectedPath.wstring();
+    if (!wxLaunchDefaultApplication(filePathStr)) {
+        wxMessageBox("Failed to open file:\n" + filePathStr,
+                     "Error",
+                     wxOK | wxICON_ERROR,
+                     this);
     }
 }
 /* Propmt user for a dir name and create a new one
@@ -324,7 +729,7 @@ void MainFrame::OnNewDir(wxCommandEvent& event) {
         std::error_code ec;
         if (FileOp::CreateDir(newDirPath, ec)) {
             SetStatusText("Created directory: " + wxString(newDirPath.wstring()));
-            RefreshFileList(currentPath_);
+            ApplyLocalChanges({newDirPath});
         } else {
             wxMessageBox("Failed to create directory:\n" + wxString(newDirPath.wstring()),
                          "Error",
@@ -352,120 +757,652 @@ void MainFrame::OnRename(wxCommandEvent& event) {
         wxString newName = dialog.GetValue();
         std::filesystem::path newPath = selectedPath.parent_path() / newName.ToStdWstring();
         bool overwrite = false;
-        std::error_code ec;
-        if (FileOp::Exists(newPath, ec) && !ec) {
-            if (!ConfirmOverwriteIfExists(newPath)) return;
+        // The overwrite check and the rename share these stats
+        auto statCache = std::make_shared<StatCache>();
+        const FileStat newStat = statCache->Get(newPath);
+        if (newStat.exists) {
+            if (!ConfirmOverwriteIfExists(newPath, newStat)) return;
             overwrite = true;
         }
-        if (!FileOp::RenamePath(selectedPath, newPath, overwrite, ec)) {
-            wxMessageBox("Rename failed:\n" + wxString(ec.message()),
-                     "Error", wxOK | wxICON_ERROR, this);
-            return;
-        }
-        SetStatusText("Renamed to: " + wxString(newPath.wstring()));
-        RefreshFileList(currentPath_);
+        // A job queued behind others may find things changed; it stats again
+        if (jobs_.Busy()) statCache->Clear();
+        SubmitJob("Rename " + wxString(selectedPath.filename().wstring()) + " to " + newName,
+                  "Rename failed:", {selectedPath, newPath},
+                  [selectedPath, newPath, overwrite, statCache](OpProgress& progress, std::error_code& ec,
+                                                                std::filesystem::path& errorPath) {
+            errorPath = selectedPath;
+            return FileOp::RenamePath(selectedPath, newPath, overwrite, *statCache, ec);
+        }, [this, newPath](const JobInfo& info) {
+            SetStatusText("Renamed to: " + wxString(newPath.wstring()));
+        });
     }
     else return;
 }
-/* Ask for confirmation for the selected file or dir, then delete
+/* Ask once for confirmation for the selected files and dirs, then delete
+* them all in one job
 * @param event
 * @return void
 */
 void MainFrame::OnDelete(wxCommandEvent& event) {
-    std::filesystem::path selectedPath;
-    if (!TryGetSelectedPath(selectedPath)) {
+    std::vector<std::filesystem::path> selectedPaths;
+    if (!TryGetSelectedPaths(selectedPaths)) {
         wxMessageBox("No file or directory selected to delete.",
                      "Error",
                      wxOK | wxICON_ERROR,
                      this);
         return;
     }
-    int answer = wxMessageBox("Are you sure you want to delete:\n" +
-                            wxString(selectedPath.wstring()) + "?",
+    const wxString what = DescribePaths(selectedPaths);
+    int answer = wxMessageBox("Are you sure you want to delete:\n" + what + "?",
                             "Confirm Deletion",
                             wxYES_NO | wxICON_QUESTION,
                             this);
     if (answer != wxYES) return;
-    std::error_code ec;
-    if (!FileOp::DeletePath(selectedPath, ec)) {
-        wxMessageBox("Delete failed:\n" + wxString(ec.message()),
-                     "Error",
-                     wxOK | wxICON_ERROR,
-                     this);
-        return;
-    }
-    SetStatusText("Deleted: " + wxString(selectedPath.wstring()));
-    RefreshFileList(currentPath_);
+    auto stats = std::make_shared<DeleteStats>();
+    auto failures = std::make_shared<std::vector<PathError>>();
+    SubmitJob("Delete " + what, "Delete failed:", selectedPaths,
+              [selectedPaths, stats, failures](OpProgress& progress, std::error_code& ec,
+                                               std::filesystem::path& errorPath) {
+        DeleteOptions options;
+        options.progress = &progress;
+        const bool ok = FileOp::DeletePaths(selectedPaths, options, *stats, *failures, ec);
+        errorPath = stats->errorPath;
+        return ok;
+    }, [this, what, stats](const JobInfo& info) {
+        SetStatusText(wxString::Format("Deleted: %s (%llu entries, %.0f entries/s)", what,
+                                       static_cast<unsigned long long>(stats->entries),
+                                       stats->EntriesPerSecond()));
+    }, failures);
 }
-/* Mark the selected file in virtual clipboard
+/* Mark the selected files in virtual clipboard
 * @param event
 * @return void
 */
 void MainFrame::OnCopy(wxCommandEvent& event) {
-    std::filesystem::path selectedPath;
-    if (!TryGetSelectedPath(selectedPath)) {
+    std::vector<std::filesystem::path> selectedPaths;
+    if (!TryGetSelectedPaths(selectedPaths)) {
         wxMessageBox("No file or directory selected to copy.",
                      "Error",
                      wxOK | wxICON_ERROR,
                      this);
         return;
     }
-    clipboardPath_ = selectedPath;
+    clipboardPaths_ = std::move(selectedPaths);
     clipMode_ = ClipMode::Copy;
-    SetStatusText("Marked for copy: " + wxString(clipboardPath_.wstring()));
+    SetStatusText("Marked for copy: " + DescribePaths(clipboardPaths_));
 }
 /* Cut a file, marking a file in a virtual clipboard to be moved with a later paste operation.  The status bar should display a message indicating the given file was marked for cutting.
 * @param event
 * @return void
 */
 void MainFrame::OnCut(wxCommandEvent& event) {
-    std::filesystem::path selectedPath;
-    if (!TryGetSelectedPath(selectedPath)) {
+    std::vector<std::filesystem::path> selectedPaths;
+    if (!TryGetSelectedPaths(selectedPaths)) {
         wxMessageBox("No file or directory selected to cut.",
                      "Error",
                      wxOK | wxICON_ERROR,
                      this);
         return;
     }
-    clipboardPath_ = selectedPath;
+    clipboardPaths_ = std::move(selectedPaths);
     clipMode_ = ClipMode::Cut;
-    SetStatusText("Cut: " + wxString(clipboardPath_.wstring()));
+    SetStatusText("Cut: " + DescribePaths(clipboardPaths_));
 }
 /* Paste a file, completing a copy or cut operation by copying or moving the marked file into the current directory depending on whether it was copied or cut in the first place.
 * @param event
 * @return void
 */
 void MainFrame::OnPaste(wxCommandEvent& event) {
-    if (clipMode_ == ClipMode::None || clipboardPath_.empty()) {
+    if (clipMode_ == ClipMode::None || clipboardPaths_.empty()) {
         wxMessageBox("Clipboard is empty.", "Error", wxOK | wxICON_ERROR, this);
         return;
     }
 
-    std::filesystem::path destPath = currentPath_ / clipboardPath_.filename();
-
+    // Ask once for all names that already exist here
+    // Each path is stat'ed once for the checks here and the job's own
+    auto statCache = std::make_shared<StatCache>();
+    const bool isCopy = clipMode_ == ClipMode::Copy;
+    const PastePlan plan = FileActions::PlanPaste(clipboardPaths_, currentPath_, isCopy, *statCache);
+    const std::vector<std::filesystem::path>& existing = plan.existing;
     bool overwrite = false;
-    std::error_code ec;
-    if (FileOp::Exists(destPath, ec) && !ec) {
-        if (!ConfirmOverwriteIfExists(destPath)) return;
+    if (plan.syncable) {
+        wxMessageDialog ask(this, wxString::Format("%llu of the %llu items are folders that already exist here, "
+                                                   "e.g. \"%s\".\nSync copies only what changed; "
+                                                   "Replace copies them again.",
+                                                   static_cast<unsigned long long>(existing.size()),
+                                                   static_cast<unsigned long long>(clipboardPaths_.size()),
+                                                   wxString(existing.front().filename().wstring())),
+                            "Folder Exists", wxYES_NO | wxCANCEL | wxICON_QUESTION);
+        ask.SetYesNoCancelLabels("&Sync", "&Replace", "Cancel");
+        const int answer = ask.ShowModal();
+        if (answer == wxID_CANCEL) return;
+        overwrite = answer == wxID_NO;
+        if (!overwrite) {
+            // Each folder gets a compare window; the sync starts from there
+            for (const auto& src : existing) OpenSync(src, currentPath_ / src.filename());
+            if (existing.size() == clipboardPaths_.size()) {
+                clipboardPaths_.clear();
+                clipMode_ = ClipMode::None;
+                SetStatusText("Comparing before sync. Clipboard is now empty.");
+                return;
+            }
+        }
+    } else if (existing.size() == 1 && clipboardPaths_.size() == 1) {
+        const std::filesystem::path dest = currentPath_ / existing.front().filename();
+        if (!ConfirmOverwriteIfExists(dest, statCache->Get(dest))) return;
         overwrite = true;
+    } else if (!existing.empty()) {
+        int answer = wxMessageBox(wxString::Format("%llu of the %llu items already exist here, "
+                                                   "e.g. \"%s\".\nOverwrite them? "
+                                                   "Choose No to skip them.",
+                                                   static_cast<unsigned long long>(existing.size()),
+                                                   static_cast<unsigned long long>(clipboardPaths_.size()),
+                                                   wxString(existing.front().filename().wstring())),
+                                  "Confirm Overwrite",
+                                  wxYES_NO | wxCANCEL | wxICON_QUESTION,
+                                  this);
+        if (answer == wxCANCEL) return;
+        overwrite = answer == wxYES;
     }
-    bool success = false;
-    if (clipMode_ == ClipMode::Copy) {
-        success = FileOp::CopyPath(clipboardPath_, destPath, overwrite, ec);
-    } else if (clipMode_ == ClipMode::Cut) {
-        success = FileOp::MovePath(clipboardPath_, destPath, overwrite, ec);
+    const std::vector<std::filesystem::path> srcs = FileActions::PasteSources(clipboardPaths_, plan, overwrite);
+    if (srcs.empty()) {
+        SetStatusText("Nothing to paste: every item already exists.");
+        return;
     }
+    CopyOptions options;
+    options.threads = copyThreads_;
+    options.verify = verifyCopies_;
+    // A job queued behind others may find things changed; it stats again
+    if (jobs_.Busy()) statCache->Clear();
+    auto stats = std::make_shared<CopyStats>();
+    auto failures = std::make_shared<std::vector<PathError>>();
+    const std::filesystem::path destDir = currentPath_;
+    std::vector<std::filesystem::path> touches = srcs;
+    for (const auto& src : srcs) touches.push_back(destDir / src.filename());
+    // clipboard is empty after paste
+    clipboardPaths_.clear();
+    clipMode_ = ClipMode::None;
 
-    if (!success) {
-        wxMessageBox("Failed to paste:\n" + wxString(ec.message()),
+    const wxString title = (isCopy ? "Copy " : "Move ") + DescribePaths(srcs) +
+                           " to " + wxString(destDir.wstring());
+    // Checksums of verified copies go beside the name index, one file per paste
+    std::filesystem::path manifest;
+    if (options.verify) {
+        const std::time_t now = std::time(nullptr);
+        std::tm local{};
+        char stamp[32];
+        localtime_r(&now, &local);
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S.xxh64", &local);
+        manifest = NameIndex::DefaultFile().parent_path() / "manifests" / stamp;
+    }
+    SubmitJob(title, "Failed to paste:", touches,
+              [srcs, destDir, overwrite, options, isCopy, stats, failures, manifest, statCache](
+                  OpProgress& progress, std::error_code& ec, std::filesystem::path& errorPath) mutable {
+        options.progress = &progress;
+        options.statCache = statCache.get();
+        const bool ok = FileActions::Paste(srcs, destDir, overwrite, isCopy, options, *stats, *failures, ec);
+        errorPath = stats->errorPath;
+        if (ok && !stats->checksums.empty() && !CopyEngine::WriteManifest(manifest, stats->checksums, ec)) {
+            errorPath = manifest;
+            return false;
+        }
+        return ok;
+    }, [this, destDir, stats, manifest](const JobInfo& info) {
+        // Which copy mechanism handled the data (run with --verbose to see)
+        for (int i = 0; i < kCopyStrategyCount; ++i) {
+            if (stats->strategyFiles[i] > 0) {
+                wxLogVerbose("Paste into %s: %llu file(s) via %s", wxString(destDir.wstring()),
+                             static_cast<unsigned long long>(stats->strategyFiles[i]),
+                             CopyStrategyName(static_cast<CopyStrategy>(i)));
+            }
+        }
+        if (stats->verified > 0) {
+            wxLogVerbose("Verified paste into %s: hashing %.2f s, read-back %.2f s (%llu of %llu files uncached)",
+                         wxString(destDir.wstring()), stats->hashSeconds, stats->readBackSeconds,
+                         static_cast<unsigned long long>(stats->direct),
+                         static_cast<unsigned long long>(stats->verified));
+            SetStatusText(wxString::Format("Paste complete: %llu files, %.1f MB/s, all read back and verified "
+                                           "(+%.0f%% time). Checksums: %s",
+                                           static_cast<unsigned long long>(stats->files), stats->MBPerSecond(),
+                                           stats->VerifyOverhead() * 100.0, wxString(manifest.wstring())));
+        } else if (stats->files > 0) {
+            SetStatusText(wxString::Format("Paste complete: %llu files, %.1f files/s, %.1f MB/s.",
+                                           static_cast<unsigned long long>(stats->files),
+                                           stats->FilesPerSecond(), stats->MBPerSecond()));
+        } else {
+            SetStatusText("Paste complete.");
+        }
+    }, failures);
+    SetStatusText("Queued: " + title + ". Clipboard is now empty.");
+}
+/* Queue a file operation. When it ends the affected rows are updated; a
+* failure is reported with its path, a cancel in the status bar.
+* @param title: job name shown in the jobs panel
+* @param failText: first line of the error box
+* @param touches: paths read or written; also used for per-device limits
+* @param work: the operation, runs on the job's thread
+* @param onSuccess: runs on the GUI thread when the job succeeded
+* @param failures: filled by a batch job; all of them are reported in one box
+*/
+void MainFrame::SubmitJob(const wxString& title, const wxString& failText,
+                          const std::vector<std::filesystem::path>& touches,
+                          JobQueue::Work work, std::function<void(const JobInfo&)> onSuccess,
+                          std::shared_ptr<std::vector<PathError>> failures) {
+    jobs_.Submit(std::string(title.utf8_str()), touches, std::move(work),
+                 [this, title, failText, touches, onSuccess, failures](const JobInfo& info) {
+        CallAfter([this, title, failText, touches, onSuccess, failures, info]() {
+            for (const auto& p : touches) duCache_.InvalidateUp(p);
+            ApplyLocalChanges(touches); // Part of the work may be done even on failure
+            m_jobsPanel->RefreshJobs();
+            if (info.state == JobState::Done) {
+                if (onSuccess) onSuccess(info);
+            } else if (info.state == JobState::Cancelled) {
+                SetStatusText("Cancelled: " + title);
+            } else if (failures && failures->size() > 1) {
+                wxString list;
+                const std::size_t shown = std::min<std::size_t>(failures->size(), kMaxListedFailures);
+                for (std::size_t i = 0; i < shown; ++i) {
+                    list += "\n" + wxString((*failures)[i].path.wstring()) + ": " +
+                            wxString((*failures)[i].ec.message());
+                }
+                if (failures->size() > shown) {
+                    list += wxString::Format("\n... and %llu more",
+                                             static_cast<unsigned long long>(failures->size() - shown));
+                }
+                wxMessageBox(wxString::Format("%s %llu items failed.", failText,
+                                              static_cast<unsigned long long>(failures->size())) + list,
+                             "Error", wxOK | wxICON_ERROR, this);
+            } else {
+                wxString where = info.errorPath.empty() ? wxString()
+                                 : "\n" + wxString(info.errorPath.wstring());
+                wxMessageBox(failText + "\n" + wxString(info.ec.message()) + where,
+                             "Error", wxOK | wxICON_ERROR, this);
+            }
+        });
+    });
+    m_jobsPanel->RefreshJobs();
+}
+/* Ask before closing while jobs are still running; they are cancelled
+* @param event
+*/
+void MainFrame::OnClose(wxCloseEvent& event) {
+    if (event.CanVeto() && jobs_.Busy()) {
+        int answer = wxMessageBox("File operations are still running. Cancel them and quit?",
+                                  "Confirm Exit", wxYES_NO | wxICON_QUESTION, this);
+        if (answer != wxYES) {
+            event.Veto();
+            return;
+        }
+    }
+    event.Skip();
+}
+/* Ask for the number of concurrent file copies used by paste
+* @param event
+* @return void
+*/
+void MainFrame::OnCopyThreads(wxCommandEvent& event) {
+    long value = wxGetNumberFromUser("Number of files copied in parallel (0 = one per CPU):",
+                                     "Threads:", "Copy Threads",
+                                     static_cast<long>(copyThreads_), 0, 256, this);
+    if (value < 0) return; // Cancelled
+    copyThreads_ = static_cast<unsigned>(value);
+    SetStatusText(wxString::Format("Copy threads: %ld", value));
+}
+/* Toggle checking pasted files by reading them back
+* @param event
+* @return void
+*/
+void MainFrame::OnVerifyCopies(wxCommandEvent& event) {
+    verifyCopies_ = event.IsChecked();
+    SetStatusText(verifyCopies_ ? "Pasted files will be read back and checked." : "Copies are no longer verified.");
+}
+/* Turn tracing on or off. Counters and events are kept when it is
+* turned off, so they can still be saved.
+* @param event
+* @return void
+*/
+void MainFrame::OnTracing(wxCommandEvent& event) {
+    Trace::SetEnabled(event.IsChecked());
+    SetStatusText(event.IsChecked() ? "Tracing file operations and refreshes." : "Tracing stopped.");
+    if (m_statsPanel->IsShown()) m_statsPanel->RefreshStats();
+}
+/* Show or hide the trace statistics under the jobs
+* @param event
+* @return void
+*/
+void MainFrame::OnTraceStats(wxCommandEvent& event) {
+    m_statsPanel->Show(event.IsChecked());
+    if (event.IsChecked()) m_statsPanel->RefreshStats();
+    m_statsPanel->GetParent()->Layout();
+}
+/* Show the preview with the selected file, or hide it and release the
+* file and its index
+* @param event
+* @return void
+*/
+void MainFrame::OnPreview(wxCommandEvent& event) {
+    m_previewPanel->Show(event.IsChecked());
+    if (event.IsChecked()) {
+        std::filesystem::path selectedPath;
+        if (TryGetSelectedPath(selectedPath)) m_previewPanel->ShowFile(selectedPath);
+    } else {
+        m_previewPanel->Clear();
+    }
+    m_previewPanel->GetParent()->Layout();
+}
+/* While the pane is shown it follows the selection
+* @param event
+* @return void
+*/
+void MainFrame::OnItemSelected(wxListEvent& event) {
+    if (!m_previewPanel->IsShown()) return;
+    std::filesystem::path selectedPath;
+    if (TryGetRowPath(event.GetIndex(), selectedPath) && selectedPath != m_previewPanel->Path()) {
+        m_previewPanel->ShowFile(selectedPath);
+    }
+}
+/* Save the recorded events for chrome://tracing or ui.perfetto.dev
+* @param event
+* @return void
+*/
+void MainFrame::OnSaveTrace(wxCommandEvent& event) {
+    wxFileDialog dialog(this, "Save Trace", "", "filemanager-trace.json",
+                        "Trace files (*.json)|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (dialog.ShowModal() != wxID_OK) return;
+    const std::filesystem::path file(dialog.GetPath().ToStdWstring());
+    std::uint64_t events = 0;
+    std::error_code ec;
+    if (!Trace::WriteChrome(file, events, ec)) {
+        wxMessageBox("Failed to save the trace:\n" + wxString(file.wstring()) + "\n" + wxString(ec.message()),
                      "Error", wxOK | wxICON_ERROR, this);
         return;
     }
+    SetStatusText(wxString::Format("Saved %llu trace events%s.", static_cast<unsigned long long>(events),
+                                   Trace::Enabled() ? "" : " (tracing is off)"));
+}
+/* Ask for the memory budget of the directory cache
+* @param event
+* @return void
+*/
+void MainFrame::OnCacheBudget(wxCommandEvent& event) {
+    const long currentMb = static_cast<long>(dirCache_.Budget() / (1024 * 1024));
+    long value = wxGetNumberFromUser("Memory kept for listings of visited directories, in MB (0 = off):",
+                                     "MB:", "Directory Cache",
+                                     currentMb, 0, 65536, this);
+    if (value < 0) return; // Cancelled
+    dirCache_.SetBudget(static_cast<std::size_t>(value) * 1024 * 1024);
+    SetStatusText(wxString::Format("Directory cache budget: %ld MB", value));
+}
+/* Show the directory cache counters
+* @param event
+* @return void
+*/
+void MainFrame::OnCacheStats(wxCommandEvent& event) {
+    const DirCache::Stats st = dirCache_.GetStats();
+    const std::uint64_t lookups = st.hits + st.misses;
+    wxMessageBox(wxString::Format("Hits: %llu\nMisses: %llu (%llu stale)\nHit rate: %.1f%%\n"
+                                  "Evictions: %llu\nDirectories cached: %llu\n"
+                                  "Memory: %.1f of %.1f MB",
+                                  static_cast<unsigned long long>(st.hits),
+                                  static_cast<unsigned long long>(st.misses),
+                                  static_cast<unsigned long long>(st.stale),
+                                  lookups ? 100.0 * st.hits / lookups : 0.0,
+                                  static_cast<unsigned long long>(st.evictions),
+                                  static_cast<unsigned long long>(st.entries),
+                                  st.bytes / (1024.0 * 1024.0), st.budget / (1024.0 * 1024.0)),
+                 "Directory Cache", wxOK | wxICON_INFORMATION, this);
+}
+/* Toggle recursive directory totals in the size column
+* @param event
+* @return void
+*/
+void MainFrame::OnDirSizes(wxCommandEvent& event) {
+    dirSizes_ = event.IsChecked();
+    if (dirSizes_) {
+        m_fileList->SetDirTotals(&dirTotals_);
+        StartDirSizes();
+    } else {
+        CancelDirSizes();
+        dirTotals_.clear();
+        m_fileList->SetDirTotals(nullptr);
+    }
+    UpdateEntryCount();
+}
+/* Toggle ordering the rows by size, largest first
+* @param event
+* @return void
+*/
+void MainFrame::OnSortBySize(wxCommandEvent& event) {
+    if (event.IsChecked()) m_fileList->SetSort(SortColumn::Size, false);
+    else m_fileList->SetSort(SortColumn::None, true);
+}
+/* Sort by the clicked column; clicking it again reverses the order. Sizes
+* and dates start with the largest and newest.
+* @param event
+* @return void
+*/
+void MainFrame::OnColumnClick(wxListEvent& event) {
+    const SortColumn column = FileListCtrl::SortColumnAt(event.GetColumn());
+    if (column == SortColumn::None) return;
+    bool ascending = column != SortColumn::Size && column != SortColumn::Modified;
+    if (column == m_fileList->SortedBy()) ascending = !m_fileList->SortAscending();
+    m_fileList->SetSort(column, ascending);
+    GetMenuBar()->Check(ID_SortBySize, column == SortColumn::Size && !ascending);
+}
+/* Re-filter the listing on every keystroke in the filter box or a mode
+* change. Only the visible rows are rebuilt; the sort order is kept.
+* @param event
+*/
+void MainFrame::OnFilter(wxCommandEvent& event) {
+    const MatchMode mode = static_cast<MatchMode>(m_filterMode->GetSelection());
+    m_fileList->SetFilter(mode, std::string(m_filterBox->GetValue().mb_str(wxConvFile)));
+    UpdateEntryCount();
+}
+/* Open a find-in-files window rooted at the current directory
+* @param event
+*/
+void MainFrame::OnFindInFiles(wxCommandEvent& event) {
+    SearchFrame* frame = new SearchFrame(this, jobs_, currentPath_,
+                                         [this](const std::filesystem::path& path) { Reveal(path); });
+    frame->Show();
+}
+/* Open a duplicate finder window rooted at the current directory
+* @param event
+*/
+void MainFrame::OnFindDuplicates(wxCommandEvent& event) {
+    DupFrame* frame = new DupFrame(this, jobs_, currentPath_,
+                                   [this](const std::filesystem::path& path) { Reveal(path); });
+    frame->Show();
+}
+/* Open a compare window for src and an existing copy of it
+* @param src: directory being pasted
+* @param dest: directory of the same name here
+*/
+void MainFrame::OpenSync(const std::filesystem::path& src, const std::filesystem::path& dest) {
+    SyncFrame* frame = new SyncFrame(this, jobs_, src, dest,
+                                     [this](const std::filesystem::path& from, const std::filesystem::path& to,
+                                            std::vector<SyncItem> items, const SyncOptions& options) {
+        StartSync(from, to, std::move(items), options);
+    });
+    frame->Show();
+}
+/* Queue a sync confirmed in a SyncFrame
+* @param src
+* @param dest
+* @param items: the plan shown to the user
+* @param options: the options it was made with
+*/
+void MainFrame::StartSync(const std::filesystem::path& src, const std::filesystem::path& dest,
+                          std::vector<SyncItem> items, SyncOptions options) {
+    options.threads = copyThreads_;
+    auto plan = std::make_shared<const std::vector<SyncItem>>(std::move(items));
+    auto stats = std::make_shared<SyncStats>();
+    auto failures = std::make_shared<std::vector<PathError>>();
+    const wxString title = "Sync " + wxString(src.wstring()) + " to " + wxString(dest.wstring());
+    SubmitJob(title, "Failed to sync:", {src, dest},
+              [src, dest, plan, options, stats, failures](
+                  OpProgress& progress, std::error_code& ec, std::filesystem::path& errorPath) mutable {
+        options.progress = &progress;
+        const bool ok = DirSync::Apply(src, dest, *plan, options, *stats, *failures, ec);
+        errorPath = stats->errorPath;
+        return ok;
+    }, [this, stats](const JobInfo& info) {
+        SetStatusText(wxString::Format("Sync complete in %.1f s: %llu new, %llu updated (%llu block by block, "
+                                       "%.1f MB written), %llu attributes only, %llu removed.",
+                                       stats->seconds,
+                                       static_cast<unsigned long long>(stats->created),
+                                       static_cast<unsigned long long>(stats->updated),
+                                       static_cast<unsigned long long>(stats->deltaFiles),
+                                       (stats->bytesCopied + stats->bytesWritten) / (1024.0 * 1024.0),
+                                       static_cast<unsigned long long>(stats->touched),
+                                       static_cast<unsigned long long>(stats->removed)));
+    }, failures);
+    SetStatusText("Queued: " + title);
+}
+/* Show the directory of path with path selected
+* @param path
+*/
+void MainFrame::Reveal(const std::filesystem::path& path) {
+    pendingSelect_ = path;
+    Raise();
+    if (path.parent_path() == currentPath_ && !loading_) {
+        SelectPending();
+        return;
+    }
+    RefreshFileList(path.parent_path());
+}
+/* Select the entry Reveal asked for once the listing holds it
+*/
+void MainFrame::SelectPending() {
+    if (pendingSelect_.empty() || pendingSelect_.parent_path() != currentPath_) return; // Navigated away
+    const std::size_t i = entries_.Find(pendingSelect_.filename().string());
+    pendingSelect_.clear();
+    const long row = i == EntryStore::npos ? -1 : m_fileList->EntryToRow(i);
+    if (row == -1) return;
+    m_fileList->SetItemState(-1, 0, wxLIST_STATE_SELECTED);
+    m_fileList->SetItemState(row, wxLIST_STATE_SELECTED | wxLIST_STATE_FOCUSED,
+                             wxLIST_STATE_SELECTED | wxLIST_STATE_FOCUSED);
+    m_fileList->EnsureVisible(row);
+}
+/* Query the name index on every keystroke after a leading '?'. The hits
+* are listed under the path bar; anything else hides them.
+* @param event
+*/
+void MainFrame::OnPathText(wxCommandEvent& event) {
+    wxString name;
+    if (!m_pathBar->GetValue().StartsWith("?", &name) || name.empty()) {
+        HideNameMatches();
+        return;
+    }
+    if (!nameIndex_.Loaded()) {
+        SetStatusText("No name index yet: build one with View > Name Index");
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> paths;
+    nameIndex_.Query(std::string(name.mb_str(wxConvFile)), kMaxNameMatches, paths);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-    // clipboard is empty after paste
-    clipboardPath_.clear();
-    clipMode_ = ClipMode::None;
+    m_nameMatches->Freeze();
+    m_nameMatches->Clear();
+    for (const auto& path : paths) m_nameMatches->Append(wxString(std::filesystem::path(path).wstring()));
+    if (!paths.empty()) m_nameMatches->SetSelection(0);
+    m_nameMatches->Thaw();
+    if (!m_nameMatches->IsShown()) {
+        m_nameMatches->Show();
+        m_nameMatches->GetParent()->Layout();
+    }
+    const char* format = paths.size() < kMaxNameMatches ? "%llu names found in %.1f ms"
+                                                        : "First %llu names found in %.1f ms";
+    SetStatusText(wxString::Format(format, static_cast<unsigned long long>(paths.size()), ms));
+}
+/* Show a double-clicked index hit in its directory
+* @param event
+*/
+void MainFrame::OnNameMatch(wxCommandEvent& event) {
+    const int row = event.GetSelection();
+    if (row == wxNOT_FOUND) return;
+    const std::filesystem::path match(m_nameMatches->GetString(row).ToStdWstring());
+    HideNameMatches();
+    UpdatePathUI();
+    Reveal(match);
+}
+void MainFrame::HideNameMatches() {
+    if (!m_nameMatches->IsShown()) return;
+    m_nameMatches->Hide();
+    m_nameMatches->GetParent()->Layout();
+}
+/* Ask which directories to index, then build the index as a job. An
+* empty answer turns the index off and deletes it.
+* @param event
+* @return void
+*/
+void MainFrame::OnNameIndex(wxCommandEvent& event) {
+    wxString current;
+    for (const auto& root : nameIndex_.Roots()) {
+        if (!current.empty()) current += ":";
+        current += wxString(root.wstring());
+    }
+    if (current.empty()) current = "/";
+    wxTextEntryDialog dialog(this, "Directories to index for \"?name\" in the path bar, separated by ':'.\n"
+                                   "Leave empty to turn the index off.", "Name Index", current);
+    if (dialog.ShowModal() != wxID_OK) return;
 
-    SetStatusText("Paste complete. Clipboard is now empty.");
-    RefreshFileList(currentPath_);
+    std::vector<std::filesystem::path> roots;
+    const std::wstring value = dialog.GetValue().ToStdWstring();
+    for (std::size_t begin = 0; begin <= value.size();) {
+        std::size_t end = value.find(L':', begin);
+        if (end == std::wstring::npos) end = value.size();
+        if (end > begin) roots.emplace_back(value.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    if (roots.empty()) {
+        nameIndex_.Disable();
+        HideNameMatches();
+        SetStatusText("Name index turned off");
+        return;
+    }
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(root, ec)) {
+            wxMessageBox("Not a directory:\n" + wxString(root.wstring()), "Error", wxOK | wxICON_ERROR, this);
+            return;
+        }
+    }
+    nameIndex_.StopWatching(); // Build starts a new overlay
+    jobs_.Submit("Build name index", roots,
+                 [this, roots](OpProgress& progress, std::error_code& ec, std::filesystem::path& errorPath) {
+        if (!nameIndex_.Build(roots, &progress, ec)) return false;
+        nameIndex_.StartWatching();
+        return true;
+    }, [this](const JobInfo& info) {
+        CallAfter([this, info]() {
+            m_jobsPanel->RefreshJobs();
+            if (info.state == JobState::Done) {
+                SetStatusText(wxString::Format("Name index built: %llu names in %.1f s",
+                                               static_cast<unsigned long long>(nameIndex_.EntryCount()),
+                                               info.seconds));
+            } else if (info.state == JobState::Failed) {
+                wxMessageBox("Failed to build the name index:\n" + wxString(info.ec.message()),
+                             "Error", wxOK | wxICON_ERROR, this);
+            }
+        });
+    });
+    m_jobsPanel->RefreshJobs();
+}
+/* Only runs when an index was built before. Refresh rescans just the
+* directories whose mtime moved; the watcher takes over from there.
+*/
+void MainFrame::StartNameIndex() {
+    std::error_code ec;
+    if (!std::filesystem::exists(NameIndex::DefaultFile(), ec)) return;
+    jobs_.Submit("Update name index", {},
+                 [this](OpProgress& progress, std::error_code& ec, std::filesystem::path& errorPath) {
+        if (!nameIndex_.Open(ec) || !nameIndex_.Refresh(&progress, ec)) return false;
+        nameIndex_.StartWatching();
+        return true;
+    }, [this](const JobInfo& info) {
+        CallAfter([this]() { m_jobsPanel->RefreshJobs(); });
+    });
+    m_jobsPanel->RefreshJobs();
 }
@@ -7,13 +7,35 @@
 #define MAINFRAME_H
 #include <wx/wx.h>
 #include <wx/listctrl.h>
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "DirCache.h"
+#include "DirLoader.h"
+#include "DirSync.h"
+#include "DirWatcher.h"
+#include "DiskUsage.h"
+#include "EntryStore.h"
+#include "FileListCtrl.h"
+#include "FileStat.h"
+#include "JobQueue.h"
+#include "JobsPanel.h"
+#include "NameIndex.h"
+#include "OpProgress.h"
+#include "PreviewPanel.h"
+#include "StatsPanel.h"
+#include "StrSearch.h"
+
 /* The primary app window. Responsible for:
                  - Rendering the current directory path and its entries
-                 - Tracking selection-to-path mapping for list rows
-                 - Handling clipboard state for copy/cut/paste
+                 - Tracking selection-to-path mapping for list rows (multi-select)
+                 - Handling clipboard state (a set of paths) for copy/cut/paste
                  - Responding to UI events
 */
 class MainFrame : public wxFrame {
@@ -22,65 +44,215 @@ class MainFrame : public wxFrame {
     * @param title: window title displayed
     */
         MainFrame(const wxString& title);
+        ~MainFrame() override;
     private:
         enum {
             ID_Refresh = wxID_HIGHEST + 1,
             ID_NewDir,
             ID_Open,
+            ID_OpenExternal,
             ID_Rename,
             ID_Delete,
             ID_Copy,
             ID_Cut,
             ID_Paste,
+            ID_FindInFiles,
+            ID_FindDuplicates,
+            ID_CopyThreads,
+            ID_VerifyCopies,
+            ID_CacheBudget,
+            ID_CacheStats,
+            ID_DirSizes,
+            ID_SortBySize,
+            ID_NameIndex,
+            ID_Tracing,
+            ID_TraceStats,
+            ID_SaveTrace,
+            ID_Preview,
             ID_About
         };
         enum class ClipMode { None, Copy, Cut };
+        static constexpr std::size_t kMaxListedFailures = 10; // Per error box
+        static constexpr std::chrono::milliseconds kSizesFlushInterval{200}; // Totals handed to the list
+        static constexpr std::size_t kMaxNameMatches = 200; // Rows of a "?name" query
  
         // UI
         wxTextCtrl* m_pathBar;   // path input bar
-        wxListCtrl* m_fileList; // file list
+        wxTextCtrl* m_filterBox; // filters the listing as the user types
+        wxChoice* m_filterMode;  // Substring, Glob or Fuzzy, in MatchMode order
+        wxListBox* m_nameMatches; // Index hits for a "?name" typed in the path bar
+        FileListCtrl* m_fileList; // file list
+        JobsPanel* m_jobsPanel;   // running and finished file operations
+        StatsPanel* m_statsPanel; // trace counters, hidden until asked for
+        PreviewPanel* m_previewPanel; // text/hex view of the opened file, beside the list
 
         // State
         std::filesystem::path currentPath_; // Curr working dir shown in UI
-        std::vector<std::filesystem::path> rowPaths_; // Store paths for each row
-        std::filesystem::path clipboardPath_; // Operation path
+        EntryStore entries_; // Entries of currentPath_ shown by m_fileList
+        DirLoader loader_;   // Background enumeration of currentPath_
+        DirWatcher watcher_; // Live changes to currentPath_
+        bool loading_ = false; // loader_ has not delivered its last batch yet
+        std::vector<std::shared_ptr<DirDelta>> pendingDeltas_; // Held back until the load ends
+        DirCache dirCache_;      // Listings of recently left directories
+        DirStamp listingStamp_;  // entries_ is current for this stamp of currentPath_
+        bool listingComplete_ = false; // entries_ holds the whole directory
+        std::vector<std::filesystem::path> clipboardPaths_; // Operation paths
         ClipMode clipMode_ = ClipMode::None;
+        unsigned copyThreads_ = 0; // Concurrent file copies on paste, 0 for auto
+        bool verifyCopies_ = false; // Paste reads every copied file back and writes a manifest
+        JobQueue jobs_;      // Background file operations
+        bool dirSizes_ = false;  // Size column shows recursive directory totals
+        bool sizesUseCache_ = true; // False after an explicit refresh
+        DiskUsageCache duCache_; // Totals of every directory walked so far
+        DirTotals dirTotals_;    // Totals of the directories in entries_
+        std::unordered_map<std::string, std::uint64_t> sizesPending_; // Name to the walk computing it
+        std::uint64_t sizesToken_ = 0;        // Id of the latest walk
+        std::vector<std::uint64_t> sizeJobs_; // Walks for currentPath_ still queued or running
+        std::filesystem::path pendingSelect_; // Entry to select once its listing is loaded (Reveal)
+        NameIndex nameIndex_;    // Whole-volume name search behind "?name"
 
         /* List control col and update the path bar
         */
         void SetupListColumns();
         void UpdatePathUI(); 
         
-        /* Resolve the selected row using rowPath
+        /* Resolve the selected row to a path
         * @param outPath: output with selected path
         * @return: true if a valid row is selected
         */
         bool TryGetSelectedPath(std::filesystem::path& outPath) const;
 
+        /* Show the preview pane with a file in it
+        * @param p
+        */
+        void ShowPreview(const std::filesystem::path& p);
+
+        /* Resolve every selected row to a path; the parent row is skipped
+        * @param outPaths: output with the selected paths, in row order
+        * @return: true if at least one entry is selected
+        */
+        bool TryGetSelectedPaths(std::vector<std::filesystem::path>& outPaths) const;
+
+        /* Resolve a list row to a path
+        * @param row: list row
+        * @param outPath: output with the row path
+        * @return: true if the row is valid
+        */
+        bool TryGetRowPath(long row, std::filesystem::path& outPath) const;
+
         /* If the dest path already exists, ask user to confirm 
         * @param dest: destination path
+        * @param destStat: its stat, taken by the caller
         * @return: True if overwrite is allowed or dest DNE
         */
-        bool ConfirmOverwriteIfExists(const std::filesystem::path& dest);
+        bool ConfirmOverwriteIfExists(const std::filesystem::path& dest, const FileStat& destStat);
+
+        /* Run a file operation as a background job
+        * @param title: job name
+        * @param failText: first line of the error box on failure
+        * @param touches: paths the job reads or writes
+        * @param work: the operation
+        * @param onSuccess: GUI thread callback after a successful run
+        * @param failures: per-item errors of a batch, listed in the error box
+        */
+        void SubmitJob(const wxString& title, const wxString& failText,
+                       const std::vector<std::filesystem::path>& touches,
+                       JobQueue::Work work, std::function<void(const JobInfo&)> onSuccess,
+                       std::shared_ptr<std::vector<PathError>> failures = nullptr);
 
         // Handling user events
         void OnExit(wxCommandEvent& event);
+        void OnClose(wxCloseEvent& event); // Confirm while jobs run
         void OnRefresh(wxCommandEvent& event);
         void OnPathEnter(wxCommandEvent& event); // Handle path input
         void OnFileActivated(wxListEvent& event); // Handle file/directory activation
+        void OnColumnClick(wxListEvent& event);   // Sort by the clicked column
+        void OnFilter(wxCommandEvent& event);     // Filter text or mode changed
+        void OnFindInFiles(wxCommandEvent& event); // Open a content search window
+        void OnFindDuplicates(wxCommandEvent& event); // Open a duplicate finder window
+        void OnPathText(wxCommandEvent& event);    // "?name" queries the name index
+        void OnNameMatch(wxCommandEvent& event);   // Reveal an index hit
+        void OnNameIndex(wxCommandEvent& event);   // Choose the indexed roots
 
         void OnNewDir(wxCommandEvent& event);
         void OnOpen(wxCommandEvent& event);
+        void OnOpenExternal(wxCommandEvent& event); // The old Open: default application
         void OnRename(wxCommandEvent& event);
         void OnDelete(wxCommandEvent& event);
         void OnCopy(wxCommandEvent& event);
         void OnCut(wxCommandEvent& event);
         void OnPaste(wxCommandEvent& event);
+        void OnCopyThreads(wxCommandEvent& event);
+        void OnVerifyCopies(wxCommandEvent& event);
+        void OnCacheBudget(wxCommandEvent& event);
+        void OnCacheStats(wxCommandEvent& event);
+        void OnDirSizes(wxCommandEvent& event);
+        void OnSortBySize(wxCommandEvent& event);
+        void OnTracing(wxCommandEvent& event);    // Start or stop recording
+        void OnTraceStats(wxCommandEvent& event); // Show or hide the counters
+        void OnSaveTrace(wxCommandEvent& event);  // Write a Chrome trace file
+        void OnPreview(wxCommandEvent& event);    // Show or hide the preview pane
+        void OnItemSelected(wxListEvent& event);  // Follow the selection while previewing
         void OnAbout(wxCommandEvent& event);
-        /* Read dir entries from provided path and update
+        /* Show a directory: from dirCache_ when still current, otherwise
+        * start reading its entries in the background
         * @param path: dir path to display
+        * @param useCache: false to always rescan (explicit refresh)
+        * @param known: stat of path the caller just took, to skip taking another
+        */
+        void RefreshFileList(const std::filesystem::path& path, bool useCache = true,
+                             const FileStat* known = nullptr);
+        /* Merge a batch from loader_ into the list (GUI thread)
+        * @param generation: load the batch belongs to
+        * @param batch: new entries
+        * @param done: last batch of the load
+        * @param ec: error that ended the load
+        */
+        void OnDirBatch(std::uint64_t generation, std::shared_ptr<EntryStore> batch,
+                        bool done, std::error_code ec);
+        /* Apply a delta from watcher_ (GUI thread)
+        * @param generation: watch the delta belongs to
+        * @param delta: changed and removed names
+        */
+        void OnDirDelta(std::uint64_t generation, std::shared_ptr<DirDelta> delta);
+        /* Update, insert and remove rows in place, keeping the selected names
+        * @param delta: changes to apply
+        */
+        void ApplyDelta(const DirDelta& delta);
+        /* Reflect paths changed by our own operations without a rescan
+        * @param paths: paths that were created, removed or modified
+        */
+        void ApplyLocalChanges(const std::vector<std::filesystem::path>& paths);
+        // Show the entry count, and the total size when known, in the status bar
+        void UpdateEntryCount();
+        /* Fill in the totals of directories in entries_ that have none yet:
+        * from duCache_ when current, otherwise with a background walk
+        */
+        void StartDirSizes();
+        /* Merge totals delivered by a walk (GUI thread)
+        * @param token: walk the totals come from
+        * @param totals: directory name and total
+        */
+        void OnDirTotals(std::uint64_t token, std::vector<std::pair<std::string, DuTotal>> totals);
+        // Cancel the walks of the current directory and forget their names
+        void CancelDirSizes();
+        // Compare a pasted folder with its copy here before syncing
+        void OpenSync(const std::filesystem::path& src, const std::filesystem::path& dest);
+        // Run a sync the user confirmed as a background job
+        void StartSync(const std::filesystem::path& src, const std::filesystem::path& dest,
+                       std::vector<SyncItem> items, SyncOptions options);
+        /* Navigate to the directory of path and select it there
+        * @param path: file or directory to show
+        */
+        void Reveal(const std::filesystem::path& path);
+        // Select pendingSelect_ if the listing has it, then forget it
+        void SelectPending();
+        /* Load the name index, catch up with changes made while the app was
+        * not running, then follow new ones; all in a background job
         */
-        void RefreshFileList(const std::filesystem::path& path);
+        void StartNameIndex();
+        // Hide the index hits and give their space back to the list
+        void HideNameMatches();
 };
 
 
@@ -0,0 +1,109 @@
+/*
+    Description: Implementation of the windowed read-only file mapping.
+*/
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedFile.h"
+#include "Trace.h"
+
+MappedFile::~MappedFile() {
+    Close();
+}
+/* Open and fstat; nothing is mapped until the first Window
+* @param p
+* @param ec
+* @return true on success
+*/
+bool MappedFile::Open(const std::filesystem::path& p, std::error_code& ec) {
+    Close();
+    ec.clear();
+    // O_NONBLOCK so a FIFO cannot hang the caller; it is refused below
+    const int fd = ::open(p.c_str(), O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    TRACE_COUNT(kSyscalls, 2); // open and fstat
+    if (fd < 0) {
+        ec.assign(errno, std::generic_category());
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ec.assign(errno, std::generic_category());
+        ::close(fd);
+        return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        ec = std::make_error_code(S_ISDIR(st.st_mode) ? std::errc::is_a_directory
+                                                      : std::errc::invalid_argument);
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    size_ = static_cast<std::uint64_t>(st.st_size);
+    path_ = p;
+    return true;
+}
+/* Unmap the window and close the file
+*/
+void MappedFile::Close() {
+    Unmap();
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    size_ = 0;
+    path_.clear();
+}
+
+void MappedFile::Unmap() {
+    if (map_) ::munmap(map_, mapLength_);
+    map_ = nullptr;
+    mapLength_ = 0;
+    mapOffset_ = 0;
+}
+/* Refresh the size, then map the pages around the range unless the
+* current window has them and still lies inside the file
+* @param offset
+* @param length
+* @param ec
+* @return view of the range
+*/
+std::string_view MappedFile::Window(std::uint64_t offset, std::size_t length, std::error_code& ec) {
+    ec.clear();
+    if (fd_ < 0) {
+        ec = std::make_error_code(std::errc::bad_file_descriptor);
+        return {};
+    }
+    static const std::uint64_t page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+    struct stat st;
+    TRACE_COUNT(kSyscalls, 1);
+    if (::fstat(fd_, &st) != 0) {
+        ec.assign(errno, std::generic_category());
+        return {};
+    }
+    size_ = static_cast<std::uint64_t>(st.st_size);
+    // Touching a mapped page wholly past the end raises SIGBUS
+    if (map_ && mapOffset_ + mapLength_ > (size_ + page - 1) / page * page) Unmap();
+    if (offset >= size_ || length == 0) return {};
+    length = static_cast<std::size_t>(std::min<std::uint64_t>({length, size_ - offset, kMaxWindow}));
+    if (map_ && offset >= mapOffset_ && offset + length <= mapOffset_ + mapLength_) {
+        return std::string_view(static_cast<const char*>(map_) + (offset - mapOffset_), length);
+    }
+    Unmap();
+    const std::uint64_t start = offset / page * page;
+    // Map up to a full window so small steps forward reuse it
+    const std::size_t mapLength = static_cast<std::size_t>(
+        std::min<std::uint64_t>(size_ - start, std::max<std::uint64_t>(offset - start + length, kMaxWindow)));
+    TRACE_COUNT(kSyscalls, 2); // mmap, and munmap later
+    void* map = ::mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd_, static_cast<off_t>(start));
+    if (map == MAP_FAILED) {
+        ec.assign(errno, std::generic_category());
+        return {};
+    }
+    map_ = map;
+    mapLength_ = mapLength;
+    mapOffset_ = start;
+    return std::string_view(static_cast<const char*>(map_) + (offset - start), length);
+}
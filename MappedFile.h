@@ -0,0 +1,66 @@
+/*
+    Description: Declare MappedFile, a read-only file seen through one
+                 memory-mapped window at a time
+*/
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+/* Reads any size of file with a bounded footprint.
+                 - At most one window of kMaxWindow bytes is mapped; asking
+                   for another range unmaps the previous one
+                 - A range inside the current window reuses it
+                 - Only regular files open
+                 - Every Window call fstats the file first and unmaps a
+                   window that reaches past the new end, so logs that are
+                   truncated (copytruncate rotation) or grow are followed.
+                   A truncation landing between that check and the caller's
+                   read can still fault; the span is one Window call
+*/
+class MappedFile {
+public:
+    static constexpr std::size_t kMaxWindow = 8 * 1024 * 1024;
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /* Open a file for reading, closing the previous one
+    * @param p
+    * @param ec: is_a_directory or invalid_argument for anything but a regular file
+    * @return true on success
+    */
+    bool Open(const std::filesystem::path& p, std::error_code& ec);
+    void Close();
+    bool IsOpen() const { return fd_ >= 0; }
+    // Size as of the last Open or Window
+    std::uint64_t Size() const { return size_; }
+    const std::filesystem::path& Path() const { return path_; }
+
+    /* Bytes [offset, offset + length), clamped to the file and to kMaxWindow.
+    * The view stays valid until the next Window, Open or Close.
+    * @param offset
+    * @param length
+    * @param ec
+    * @return the bytes; empty at or past the end, or on error
+    */
+    std::string_view Window(std::uint64_t offset, std::size_t length, std::error_code& ec);
+
+private:
+    void Unmap();
+
+    std::filesystem::path path_;
+    int fd_ = -1;
+    std::uint64_t size_ = 0;
+    void* map_ = nullptr;
+    std::size_t mapLength_ = 0;
+    std::uint64_t mapOffset_ = 0; // Page aligned
+};
+
+#endif
@@ -0,0 +1,1243 @@
+/*
+    Description: Implementation of the filename index, its file format and its
+                 incremental updates.
+*/
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <unordered_set>
+#include <utility>
+
+#include "DirScanner.h"
+#include "NameIndex.h"
+#include "StrSearch.h"
+#include "ThreadPool.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File layout; every section starts 8-byte aligned
+struct NameIndexFile::Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t blockSize;
+    std::uint64_t entryCount;
+    std::uint64_t dirCount;
+    std::uint64_t trigramCount;
+    std::uint64_t rootsOffset;    // Root paths, each followed by a NUL
+    std::uint64_t rootsSize;
+    std::uint64_t blocksOffset;   // uint64 per block: offset of its first entry in the names
+    std::uint64_t namesOffset;    // Per entry: varint shared, varint length, bytes, flag byte
+    std::uint64_t namesSize;
+    std::uint64_t dirsOffset;     // uint64 entry id per directory, then int64 mtime per directory
+    std::uint64_t trigramsOffset; // TrigramRecord per trigram, ascending
+    std::uint64_t postingsOffset; // Per trigram: varint gaps between entry ids
+    std::uint64_t postingsSize;
+};
+struct NameIndexFile::TrigramRecord {
+    std::uint32_t trigram;
+    std::uint32_t count;   // Entries in its list
+    std::uint64_t offset;  // Into the postings
+};
+
+namespace {
+constexpr char kMagic[8] = {'F', 'M', 'N', 'A', 'M', 'E', 'S', '1'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kVerifyDirectly = 64; // A rarest list this short is checked on its own
+constexpr std::uint64_t kMaxSkew = 16;        // Lists this many times longer than the rarest are not read
+// Directory mtime of a mount point: listed, never entered nor rescanned
+constexpr std::int64_t kNotEntered = EntryStore::kUnknownTime;
+
+void PutVarint(std::string& out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+/* Decode one varint
+* @return false if it runs past end or is too long
+*/
+bool GetVarint(const std::uint8_t*& p, const std::uint8_t* end, std::uint64_t& v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+        const std::uint8_t b = *p++;
+        v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+inline std::uint32_t Fold(char c) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'A' && u <= 'Z') ? u + 32u : u;
+}
+inline std::uint32_t Trigram(const char* s) {
+    return Fold(s[0]) << 16 | Fold(s[1]) << 8 | Fold(s[2]);
+}
+std::uint64_t Align8(std::uint64_t v) {
+    return (v + 7) & ~std::uint64_t(7);
+}
+std::string_view BaseName(std::string_view path) {
+    const std::size_t slash = path.rfind('/');
+    return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+// Path of name inside dir; the root "/" already ends with the separator
+std::string Join(std::string_view dir, std::string_view name) {
+    std::string path(dir);
+    if (path.empty() || path.back() != '/') path.push_back('/');
+    path.append(name.data(), name.size());
+    return path;
+}
+// The query rule shared by the file and the overlay
+bool NameMatches(std::string_view path, std::string_view text, bool wholePath) {
+    return StrSearch::FindCaseless(wholePath ? path : BaseName(path), text) != StrSearch::npos;
+}
+}
+
+int NameIndexFile::ComparePaths(std::string_view a, std::string_view b) {
+    const std::size_t n = std::min(a.size(), b.size());
+    for (std::size_t i = 0; i < n; ++i) {
+        if (a[i] == b[i]) continue;
+        const unsigned ca = a[i] == '/' ? 0u : static_cast<unsigned char>(a[i]);
+        const unsigned cb = b[i] == '/' ? 0u : static_cast<unsigned char>(b[i]);
+        return ca < cb ? -1 : 1;
+    }
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+/* Map the file (or read it where mmap is not available) and check that
+* every section lies inside it
+* @param file
+* @param ec
+* @return the index, nullptr on error
+*/
+std::shared_ptr<const NameIndexFile> NameIndexFile::Open(const std::filesystem::path& file, std::error_code& ec) {
+    ec.clear();
+    std::shared_ptr<NameIndexFile> index(new NameIndexFile());
+#if defined(__linux__)
+    const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ec = std::error_code(errno, std::generic_category());
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ec = std::error_code(errno, std::generic_category());
+        ::close(fd);
+        return nullptr;
+    }
+    index->size_ = static_cast<std::size_t>(st.st_size);
+    if (index->size_ >= sizeof(Header)) {
+        void* map = ::mmap(nullptr, index->size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            ec = std::error_code(errno, std::generic_category());
+            ::close(fd);
+            return nullptr;
+        }
+        index->data_ = static_cast<const std::uint8_t*>(map);
+        index->mapped_ = true;
+    }
+    ::close(fd);
+#else
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return nullptr;
+    }
+    index->buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    index->data_ = index->buffer_.data();
+    index->size_ = index->buffer_.size();
+#endif
+    const std::uint64_t size = index->size_;
+    auto inside = [size](std::uint64_t offset, std::uint64_t length) {
+        return offset % 8 == 0 && offset <= size && length <= size - offset;
+    };
+    bool ok = size >= sizeof(Header);
+    if (ok) {
+        const Header& h = index->Head();
+        const std::uint64_t blocks = (h.entryCount + kBlockSize - 1) / kBlockSize;
+        ok = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion &&
+             h.blockSize == kBlockSize && h.entryCount <= size && h.dirCount <= size &&
+             h.trigramCount <= size && inside(h.rootsOffset, h.rootsSize) &&
+             inside(h.blocksOffset, blocks * 8) && inside(h.namesOffset, h.namesSize) &&
+             inside(h.dirsOffset, h.dirCount * 16) &&
+             inside(h.trigramsOffset, h.trigramCount * sizeof(TrigramRecord)) &&
+             inside(h.postingsOffset, h.postingsSize);
+    }
+    if (!ok) {
+        ec = std::make_error_code(std::errc::bad_message);
+        return nullptr;
+    }
+    return index;
+}
+NameIndexFile::~NameIndexFile() {
+#if defined(__linux__)
+    if (mapped_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+#endif
+}
+const NameIndexFile::Header& NameIndexFile::Head() const {
+    return *reinterpret_cast<const Header*>(data_);
+}
+std::uint64_t NameIndexFile::EntryCount() const {
+    return Head().entryCount;
+}
+std::uint64_t NameIndexFile::DirCount() const {
+    return Head().dirCount;
+}
+std::vector<std::filesystem::path> NameIndexFile::Roots() const {
+    const Header& h = Head();
+    std::vector<std::filesystem::path> roots;
+    const char* p = reinterpret_cast<const char*>(data_ + h.rootsOffset);
+    const char* end = p + h.rootsSize;
+    while (p < end) {
+        const char* nul = static_cast<const char*>(std::memchr(p, 0, end - p));
+        if (!nul) break;
+        roots.emplace_back(std::string(p, nul));
+        p = nul + 1;
+    }
+    return roots;
+}
+void NameIndexFile::Dir(std::uint64_t i, std::uint64_t& entry, std::int64_t& mtimeNs) const {
+    const Header& h = Head();
+    entry = reinterpret_cast<const std::uint64_t*>(data_ + h.dirsOffset)[i];
+    mtimeNs = reinterpret_cast<const std::int64_t*>(data_ + h.dirsOffset + h.dirCount * 8)[i];
+}
+/* The first entry of a block is stored whole
+* @param block
+* @return its path, empty if the block is corrupt
+*/
+std::string_view NameIndexFile::BlockHead(std::uint64_t block) const {
+    const Header& h = Head();
+    const std::uint64_t offset = reinterpret_cast<const std::uint64_t*>(data_ + h.blocksOffset)[block];
+    if (offset >= h.namesSize) return std::string_view();
+    const std::uint8_t* p = data_ + h.namesOffset + offset;
+    const std::uint8_t* end = data_ + h.namesOffset + h.namesSize;
+    std::uint64_t shared = 0;
+    std::uint64_t length = 0;
+    if (!GetVarint(p, end, shared) || !GetVarint(p, end, length) ||
+        length > static_cast<std::uint64_t>(end - p)) {
+        return std::string_view();
+    }
+    return std::string_view(reinterpret_cast<const char*>(p), length);
+}
+/* Binary search over the block heads, then a scan inside one block
+* @param key
+* @return id of the first entry not below key
+*/
+std::uint64_t NameIndexFile::LowerBound(std::string_view key) const {
+    const std::uint64_t blocks = (EntryCount() + kBlockSize - 1) / kBlockSize;
+    std::uint64_t lo = 0;
+    std::uint64_t hi = blocks;
+    while (lo < hi) { // First block whose head sorts after key
+        const std::uint64_t mid = lo + (hi - lo) / 2;
+        if (ComparePaths(BlockHead(mid), key) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    Cursor cursor(*this, lo == 0 ? 0 : (lo - 1) * kBlockSize);
+    while (cursor.Next()) {
+        if (ComparePaths(cursor.Get().path, key) >= 0) return cursor.Get().id;
+    }
+    return EntryCount();
+}
+/* Trigram records in a key range
+* @param lo
+* @param hi
+* @return [first, last) of the records with lo <= key <= hi
+*/
+std::pair<const NameIndexFile::TrigramRecord*, const NameIndexFile::TrigramRecord*>
+NameIndexFile::Trigrams(std::uint32_t lo, std::uint32_t hi) const {
+    const Header& h = Head();
+    const auto* first = reinterpret_cast<const TrigramRecord*>(data_ + h.trigramsOffset);
+    const auto* last = first + h.trigramCount;
+    const TrigramRecord* from = std::lower_bound(first, last, lo,
+        [](const TrigramRecord& r, std::uint32_t t) { return r.trigram < t; });
+    const TrigramRecord* to = std::upper_bound(from, last, hi,
+        [](std::uint32_t t, const TrigramRecord& r) { return t < r.trigram; });
+    return {from, to};
+}
+/* A list ends where the next record's begins
+* @param record
+* @param begin
+* @param end
+* @return false on a corrupt record
+*/
+bool NameIndexFile::Postings(const TrigramRecord* record, const std::uint8_t*& begin, const std::uint8_t*& end) const {
+    const Header& h = Head();
+    const auto* last = reinterpret_cast<const TrigramRecord*>(data_ + h.trigramsOffset) + h.trigramCount;
+    const std::uint64_t to = record + 1 == last ? h.postingsSize : (record + 1)->offset;
+    if (record->offset > to || to > h.postingsSize) return false;
+    begin = data_ + h.postingsOffset + record->offset;
+    end = data_ + h.postingsOffset + to;
+    return true;
+}
+
+namespace {
+// Reads one postings list
+struct PostingList {
+    const std::uint8_t* p = nullptr;
+    const std::uint8_t* end = nullptr;
+    std::uint32_t count = 0;
+    std::uint64_t id = 0;
+    std::uint64_t gaps = 0;
+
+    bool Next() {
+        if (!GetVarint(p, end, gaps)) return false;
+        id += gaps;
+        return true;
+    }
+};
+}
+
+/* Stream the entries of the rarest trigram of text, keep those every other
+* selected list also has, and check each survivor's name. Lists much longer
+* than the rarest are not read: checking a candidate is cheaper than walking
+* them. Two bytes merge the lists of every trigram they start. Anything
+* shorter, or with a '/', is a scan.
+* @param text
+* @param fn
+*/
+void NameIndexFile::Find(std::string_view text, const std::function<bool(const Entry&)>& fn) const {
+    if (text.empty()) return;
+    const bool wholePath = text.find('/') != std::string_view::npos;
+    if (wholePath || text.size() < 2) {
+        Cursor cursor(*this, 0);
+        while (cursor.Next()) {
+            if (NameMatches(cursor.Get().path, text, wholePath) && !fn(cursor.Get())) return;
+        }
+        return;
+    }
+    std::vector<PostingList> lists;
+    auto open = [&](const TrigramRecord* r) {
+        PostingList list;
+        list.count = r->count;
+        if (!Postings(r, list.p, list.end) || !list.Next()) return false;
+        lists.push_back(list);
+        return true;
+    };
+
+    // Candidates ascend, so those in one block are decoded in one pass
+    Cursor cursor(*this, 0);
+    bool positioned = false;
+    auto check = [&](std::uint64_t want) {
+        if (!positioned || want / kBlockSize != cursor.Get().id / kBlockSize || want < cursor.Get().id) {
+            cursor = Cursor(*this, want);
+            if (!cursor.Next()) return false;
+            positioned = true;
+        }
+        while (cursor.Get().id < want) {
+            if (!cursor.Next()) return false;
+        }
+        return !NameMatches(cursor.Get().path, text, false) || fn(cursor.Get());
+    };
+
+    if (text.size() == 2) {
+        const std::uint32_t lo = Fold(text[0]) << 16 | Fold(text[1]) << 8;
+        const auto range = Trigrams(lo, lo | 0xff);
+        for (const TrigramRecord* r = range.first; r != range.second; ++r) open(r);
+        auto later = [&lists](std::size_t a, std::size_t b) { return lists[a].id > lists[b].id; };
+        std::vector<std::size_t> heap;
+        for (std::size_t k = 0; k < lists.size(); ++k) heap.push_back(k);
+        std::make_heap(heap.begin(), heap.end(), later);
+        bool any = false;
+        std::uint64_t last = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            PostingList& list = lists[heap.back()];
+            const std::uint64_t id = list.id;
+            if (list.Next()) std::push_heap(heap.begin(), heap.end(), later);
+            else heap.pop_back();
+            if (any && id == last) continue;
+            any = true;
+            last = id;
+            if (!check(id)) return;
+        }
+        return;
+    }
+
+    std::vector<std::uint32_t> seen;
+    for (std::size_t i = 0; i + 3 <= text.size(); ++i) {
+        const std::uint32_t t = Trigram(text.data() + i);
+        if (std::find(seen.begin(), seen.end(), t) != seen.end()) continue;
+        seen.push_back(t);
+        const auto range = Trigrams(t, t);
+        if (range.first == range.second || !open(range.first)) return; // No name has it
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const PostingList& a, const PostingList& b) { return a.count < b.count; });
+    std::size_t used = 1;
+    while (used < lists.size() && lists[0].count > kVerifyDirectly &&
+           lists[used].count <= lists[0].count * kMaxSkew) {
+        ++used;
+    }
+    PostingList& rarest = lists[0];
+    do {
+        const std::uint64_t id = rarest.id;
+        bool all = true;
+        for (std::size_t k = 1; k < used && all; ++k) {
+            while (lists[k].id < id) {
+                if (!lists[k].Next()) return; // No later id can be in every list
+            }
+            all = lists[k].id == id;
+        }
+        if (all && !check(id)) return;
+    } while (rarest.Next());
+}
+/* Walk the run of entries below dir, jumping over each subdirectory's own run
+* @param dir
+* @param fn
+*/
+void NameIndexFile::Children(std::string_view dir, const std::function<void(const Entry&)>& fn) const {
+    const std::string prefix = Join(dir, "");
+    Cursor cursor(*this, LowerBound(prefix));
+    while (cursor.Next()) {
+        const Entry& e = cursor.Get();
+        if (e.path.size() <= prefix.size()) continue; // dir itself, when it is "/"
+        if (e.path.compare(0, prefix.size(), prefix) != 0) break;
+        fn(e);
+        // '/' sorts as 0, so the subtree of e ends before e + "\x01"
+        if (e.dir) cursor = Cursor(*this, LowerBound(e.path + '\x01'));
+    }
+}
+
+/* Start at the head of id's block and decode up to id
+* @param file
+* @param id
+*/
+NameIndexFile::Cursor::Cursor(const NameIndexFile& file, std::uint64_t id)
+    : file_(&file), next_(id - id % kBlockSize)
+{
+    while (next_ < id && Next()) {
+    }
+}
+/* Decode the next entry, restarting at every block boundary
+* @return false at the end or on a corrupt entry
+*/
+bool NameIndexFile::Cursor::Next() {
+    const Header& h = file_->Head();
+    if (next_ >= h.entryCount) return false;
+    const std::uint8_t* names = file_->data_ + h.namesOffset;
+    const std::uint8_t* end = names + h.namesSize;
+    if (next_ % kBlockSize == 0) {
+        const std::uint64_t offset =
+            reinterpret_cast<const std::uint64_t*>(file_->data_ + h.blocksOffset)[next_ / kBlockSize];
+        if (offset >= h.namesSize) {
+            next_ = h.entryCount;
+            return false;
+        }
+        p_ = names + offset;
+        entry_.path.clear();
+    }
+    std::uint64_t shared = 0;
+    std::uint64_t length = 0;
+    if (!GetVarint(p_, end, shared) || !GetVarint(p_, end, length) || shared > entry_.path.size() ||
+        length >= static_cast<std::uint64_t>(end - p_)) {
+        next_ = h.entryCount;
+        return false;
+    }
+    entry_.path.resize(shared);
+    entry_.path.append(reinterpret_cast<const char*>(p_), length);
+    p_ += length;
+    entry_.dir = (*p_++ & 1) != 0;
+    entry_.id = next_++;
+    return true;
+}
+
+/* Append one entry: front code it against the previous path and post the
+* trigrams of its base name
+* @param path: sorts after the previous one
+* @param dir
+* @param mtimeNs: directories only
+*/
+void NameIndexFile::Writer::Add(std::string_view path, bool dir, std::int64_t mtimeNs) {
+    if (count_ % kBlockSize == 0) {
+        blocks_.push_back(names_.size());
+        prev_.clear();
+    }
+    const std::size_t n = std::min(prev_.size(), path.size());
+    std::size_t shared = 0;
+    while (shared < n && prev_[shared] == path[shared]) ++shared;
+    PutVarint(names_, shared);
+    PutVarint(names_, path.size() - shared);
+    names_.append(path.data() + shared, path.size() - shared);
+    names_.push_back(dir ? 1 : 0);
+    if (dir) {
+        dirEntries_.push_back(count_);
+        dirTimes_.push_back(mtimeNs);
+    }
+    // Runs of base + "\0\0" that start before its last byte: every trigram of
+    // the name plus the one that ends it
+    const std::string_view base = BaseName(path);
+    auto at = [&base](std::size_t i) { return i < base.size() ? base[i] : '\0'; };
+    for (std::size_t i = 0; i + 1 < base.size(); ++i) {
+        const char run[3] = {base[i], at(i + 1), at(i + 2)};
+        Postings& list = trigrams_[Trigram(run)];
+        if (list.count > 0 && list.last == count_) continue; // Repeated in this name
+        PutVarint(list.bytes, count_ - list.last);
+        list.last = count_;
+        ++list.count;
+    }
+    prev_.assign(path.data(), path.size());
+    ++count_;
+}
+/* Lay the sections out, write them to a temporary file and rename it
+* over file
+* @param file
+* @param roots
+* @param ec
+* @return true on success
+*/
+bool NameIndexFile::Writer::Finish(const std::filesystem::path& file,
+                                   const std::vector<std::filesystem::path>& roots, std::error_code& ec) {
+    ec.clear();
+    std::vector<std::uint32_t> keys;
+    keys.reserve(trigrams_.size());
+    for (const auto& kv : trigrams_) keys.push_back(kv.first);
+    std::sort(keys.begin(), keys.end());
+    std::vector<TrigramRecord> records;
+    records.reserve(keys.size());
+    std::string postings;
+    for (const std::uint32_t key : keys) {
+        Postings& list = trigrams_[key];
+        records.push_back({key, list.count, postings.size()});
+        postings += list.bytes;
+        std::string().swap(list.bytes);
+    }
+    std::string rootText;
+    for (const auto& root : roots) {
+        rootText += root.string();
+        rootText.push_back('\0');
+    }
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.blockSize = kBlockSize;
+    h.entryCount = count_;
+    h.dirCount = dirEntries_.size();
+    h.trigramCount = records.size();
+    h.rootsOffset = Align8(sizeof(Header));
+    h.rootsSize = rootText.size();
+    h.blocksOffset = Align8(h.rootsOffset + h.rootsSize);
+    h.namesOffset = h.blocksOffset + blocks_.size() * 8;
+    h.namesSize = names_.size();
+    h.dirsOffset = Align8(h.namesOffset + h.namesSize);
+    h.trigramsOffset = h.dirsOffset + h.dirCount * 16;
+    h.postingsOffset = h.trigramsOffset + records.size() * sizeof(TrigramRecord);
+    h.postingsSize = postings.size();
+
+    std::filesystem::create_directories(file.parent_path(), ec);
+    if (ec) return false;
+    std::filesystem::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        std::uint64_t written = 0;
+        auto put = [&](std::uint64_t at, const void* data, std::size_t size) {
+            static const char zeros[8] = {};
+            out.write(zeros, static_cast<std::streamsize>(at - written));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            written = at + size;
+        };
+        put(0, &h, sizeof(h));
+        put(h.rootsOffset, rootText.data(), rootText.size());
+        put(h.blocksOffset, blocks_.data(), blocks_.size() * 8);
+        put(h.namesOffset, names_.data(), names_.size());
+        put(h.dirsOffset, dirEntries_.data(), dirEntries_.size() * 8);
+        put(h.dirsOffset + h.dirCount * 8, dirTimes_.data(), dirTimes_.size() * 8);
+        put(h.trigramsOffset, records.data(), records.size() * sizeof(TrigramRecord));
+        put(h.postingsOffset, postings.data(), postings.size());
+        out.flush();
+        if (!out) ec = std::make_error_code(std::errc::io_error);
+    }
+    if (!ec) std::filesystem::rename(tmp, file, ec);
+    if (ec) {
+        std::error_code ignored;
+        std::filesystem::remove(tmp, ignored);
+        return false;
+    }
+    return true;
+}
+
+namespace {
+// A directory found by Build, with its listing; freed once written
+struct BuildDir {
+    std::string path;
+    std::int64_t mtimeNs = 0;
+    std::string names;               // File names back to back
+    std::vector<std::uint32_t> ends; // End of each in names
+    std::vector<std::unique_ptr<BuildDir>> dirs;
+};
+struct BuildJob {
+    ThreadPool* pool = nullptr;
+    OpProgress* progress = nullptr;
+};
+
+/* List one directory; subdirectories become tasks
+* @param job
+* @param node
+* @param parentDev: device of the parent, 0 for a root
+*/
+void WalkDir(BuildJob& job, BuildDir* node, std::uint64_t parentDev) {
+    if (job.progress && !job.progress->Checkpoint()) return;
+    DirEntryInfo info;
+    std::error_code ec;
+    if (!DirScanner::Stat(node->path, info, ec)) return;
+    if (parentDev != 0 && info.dev != parentDev) {
+        node->mtimeNs = kNotEntered;
+        return;
+    }
+    node->mtimeNs = info.mtimeNs;
+    DirScanner::Scan(node->path, DirScanner::kNamesOnly | DirScanner::kNoFollow,
+                     [node](const DirEntryInfo& e) {
+        if (e.type == EntryType::Dir && !e.symlink) {
+            auto child = std::make_unique<BuildDir>();
+            child->path = Join(node->path, e.name);
+            node->dirs.push_back(std::move(child));
+        } else {
+            node->names.append(e.name.data(), e.name.size());
+            node->ends.push_back(static_cast<std::uint32_t>(node->names.size()));
+        }
+        return true;
+    }, ec);
+    if (job.progress) job.progress->files.fetch_add(node->ends.size() + node->dirs.size(), std::memory_order_relaxed);
+    for (auto& child : node->dirs) {
+        BuildDir* c = child.get();
+        const std::uint64_t dev = info.dev;
+        job.pool->Submit([&job, c, dev]() { WalkDir(job, c, dev); });
+    }
+}
+
+/* Write a directory and everything below it in index order: siblings by
+* name, each directory followed by its own subtree
+* @param writer
+* @param node
+*/
+void Emit(NameIndexFile::Writer& writer, BuildDir& node) {
+    writer.Add(node.path, true, node.mtimeNs);
+    std::vector<std::string_view> files;
+    files.reserve(node.ends.size());
+    std::uint32_t begin = 0;
+    for (const std::uint32_t end : node.ends) {
+        files.emplace_back(node.names.data() + begin, end - begin);
+        begin = end;
+    }
+    std::sort(files.begin(), files.end());
+    std::sort(node.dirs.begin(), node.dirs.end(), [](const auto& a, const auto& b) {
+        return BaseName(a->path) < BaseName(b->path);
+    });
+    std::size_t f = 0;
+    std::size_t d = 0;
+    while (f < files.size() || d < node.dirs.size()) {
+        if (d == node.dirs.size() || (f < files.size() && files[f] < BaseName(node.dirs[d]->path))) {
+            writer.Add(Join(node.path, files[f++]), false, 0);
+        } else {
+            Emit(writer, *node.dirs[d]);
+            node.dirs[d++].reset();
+        }
+    }
+}
+}
+
+NameIndex::NameIndex(std::filesystem::path file)
+    : file_(std::move(file))
+{
+}
+NameIndex::~NameIndex() {
+    StopWatching();
+}
+std::filesystem::path NameIndex::DefaultFile() {
+    std::filesystem::path base;
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) {
+        base = cache;
+    } else if (const char* home = std::getenv("HOME"); home && *home) {
+        base = std::filesystem::path(home) / ".cache";
+    } else {
+        std::error_code ec;
+        base = std::filesystem::temp_directory_path(ec);
+    }
+    return base / "filemanager" / "names.idx";
+}
+/* Map the index file; the overlay starts empty
+* @param ec
+* @return true if loaded
+*/
+bool NameIndex::Open(std::error_code& ec) {
+    std::lock_guard<std::mutex> write(writeMutex_);
+    std::shared_ptr<const NameIndexFile> file = NameIndexFile::Open(file_, ec);
+    if (!file) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    base_ = std::move(file);
+    changes_.clear();
+    hiding_ = 0;
+    return true;
+}
+/* Walk the roots in parallel into a tree of listings, then write the tree
+* in index order. Roots inside another root are dropped. Watching should be
+* stopped around a Build: the overlay is cleared.
+* @param roots
+* @param progress
+* @param ec
+* @return true if the new index is loaded
+*/
+bool NameIndex::Build(const std::vector<std::filesystem::path>& roots, OpProgress* progress, std::error_code& ec) {
+    ec.clear();
+    std::vector<std::string> paths;
+    for (const auto& root : roots) {
+        std::string s = root.lexically_normal().string();
+        while (s.size() > 1 && s.back() == '/') s.pop_back();
+        if (!s.empty()) paths.push_back(std::move(s));
+    }
+    std::sort(paths.begin(), paths.end(), [](const std::string& a, const std::string& b) {
+        return NameIndexFile::ComparePaths(a, b) < 0;
+    });
+    std::vector<std::filesystem::path> kept;
+    std::vector<std::unique_ptr<BuildDir>> tops;
+    for (const auto& path : paths) {
+        if (!tops.empty()) {
+            const std::string prefix = Join(tops.back()->path, "");
+            if (path == tops.back()->path || path.compare(0, prefix.size(), prefix) == 0) continue;
+        }
+        tops.push_back(std::make_unique<BuildDir>());
+        tops.back()->path = path;
+        kept.emplace_back(path);
+    }
+    if (tops.empty()) {
+        ec = std::make_error_code(std::errc::invalid_argument);
+        return false;
+    }
+    {
+        ThreadPool pool;
+        BuildJob job;
+        job.pool = &pool;
+        job.progress = progress;
+        for (auto& top : tops) {
+            BuildDir* node = top.get();
+            pool.Submit([&job, node]() { WalkDir(job, node, 0); });
+        }
+        pool.Wait();
+    }
+    if (progress && progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    NameIndexFile::Writer writer;
+    for (auto& top : tops) Emit(writer, *top);
+    tops.clear();
+
+    std::lock_guard<std::mutex> write(writeMutex_);
+    if (!writer.Finish(file_, kept, ec)) return false;
+    std::shared_ptr<const NameIndexFile> file = NameIndexFile::Open(file_, ec);
+    if (!file) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    base_ = std::move(file);
+    changes_.clear();
+    hiding_ = 0;
+    return true;
+}
+/* Stat every indexed directory on a pool. A directory whose mtime moved
+* gained or lost names; only those are listed again.
+* @param progress
+* @param ec
+* @return false when cancelled or nothing is loaded
+*/
+bool NameIndex::Refresh(OpProgress* progress, std::error_code& ec) {
+    ec.clear();
+    std::lock_guard<std::mutex> write(writeMutex_);
+    std::shared_ptr<const NameIndexFile> base;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base = base_;
+    }
+    if (!base) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return false;
+    }
+    const std::uint64_t dirs = base->DirCount();
+    if (progress) progress->totalFiles.store(dirs);
+    {
+        ThreadPool pool;
+        for (std::uint64_t first = 0; first < dirs; first += kDirsPerTask) {
+            pool.Submit([this, &base, first, dirs, progress]() {
+                const std::uint64_t last = std::min<std::uint64_t>(first + kDirsPerTask, dirs);
+                for (std::uint64_t i = first; i < last; ++i) {
+                    if (progress && !progress->Checkpoint()) return;
+                    std::uint64_t entry = 0;
+                    std::int64_t mtimeNs = 0;
+                    base->Dir(i, entry, mtimeNs);
+                    if (progress) progress->files.fetch_add(1, std::memory_order_relaxed);
+                    if (mtimeNs == kNotEntered) continue;
+                    NameIndexFile::Cursor cursor(*base, entry);
+                    if (!cursor.Next()) continue;
+                    const std::string& path = cursor.Get().path;
+                    DirEntryInfo info;
+                    std::error_code statEc;
+                    if (!DirScanner::Stat(path, info, statEc)) {
+                        Change gone;
+                        gone.dir = true;
+                        gone.hidesBase = true;
+                        Record(path, gone);
+                    } else if (info.type != EntryType::Dir) {
+                        continue; // Replaced by a file; the parent's rescan records that
+                    } else if (info.mtimeNs != mtimeNs) {
+                        RescanDir(*base, path, info.mtimeNs, info.dev);
+                    }
+                }
+            });
+        }
+        pool.Wait();
+    }
+    if (progress && progress->cancelled.load()) {
+        ec = std::make_error_code(std::errc::operation_canceled);
+        return false;
+    }
+    return true;
+}
+/* List dir and record how it differs from its indexed children
+* @param base
+* @param dir
+* @param mtimeNs: its mtime now
+* @param dev: its device
+*/
+void NameIndex::RescanDir(const NameIndexFile& base, const std::string& dir, std::int64_t mtimeNs,
+                          std::uint64_t dev) {
+    std::unordered_map<std::string, bool> now; // Name -> is a directory
+    std::error_code ec;
+    DirScanner::Scan(dir, DirScanner::kNamesOnly | DirScanner::kNoFollow, [&now](const DirEntryInfo& e) {
+        now.emplace(std::string(e.name), e.type == EntryType::Dir && !e.symlink);
+        return true;
+    }, ec);
+    if (ec) return; // Unreadable now; keep what is indexed
+    base.Children(dir, [&](const NameIndexFile::Entry& e) {
+        auto it = now.find(std::string(BaseName(e.path)));
+        if (it != now.end() && it->second == e.dir) {
+            now.erase(it); // Unchanged
+            return;
+        }
+        Change gone; // Removed, or its type changed and it is added again below
+        gone.dir = e.dir;
+        gone.hidesBase = e.dir;
+        Record(e.path, gone);
+    });
+    for (const auto& [name, isDir] : now) {
+        const std::string path = Join(dir, name);
+        if (isDir) {
+            AddTree(path, dev, nullptr);
+        } else {
+            Change added;
+            added.present = true;
+            Record(path, added);
+        }
+    }
+    Change self;
+    self.present = true;
+    self.dir = true;
+    self.mtimeNs = mtimeNs;
+    Record(dir, self);
+}
+/* Walk a directory that is not indexed yet, on the calling thread
+* @param dir
+* @param parentDev: device of its parent; a different one is not entered
+* @param dirs
+*/
+void NameIndex::AddTree(const std::string& dir, std::uint64_t parentDev, std::vector<std::string>* dirs) {
+    std::vector<std::pair<std::string, std::uint64_t>> stack{{dir, parentDev}};
+    while (!stack.empty()) {
+        auto [path, dev] = std::move(stack.back());
+        stack.pop_back();
+        DirEntryInfo info;
+        std::error_code ec;
+        if (!DirScanner::Stat(path, info, ec)) continue;
+        Change self;
+        self.present = true;
+        self.dir = true;
+        self.mtimeNs = dev != 0 && info.dev != dev ? kNotEntered : info.mtimeNs;
+        Record(path, self);
+        if (self.mtimeNs == kNotEntered) continue;
+        if (dirs) dirs->push_back(path);
+        DirScanner::Scan(path, DirScanner::kNamesOnly | DirScanner::kNoFollow, [&](const DirEntryInfo& e) {
+            std::string child = Join(path, e.name);
+            if (e.type == EntryType::Dir && !e.symlink) {
+                stack.emplace_back(std::move(child), info.dev);
+            } else {
+                Change file;
+                file.present = true;
+                Record(child, file);
+            }
+            return true;
+        }, ec);
+    }
+}
+/* Overlay one path. A removed directory takes the overlay entries below
+* it along, and hidesBase is never cleared by a later change.
+* @param path
+* @param change
+*/
+void NameIndex::Record(const std::string& path, Change change) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (change.hidesBase && !change.present) {
+        // The subtree is one run of the ordered overlay
+        auto first = changes_.upper_bound(Join(path, ""));
+        auto last = path == "/" ? changes_.end() : changes_.lower_bound(path + '\x01');
+        for (auto it = first; it != last; ++it) {
+            if (it->second.hidesBase) --hiding_;
+        }
+        changes_.erase(first, last);
+    }
+    auto [it, added] = changes_.emplace(path, change);
+    if (added) {
+        if (change.hidesBase) ++hiding_;
+        return;
+    }
+    if (it->second.hidesBase) change.hidesBase = true;
+    else if (change.hidesBase) ++hiding_;
+    it->second = change;
+}
+/* An indexed path is hidden when the overlay has its own entry for it or
+* one of its directories was removed
+* @param overlay
+* @param hiding: entries of overlay with hidesBase
+* @param path
+* @return true if path should not be reported from the file
+*/
+bool NameIndex::Hidden(const Overlay& overlay, std::size_t hiding, const std::string& path) {
+    if (overlay.empty()) return false;
+    if (overlay.count(path)) return true;
+    if (hiding == 0) return false;
+    std::string ancestor;
+    for (std::size_t slash = path.find('/'); slash != std::string::npos && slash + 1 < path.size();
+         slash = path.find('/', slash + 1)) {
+        ancestor.assign(path, 0, slash == 0 ? 1 : slash);
+        auto it = overlay.find(ancestor);
+        if (it != overlay.end() && it->second.hidesBase) return true;
+    }
+    return false;
+}
+/* Stream the file and the sorted overlay into a new file. Changes made
+* while it is written stay in the overlay.
+* @param ec
+* @return true if the file is current
+*/
+bool NameIndex::Save(std::error_code& ec) {
+    ec.clear();
+    std::lock_guard<std::mutex> write(writeMutex_);
+    std::shared_ptr<const NameIndexFile> base;
+    Overlay snapshot;
+    std::size_t hiding = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base = base_;
+        snapshot = changes_;
+        hiding = hiding_;
+    }
+    if (!base) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return false;
+    }
+    if (snapshot.empty()) return true;
+    std::vector<const Overlay::value_type*> added; // Already in index order
+    for (const auto& kv : snapshot) {
+        if (kv.second.present) added.push_back(&kv);
+    }
+
+    NameIndexFile::Writer writer;
+    std::size_t a = 0;
+    const std::uint64_t dirCount = base->DirCount();
+    std::uint64_t dirIndex = 0;
+    std::uint64_t dirEntry = 0;
+    std::int64_t dirTime = 0;
+    auto nextDir = [&]() {
+        if (dirIndex < dirCount) base->Dir(dirIndex++, dirEntry, dirTime);
+        else dirEntry = base->EntryCount();
+    };
+    nextDir();
+    NameIndexFile::Cursor cursor(*base, 0);
+    while (cursor.Next()) {
+        const NameIndexFile::Entry& e = cursor.Get();
+        std::int64_t mtimeNs = 0;
+        if (e.id == dirEntry) {
+            mtimeNs = dirTime;
+            nextDir();
+        }
+        for (; a < added.size() && NameIndexFile::ComparePaths(added[a]->first, e.path) < 0; ++a) {
+            writer.Add(added[a]->first, added[a]->second.dir, added[a]->second.mtimeNs);
+        }
+        if (!Hidden(snapshot, hiding, e.path)) writer.Add(e.path, e.dir, mtimeNs);
+    }
+    for (; a < added.size(); ++a) {
+        writer.Add(added[a]->first, added[a]->second.dir, added[a]->second.mtimeNs);
+    }
+    if (!writer.Finish(file_, base->Roots(), ec)) return false;
+    std::shared_ptr<const NameIndexFile> file = NameIndexFile::Open(file_, ec);
+    if (!file) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    base_ = std::move(file);
+    for (const auto& [path, change] : snapshot) {
+        auto it = changes_.find(path);
+        if (it == changes_.end()) continue;
+        if (it->second == change) {
+            if (change.hidesBase) --hiding_;
+            changes_.erase(it);
+        } else if (it->second.present && it->second.hidesBase && change.hidesBase) {
+            // The removal is in the new file; do not hide what it has below
+            it->second.hidesBase = false;
+            --hiding_;
+        }
+    }
+    return true;
+}
+/* Stop watching, drop the index and delete its file
+*/
+void NameIndex::Disable() {
+    StopWatching();
+    std::lock_guard<std::mutex> write(writeMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base_.reset();
+        changes_.clear();
+        hiding_ = 0;
+    }
+    std::error_code ec;
+    std::filesystem::remove(file_, ec);
+}
+/* Indexed matches first, in path order, then matching paths of the overlay
+* @param text
+* @param limit
+* @param out
+* @return out.size()
+*/
+std::size_t NameIndex::Query(std::string_view text, std::size_t limit, std::vector<std::string>& out) const {
+    out.clear();
+    if (text.empty() || limit == 0) return 0;
+    std::shared_ptr<const NameIndexFile> base;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base = base_;
+    }
+    if (!base) return 0;
+    base->Find(text, [&](const NameIndexFile::Entry& e) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (Hidden(changes_, hiding_, e.path)) return true;
+        }
+        out.push_back(e.path);
+        return out.size() < limit;
+    });
+    const bool wholePath = text.find('/') != std::string_view::npos;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [path, change] : changes_) {
+        if (out.size() >= limit) break;
+        if (change.present && NameMatches(path, text, wholePath)) out.push_back(path);
+    }
+    return out.size();
+}
+bool NameIndex::Loaded() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return base_ != nullptr;
+}
+std::vector<std::filesystem::path> NameIndex::Roots() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return base_ ? base_->Roots() : std::vector<std::filesystem::path>();
+}
+std::uint64_t NameIndex::EntryCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return base_ ? base_->EntryCount() : 0;
+}
+std::size_t NameIndex::OverlaySize() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return changes_.size();
+}
+
+#if defined(__linux__)
+namespace {
+constexpr std::uint32_t kIndexWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                          IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+constexpr std::size_t kIndexEventBufSize = 64 * 1024;
+
+bool StopRequested(int stopFd) {
+    pollfd fd = {stopFd, POLLIN, 0};
+    return ::poll(&fd, 1, 0) > 0;
+}
+}
+
+/* Start the watch thread; it adds the watches itself, so this returns at once
+* @return false if nothing is loaded or inotify is unavailable
+*/
+bool NameIndex::StartWatching() {
+    std::lock_guard<std::mutex> guard(watchMutex_);
+    if (watchThread_.joinable()) return true;
+    if (!Loaded()) return false;
+    const int inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) return false;
+    stopFd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (stopFd_ < 0) {
+        ::close(inotifyFd);
+        return false;
+    }
+    watchThread_ = std::thread(&NameIndex::WatchLoop, this, inotifyFd, stopFd_);
+    return true;
+}
+/* Wake the watch thread through the eventfd and join it
+*/
+void NameIndex::StopWatching() {
+    std::lock_guard<std::mutex> guard(watchMutex_);
+    if (watchThread_.joinable()) {
+        const std::uint64_t one = 1;
+        ssize_t rc = ::write(stopFd_, &one, sizeof(one));
+        (void)rc;
+        watchThread_.join();
+    }
+    if (stopFd_ >= 0) {
+        ::close(stopFd_);
+        stopFd_ = -1;
+    }
+}
+/* Watch every indexed directory, then turn events into overlay changes.
+* Lost events and the end of the watch budget fall back to mtime checks.
+* @param inotifyFd: closed on exit
+* @param stopFd: readable when StopWatching is called
+*/
+void NameIndex::WatchLoop(int inotifyFd, int stopFd) {
+    std::unordered_map<int, std::string> watched; // Watch descriptor -> directory
+    std::map<std::string, int, PathLess> byPath;  // And back, in index order
+    bool full = false; // Out of watches; the rest waits for the next Refresh
+    auto watch = [&](const std::string& dir) {
+        if (full) return;
+        const int wd = ::inotify_add_watch(inotifyFd, dir.c_str(), kIndexWatchMask);
+        if (wd >= 0) {
+            watched[wd] = dir;
+            byPath[dir] = wd;
+        } else if (errno == ENOSPC) {
+            full = true;
+        }
+    };
+    // A directory moved away keeps its watches; drop them with their old paths
+    auto unwatch = [&](const std::string& dir) {
+        auto first = byPath.lower_bound(dir);
+        auto last = dir == "/" ? byPath.end() : byPath.lower_bound(dir + '\x01');
+        for (auto it = first; it != last; ++it) {
+            ::inotify_rm_watch(inotifyFd, it->second);
+            watched.erase(it->second);
+        }
+        byPath.erase(first, last);
+    };
+    std::shared_ptr<const NameIndexFile> base;
+    std::vector<std::string> recentDirs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base = base_;
+        for (const auto& [path, change] : changes_) {
+            if (change.present && change.dir && change.mtimeNs != kNotEntered) recentDirs.push_back(path);
+        }
+    }
+    for (std::uint64_t i = 0; base && i < base->DirCount() && !full; ++i) {
+        if (i % 4096 == 0 && StopRequested(stopFd)) {
+            ::close(inotifyFd);
+            return;
+        }
+        std::uint64_t entry = 0;
+        std::int64_t mtimeNs = 0;
+        base->Dir(i, entry, mtimeNs);
+        if (mtimeNs == kNotEntered) continue;
+        NameIndexFile::Cursor cursor(*base, entry);
+        if (cursor.Next()) watch(cursor.Get().path);
+    }
+    base.reset();
+    for (const auto& dir : recentDirs) watch(dir);
+
+    alignas(inotify_event) char buf[kIndexEventBufSize];
+    for (;;) {
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0 && errno != EINTR) break;
+        if (fds[1].revents & POLLIN) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        bool lost = false;
+        std::unordered_set<std::string> touched;        // Directories whose names changed
+        std::vector<std::pair<std::string, std::string>> created; // New directory, its parent
+        for (;;) {
+            const ssize_t n = ::read(inotifyFd, buf, sizeof(buf));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                break; // EAGAIN: drained
+            }
+            for (ssize_t off = 0; off < n;) {
+                const auto* ev = reinterpret_cast<const inotify_event*>(buf + off);
+                off += sizeof(inotify_event) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    lost = true;
+                    continue;
+                }
+                auto it = watched.find(ev->wd);
+                if (it == watched.end()) continue;
+                if (ev->mask & IN_IGNORED) {
+                    auto back = byPath.find(it->second);
+                    if (back != byPath.end() && back->second == ev->wd) byPath.erase(back);
+                    watched.erase(it);
+                    continue;
+                }
+                if (ev->len == 0) continue;
+                const std::string dir = it->second;
+                const std::string path = Join(dir, ev->name); // name is null padded
+                const bool isDir = (ev->mask & IN_ISDIR) != 0;
+                touched.insert(dir);
+                if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    Change gone;
+                    gone.dir = isDir;
+                    gone.hidesBase = isDir;
+                    Record(path, gone);
+                    if (isDir) unwatch(path);
+                } else if (isDir) {
+                    created.emplace_back(path, dir);
+                } else {
+                    Change file;
+                    file.present = true;
+                    Record(path, file);
+                }
+            }
+        }
+        std::unordered_map<std::string, std::uint64_t> devices;
+        for (const auto& dir : touched) {
+            DirEntryInfo info;
+            std::error_code ec;
+            if (!DirScanner::Stat(dir, info, ec)) continue;
+            devices[dir] = info.dev;
+            Change self;
+            self.present = true;
+            self.dir = true;
+            self.mtimeNs = info.mtimeNs;
+            Record(dir, self);
+        }
+        for (const auto& [path, parent] : created) {
+            auto dev = devices.find(parent);
+            std::vector<std::string> dirs;
+            AddTree(path, dev == devices.end() ? 0 : dev->second, &dirs);
+            for (const auto& dir : dirs) watch(dir);
+        }
+        std::error_code ec;
+        if (lost) Refresh(nullptr, ec); // New directories it finds are watched from the next start
+        if (OverlaySize() >= kMaxOverlay) Save(ec);
+    }
+    ::close(inotifyFd);
+}
+
+#else // Portable fallback: only the mtime checks of Refresh
+
+bool NameIndex::StartWatching() {
+    return false;
+}
+void NameIndex::StopWatching() {
+}
+
+#endif
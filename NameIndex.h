@@ -0,0 +1,277 @@
+/*
+    Description: Declare NameIndexFile, the compact on-disk index of every path
+                 under a set of roots, and NameIndex, which keeps it current
+*/
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "OpProgress.h"
+
+/* A read-only index file, mapped into memory.
+                 - Paths are sorted component by component ('/' sorts before
+                   any other byte), so every subtree is one contiguous run
+                 - They are front coded in blocks of kBlockSize: each block
+                   starts with a full path, the others store only the bytes
+                   that differ from the previous path
+                 - Every directory has a record with its mtime, for the
+                   change check at startup
+                 - A trigram table maps each 3-byte run of the ASCII-lowercased
+                   base names to the ids of the entries containing it, as
+                   delta-coded varints. Names are padded with a NUL, so a
+                   two-byte query is the union of one range of trigrams
+                 - Integers are in native byte order; the file is a cache and
+                   is rebuilt when it does not match
+*/
+class NameIndexFile {
+public:
+    static constexpr std::uint32_t kBlockSize = 32;
+
+    // One decoded entry
+    struct Entry {
+        std::uint64_t id = 0;
+        std::string path;
+        bool dir = false;
+    };
+
+    /* Reads entries in order, decoding each block once
+    */
+    class Cursor {
+    public:
+        // Position so that the first Next yields entry id
+        Cursor(const NameIndexFile& file, std::uint64_t id);
+        // Advance; false past the last entry or on a corrupt block
+        bool Next();
+        const Entry& Get() const { return entry_; }
+
+    private:
+        const NameIndexFile* file_;
+        std::uint64_t next_;
+        const std::uint8_t* p_ = nullptr;
+        Entry entry_;
+    };
+
+    /* Map an index file
+    * @param file
+    * @param ec: bad_message when it is not an index of this version
+    * @return the index, nullptr on error
+    */
+    static std::shared_ptr<const NameIndexFile> Open(const std::filesystem::path& file, std::error_code& ec);
+    ~NameIndexFile();
+    NameIndexFile(const NameIndexFile&) = delete;
+    NameIndexFile& operator=(const NameIndexFile&) = delete;
+
+    std::uint64_t EntryCount() const;
+    std::uint64_t DirCount() const;
+    std::vector<std::filesystem::path> Roots() const;
+
+    /* Directory record i, in path order
+    * @param i: < DirCount()
+    * @param entry: receives its entry id
+    * @param mtimeNs: receives its mtime when indexed
+    */
+    void Dir(std::uint64_t i, std::uint64_t& entry, std::int64_t& mtimeNs) const;
+
+    /* Id of the first entry whose path sorts at or after key
+    * @param key
+    * @return EntryCount() when there is none
+    */
+    std::uint64_t LowerBound(std::string_view key) const;
+
+    /* Find entries whose base name contains text, ASCII case folded. A text
+    * with a '/' is matched against the whole path instead.
+    * @param text: may not be empty
+    * @param fn: called with each match in path order; return false to stop
+    */
+    void Find(std::string_view text, const std::function<bool(const Entry&)>& fn) const;
+
+    /* Call fn for each entry directly inside dir
+    * @param dir: an indexed directory
+    * @param fn: called with each child in path order
+    */
+    void Children(std::string_view dir, const std::function<void(const Entry&)>& fn) const;
+
+    /* Order of the index: bytewise with '/' below every other byte
+    * @return <0, 0 or >0 like strcmp
+    */
+    static int ComparePaths(std::string_view a, std::string_view b);
+
+    /* Write an index from entries given in ComparePaths order. The file is
+    * written next to its final name and renamed over it.
+    */
+    class Writer {
+    public:
+        void Add(std::string_view path, bool dir, std::int64_t mtimeNs);
+        bool Finish(const std::filesystem::path& file, const std::vector<std::filesystem::path>& roots,
+                    std::error_code& ec);
+        std::uint64_t Count() const { return count_; }
+
+    private:
+        struct Postings {
+            std::string bytes;
+            std::uint64_t last = 0;
+            std::uint32_t count = 0;
+        };
+        std::string names_;
+        std::vector<std::uint64_t> blocks_;
+        std::vector<std::uint64_t> dirEntries_;
+        std::vector<std::int64_t> dirTimes_;
+        std::unordered_map<std::uint32_t, Postings> trigrams_;
+        std::string prev_;
+        std::uint64_t count_ = 0;
+    };
+
+private:
+    struct Header;
+    struct TrigramRecord;
+    NameIndexFile() = default;
+    const Header& Head() const;
+    // Trigram records with keys in [lo, hi]
+    std::pair<const TrigramRecord*, const TrigramRecord*> Trigrams(std::uint32_t lo, std::uint32_t hi) const;
+    // Postings of one record; false if they lie outside the file
+    bool Postings(const TrigramRecord* record, const std::uint8_t*& begin, const std::uint8_t*& end) const;
+    // Full path at the start of a block
+    std::string_view BlockHead(std::uint64_t block) const;
+
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<std::uint8_t> buffer_; // Used where mmap is not
+};
+
+/* Instant name search over whole volumes.
+                 - Build walks the roots on a work-stealing pool, staying on
+                   each root's file system, and writes a NameIndexFile
+                 - Changes since then live in an in-memory overlay keyed by
+                   path; queries merge it over the file
+                 - Refresh compares every directory's mtime with the index
+                   and rescans only the directories that changed; it runs at
+                   startup and when inotify loses events
+                 - StartWatching puts an inotify watch on every indexed
+                   directory; past the system watch limit the rest is left to
+                   the next Refresh
+                 - Once the overlay holds kMaxOverlay paths it is merged into
+                   a new file, so memory stays bounded
+*/
+class NameIndex {
+public:
+    static constexpr std::size_t kMaxOverlay = 64 * 1024;
+    static constexpr std::size_t kDirsPerTask = 256;  // Directories one Refresh task checks
+
+    /* Index kept in file
+    * @param file: need not exist yet
+    */
+    explicit NameIndex(std::filesystem::path file);
+    ~NameIndex();
+
+    // $XDG_CACHE_HOME/filemanager/names.idx, ~/.cache/... when unset
+    static std::filesystem::path DefaultFile();
+
+    /* Load the index file
+    * @param ec
+    * @return false if it is missing or unusable
+    */
+    bool Open(std::error_code& ec);
+
+    /* Index everything below roots and replace the file
+    * @param roots: directories to index
+    * @param progress: files counts entries found; checked per directory
+    * @param ec: operation_canceled when cancelled
+    * @return false on error or cancel; the old index stays
+    */
+    bool Build(const std::vector<std::filesystem::path>& roots, OpProgress* progress, std::error_code& ec);
+
+    /* Rescan the directories whose mtime differs from the index
+    * @param progress: files counts directories checked; may be nullptr
+    * @param ec
+    * @return false when cancelled or nothing is loaded
+    */
+    bool Refresh(OpProgress* progress, std::error_code& ec);
+
+    /* Merge the overlay into a new index file
+    * @param ec
+    * @return true if the file is current
+    */
+    bool Save(std::error_code& ec);
+
+    /* Follow changes with inotify until StopWatching
+    * @return false if unsupported or nothing is loaded
+    */
+    bool StartWatching();
+    void StopWatching();
+
+    // Stop watching, forget the index and delete its file
+    void Disable();
+
+    /* Paths whose base name contains text: indexed ones first in path order,
+    * then recent changes
+    * @param text: ASCII case is ignored; with a '/' the whole path is matched
+    * @param limit: most paths to return
+    * @param out: receives the paths
+    * @return number of paths
+    */
+    std::size_t Query(std::string_view text, std::size_t limit, std::vector<std::string>& out) const;
+
+    bool Loaded() const;
+    std::vector<std::filesystem::path> Roots() const;
+    std::uint64_t EntryCount() const;
+    std::size_t OverlaySize() const;
+
+private:
+    // State of one path in the overlay
+    struct Change {
+        bool present = false;    // Exists now
+        bool dir = false;
+        bool hidesBase = false;  // Indexed entries below it are gone
+        std::int64_t mtimeNs = 0;
+        bool operator==(const Change& o) const {
+            return present == o.present && dir == o.dir && hidesBase == o.hidesBase && mtimeNs == o.mtimeNs;
+        }
+    };
+    struct PathLess {
+        bool operator()(const std::string& a, const std::string& b) const {
+            return NameIndexFile::ComparePaths(a, b) < 0;
+        }
+    };
+    using Overlay = std::map<std::string, Change, PathLess>; // In index order
+
+    // Overlay a path; a removed directory keeps hiding what was below it
+    void Record(const std::string& path, Change change);
+    /* Record everything below a directory that just appeared
+    * @param dir
+    * @param parentDev: device of its parent, 0 if unknown
+    * @param dirs: receives each directory entered, dir included; may be nullptr
+    */
+    void AddTree(const std::string& dir, std::uint64_t parentDev, std::vector<std::string>* dirs);
+    // Compare one directory with the index and record the differences
+    void RescanDir(const NameIndexFile& base, const std::string& dir, std::int64_t mtimeNs, std::uint64_t dev);
+    // True if the overlay replaces or hides an indexed path
+    static bool Hidden(const Overlay& overlay, std::size_t hiding, const std::string& path);
+    void WatchLoop(int inotifyFd, int stopFd);
+
+    std::filesystem::path file_;
+    std::mutex writeMutex_;  // One Build, Refresh or Save at a time
+    mutable std::mutex mutex_;
+    std::shared_ptr<const NameIndexFile> base_;
+    Overlay changes_;
+    std::size_t hiding_ = 0;  // Changes with hidesBase
+    std::mutex watchMutex_;
+    std::thread watchThread_;
+    int stopFd_ = -1;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+    Description: Declare OpProgress, live counters shared by long file operations,
+                 and PathError, the per-item outcome of a batch
+*/
+#ifndef OPPROGRESS_H
+#define OPPROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+/* Counters written by worker threads and read by the UI while an
+   operation runs. Totals stay 0 when they are not known up front.
+   The UI can also pause or cancel the operation; workers notice at
+   their next Checkpoint.
+*/
+struct OpProgress {
+    std::atomic<std::uint64_t> files{0};       // Files finished
+    std::atomic<std::uint64_t> bytes{0};       // Data bytes moved so far
+    std::atomic<std::uint64_t> totalFiles{0};
+    std::atomic<std::uint64_t> totalBytes{0};
+    std::atomic<bool> paused{false};
+    std::atomic<bool> cancelled{false};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    /* Called by workers between units of work. Blocks while paused.
+    * @return false once the operation was cancelled
+    */
+    bool Checkpoint() const {
+        while (paused.load(std::memory_order_relaxed) && !cancelled.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return !cancelled.load(std::memory_order_relaxed);
+    }
+
+    double Seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    double MBPerSecond() const {
+        double s = Seconds();
+        return s > 0 ? bytes.load(std::memory_order_relaxed) / s / (1024.0 * 1024.0) : 0.0;
+    }
+};
+
+// One failed item of a batch operation
+struct PathError {
+    std::filesystem::path path;  // Path the error happened on
+    std::error_code ec;
+};
+
+#endif
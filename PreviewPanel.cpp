@@ -0,0 +1,403 @@
+/*
+    Description: Implementation of the text and hex preview panel.
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "PreviewPanel.h"
+#include "Trace.h"
+
+static constexpr int kTabWidth = 4;
+static constexpr int kMargin = 4;
+/* Make one text row drawable: tabs become spaces, other control
+* characters dots, and bytes that are not UTF-8 are read as Latin-1
+* @param row: the bytes of the row without its newline
+* @return wxString
+*/
+static wxString FormatTextRow(std::string_view row) {
+    if (!row.empty() && row.back() == '\r') row.remove_suffix(1);
+    std::string text;
+    text.reserve(row.size());
+    for (const char c : row) {
+        const unsigned char u = static_cast<unsigned char>(c);
+        if (c == '\t') {
+            text.append(kTabWidth - text.size() % kTabWidth, ' ');
+        } else {
+            text.push_back(u < 0x20 || u == 0x7f ? '.' : c);
+        }
+    }
+    wxString s = wxString::FromUTF8(text.data(), text.size());
+    if (s.empty() && !text.empty()) s = wxString(text.data(), wxConvISO8859_1, text.size());
+    return s;
+}
+/* Offset, up to 16 bytes in hex and the same bytes as ASCII
+* @param offset
+* @param row
+* @return wxString
+*/
+static wxString FormatHexRow(std::uint64_t offset, std::string_view row) {
+    char line[128];
+    int n = std::snprintf(line, sizeof(line), "%012llx ", static_cast<unsigned long long>(offset));
+    for (std::size_t i = 0; i < PreviewPanel::kHexBytes; ++i) {
+        if (i % 8 == 0) line[n++] = ' ';
+        if (i < row.size()) {
+            n += std::snprintf(line + n, sizeof(line) - n, "%02x ", static_cast<unsigned char>(row[i]));
+        } else {
+            n += std::snprintf(line + n, sizeof(line) - n, "   ");
+        }
+    }
+    line[n++] = '|';
+    for (const char c : row) {
+        const unsigned char u = static_cast<unsigned char>(c);
+        line[n++] = u >= 0x20 && u < 0x7f ? c : '.';
+    }
+    line[n++] = '|';
+    return wxString(line, wxConvISO8859_1, static_cast<std::size_t>(n));
+}
+/* Create the toolbar and the drawn view
+* @param parent
+*/
+PreviewPanel::PreviewPanel(wxWindow* parent)
+    : wxPanel(parent, wxID_ANY), timer_(this),
+      font_(10, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL)
+{
+    const wxString modes[] = { "Text", "Hex" };
+    m_mode = new wxChoice(this, ID_Mode, wxDefaultPosition, wxDefaultSize, 2, modes);
+    m_mode->SetSelection(0);
+    m_goto = new wxTextCtrl(this, ID_Goto, "", wxDefaultPosition, wxSize(140, -1), wxTE_PROCESS_ENTER);
+    m_goto->SetHint("Line or 0x offset");
+    wxButton* externalButton = new wxButton(this, ID_External, "Open E&xternally");
+    m_status = new wxStaticText(this, wxID_ANY, "");
+    m_view = new wxWindow(this, wxID_ANY, wxDefaultPosition, wxDefaultSize,
+                          wxVSCROLL | wxWANTS_CHARS | wxFULL_REPAINT_ON_RESIZE);
+    m_view->SetBackgroundStyle(wxBG_STYLE_PAINT);
+    m_view->SetFont(font_);
+
+    Bind(wxEVT_CHOICE, &PreviewPanel::OnMode, this, ID_Mode);
+    Bind(wxEVT_TEXT_ENTER, &PreviewPanel::OnGoto, this, ID_Goto);
+    Bind(wxEVT_BUTTON, &PreviewPanel::OnExternal, this, ID_External);
+    Bind(wxEVT_TIMER, &PreviewPanel::OnTimer, this);
+    m_view->Bind(wxEVT_PAINT, &PreviewPanel::OnPaint, this);
+    m_view->Bind(wxEVT_SIZE, &PreviewPanel::OnSize, this);
+    m_view->Bind(wxEVT_MOUSEWHEEL, &PreviewPanel::OnWheel, this);
+    m_view->Bind(wxEVT_KEY_DOWN, &PreviewPanel::OnKey, this);
+    m_view->Bind(wxEVT_SCROLLWIN_TOP, &PreviewPanel::OnScroll, this);
+    m_view->Bind(wxEVT_SCROLLWIN_BOTTOM, &PreviewPanel::OnScroll, this);
+    m_view->Bind(wxEVT_SCROLLWIN_LINEUP, &PreviewPanel::OnScroll, this);
+    m_view->Bind(wxEVT_SCROLLWIN_LINEDOWN, &PreviewPanel::OnScroll, this);
+    m_view->Bind(wxEVT_SCROLLWIN_PAGEUP, &PreviewPanel::OnScroll, this);
+    m_view->Bind(wxEVT_SCROLLWIN_PAGEDOWN, &PreviewPanel::OnScroll, this);
+    m_view->Bind(wxEVT_SCROLLWIN_THUMBTRACK, &PreviewPanel::OnScroll, this);
+    m_view->Bind(wxEVT_SCROLLWIN_THUMBRELEASE, &PreviewPanel::OnScroll, this);
+
+    wxBoxSizer* bar = new wxBoxSizer(wxHORIZONTAL);
+    bar->Add(m_mode, 0, wxRIGHT, 5);
+    bar->Add(m_goto, 0, wxRIGHT, 5);
+    bar->Add(externalButton, 0, wxRIGHT, 5);
+    bar->Add(m_status, 1, wxALIGN_CENTER_VERTICAL);
+    wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+    sizer->Add(bar, 0, wxEXPAND | wxBOTTOM, 5);
+    sizer->Add(m_view, 1, wxEXPAND);
+    SetSizer(sizer);
+}
+/* Open a file, pick text or hex from its first bytes and start indexing
+* @param p
+* @return true if the file can be shown
+*/
+bool PreviewPanel::ShowFile(const std::filesystem::path& p) {
+    index_.Stop();
+    timer_.Stop();
+    top_ = 0;
+    pageEnd_ = 0;
+    message_ = "";
+    std::error_code ec;
+    if (!file_.Open(p, ec)) {
+        message_ = ec == std::errc::is_a_directory
+            ? wxString("Folders have no preview.")
+            : "Cannot preview this file: " + wxString(ec.message());
+        m_status->SetLabel(wxString(p.filename().wstring()));
+        UpdateScrollbar();
+        m_view->Refresh();
+        return false;
+    }
+    // A NUL near the start means binary
+    const std::string_view head = file_.Window(0, kBinaryProbe, ec);
+    mode_ = !head.empty() && std::memchr(head.data(), '\0', head.size()) ? Mode::Hex : Mode::Text;
+    m_mode->SetSelection(mode_ == Mode::Hex ? 1 : 0);
+    index_.Start(p);
+    timer_.Start(kProgressMs);
+    UpdateScrollbar();
+    UpdateStatus();
+    m_view->Refresh();
+    return true;
+}
+
+void PreviewPanel::Clear() {
+    index_.Stop();
+    timer_.Stop();
+    file_.Close();
+    top_ = 0;
+    pageEnd_ = 0;
+    message_ = "";
+    m_status->SetLabel("");
+    UpdateScrollbar();
+    m_view->Refresh();
+}
+/* Search back at most one row for the newline before offset. Without one
+* the row is a wrapped piece of a long line and starts kRowBytes earlier.
+* @param offset
+* @return std::uint64_t
+*/
+std::uint64_t PreviewPanel::RowContaining(std::uint64_t offset) {
+    if (mode_ == Mode::Hex) return offset / kHexBytes * kHexBytes;
+    const std::uint64_t from = offset + 1 > kRowBytes ? offset + 1 - kRowBytes : 0;
+    std::error_code ec;
+    const std::string_view w = file_.Window(from, static_cast<std::size_t>(offset - from), ec);
+    for (std::size_t i = w.size(); i > 0; --i) {
+        if (w[i - 1] == '\n') return from + i;
+    }
+    return from;
+}
+
+std::uint64_t PreviewPanel::NextRow(std::uint64_t row) {
+    if (mode_ == Mode::Hex) return std::min(row + kHexBytes, file_.Size());
+    std::error_code ec;
+    const std::string_view w = file_.Window(row, kRowBytes, ec);
+    if (w.empty()) return file_.Size();
+    const void* newline = std::memchr(w.data(), '\n', w.size());
+    if (newline) return row + static_cast<std::uint64_t>(static_cast<const char*>(newline) - w.data()) + 1;
+    return row + w.size();
+}
+/* Step the top row forward or back; the last row stays on screen
+* @param delta
+*/
+void PreviewPanel::ScrollRows(long delta) {
+    std::uint64_t row = top_;
+    for (; delta > 0; --delta) {
+        const std::uint64_t next = NextRow(row);
+        if (next >= file_.Size()) break;
+        row = next;
+    }
+    for (; delta < 0 && row > 0; ++delta) row = RowContaining(row - 1);
+    top_ = row;
+    UpdateScrollbar();
+    UpdateStatus();
+    m_view->Refresh();
+}
+
+void PreviewPanel::ScrollTo(std::uint64_t offset) {
+    top_ = file_.Size() == 0 ? 0 : RowContaining(std::min(offset, file_.Size() - 1));
+    UpdateScrollbar();
+    UpdateStatus();
+    m_view->Refresh();
+}
+
+int PreviewPanel::VisibleRows() const {
+    return std::max(1, m_view->GetClientSize().GetHeight() / std::max(1, m_view->GetCharHeight()));
+}
+/* Place the thumb by byte offset, sized by the bytes on screen
+*/
+void PreviewPanel::UpdateScrollbar() {
+    const std::uint64_t size = file_.Size();
+    if (!file_.IsOpen() || size == 0) {
+        m_view->SetScrollbar(wxVERTICAL, 0, 0, 0);
+        return;
+    }
+    pageEnd_ = top_;
+    for (int i = VisibleRows(); i > 0 && pageEnd_ < size; --i) pageEnd_ = NextRow(pageEnd_);
+    const double steps = kScrollSteps;
+    const int thumb = std::max(1, static_cast<int>((pageEnd_ - top_) * steps / size));
+    const int position = std::min(kScrollSteps - thumb, static_cast<int>(top_ * steps / size));
+    m_view->SetScrollbar(wxVERTICAL, position, thumb, kScrollSteps);
+}
+/* Name, size, index progress and where the top row is
+*/
+void PreviewPanel::UpdateStatus() {
+    if (!file_.IsOpen()) return;
+    const LineIndex::Progress progress = index_.GetProgress();
+    wxString text = wxString(file_.Path().filename().wstring()) +
+                    wxString::Format("  %.1f MB  ", file_.Size() / (1024.0 * 1024.0));
+    if (progress.ec) {
+        text += "lines unknown: " + wxString(progress.ec.message());
+    } else if (progress.done) {
+        text += wxString::Format("%llu lines", static_cast<unsigned long long>(progress.Lines()));
+    } else {
+        const double percent = progress.size ? 100.0 * progress.scanned / progress.size : 0.0;
+        text += wxString::Format("indexing %.0f%%", percent);
+    }
+    std::uint64_t line = 0;
+    std::error_code ec;
+    if (index_.OffsetToLine(top_, file_, line, ec)) {
+        text += wxString::Format("  line %llu", static_cast<unsigned long long>(line + 1));
+    }
+    text += wxString::Format("  offset 0x%llx", static_cast<unsigned long long>(top_));
+    m_status->SetLabel(text);
+}
+/* Format and draw only the rows on screen. Each row is copied out of the
+* window before the next lookup, which may move it.
+*/
+void PreviewPanel::OnPaint(wxPaintEvent& event) {
+    wxPaintDC dc(m_view);
+    dc.SetBackground(wxBrush(m_view->GetBackgroundColour()));
+    dc.Clear();
+    dc.SetFont(font_);
+    dc.SetTextForeground(m_view->GetForegroundColour());
+    const int rowHeight = m_view->GetCharHeight();
+    if (!file_.IsOpen()) {
+        if (!message_.empty()) dc.DrawText(message_, kMargin, kMargin);
+        return;
+    }
+    TRACE_SCOPE(kUi, "PreviewPaint");
+    const std::uint64_t size = file_.Size();
+    std::error_code ec;
+    // Line numbers for rows that start a line, once the index has them
+    std::uint64_t line = 0;
+    const bool numbered = mode_ == Mode::Text && index_.OffsetToLine(top_, file_, line, ec);
+    bool lineStart = top_ == 0;
+    if (top_ > 0) {
+        const std::string_view before = file_.Window(top_ - 1, 1, ec);
+        lineStart = !before.empty() && before[0] == '\n';
+    }
+    const int gutter = numbered ? 11 * m_view->GetCharWidth() : 0;
+    std::uint64_t row = top_;
+    // One extra row fills the partly visible bottom line
+    for (int i = 0; i <= VisibleRows() && row < size; ++i) {
+        const std::uint64_t next = NextRow(row);
+        const std::string_view bytes = file_.Window(row, static_cast<std::size_t>(next - row), ec);
+        if (ec) break;
+        const int y = i * rowHeight;
+        if (mode_ == Mode::Hex) {
+            dc.DrawText(FormatHexRow(row, bytes), kMargin, y);
+        } else {
+            const bool endsLine = !bytes.empty() && bytes.back() == '\n';
+            dc.DrawText(FormatTextRow(endsLine ? bytes.substr(0, bytes.size() - 1) : bytes),
+                        kMargin + gutter, y);
+            if (numbered && lineStart) {
+                dc.DrawText(wxString::Format("%10llu", static_cast<unsigned long long>(line + 1)), kMargin, y);
+            }
+            if (endsLine) ++line;
+            lineStart = endsLine;
+        }
+        row = next;
+    }
+}
+
+void PreviewPanel::OnSize(wxSizeEvent& event) {
+    UpdateScrollbar();
+    m_view->Refresh();
+    event.Skip();
+}
+/* Arrows and pages move by rows; dragging the thumb jumps by offset
+* @param event
+*/
+void PreviewPanel::OnScroll(wxScrollWinEvent& event) {
+    if (!file_.IsOpen()) return;
+    const wxEventType type = event.GetEventType();
+    const long page = std::max(1, VisibleRows() - 1);
+    if (type == wxEVT_SCROLLWIN_TOP) {
+        ScrollTo(0);
+    } else if (type == wxEVT_SCROLLWIN_BOTTOM) {
+        ScrollTo(file_.Size());
+        ScrollRows(-page);
+    } else if (type == wxEVT_SCROLLWIN_LINEUP) {
+        ScrollRows(-1);
+    } else if (type == wxEVT_SCROLLWIN_LINEDOWN) {
+        ScrollRows(1);
+    } else if (type == wxEVT_SCROLLWIN_PAGEUP) {
+        ScrollRows(-page);
+    } else if (type == wxEVT_SCROLLWIN_PAGEDOWN) {
+        ScrollRows(page);
+    } else {
+        ScrollTo(static_cast<std::uint64_t>(static_cast<double>(event.GetPosition()) / kScrollSteps * file_.Size()));
+    }
+}
+
+void PreviewPanel::OnWheel(wxMouseEvent& event) {
+    const int delta = event.GetWheelDelta();
+    if (!file_.IsOpen() || delta == 0) return;
+    ScrollRows(-static_cast<long>(event.GetWheelRotation()) / delta * kWheelRows);
+}
+
+void PreviewPanel::OnKey(wxKeyEvent& event) {
+    if (!file_.IsOpen()) {
+        event.Skip();
+        return;
+    }
+    const long page = std::max(1, VisibleRows() - 1);
+    switch (event.GetKeyCode()) {
+        case WXK_UP: ScrollRows(-1); break;
+        case WXK_DOWN: ScrollRows(1); break;
+        case WXK_PAGEUP: ScrollRows(-page); break;
+        case WXK_PAGEDOWN: ScrollRows(page); break;
+        case WXK_HOME: ScrollTo(0); break;
+        case WXK_END:
+            ScrollTo(file_.Size());
+            ScrollRows(-page);
+            break;
+        default: event.Skip();
+    }
+}
+/* Rows have different starts in each mode, so snap the top row again
+* @param event
+*/
+void PreviewPanel::OnMode(wxCommandEvent& event) {
+    mode_ = m_mode->GetSelection() == 1 ? Mode::Hex : Mode::Text;
+    ScrollTo(top_);
+}
+/* Jump to "123" (line), "0x1f00" or "@7936" (byte offset). A line the
+* index has not reached yet says how far it is instead.
+* @param event
+*/
+void PreviewPanel::OnGoto(wxCommandEvent& event) {
+    if (!file_.IsOpen()) return;
+    wxString value = m_goto->GetValue();
+    value.Trim().Trim(false);
+    wxString rest;
+    unsigned long long n = 0;
+    if (value.StartsWith("0x", &rest) || value.StartsWith("0X", &rest) || value.StartsWith("@", &rest)) {
+        const int base = value.StartsWith("@") ? 10 : 16;
+        if (!rest.ToULongLong(&n, base) || n >= file_.Size()) {
+            m_status->SetLabel("Offset " + value + " is outside the file.");
+            return;
+        }
+        ScrollTo(n);
+    } else {
+        if (!value.ToULongLong(&n, 10) || n == 0) {
+            m_status->SetLabel("Enter a line number, 0x offset or @offset.");
+            return;
+        }
+        std::uint64_t offset = 0;
+        std::error_code ec;
+        if (!index_.LineToOffset(n - 1, file_, offset, ec)) {
+            const LineIndex::Progress progress = index_.GetProgress();
+            if (progress.done) {
+                m_status->SetLabel(wxString::Format("Line %llu is past the end (%llu lines).", n,
+                                                    static_cast<unsigned long long>(progress.Lines())));
+            } else {
+                const double percent = progress.size ? 100.0 * progress.scanned / progress.size : 0.0;
+                m_status->SetLabel(wxString::Format("Line %llu is not indexed yet (%.0f%% scanned).", n, percent));
+            }
+            return;
+        }
+        ScrollTo(offset);
+    }
+    m_view->SetFocus();
+}
+
+void PreviewPanel::OnExternal(wxCommandEvent& event) {
+    if (Path().empty()) return;
+    wxString filePathStr = Path().wstring();
+    if (!wxLaunchDefaultApplication(filePathStr)) {
+        wxMessageBox("Failed to open file:\n" + filePathStr, "Error", wxOK | wxICON_ERROR, this);
+    }
+}
+/* Show index progress and redraw so line numbers appear as it advances
+* @param event
+*/
+void PreviewPanel::OnTimer(wxTimerEvent& event) {
+    UpdateStatus();
+    m_view->Refresh();
+    if (index_.GetProgress().done) timer_.Stop();
+}
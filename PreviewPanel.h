@@ -0,0 +1,89 @@
+/*
+    Description: Declare PreviewPanel, the text and hex viewer for files of
+                 any size
+*/
+#ifndef PREVIEWPANEL_H
+#define PREVIEWPANEL_H
+#include <wx/wx.h>
+#include <wx/timer.h>
+#include <cstdint>
+#include <filesystem>
+
+#include "LineIndex.h"
+#include "MappedFile.h"
+
+/* Shows one file through a MappedFile window: only the rows on screen are
+   read and formatted, so a 20 GB log opens as fast as a small one and
+   memory stays the same.
+                 - Text mode: rows end at a newline or after kRowBytes bytes;
+                   line numbers appear once LineIndex has reached them
+                 - Hex mode: 16 bytes per row with offsets and ASCII
+                 - Go to: "123" is a line, "0x1f00" or "@7936" a byte offset
+                 - The scrollbar maps to byte offsets, not rows
+*/
+class PreviewPanel : public wxPanel {
+    public:
+        enum class Mode { Text, Hex };
+
+        static constexpr std::uint64_t kRowBytes = 1024;   // Longest text row before it wraps
+        static constexpr std::uint64_t kHexBytes = 16;     // Bytes per hex row
+        static constexpr std::size_t kBinaryProbe = 8192;  // NULs in this prefix start in hex
+        static constexpr int kScrollSteps = 100000;
+        static constexpr int kWheelRows = 3;
+        static constexpr int kProgressMs = 200;            // Index status refresh
+
+        explicit PreviewPanel(wxWindow* parent);
+
+        /* Show a file from its first row and start indexing its lines
+        * @param p
+        * @return false if it cannot be read; the reason is shown instead
+        */
+        bool ShowFile(const std::filesystem::path& p);
+        // Close the file and stop indexing
+        void Clear();
+        // The file shown, empty if none
+        const std::filesystem::path& Path() const { return file_.Path(); }
+
+    private:
+        enum {
+            ID_Mode = wxID_HIGHEST + 280,
+            ID_Goto,
+            ID_External
+        };
+        void OnPaint(wxPaintEvent& event);
+        void OnSize(wxSizeEvent& event);
+        void OnScroll(wxScrollWinEvent& event);
+        void OnWheel(wxMouseEvent& event);
+        void OnKey(wxKeyEvent& event);
+        void OnMode(wxCommandEvent& event);
+        void OnGoto(wxCommandEvent& event);
+        void OnExternal(wxCommandEvent& event);
+        void OnTimer(wxTimerEvent& event);
+
+        // Start of the row that holds offset
+        std::uint64_t RowContaining(std::uint64_t offset);
+        // Start of the row after the one at row
+        std::uint64_t NextRow(std::uint64_t row);
+        // Move the top row by delta rows
+        void ScrollRows(long delta);
+        // Put offset in the top row and repaint
+        void ScrollTo(std::uint64_t offset);
+        int VisibleRows() const;
+        void UpdateScrollbar();
+        void UpdateStatus();
+
+        wxChoice* m_mode;
+        wxTextCtrl* m_goto;
+        wxStaticText* m_status;
+        wxWindow* m_view;     // Drawn by OnPaint
+        wxTimer timer_;
+        wxFont font_;
+        MappedFile file_;
+        LineIndex index_;
+        Mode mode_ = Mode::Text;
+        std::uint64_t top_ = 0;     // Offset of the first row on screen
+        std::uint64_t pageEnd_ = 0; // Offset after the last row painted
+        wxString message_;          // Shown instead of the file when it cannot be read
+};
+
+#endif
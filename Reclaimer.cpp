@@ -0,0 +1,93 @@
+/*
+    Description: Implementation of the background remover.
+*/
+#include "DeleteEngine.h"
+#include "Reclaimer.h"
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+/* Lower the calling thread's CPU and I/O priority as far as allowed
+*/
+void LowerThreadPriority() {
+#if defined(__linux__)
+    const pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+    ::setpriority(PRIO_PROCESS, static_cast<id_t>(tid), 19);
+    // IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0) for IOPRIO_WHO_PROCESS
+    const int kIoprioWhoProcess = 1;
+    const int kIoprioClassIdle = 3;
+    const int kIoprioClassShift = 13;
+    ::syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << kIoprioClassShift);
+#endif
+}
+}
+/* Lazily created singleton
+* @return the reclaimer
+*/
+Reclaimer& Reclaimer::Instance() {
+    static Reclaimer instance;
+    return instance;
+}
+Reclaimer::Reclaimer() : thread_(&Reclaimer::Run, this) {}
+/* Stop the thread after the current path; exit does not wait for a
+* whole queue of old trees
+*/
+Reclaimer::~Reclaimer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+/* Queue a displaced path
+* @param p
+*/
+void Reclaimer::Enqueue(const std::filesystem::path& p) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(p);
+    }
+    cv_.notify_one();
+}
+/* Wait for all queued deletions
+*/
+void Reclaimer::WaitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idleCv_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+}
+/* Count of paths not yet deleted
+* @return count
+*/
+std::size_t Reclaimer::Pending() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + (busy_ ? 1 : 0);
+}
+/* Worker: delete queued paths one at a time until stopped
+*/
+void Reclaimer::Run() {
+    LowerThreadPriority();
+    for (;;) {
+        std::filesystem::path p;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            busy_ = false;
+            if (queue_.empty()) idleCv_.notify_all();
+            cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if (stop_) return;
+            p = std::move(queue_.front());
+            queue_.pop_front();
+            busy_ = true;
+        }
+        // Single threaded on purpose: this is background work
+        DeleteOptions options;
+        options.threads = 1;
+        DeleteStats stats;
+        std::error_code ec;
+        DeleteEngine::DeleteTree(p, options, stats, ec);
+    }
+}
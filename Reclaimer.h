@@ -0,0 +1,48 @@
+/*
+    Description: Declare Reclaimer, the background remover for displaced trees
+*/
+#ifndef RECLAIMER_H
+#define RECLAIMER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+/* Deletes paths that an overwrite has swapped out of the way, on a single
+   low priority thread (nice 19 and idle I/O class on Linux), so the user
+   never waits for the old tree to be removed. Queued paths are staging
+   names; what is left at exit is found again by the next start's listing
+   (FileOp::ReclaimIfStale).
+*/
+class Reclaimer {
+public:
+    // Process wide instance; its thread starts on first use
+    static Reclaimer& Instance();
+
+    // Queue a path for deletion
+    void Enqueue(const std::filesystem::path& p);
+    // Block until the queue is empty and nothing is being deleted
+    void WaitIdle();
+    // Paths queued or in progress
+    std::size_t Pending();
+
+    // Finishes the path being deleted and leaves the rest of the queue
+    ~Reclaimer();
+
+private:
+    Reclaimer();
+    void Run();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable idleCv_;
+    std::deque<std::filesystem::path> queue_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+#endif
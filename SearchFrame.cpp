@@ -0,0 +1,203 @@
+/*
+    Description: Implementation of the find-in-files window.
+*/
+#include <string>
+#include <vector>
+
+#include "SearchFrame.h"
+
+/* Virtual list over a SearchResults: path, line and text of each hit,
+   formatted only for the rows on screen
+*/
+class SearchResultList : public wxListCtrl {
+    public:
+        explicit SearchResultList(wxWindow* parent)
+            : wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize,
+                         wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL)
+        {
+            InsertColumn(0, _("File"), wxLIST_FORMAT_LEFT, 300);
+            InsertColumn(1, _("Line"), wxLIST_FORMAT_RIGHT, 70);
+            InsertColumn(2, _("Text"), wxLIST_FORMAT_LEFT, 500);
+        }
+        /* Show another search
+        * @param results: nullptr for none
+        * @param root: paths are shown relative to it
+        */
+        void SetResults(std::shared_ptr<const SearchResults> results, const std::filesystem::path& root) {
+            results_ = std::move(results);
+            root_ = root;
+            SetItemCount(0);
+            Refresh();
+        }
+
+    protected:
+        wxString OnGetItemText(long item, long column) const override {
+            if (!results_ || item < 0 || item >= GetItemCount()) return wxString();
+            const SearchHit hit = results_->At(static_cast<std::size_t>(item));
+            switch (column) {
+            case 0:
+                return wxString(hit.path.lexically_relative(root_).wstring());
+            case 1:
+                return wxString::Format("%llu", static_cast<unsigned long long>(hit.line));
+            case 2: {
+                // Not every file is UTF-8; show such lines byte for byte
+                wxString text = wxString::FromUTF8(hit.text.data(), hit.text.size());
+                if (text.empty() && !hit.text.empty()) {
+                    text = wxString(hit.text.data(), wxConvISO8859_1, hit.text.size());
+                }
+                return text;
+            }
+            default:
+                return wxString();
+            }
+        }
+
+    private:
+        std::shared_ptr<const SearchResults> results_;
+        std::filesystem::path root_;
+};
+
+/* Lay out the query row, result list and counters
+* @param parent
+* @param jobs
+* @param root
+* @param onOpen
+*/
+SearchFrame::SearchFrame(wxWindow* parent, JobQueue& jobs, const std::filesystem::path& root, OpenFn onOpen)
+    : wxFrame(parent, wxID_ANY, "Find in Files - " + wxString(root.wstring()),
+              wxDefaultPosition, wxSize(900, 560)),
+      jobs_(jobs), root_(root), onOpen_(std::move(onOpen)), timer_(this)
+{
+    wxPanel* panel = new wxPanel(this);
+    m_query = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
+    m_query->SetHint("Text to find");
+    m_matchCase = new wxCheckBox(panel, wxID_ANY, "Match &case");
+    wxButton* searchButton = new wxButton(panel, ID_Search, "&Search");
+    m_stopButton = new wxButton(panel, ID_Stop, "S&top");
+    m_stopButton->Disable();
+    m_list = new SearchResultList(panel);
+    m_status = new wxStaticText(panel, wxID_ANY, "Searching " + wxString(root.wstring()));
+
+    m_query->Bind(wxEVT_TEXT_ENTER, &SearchFrame::OnSearch, this);
+    m_list->Bind(wxEVT_LIST_ITEM_ACTIVATED, &SearchFrame::OnActivated, this);
+    Bind(wxEVT_BUTTON, &SearchFrame::OnSearch, this, ID_Search);
+    Bind(wxEVT_BUTTON, &SearchFrame::OnStop, this, ID_Stop);
+    Bind(wxEVT_TIMER, &SearchFrame::OnTimer, this);
+
+    wxBoxSizer* queryRow = new wxBoxSizer(wxHORIZONTAL);
+    queryRow->Add(m_query, 1, wxEXPAND | wxRIGHT, 5);
+    queryRow->Add(m_matchCase, 0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 5);
+    queryRow->Add(searchButton, 0, wxRIGHT, 5);
+    queryRow->Add(m_stopButton, 0);
+    wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+    sizer->Add(queryRow, 0, wxEXPAND | wxALL, 5);
+    sizer->Add(m_list, 1, wxEXPAND | wxLEFT | wxRIGHT, 5);
+    sizer->Add(m_status, 0, wxEXPAND | wxALL, 5);
+    panel->SetSizer(sizer);
+    m_query->SetFocus();
+}
+/* A search nobody can see any more is not worth finishing
+*/
+SearchFrame::~SearchFrame() {
+    timer_.Stop();
+    StopSearch();
+}
+/* Queue a search job. It only writes to its SearchResults, which the
+* window polls; the job never touches the UI.
+*/
+void SearchFrame::StartSearch() {
+    const std::string needle(m_query->GetValue().utf8_str());
+    if (needle.empty()) return;
+    StopSearch();
+
+    auto results = std::make_shared<SearchResults>();
+    SearchOptions options;
+    options.matchCase = m_matchCase->GetValue();
+    const std::filesystem::path root = root_;
+    const wxString title = "Find \"" + m_query->GetValue() + "\" in " + wxString(root.wstring());
+    jobId_ = jobs_.Submit(std::string(title.utf8_str()), {root},
+                          [results, root, needle, options](OpProgress& progress, std::error_code& ec,
+                                                           std::filesystem::path& errorPath) mutable {
+        options.progress = &progress;
+        const bool ok = ContentSearch::Run(root, needle, options, *results, ec);
+        if (!ok) errorPath = root;
+        return ok;
+    }, [results](const JobInfo& info) {
+        results->Finish(); // Also when cancelled before it started
+    });
+    results_ = results;
+    m_list->SetResults(results_, root_);
+    m_stopButton->Enable();
+    RefreshResults();
+    timer_.Start(kRefreshMs);
+}
+/* Cancel the job of the latest search
+*/
+void SearchFrame::StopSearch() {
+    if (results_ && !results_->done.load()) jobs_.Cancel(jobId_);
+}
+/* Show the hits that came in since the last refresh. Rows already shown
+* keep their place because hits are only appended.
+*/
+void SearchFrame::RefreshResults() {
+    if (!results_) return;
+    const SearchResults& r = *results_;
+    const bool done = r.done.load();
+    const long shown = m_list->GetItemCount();
+    const long count = static_cast<long>(r.Size());
+    if (count != shown) m_list->SetItemCount(count);
+
+    wxString text = wxString::Format("%llu matches in %llu files; %llu files, %.1f MB scanned at %.2f GB/s",
+                                     static_cast<unsigned long long>(r.totalHits.load()),
+                                     static_cast<unsigned long long>(r.matchedFiles.load()),
+                                     static_cast<unsigned long long>(r.files.load()),
+                                     r.bytes.load() / (1024.0 * 1024.0), r.GBPerSecond());
+    if (r.binary.load() > 0) {
+        text += wxString::Format(", %llu binary skipped", static_cast<unsigned long long>(r.binary.load()));
+    }
+    if (r.unreadable.load() > 0) {
+        text += wxString::Format(", %llu unreadable", static_cast<unsigned long long>(r.unreadable.load()));
+    }
+    if (r.totalHits.load() > static_cast<std::uint64_t>(count) && done) {
+        text += wxString::Format(" (first %ld listed)", count);
+    }
+    if (!done) {
+        text = "Searching... " + text;
+    } else {
+        text = wxString::Format("Finished in %.2f s: ", r.Seconds()) + text;
+        for (const JobInfo& info : jobs_.Snapshot()) {
+            if (info.id != jobId_) continue;
+            if (info.state == JobState::Cancelled) text = "Stopped. " + text;
+            if (info.state == JobState::Failed) text = "Search failed: " + wxString(info.ec.message());
+        }
+        timer_.Stop();
+        m_stopButton->Disable();
+    }
+    m_status->SetLabel(text);
+}
+/* Search button or Enter in the query
+* @param event
+*/
+void SearchFrame::OnSearch(wxCommandEvent& event) {
+    StartSearch();
+}
+/* Stop button
+* @param event
+*/
+void SearchFrame::OnStop(wxCommandEvent& event) {
+    StopSearch();
+}
+/* Periodic refresh while a search runs
+* @param event
+*/
+void SearchFrame::OnTimer(wxTimerEvent& event) {
+    RefreshResults();
+}
+/* Show the file of the activated hit in the main window
+* @param event
+*/
+void SearchFrame::OnActivated(wxListEvent& event) {
+    const long row = event.GetIndex();
+    if (!results_ || row < 0 || row >= m_list->GetItemCount()) return;
+    if (onOpen_) onOpen_(results_->At(static_cast<std::size_t>(row)).path);
+}
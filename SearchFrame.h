@@ -0,0 +1,74 @@
+/*
+    Description: Declare SearchFrame, the find-in-files window
+*/
+#ifndef SEARCHFRAME_H
+#define SEARCHFRAME_H
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+#include <wx/timer.h>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+#include "ContentSearch.h"
+#include "JobQueue.h"
+
+class SearchResultList;
+
+/* Searches the files below a directory for a string and lists the
+   matching lines as they are found.
+                 - The search runs as a job of the shared JobQueue, so it
+                   shows in the jobs panel and can be paused there too
+                 - Workers only append to a SearchResults; the window polls
+                   it on a timer and grows a virtual list
+                 - Closing the window or starting a new search cancels the
+                   running one
+*/
+class SearchFrame : public wxFrame {
+    public:
+        // Reveal a hit's file in the main window
+        using OpenFn = std::function<void(const std::filesystem::path& path)>;
+
+        /* Create the window
+        * @param parent
+        * @param jobs: queue to run searches on, must outlive the window
+        * @param root: directory searched
+        * @param onOpen: called when a hit is activated
+        */
+        SearchFrame(wxWindow* parent, JobQueue& jobs, const std::filesystem::path& root, OpenFn onOpen);
+        ~SearchFrame() override;
+
+        static constexpr int kRefreshMs = 250;
+
+    private:
+        enum {
+            ID_Search = wxID_HIGHEST + 200,
+            ID_Stop
+        };
+        // Start a search for the query, cancelling the previous one
+        void StartSearch();
+        // Cancel the running search, if any
+        void StopSearch();
+        // Grow the list to the hits found so far and update the counters
+        void RefreshResults();
+
+        void OnSearch(wxCommandEvent& event);
+        void OnStop(wxCommandEvent& event);
+        void OnTimer(wxTimerEvent& event);
+        void OnActivated(wxListEvent& event);
+
+        JobQueue& jobs_;
+        std::filesystem::path root_;
+        OpenFn onOpen_;
+        wxTextCtrl* m_query;
+        wxCheckBox* m_matchCase;
+        wxButton* m_stopButton;
+        SearchResultList* m_list;
+        wxStaticText* m_status;
+        wxTimer timer_;
+        std::shared_ptr<SearchResults> results_; // Latest search, nullptr before the first
+        std::uint64_t jobId_ = 0;                // Its job
+};
+
+#endif
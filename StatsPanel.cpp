@@ -0,0 +1,94 @@
+/*
+    Description: Implementation of the trace statistics panel.
+*/
+#include "StatsPanel.h"
+/* Format a counter value; byte counters in MB
+* @param counter
+* @param value
+* @return wxString
+*/
+static wxString FormatCounter(Trace::Counter counter, double value) {
+    if (counter == Trace::kBytesRead || counter == Trace::kBytesWritten) {
+        return wxString::Format("%.1f MB", value / (1024.0 * 1024.0));
+    }
+    return wxString::Format("%.0f", value);
+}
+/* Create the list with one row per counter and category, and the timer
+* @param parent
+*/
+StatsPanel::StatsPanel(wxWindow* parent)
+    : wxPanel(parent, wxID_ANY), timer_(this), lastTime_(std::chrono::steady_clock::now())
+{
+    m_list = new wxListCtrl(this, wxID_ANY, wxDefaultPosition, wxSize(-1, 150),
+                            wxLC_REPORT | wxLC_SINGLE_SEL);
+    m_list->InsertColumn(0, _("Counter"), wxLIST_FORMAT_LEFT, 160);
+    m_list->InsertColumn(1, _("Total"), wxLIST_FORMAT_RIGHT, 130);
+    m_list->InsertColumn(2, _("Per Second"), wxLIST_FORMAT_RIGHT, 130);
+    long row = 0;
+    for (unsigned c = 0; c < Trace::kCounters; ++c) {
+        m_list->InsertItem(row++, Trace::CounterName(static_cast<Trace::Counter>(c)));
+    }
+    for (unsigned c = 0; c < Trace::kCategories; ++c) {
+        m_list->InsertItem(row++, wxString(Trace::CategoryName(static_cast<Trace::Category>(c))) + " time");
+    }
+    m_status = new wxStaticText(this, wxID_ANY, "");
+    wxButton* resetButton = new wxButton(this, ID_Reset, "R&eset");
+
+    Bind(wxEVT_BUTTON, &StatsPanel::OnReset, this, ID_Reset);
+    Bind(wxEVT_TIMER, &StatsPanel::OnTimer, this);
+
+    wxBoxSizer* side = new wxBoxSizer(wxVERTICAL);
+    side->Add(resetButton, 0, wxEXPAND | wxBOTTOM, 5);
+    side->Add(m_status, 0, wxEXPAND);
+    wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL);
+    sizer->Add(m_list, 1, wxEXPAND | wxRIGHT, 5);
+    sizer->Add(side, 0);
+    SetSizer(sizer);
+
+    last_ = Trace::Snapshot();
+    timer_.Start(kRefreshMs);
+}
+/* Show totals and the rate since the previous refresh. Category times
+* per second can pass 1000 ms when several threads are busy.
+*/
+void StatsPanel::RefreshStats() {
+    const Trace::Totals now = Trace::Snapshot();
+    const auto time = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(time - lastTime_).count();
+    auto rate = [&](std::uint64_t value, std::uint64_t before) {
+        // A reset in between makes the new value smaller
+        return seconds > 0 && value >= before ? (value - before) / seconds : 0.0;
+    };
+    long row = 0;
+    for (unsigned c = 0; c < Trace::kCounters; ++c, ++row) {
+        const Trace::Counter counter = static_cast<Trace::Counter>(c);
+        m_list->SetItem(row, 1, FormatCounter(counter, static_cast<double>(now.counters[c])));
+        m_list->SetItem(row, 2, FormatCounter(counter, rate(now.counters[c], last_.counters[c])));
+    }
+    for (unsigned c = 0; c < Trace::kCategories; ++c, ++row) {
+        m_list->SetItem(row, 1, wxString::Format("%.1f ms", now.categoryNs[c] / 1e6));
+        m_list->SetItem(row, 2, wxString::Format("%.1f ms", rate(now.categoryNs[c], last_.categoryNs[c]) / 1e6));
+    }
+    if (!Trace::Enabled()) {
+        m_status->SetLabel("Tracing is off.\nView > Tracing turns it on.");
+    } else {
+        m_status->SetLabel(wxString::Format("%llu events\n%llu threads",
+                                            static_cast<unsigned long long>(now.events),
+                                            static_cast<unsigned long long>(now.threads)));
+    }
+    last_ = now;
+    lastTime_ = time;
+}
+/* Periodic refresh, skipped while hidden
+* @param event
+*/
+void StatsPanel::OnTimer(wxTimerEvent& event) {
+    if (IsShownOnScreen()) RefreshStats();
+}
+/* Start the counters and the trace over
+* @param event
+*/
+void StatsPanel::OnReset(wxCommandEvent& event) {
+    Trace::Clear();
+    RefreshStats();
+}
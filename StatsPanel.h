@@ -0,0 +1,39 @@
+/*
+    Description: Declare StatsPanel, the live view of the trace counters
+*/
+#ifndef STATSPANEL_H
+#define STATSPANEL_H
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+#include <wx/timer.h>
+#include <chrono>
+
+#include "Trace.h"
+
+/* Shows every Trace counter and category time, in total and per second
+   over the last refresh. Polls Trace on a timer while it is on screen.
+*/
+class StatsPanel : public wxPanel {
+    public:
+        explicit StatsPanel(wxWindow* parent);
+
+        static constexpr int kRefreshMs = 500;
+
+        // Re-read the counters now
+        void RefreshStats();
+
+    private:
+        enum {
+            ID_Reset = wxID_HIGHEST + 260
+        };
+        void OnTimer(wxTimerEvent& event);
+        void OnReset(wxCommandEvent& event);
+
+        wxListCtrl* m_list;
+        wxStaticText* m_status;
+        wxTimer timer_;
+        Trace::Totals last_;   // Counters at the previous refresh
+        std::chrono::steady_clock::time_point lastTime_;
+};
+
+#endif
@@ -0,0 +1,417 @@
+/*
+    Description: Implementation of the name matching kernels.
+*/
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "StrSearch.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+char Fold(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+bool EqualCaseless(const char* a, const char* b, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        if (Fold(a[i]) != Fold(b[i])) return false;
+    }
+    return true;
+}
+std::string FoldAll(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) c = Fold(c);
+    return out;
+}
+
+/* Match one [...] class at pattern[p] against ch
+* @param pattern
+* @param p: offset of '['
+* @param ch
+* @param end: receives the offset after ']', npos if the class is not closed
+* @return true if ch is in the class
+*/
+bool MatchClass(std::string_view pattern, std::size_t p, char ch, std::size_t& end) {
+    std::size_t i = p + 1;
+    bool negate = false;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^')) {
+        negate = true;
+        ++i;
+    }
+    const char c = Fold(ch);
+    bool found = false;
+    bool first = true;
+    for (; i < pattern.size(); ++i) {
+        if (pattern[i] == ']' && !first) {
+            end = i + 1;
+            return found != negate;
+        }
+        first = false;
+        char lo = Fold(pattern[i]);
+        char hi = lo;
+        if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+            hi = Fold(pattern[i + 2]);
+            i += 2;
+        }
+        if (c >= lo && c <= hi) found = true;
+    }
+    end = StrSearch::npos;
+    return false;
+}
+
+/* Longest run of plain characters in a glob; every match contains it
+* @param pattern
+* @return the run, empty if the pattern is all wildcards
+*/
+std::string_view LongestLiteral(std::string_view pattern) {
+    std::string_view best;
+    std::size_t start = 0;
+    for (std::size_t i = 0; i <= pattern.size(); ++i) {
+        const bool special = i == pattern.size() || pattern[i] == '*' || pattern[i] == '?' ||
+                             pattern[i] == '[';
+        if (!special) continue;
+        if (i - start > best.size()) best = pattern.substr(start, i - start);
+        if (i < pattern.size() && pattern[i] == '[') {
+            std::size_t end = StrSearch::npos;
+            MatchClass(pattern, i, '\0', end);
+            if (end == StrSearch::npos) return best; // Rest is taken literally; keep it simple
+            i = end - 1;
+        }
+        start = i + 1;
+    }
+    return best;
+}
+
+/* A glob split at its stars. Between stars every element (a character,
+* ? or a class) matches exactly one name character, so each segment has a
+* fixed width and can be placed without backtracking: the first at the
+* start, the last at the end, the others at their leftmost fit.
+*/
+struct GlobProgram {
+    struct Segment {
+        std::string_view text;
+        std::size_t width = 0;  // Name characters it covers
+        bool plain = true;      // No ? or classes: FindCaseless can place it
+        std::size_t anchor = StrSearch::npos; // Name offset of a plain character, if any
+        char anchorChar = 0;                  // That character, folded
+    };
+    std::vector<Segment> segments;
+    bool star = false;          // At least one '*'
+    bool anchoredStart = true;  // Does not start with '*'
+    bool anchoredEnd = true;    // Does not end with '*'
+
+    explicit GlobProgram(std::string_view pattern) {
+        std::size_t start = 0;
+        Segment seg;
+        for (std::size_t i = 0; i <= pattern.size(); ++i) {
+            if (i == pattern.size() || pattern[i] == '*') {
+                seg.text = pattern.substr(start, i - start);
+                if (i < pattern.size()) {
+                    star = true;
+                    if (i == 0) anchoredStart = false;
+                    if (i + 1 == pattern.size()) anchoredEnd = false;
+                }
+                if (!seg.text.empty() || !star) segments.push_back(seg);
+                seg = Segment();
+                start = i + 1;
+                continue;
+            }
+            bool literal = false;
+            if (pattern[i] == '?') {
+                seg.plain = false;
+            } else if (pattern[i] == '[') {
+                std::size_t end = StrSearch::npos;
+                MatchClass(pattern, i, '\0', end);
+                if (end != StrSearch::npos) {
+                    seg.plain = false;
+                    i = end - 1;
+                } else {
+                    literal = true;
+                }
+            } else {
+                literal = true;
+            }
+            if (literal && seg.anchor == StrSearch::npos) {
+                seg.anchor = seg.width;
+                seg.anchorChar = Fold(pattern[i]);
+            }
+            ++seg.width;
+        }
+    }
+    // Match seg at name[pos], which must have seg.width characters left
+    static bool MatchAt(const Segment& seg, std::string_view name, std::size_t pos) {
+        const std::string_view p = seg.text;
+        for (std::size_t i = 0; i < p.size(); ++i, ++pos) {
+            if (p[i] == '?') continue;
+            if (p[i] == '[') {
+                std::size_t end = StrSearch::npos;
+                const bool in = MatchClass(p, i, name[pos], end);
+                if (end != StrSearch::npos) {
+                    if (!in) return false;
+                    i = end - 1;
+                    continue;
+                }
+            }
+            if (Fold(p[i]) != Fold(name[pos])) return false;
+        }
+        return true;
+    }
+    // Leftmost fit of seg in name[from, limit + seg.width), npos if none
+    static std::size_t Find(const Segment& seg, std::string_view name, std::size_t from, std::size_t limit) {
+        if (from > limit) return StrSearch::npos;
+        if (seg.plain) {
+            const std::size_t found = StrSearch::FindCaseless(name.substr(from, limit - from + seg.width), seg.text);
+            return found == StrSearch::npos ? found : from + found;
+        }
+        if (seg.anchor == StrSearch::npos) {
+            for (std::size_t pos = from; pos <= limit; ++pos) {
+                if (MatchAt(seg, name, pos)) return pos;
+            }
+            return StrSearch::npos;
+        }
+        // Only try the places where the plain character lines up
+        for (std::size_t at = from + seg.anchor; at <= limit + seg.anchor; ++at) {
+            if (Fold(name[at]) == seg.anchorChar && MatchAt(seg, name, at - seg.anchor)) return at - seg.anchor;
+        }
+        return StrSearch::npos;
+    }
+    bool Match(std::string_view name) const {
+        if (!star) {
+            return segments[0].width == name.size() && MatchAt(segments[0], name, 0);
+        }
+        std::size_t first = 0;
+        std::size_t last = segments.size();
+        std::size_t pos = 0;
+        std::size_t end = name.size();
+        if (anchoredStart) {
+            const Segment& seg = segments[first++];
+            if (seg.width > name.size() || !MatchAt(seg, name, 0)) return false;
+            pos = seg.width;
+        }
+        if (anchoredEnd && last > first) {
+            const Segment& seg = segments[--last];
+            if (seg.width > end - pos || !MatchAt(seg, name, end - seg.width)) return false;
+            end -= seg.width;
+        }
+        for (std::size_t k = first; k < last; ++k) {
+            const Segment& seg = segments[k];
+            if (seg.width > end - pos) return false;
+            const std::size_t found = Find(seg, name, pos, end - seg.width);
+            if (found == StrSearch::npos) return false;
+            pos = found + seg.width;
+        }
+        return true;
+    }
+};
+
+/* Visit every entry whose name contains needle, in store order, with
+* one scan over the arena. Matches that run across two names are skipped.
+* @param store
+* @param needle
+* @param fn: fn(index, offset of the match in the arena)
+*/
+template <typename Fn>
+void ForEachContaining(const EntryStore& store, std::string_view needle, const Fn& fn) {
+    const std::string_view arena = store.Arena();
+    std::size_t pos = 0;
+    std::size_t e = 0;
+    const std::size_t n = store.Size();
+    while (pos < arena.size() && e < n) {
+        const std::size_t found = StrSearch::FindCaseless(arena.substr(pos), needle);
+        if (found == StrSearch::npos) return;
+        const std::size_t p = pos + found;
+        while (store.NameEnd(e) <= p) ++e;
+        if (p + needle.size() <= store.NameEnd(e)) {
+            fn(e, p);
+            pos = store.NameEnd(e);
+            ++e;
+        } else {
+            pos = p + 1; // Straddles two names
+        }
+    }
+}
+/* Scan for the first and last byte of needle 16 positions at a time and
+* verify the candidates. With Caseless, ASCII letters are compared with
+* bit 5 forced on.
+* @param text
+* @param needle
+* @return offset or npos
+*/
+template <bool Caseless>
+std::size_t FindImpl(std::string_view text, std::string_view needle) {
+    const std::size_t m = needle.size();
+    if (m == 0) return 0;
+    if (m > text.size()) return StrSearch::npos;
+    const std::size_t lastStart = text.size() - m;
+    const char* t = text.data();
+    auto equal = [](const char* a, const char* b, std::size_t n) {
+        return Caseless ? EqualCaseless(a, b, n) : std::memcmp(a, b, n) == 0;
+    };
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const char first = Caseless ? Fold(needle[0]) : needle[0];
+    const char last = Caseless ? Fold(needle[m - 1]) : needle[m - 1];
+    const __m128i firstVal = _mm_set1_epi8(first);
+    const __m128i firstOr = _mm_set1_epi8(Caseless && IsAlpha(first) ? 0x20 : 0);
+    const __m128i lastVal = _mm_set1_epi8(last);
+    const __m128i lastOr = _mm_set1_epi8(Caseless && IsAlpha(last) ? 0x20 : 0);
+    for (; i + 16 <= lastStart + 1; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + i + m - 1));
+        const __m128i eqA = _mm_cmpeq_epi8(_mm_or_si128(a, firstOr), firstVal);
+        const __m128i eqB = _mm_cmpeq_epi8(_mm_or_si128(b, lastOr), lastVal);
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(eqA, eqB)));
+        while (mask != 0) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (equal(t + i + bit + 1, needle.data() + 1, m > 2 ? m - 2 : 0)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i <= lastStart; ++i) {
+        if (equal(t + i, needle.data(), m)) return i;
+    }
+    return StrSearch::npos;
+}
+}
+/* Case-insensitive search; see FindImpl
+* @param text
+* @param needle
+* @return offset or npos
+*/
+std::size_t StrSearch::FindCaseless(std::string_view text, std::string_view needle) {
+    return FindImpl<true>(text, needle);
+}
+/* Exact search; see FindImpl. A single byte goes to memchr.
+* @param text
+* @param needle
+* @return offset or npos
+*/
+std::size_t StrSearch::Find(std::string_view text, std::string_view needle) {
+    if (needle.size() == 1) {
+        const void* p = std::memchr(text.data(), needle[0], text.size());
+        return p ? static_cast<const char*>(p) - text.data() : npos;
+    }
+    return FindImpl<false>(text, needle);
+}
+/* Compare 16 bytes at a time and add up the movemask bits
+* @param text
+* @param c
+* @return occurrences of c
+*/
+std::size_t StrSearch::CountByte(std::string_view text, char c) {
+    const char* t = text.data();
+    const std::size_t n = text.size();
+    std::size_t count = 0;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i val = _mm_set1_epi8(c);
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + i));
+        count += static_cast<std::size_t>(__builtin_popcount(
+            static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, val)))));
+    }
+#endif
+    for (; i < n; ++i) count += t[i] == c;
+    return count;
+}
+/* Glob match by fixed-width segments; see GlobProgram
+* @param pattern
+* @param name
+* @return true on a match
+*/
+bool StrSearch::GlobMatch(std::string_view pattern, std::string_view name) {
+    return GlobProgram(pattern).Match(name);
+}
+/* Subsequence test
+* @param pattern
+* @param name
+* @return true if every pattern character is found in order
+*/
+bool StrSearch::FuzzyMatch(std::string_view pattern, std::string_view name) {
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < name.size() && j < pattern.size(); ++i) {
+        if (Fold(name[i]) == Fold(pattern[j])) ++j;
+    }
+    return j == pattern.size();
+}
+/* Dispatch on the mode for a single name
+* @param mode
+* @param pattern
+* @param name
+* @return true on a match
+*/
+bool StrSearch::MatchName(MatchMode mode, std::string_view pattern, std::string_view name) {
+    switch (mode) {
+    case MatchMode::Substring: return FindCaseless(name, pattern) != npos;
+    case MatchMode::Glob: return pattern.empty() || GlobMatch(pattern, name);
+    case MatchMode::Fuzzy: return FuzzyMatch(pattern, name);
+    }
+    return true;
+}
+/* Run the mode's matcher over the listing. Every mode starts from an
+* arena scan for a literal piece, so names that cannot match are never
+* looked at one by one.
+* @param store
+* @param mode
+* @param pattern
+* @param hits
+* @return matches
+*/
+std::size_t StrSearch::Match(const EntryStore& store, MatchMode mode, std::string_view pattern,
+                             std::vector<std::uint8_t>& hits) {
+    const std::size_t n = store.Size();
+    if (pattern.empty()) {
+        hits.assign(n, 1);
+        return n;
+    }
+    hits.assign(n, 0);
+    std::size_t count = 0;
+    switch (mode) {
+    case MatchMode::Substring:
+        ForEachContaining(store, pattern, [&](std::size_t e, std::size_t) {
+            hits[e] = 1;
+            ++count;
+        });
+        break;
+    case MatchMode::Glob: {
+        const GlobProgram program(pattern);
+        const std::string_view literal = LongestLiteral(pattern);
+        auto test = [&](std::size_t e) {
+            if (program.Match(store.Name(e))) {
+                hits[e] = 1;
+                ++count;
+            }
+        };
+        // An anchored end is one compare per name, cheaper than a scan that
+        // stops at every name holding the literal
+        if (literal.empty() || program.anchoredStart || program.anchoredEnd) {
+            for (std::size_t e = 0; e < n; ++e) test(e);
+        } else {
+            ForEachContaining(store, literal, [&](std::size_t e, std::size_t) { test(e); });
+        }
+        break;
+    }
+    case MatchMode::Fuzzy: {
+        // The first character is found by the arena scan, the rest in the name
+        const std::string folded = FoldAll(pattern);
+        const std::string_view rest = std::string_view(folded).substr(1);
+        const std::string_view arena = store.Arena();
+        ForEachContaining(store, std::string_view(folded).substr(0, 1), [&](std::size_t e, std::size_t p) {
+            const std::size_t end = store.NameEnd(e);
+            if (FuzzyMatch(rest, arena.substr(p + 1, end - p - 1))) {
+                hits[e] = 1;
+                ++count;
+            }
+        });
+        break;
+    }
+    }
+    return count;
+}
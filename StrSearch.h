@@ -0,0 +1,91 @@
+/*
+    Description: Declare StrSearch, the matching kernels behind the filter bar
+                 and the content search
+*/
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "EntryStore.h"
+
+enum class MatchMode : std::uint8_t { Substring, Glob, Fuzzy };
+
+/* Case-insensitive name matching over a whole listing.
+                 - Substring runs one SSE2 scan over the EntryStore arena:
+                   16 positions at a time are tested against the first and
+                   last byte of the needle, only survivors are compared
+                 - Glob supports *, ? and [...]. The pattern is split at its
+                   stars into fixed-width pieces placed without backtracking;
+                   anchored ends are one compare per name, otherwise the
+                   longest literal piece is found with the substring scan
+                   first and only candidates are matched
+                 - Fuzzy keeps names that contain the pattern's characters
+                   in order (a subsequence)
+                 - Find and CountByte are the same kernels on raw buffers,
+                   for the content search
+                 - Case folding is ASCII only; other bytes match exactly
+                 - Without SSE2 a scalar scan gives the same results
+*/
+class StrSearch {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    /* Find needle in text ignoring ASCII case
+    * @param text
+    * @param needle
+    * @return offset of the first match, npos if none
+    */
+    static std::size_t FindCaseless(std::string_view text, std::string_view needle);
+
+    /* Find needle in text, byte for byte
+    * @param text
+    * @param needle
+    * @return offset of the first match, npos if none
+    */
+    static std::size_t Find(std::string_view text, std::string_view needle);
+
+    /* Count one byte value in text, e.g. newlines
+    * @param text
+    * @param c
+    * @return occurrences
+    */
+    static std::size_t CountByte(std::string_view text, char c);
+
+    /* Match a whole name against a glob pattern ignoring ASCII case
+    * @param pattern: *, ? and [abc] / [a-z] / [!abc]
+    * @param name
+    * @return true on a match
+    */
+    static bool GlobMatch(std::string_view pattern, std::string_view name);
+
+    /* True if the characters of pattern occur in name in order, ignoring ASCII case
+    * @param pattern
+    * @param name
+    */
+    static bool FuzzyMatch(std::string_view pattern, std::string_view name);
+
+    /* Match one name the way Match would
+    * @param mode
+    * @param pattern: empty matches all
+    * @param name
+    * @return true on a match
+    */
+    static bool MatchName(MatchMode mode, std::string_view pattern, std::string_view name);
+
+    /* Mark the entries whose names match. An empty pattern matches all.
+    * @param store: listing to scan
+    * @param mode
+    * @param pattern
+    * @param hits: resized to store.Size(), 1 for a match
+    * @return number of matches
+    */
+    static std::size_t Match(const EntryStore& store, MatchMode mode, std::string_view pattern,
+                             std::vector<std::uint8_t>& hits);
+};
+
+#endif
@@ -0,0 +1,213 @@
+/*
+    Description: Implementation of the directory sync window.
+*/
+#include <string>
+#include <utility>
+
+#include "SyncFrame.h"
+
+/* Virtual list over a SyncPlan: action, path and size of each difference,
+   formatted only for the rows on screen
+*/
+class SyncPlanList : public wxListCtrl {
+    public:
+        explicit SyncPlanList(wxWindow* parent)
+            : wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize,
+                         wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL)
+        {
+            InsertColumn(0, _("Action"), wxLIST_FORMAT_LEFT, 100);
+            InsertColumn(1, _("Path"), wxLIST_FORMAT_LEFT, 520);
+            InsertColumn(2, _("Size"), wxLIST_FORMAT_RIGHT, 140);
+        }
+        // Show another compare, nullptr for none
+        void SetPlan(std::shared_ptr<const SyncPlan> plan) {
+            plan_ = std::move(plan);
+            SetItemCount(0);
+            Refresh();
+        }
+
+    protected:
+        wxString OnGetItemText(long item, long column) const override {
+            if (!plan_ || item < 0 || item >= GetItemCount()) return wxString();
+            const SyncItem it = plan_->At(static_cast<std::size_t>(item));
+            switch (column) {
+            case 0:
+                return SyncActionName(it.action);
+            case 1: {
+                wxString path(it.rel.wstring());
+                if (it.symlink) return path + " (link)";
+                if (it.type == EntryType::Dir) return path + "/";
+                return path;
+            }
+            case 2:
+                if (it.symlink || it.type == EntryType::Dir || it.action == SyncAction::Touch) return wxString();
+                return wxString::Format("%llu bytes", static_cast<unsigned long long>(it.size));
+            default:
+                return wxString();
+            }
+        }
+
+    private:
+        std::shared_ptr<const SyncPlan> plan_;
+};
+
+/* Lay out the options, the plan list and the counters, then compare
+* @param parent
+* @param jobs
+* @param src
+* @param dest
+* @param onApply
+*/
+SyncFrame::SyncFrame(wxWindow* parent, JobQueue& jobs, const std::filesystem::path& src,
+                     const std::filesystem::path& dest, ApplyFn onApply)
+    : wxFrame(parent, wxID_ANY, "Sync " + wxString(src.filename().wstring()) + " to " + wxString(dest.wstring()),
+              wxDefaultPosition, wxSize(820, 520)),
+      jobs_(jobs), src_(src), dest_(dest), onApply_(std::move(onApply)), timer_(this)
+{
+    wxPanel* panel = new wxPanel(this);
+    m_checksum = new wxCheckBox(panel, wxID_ANY, "Compare &contents");
+    m_checksum->SetToolTip("Read every same-size file on both sides instead of trusting size and time");
+    m_removeExtra = new wxCheckBox(panel, wxID_ANY, "&Remove files the source does not have");
+    wxButton* compareButton = new wxButton(panel, ID_Compare, "Co&mpare");
+    m_stopButton = new wxButton(panel, ID_Stop, "S&top");
+    m_syncButton = new wxButton(panel, ID_Sync, "&Sync");
+    m_syncButton->Disable();
+    m_list = new SyncPlanList(panel);
+    m_status = new wxStaticText(panel, wxID_ANY, "Comparing " + wxString(src.wstring()));
+
+    m_checksum->Bind(wxEVT_CHECKBOX, &SyncFrame::OnCompare, this);
+    m_removeExtra->Bind(wxEVT_CHECKBOX, &SyncFrame::OnCompare, this);
+    Bind(wxEVT_BUTTON, &SyncFrame::OnCompare, this, ID_Compare);
+    Bind(wxEVT_BUTTON, &SyncFrame::OnStop, this, ID_Stop);
+    Bind(wxEVT_BUTTON, &SyncFrame::OnSync, this, ID_Sync);
+    Bind(wxEVT_TIMER, &SyncFrame::OnTimer, this);
+
+    wxBoxSizer* optionRow = new wxBoxSizer(wxHORIZONTAL);
+    optionRow->Add(m_checksum, 0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 10);
+    optionRow->Add(m_removeExtra, 0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 10);
+    optionRow->AddStretchSpacer();
+    optionRow->Add(compareButton, 0, wxRIGHT, 5);
+    optionRow->Add(m_stopButton, 0, wxRIGHT, 5);
+    optionRow->Add(m_syncButton, 0);
+    wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+    sizer->Add(optionRow, 0, wxEXPAND | wxALL, 5);
+    sizer->Add(m_list, 1, wxEXPAND | wxLEFT | wxRIGHT, 5);
+    sizer->Add(m_status, 0, wxEXPAND | wxALL, 5);
+    panel->SetSizer(sizer);
+    StartCompare();
+}
+/* A compare nobody can see any more is not worth finishing
+*/
+SyncFrame::~SyncFrame() {
+    timer_.Stop();
+    StopCompare();
+}
+/* Queue a compare job. It only writes to its SyncPlan, which the window
+* polls; the job never touches the UI.
+*/
+void SyncFrame::StartCompare() {
+    StopCompare();
+    auto plan = std::make_shared<SyncPlan>();
+    SyncOptions options;
+    options.checksum = m_checksum->GetValue();
+    options.removeExtra = m_removeExtra->GetValue();
+    const std::filesystem::path src = src_;
+    const std::filesystem::path dest = dest_;
+    const wxString title = "Compare " + wxString(src.wstring()) + " with " + wxString(dest.wstring());
+    jobId_ = jobs_.Submit(std::string(title.utf8_str()), {src, dest},
+                          [plan, src, dest, options](OpProgress& progress, std::error_code& ec,
+                                                     std::filesystem::path& errorPath) mutable {
+        options.progress = &progress;
+        const bool ok = DirSync::Plan(src, dest, options, *plan, ec);
+        if (!ok) errorPath = src;
+        return ok;
+    }, [plan](const JobInfo& info) {
+        plan->Finish(); // Also when cancelled before it started
+    });
+    plan_ = plan;
+    options_ = options;
+    m_list->SetPlan(plan_);
+    m_stopButton->Enable();
+    m_syncButton->Disable();
+    RefreshPlan();
+    timer_.Start(kRefreshMs);
+}
+/* Cancel the job of the latest compare
+*/
+void SyncFrame::StopCompare() {
+    if (plan_ && !plan_->done.load()) jobs_.Cancel(jobId_);
+}
+/* Show the differences that came in since the last refresh and the totals
+*/
+void SyncFrame::RefreshPlan() {
+    if (!plan_) return;
+    const SyncPlan& p = *plan_;
+    const bool done = p.done.load();
+    const long count = static_cast<long>(p.Size());
+    if (count != m_list->GetItemCount()) m_list->SetItemCount(count);
+
+    auto actions = [&](SyncAction a) {
+        return static_cast<unsigned long long>(p.actions[static_cast<int>(a)].load());
+    };
+    wxString text = wxString::Format("%llu new, %llu changed, %llu replaced, %llu attributes only, %llu to remove; "
+                                     "%.1f MB to copy. %llu of %llu files unchanged",
+                                     actions(SyncAction::Create), actions(SyncAction::Update),
+                                     actions(SyncAction::Replace), actions(SyncAction::Touch),
+                                     actions(SyncAction::Remove), p.copyBytes.load() / (1024.0 * 1024.0),
+                                     static_cast<unsigned long long>(p.unchanged.load()),
+                                     static_cast<unsigned long long>(p.compared.load()));
+    if (p.hashedBytes.load() > 0) {
+        text += wxString::Format(", %.1f MB read to compare", p.hashedBytes.load() / (1024.0 * 1024.0));
+    }
+    if (p.unreadable.load() > 0) {
+        text += wxString::Format(", %llu unreadable", static_cast<unsigned long long>(p.unreadable.load()));
+    }
+    bool ok = true;
+    if (!done) {
+        text = "Comparing... " + text;
+    } else {
+        text = wxString::Format("Compared in %.2f s: ", p.Seconds()) + text;
+        for (const JobInfo& info : jobs_.Snapshot()) {
+            if (info.id != jobId_) continue;
+            if (info.state == JobState::Cancelled) {
+                text = "Stopped. " + text;
+                ok = false;
+            }
+            if (info.state == JobState::Failed) {
+                text = "Compare failed: " + wxString(info.ec.message());
+                ok = false;
+            }
+        }
+        if (ok && count == 0) text = "Already in sync. " + text;
+        timer_.Stop();
+        m_stopButton->Disable();
+        m_syncButton->Enable(ok && count > 0);
+    }
+    m_status->SetLabel(text);
+}
+/* Compare button or an option changed
+* @param event
+*/
+void SyncFrame::OnCompare(wxCommandEvent& event) {
+    StartCompare();
+}
+/* Stop button
+* @param event
+*/
+void SyncFrame::OnStop(wxCommandEvent& event) {
+    StopCompare();
+}
+/* Hand the finished plan over and close
+* @param event
+*/
+void SyncFrame::OnSync(wxCommandEvent& event) {
+    if (!plan_ || !plan_->done.load() || plan_->Size() == 0) return;
+    if (onApply_) onApply_(src_, dest_, plan_->Items(), options_);
+    Close();
+}
+/* Periodic refresh while a compare runs
+* @param event
+*/
+void SyncFrame::OnTimer(wxTimerEvent& event) {
+    RefreshPlan();
+}
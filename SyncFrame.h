@@ -0,0 +1,81 @@
+/*
+    Description: Declare SyncFrame, the dry-run view of a directory sync
+*/
+#ifndef SYNCFRAME_H
+#define SYNCFRAME_H
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+#include <wx/timer.h>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "DirSync.h"
+#include "JobQueue.h"
+
+class SyncPlanList;
+
+/* Compares a source directory with an existing copy and lists what a
+   sync would change before anything is touched.
+                 - The compare runs as a job of the shared JobQueue and the
+                   list grows as directories are compared
+                 - Changing an option compares again
+                 - Sync hands the finished plan to the caller, which runs
+                   it as a job, and closes the window
+*/
+class SyncFrame : public wxFrame {
+    public:
+        // Carry out a plan of src onto dest
+        using ApplyFn = std::function<void(const std::filesystem::path& src, const std::filesystem::path& dest,
+                                           std::vector<SyncItem> items, const SyncOptions& options)>;
+
+        /* Create the window and start comparing
+        * @param parent
+        * @param jobs: queue to run the compare on, must outlive the window
+        * @param src: directory to copy from
+        * @param dest: existing directory to bring up to date
+        * @param onApply: called when the user confirms the plan
+        */
+        SyncFrame(wxWindow* parent, JobQueue& jobs, const std::filesystem::path& src,
+                  const std::filesystem::path& dest, ApplyFn onApply);
+        ~SyncFrame() override;
+
+        static constexpr int kRefreshMs = 250;
+
+    private:
+        enum {
+            ID_Compare = wxID_HIGHEST + 240,
+            ID_Stop,
+            ID_Sync
+        };
+        // Compare with the current options, cancelling the previous compare
+        void StartCompare();
+        // Cancel the running compare, if any
+        void StopCompare();
+        // Grow the list to the differences found so far and update the counters
+        void RefreshPlan();
+
+        void OnCompare(wxCommandEvent& event);
+        void OnStop(wxCommandEvent& event);
+        void OnSync(wxCommandEvent& event);
+        void OnTimer(wxTimerEvent& event);
+
+        JobQueue& jobs_;
+        std::filesystem::path src_;
+        std::filesystem::path dest_;
+        ApplyFn onApply_;
+        wxCheckBox* m_checksum;
+        wxCheckBox* m_removeExtra;
+        wxButton* m_stopButton;
+        wxButton* m_syncButton;
+        SyncPlanList* m_list;
+        wxStaticText* m_status;
+        wxTimer timer_;
+        std::shared_ptr<SyncPlan> plan_; // Latest compare, nullptr before the first
+        SyncOptions options_;            // Options it ran with
+        std::uint64_t jobId_ = 0;        // Its job
+};
+
+#endif
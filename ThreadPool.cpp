@@ -0,0 +1,126 @@
+/*
+    Description: Implementation of the bounded work-stealing thread pool.
+*/
+#include "ThreadPool.h"
+
+namespace {
+// Pool and worker index of the calling thread, if it is a pool worker
+thread_local const ThreadPool* tlsPool = nullptr;
+thread_local unsigned tlsIndex = 0;
+}
+/* Number of hardware threads, never zero
+* @return thread count
+*/
+unsigned ThreadPool::DefaultThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+/* Create the per-worker deques and start the workers
+* @param threads
+* @param capacity
+*/
+ThreadPool::ThreadPool(unsigned threads, std::size_t capacity) {
+    if (threads == 0) threads = DefaultThreads();
+    capacity_ = capacity == 0 ? static_cast<std::size_t>(threads) * 64 : capacity;
+    for (unsigned i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        threads_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+/* Drain the pool and join every worker
+*/
+ThreadPool::~ThreadPool() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    workCv_.notify_all();
+    for (auto& t : threads_) {
+        t.join();
+    }
+}
+/* Queue a task. Workers push onto their own deque, outside callers
+* round-robin across deques and wait while the pool is at capacity.
+* @param task
+*/
+void ThreadPool::Submit(std::function<void()> task) {
+    const bool fromWorker = tlsPool == this;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        unsigned target = tlsIndex;
+        if (!fromWorker) {
+            spaceCv_.wait(lock, [this]() { return queued_ < capacity_; });
+            target = next_++ % Size();
+        }
+        ++queued_;
+        ++pending_;
+        Queue& q = *queues_[target];
+        std::lock_guard<std::mutex> qlock(q.mutex);
+        q.tasks.push_back(std::move(task));
+    }
+    workCv_.notify_one();
+}
+/* Wait until all submitted tasks have run
+*/
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCv_.wait(lock, [this]() { return pending_ == 0; });
+}
+/* Take a task: newest from our own deque, else oldest from another one
+* @param self: worker index
+* @param out: receives the task
+* @return true if a task was taken
+*/
+bool ThreadPool::TryPop(unsigned self, std::function<void()>& out) {
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            out = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    const unsigned n = Size();
+    for (unsigned k = 1; k < n; ++k) {
+        Queue& victim = *queues_[(self + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+/* Worker body: run tasks until stopped and nothing is left
+* @param index: this worker's deque
+*/
+void ThreadPool::WorkerLoop(unsigned index) {
+    tlsPool = this;
+    tlsIndex = index;
+    for (;;) {
+        std::function<void()> task;
+        if (TryPop(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --queued_;
+            }
+            spaceCv_.notify_one();
+            task();
+            bool idle = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                idle = --pending_ == 0;
+            }
+            if (idle) doneCv_.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        workCv_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) return;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+    Description: Declare ThreadPool, the bounded work-stealing pool
+*/
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads, each with its own task deque.
+                 - A worker pops its own deque from the back and steals
+                   from the front of the others when it runs dry
+                 - Submit from outside the pool blocks once capacity tasks
+                   are queued, so a fast producer cannot run ahead
+                 - Submit from inside a task never blocks (no deadlock when
+                   tasks fan out into more tasks)
+*/
+class ThreadPool {
+public:
+    /* Start the workers
+    * @param threads: worker count, 0 for DefaultThreads()
+    * @param capacity: max queued tasks for outside producers, 0 for 64 per worker
+    */
+    explicit ThreadPool(unsigned threads = 0, std::size_t capacity = 0);
+    // Wait for queued tasks, then stop and join the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task; see the class comment for blocking rules
+    void Submit(std::function<void()> task);
+    // Block until every submitted task has finished. Not callable from a task
+    void Wait();
+
+    unsigned Size() const { return static_cast<unsigned>(threads_.size()); }
+    // Hardware concurrency, at least 1
+    static unsigned DefaultThreads();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    bool TryPop(unsigned self, std::function<void()>& out);
+    void WorkerLoop(unsigned index);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::size_t capacity_;
+
+    std::mutex mutex_;                // Guards the counters below
+    std::condition_variable workCv_;  // Work queued or stopping
+    std::condition_variable spaceCv_; // Room for outside producers
+    std::condition_variable doneCv_;  // pending_ dropped to zero
+    std::size_t queued_ = 0;          // Tasks sitting in a deque
+    std::size_t pending_ = 0;         // Tasks submitted and not finished
+    unsigned next_ = 0;               // Round robin target for outside producers
+    bool stop_ = false;
+};
+
+#endif
@@ -0,0 +1,274 @@
+/*
+    Description: Implementation of the per-thread trace rings and counters.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Json.h"
+#include "Trace.h"
+
+namespace {
+constexpr std::size_t kRingEvents = 8192; // Per thread, about 320 KB once used
+
+// One finished scope
+struct Event {
+    const char* name;
+    std::uint64_t startNs;
+    std::uint64_t durNs;
+    std::uint64_t arg;
+    std::uint32_t tid;
+    std::uint32_t category;
+};
+
+/* State of one thread. Counters are written only by the owning thread,
+   so a relaxed load and store is enough; readers sum them at any time.
+   A buffer outlives its thread and is handed to the next new thread.
+*/
+struct ThreadBuffer {
+    std::atomic<std::uint64_t> counters[Trace::kCounters];
+    std::atomic<std::uint64_t> categoryNs[Trace::kCategories];
+    std::mutex mutex;           // Guards ring and next against Clear and dumps
+    std::vector<Event> ring;    // Allocated by the first event
+    std::uint64_t next = 0;     // Events recorded; the newest is at (next - 1) % size
+    std::uint32_t tid = 0;      // Trace thread id of the current owner
+    bool inUse = true;          // Guarded by the registry mutex
+
+    ThreadBuffer() {
+        for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+        for (auto& c : categoryNs) c.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::uint32_t nextTid = 0;
+    Trace::Totals baseline; // Sums at the last Clear
+};
+
+// Never destroyed: threads may still record while the process exits
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+const std::chrono::steady_clock::time_point kEpoch = std::chrono::steady_clock::now();
+
+// Hands the buffer back when its thread exits
+struct BufferHolder {
+    ThreadBuffer* buffer = nullptr;
+    ~BufferHolder() {
+        if (!buffer) return;
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffer->inUse = false;
+    }
+};
+
+ThreadBuffer& LocalBuffer() {
+    thread_local BufferHolder holder;
+    if (!holder.buffer) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& buffer : registry.buffers) {
+            if (!buffer->inUse) {
+                holder.buffer = buffer.get();
+                break;
+            }
+        }
+        if (!holder.buffer) {
+            registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+            holder.buffer = registry.buffers.back().get();
+        }
+        holder.buffer->inUse = true;
+        holder.buffer->tid = ++registry.nextTid;
+    }
+    return *holder.buffer;
+}
+
+void Bump(std::atomic<std::uint64_t>& value, std::uint64_t n) {
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/* Counters of every buffer since the process started. Caller holds the
+* registry mutex.
+*/
+Trace::Totals Sum(Registry& registry) {
+    Trace::Totals totals;
+    for (const auto& buffer : registry.buffers) {
+        for (unsigned c = 0; c < Trace::kCounters; ++c) {
+            totals.counters[c] += buffer->counters[c].load(std::memory_order_relaxed);
+        }
+        for (unsigned c = 0; c < Trace::kCategories; ++c) {
+            totals.categoryNs[c] += buffer->categoryNs[c].load(std::memory_order_relaxed);
+        }
+    }
+    totals.threads = registry.buffers.size();
+    return totals;
+}
+}
+
+std::atomic<bool> Trace::enabled_{false};
+
+void Trace::SetEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+/* Restart the counters by remembering where they are now, and empty the
+* rings
+*/
+void Trace::Clear() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.baseline = Sum(registry);
+    for (auto& buffer : registry.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->next = 0;
+    }
+}
+/* Counters and category times since the last Clear
+* @return Totals
+*/
+Trace::Totals Trace::Snapshot() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    Totals totals = Sum(registry);
+    for (unsigned c = 0; c < kCounters; ++c) totals.counters[c] -= registry.baseline.counters[c];
+    for (unsigned c = 0; c < kCategories; ++c) totals.categoryNs[c] -= registry.baseline.categoryNs[c];
+    for (auto& buffer : registry.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        totals.events += buffer->next;
+    }
+    return totals;
+}
+/* Gather the rings, oldest event first, and write them with a process
+* name, the counter totals and the thread ids
+* @param file
+* @param events
+* @param ec
+* @return true on success
+*/
+bool Trace::WriteChrome(const std::filesystem::path& file, std::uint64_t& events, std::error_code& ec) {
+    ec.clear();
+    events = 0;
+    std::vector<Event> all;
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& buffer : registry.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            const std::uint64_t kept = std::min<std::uint64_t>(buffer->next, buffer->ring.size());
+            for (std::uint64_t i = buffer->next - kept; i < buffer->next; ++i) {
+                all.push_back(buffer->ring[i % buffer->ring.size()]);
+            }
+        }
+    }
+    std::sort(all.begin(), all.end(), [](const Event& a, const Event& b) { return a.startNs < b.startNs; });
+    const Totals totals = Snapshot();
+
+    if (file.has_parent_path()) {
+        std::filesystem::create_directories(file.parent_path(), ec);
+        if (ec) return false;
+    }
+    std::filesystem::path temp = file;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"filemanager\"}}";
+        char times[96];
+        for (const Event& e : all) {
+            // Chrome wants microseconds; keep the nanoseconds as decimals
+            std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", e.startNs / 1e3, e.durNs / 1e3);
+            out << ",\n{\"name\":" << JsonQuote(e.name)
+                << ",\"cat\":" << JsonQuote(CategoryName(static_cast<Category>(e.category)))
+                << ",\"ph\":\"X\"," << times << ",\"pid\":1,\"tid\":" << e.tid
+                << ",\"args\":{\"n\":" << e.arg << "}}";
+        }
+        JsonLine counters;
+        for (unsigned c = 0; c < kCounters; ++c) {
+            counters.Add(CounterName(static_cast<Counter>(c)), totals.counters[c]);
+        }
+        for (unsigned c = 0; c < kCategories; ++c) {
+            const std::string name = std::string(CategoryName(static_cast<Category>(c))) + "_ms";
+            counters.Add(name.c_str(), totals.categoryNs[c] / 1e6);
+        }
+        std::snprintf(times, sizeof(times), "\"ts\":%.3f", NowNs() / 1e3);
+        out << ",\n{\"name\":\"totals\",\"ph\":\"C\"," << times << ",\"pid\":1,\"tid\":0,\"args\":"
+            << counters.Str() << "}\n]}\n";
+        out.flush();
+        if (!out) {
+            std::error_code ignored;
+            std::filesystem::remove(temp, ignored);
+            ec = std::make_error_code(std::errc::io_error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp, file, ec);
+    if (ec) return false;
+    events = all.size();
+    return true;
+}
+
+const char* Trace::CategoryName(Category category) {
+    switch (category) {
+    case kOps: return "ops";
+    case kEnumerate: return "enumerate";
+    case kStat: return "stat";
+    case kCopy: return "copy";
+    case kDelete: return "delete";
+    case kFormat: return "format";
+    case kUi: return "ui";
+    default: return "?";
+    }
+}
+
+const char* Trace::CounterName(Counter counter) {
+    switch (counter) {
+    case kSyscalls: return "syscalls";
+    case kStats: return "stats";
+    case kDirReads: return "dir_reads";
+    case kEntries: return "entries";
+    case kBytesRead: return "bytes_read";
+    case kBytesWritten: return "bytes_written";
+    case kFiles: return "files";
+    default: return "?";
+    }
+}
+
+std::uint64_t Trace::NowNs() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - kEpoch).count()) + 1;
+}
+
+void Trace::AddCount(Counter counter, std::uint64_t n) {
+    Bump(LocalBuffer().counters[counter], n);
+}
+
+void Trace::AddTime(Category category, std::uint64_t ns) {
+    Bump(LocalBuffer().categoryNs[category], ns);
+}
+/* Store a finished scope in the calling thread's ring
+* @param category
+* @param name
+* @param startNs
+* @param endNs
+* @param arg
+*/
+void Trace::Record(Category category, const char* name, std::uint64_t startNs, std::uint64_t endNs,
+                   std::uint64_t arg) {
+    ThreadBuffer& buffer = LocalBuffer();
+    Bump(buffer.categoryNs[category], endNs - startNs);
+    std::lock_guard<std::mutex> lock(buffer.mutex); // Uncontended except during a dump
+    if (buffer.ring.empty()) buffer.ring.resize(kRingEvents);
+    buffer.ring[buffer.next % kRingEvents] = Event{name, startNs, endNs - startNs, arg, buffer.tid, category};
+    ++buffer.next;
+}
@@ -0,0 +1,150 @@
+/*
+    Description: Declare Trace, scoped timers and counters that show where the
+                 time of a file operation or directory refresh goes
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+
+/* Low overhead instrumentation, off until SetEnabled(true).
+                 - Every thread records into its own ring buffer, so traced
+                   threads never wait on each other; the oldest events of a
+                   ring are overwritten
+                 - Scopes become complete events of a Chrome/Perfetto trace
+                   and add their time to a category
+                 - Counters (syscalls, bytes, entries) and category times are
+                   summed over all threads for the stats panel
+                 - Disabled, a scope or count costs one relaxed load and a
+                   branch; building with -DFM_NO_TRACE removes them entirely
+*/
+class Trace {
+public:
+    // Where time goes. Categories do not nest: a directory load (kOps)
+    // contains getdents (kEnumerate) and statx (kStat) time
+    enum Category : unsigned {
+        kOps,       // FileOp calls and directory loads, end to end
+        kEnumerate, // Reading directory entries
+        kStat,      // Metadata lookups
+        kCopy,      // Copying one file
+        kDelete,    // Unlinking entries
+        kFormat,    // Formatting list cells
+        kUi,        // Inserting rows and other GUI thread work
+        kCategories
+    };
+    enum Counter : unsigned {
+        kSyscalls,
+        kStats,
+        kDirReads,     // getdents calls
+        kEntries,      // Directory entries read
+        kBytesRead,
+        kBytesWritten,
+        kFiles,        // Files copied or deleted
+        kCounters
+    };
+
+    // Sums over every thread since the last Clear
+    struct Totals {
+        std::uint64_t counters[kCounters] = {};
+        std::uint64_t categoryNs[kCategories] = {};
+        std::uint64_t events = 0;  // Scopes recorded
+        std::uint64_t threads = 0; // Per-thread buffers, kept for reuse after their thread exits
+    };
+
+    static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool enabled);
+    // Forget every event and restart the counters from zero
+    static void Clear();
+    static Totals Snapshot();
+
+    /* Write the events still in the rings as a Chrome trace (JSON object
+    * format), readable by chrome://tracing and ui.perfetto.dev
+    * @param file: written to file.tmp and renamed into place
+    * @param events: receives the number of events written
+    * @param ec
+    * @return false on error
+    */
+    static bool WriteChrome(const std::filesystem::path& file, std::uint64_t& events, std::error_code& ec);
+
+    static const char* CategoryName(Category category);
+    static const char* CounterName(Counter counter);
+
+    // Add n to a counter of the calling thread
+    static void Count(Counter counter, std::uint64_t n = 1) {
+        if (Enabled()) AddCount(counter, n);
+    }
+
+    /* Times a block: one trace event plus the category's time.
+    * @param name: must outlive the trace, normally a string literal
+    */
+    class Scope {
+    public:
+        Scope(Category category, const char* name, std::uint64_t arg = 0)
+            : category_(category), name_(name), arg_(arg), startNs_(Enabled() ? NowNs() : 0) {}
+        ~Scope() {
+            if (startNs_ != 0) Record(category_, name_, startNs_, NowNs(), arg_);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        // Shown with the event, e.g. bytes or entries handled
+        void SetArg(std::uint64_t arg) { arg_ = arg; }
+
+    private:
+        Category category_;
+        const char* name_;
+        std::uint64_t arg_;
+        std::uint64_t startNs_; // 0 when tracing was off at the start
+    };
+
+    /* Times a block into its category only, for calls too frequent to
+    * keep as events (a statx per entry, a cell per row)
+    */
+    class Timer {
+    public:
+        explicit Timer(Category category) : category_(category), startNs_(Enabled() ? NowNs() : 0) {}
+        ~Timer() {
+            if (startNs_ != 0) AddTime(category_, NowNs() - startNs_);
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Category category_;
+        std::uint64_t startNs_;
+    };
+
+    // Monotonic nanoseconds since the process started, never 0
+    static std::uint64_t NowNs();
+
+private:
+    static void AddCount(Counter counter, std::uint64_t n);
+    static void AddTime(Category category, std::uint64_t ns);
+    static void Record(Category category, const char* name, std::uint64_t startNs, std::uint64_t endNs,
+                       std::uint64_t arg);
+
+    static std::atomic<bool> enabled_;
+};
+
+#if defined(FM_NO_TRACE)
+#define TRACE_SCOPE(category, name) ((void)0)
+#define TRACE_SCOPE_ARG(var, category, name) ((void)0)
+#define TRACE_SET_ARG(var, arg) ((void)0)
+#define TRACE_TIME(category) ((void)0)
+#define TRACE_COUNT(counter, n) ((void)0)
+#else
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+// Time the rest of the enclosing block as an event named name
+#define TRACE_SCOPE(category, name) Trace::Scope TRACE_JOIN(traceScope_, __LINE__)(Trace::category, name)
+// Same, as a named variable so the block can SetArg on it
+#define TRACE_SCOPE_ARG(var, category, name) Trace::Scope var(Trace::category, name)
+#define TRACE_SET_ARG(var, arg) var.SetArg(arg)
+// Add the rest of the enclosing block to a category
+#define TRACE_TIME(category) Trace::Timer TRACE_JOIN(traceTimer_, __LINE__)(Trace::category)
+#define TRACE_COUNT(counter, n) Trace::Count(Trace::counter, n)
+#endif
+
+#endif
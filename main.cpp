@@ -14,6 +14,8 @@ public:
     * @return: true if initialization succeeds
     */
     bool OnInit() override {
+        // Parses the standard options such as --verbose
+        if (!wxApp::OnInit()) return false;
         MainFrame* frame = new MainFrame("File Manager");
         frame->Show(true);
         return true;